@@ -0,0 +1,490 @@
+#define _POSIX_C_SOURCE 200809L
+#include "btree.h"
+#include "bufpool.h"
+#include "heap.h"
+#include "pages.h"
+#include "row.h"
+#include "wal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * MiniDB benchmarks, run with `make bench`.
+ *
+ * Microbenchmarks time a tight loop over one building block (row
+ * encoding, heap pages, B-tree leaves, the WAL) and report ops/sec. Ops
+ * that touch the disk are also timed one by one for latency percentiles.
+ *
+ * The macro benchmark is a YCSB-style key-value workload on a table of
+ * fixed-size rows in heap pages, read and updated through the buffer
+ * pool. Updates rewrite the row in place and log it to the WAL, committed
+ * in groups of UPDATE_GROUP. Workloads A (50% updates), B (5%) and C
+ * (read only) each run with uniform and zipfian key choice; the zipfian
+ * ranks are scrambled by a hash, as YCSB does, so the hot keys are spread
+ * over the table instead of sharing a few pages.
+ *
+ * Numbers are only comparable between builds with the same CFLAGS and on
+ * the same machine.
+ */
+
+#define BENCH_DB "bench.db"
+
+#define MICRO_OPS 2000000
+#define WAL_APPEND_OPS 200000
+#define WAL_FLUSH_OPS 200
+#define LEAF_KEYS 4096
+
+#define YCSB_RECORDS 100000
+#define YCSB_OPS 200000
+#define YCSB_FIELD_LEN 100
+#define YCSB_POOL_PAGES 1024
+#define UPDATE_GROUP 100
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*: fast, and good enough for picking keys.
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+static volatile uint64_t sink; // keeps results alive past the optimizer
+
+static int u64_compare(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Print one result line. Per-op latencies, if given, are sorted in place
+ * for the percentiles.
+ */
+static void report(const char* name, uint64_t ops, uint64_t elapsed_ns,
+                   uint64_t* latencies, size_t n)
+{
+    double secs = (double)elapsed_ns / 1e9;
+    printf("%-30s %12.0f ops/s", name, secs > 0 ? (double)ops / secs : 0.0);
+
+    if (latencies && n > 0)
+    {
+        qsort(latencies, n, sizeof(uint64_t), u64_compare);
+        printf("   p50 %8.2f us  p95 %8.2f us  p99 %8.2f us  p99.9 %8.2f us",
+               latencies[n / 2] / 1e3, latencies[n * 95 / 100] / 1e3,
+               latencies[n * 99 / 100] / 1e3, latencies[n * 999 / 1000] / 1e3);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void bench_row_codec(void)
+{
+    const char* text = "some.user@example.com/profile";
+    MDBValue row[] = {mdb_value_int(123456789), mdb_value_text(text, (uint16_t)strlen(text)),
+                      mdb_value_null(), mdb_value_int(-42)};
+    uint8_t buf[256];
+    uint16_t size = 0;
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < MICRO_OPS; i++)
+    {
+        row[0].integer = i;
+        mdb_row_encode(row, 4, buf, sizeof(buf), &size);
+        sink += buf[size / 2];
+    }
+    report("row encode (4 cols)", MICRO_OPS, now_ns() - start, NULL, 0);
+
+    MDBValue out[4];
+    uint16_t ncols;
+    start = now_ns();
+    for (uint32_t i = 0; i < MICRO_OPS; i++)
+    {
+        mdb_row_decode(buf, size, out, 4, &ncols);
+        sink += (uint64_t)out[0].integer + ncols;
+    }
+    report("row decode (4 cols)", MICRO_OPS, now_ns() - start, NULL, 0);
+}
+
+static void bench_heap_page(void)
+{
+    uint8_t record[64];
+    memset(record, 'r', sizeof(record));
+
+    MDBPage page;
+    mdb_heap_page_init(&page, 1);
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < MICRO_OPS; i++)
+    {
+        MDBSlotID slot;
+        if (mdb_heap_page_insert(&page, record, sizeof(record), &slot) != OK)
+        {
+            mdb_heap_page_init(&page, 1);
+            mdb_heap_page_insert(&page, record, sizeof(record), &slot);
+        }
+        sink += slot;
+    }
+    report("heap page insert (64 B)", MICRO_OPS, now_ns() - start, NULL, 0);
+
+    mdb_heap_page_init(&page, 1);
+    MDBSlotID nslots = 0;
+    while (mdb_heap_page_insert(&page, record, sizeof(record), &nslots) == OK)
+    {
+    }
+    nslots = (MDBSlotID)(nslots + 1);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < MICRO_OPS; i++)
+    {
+        const uint8_t* rec;
+        uint16_t size;
+        mdb_heap_page_get(&page, (MDBSlotID)(rng_next() % nslots), &rec, &size);
+        sink += size;
+    }
+    report("heap page get", MICRO_OPS, now_ns() - start, NULL, 0);
+}
+
+static void bench_btree_leaf(void)
+{
+    static char keys[LEAF_KEYS][24];
+    for (uint32_t i = 0; i < LEAF_KEYS; i++)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "user:%010llu", (unsigned long long)(rng_next() % 10000000000ull));
+    }
+
+    MDBPage page;
+    mdb_btree_leaf_init(&page);
+    uint32_t inserted = 0;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < MICRO_OPS / 4; i++)
+    {
+        const char* key = keys[i % LEAF_KEYS];
+        MDBRecord rec = {i, 0};
+        if (mdb_btree_leaf_insert(&page, (UTF8String){(uint16_t)strlen(key), key}, rec) != OK)
+        {
+            mdb_btree_leaf_init(&page);
+        }
+        inserted++;
+    }
+    report("btree leaf insert", inserted, now_ns() - start, NULL, 0);
+
+    // Fill one leaf, then look up random keys that are in it.
+    mdb_btree_leaf_init(&page);
+    uint32_t nkeys = 0;
+    while (nkeys < LEAF_KEYS)
+    {
+        MDBRecord rec = {nkeys, 0};
+        const char* key = keys[nkeys];
+        if (mdb_btree_leaf_insert(&page, (UTF8String){(uint16_t)strlen(key), key}, rec) != OK) break;
+        nkeys++;
+    }
+
+    start = now_ns();
+    for (uint32_t i = 0; i < MICRO_OPS; i++)
+    {
+        const char* key = keys[rng_next() % nkeys];
+        uint16_t idx;
+        sink += mdb_btree_leaf_find(&page, (UTF8String){(uint16_t)strlen(key), key}, &idx) + idx;
+    }
+    report("btree leaf lookup", MICRO_OPS, now_ns() - start, NULL, 0);
+}
+
+static void bench_wal(MiniDB* db)
+{
+    MDBWal* wal;
+    if (mdb_wal_open(db, &wal) != OK)
+    {
+        fprintf(stderr, "bench: cannot open the WAL\n");
+        return;
+    }
+
+    uint8_t payload[100];
+    memset(payload, 'w', sizeof(payload));
+    MDBWalRecord record = {WAL_OP_UPDATE, 0, 1, sizeof(payload)};
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < WAL_APPEND_OPS; i++)
+    {
+        record.lsn = i;
+        mdb_wal_append(wal, &record, payload);
+    }
+    mdb_wal_flush(wal);
+    report("wal append (100 B, 1 flush)", WAL_APPEND_OPS, now_ns() - start, NULL, 0);
+
+    uint64_t* latencies = malloc(sizeof(uint64_t) * WAL_FLUSH_OPS);
+    start = now_ns();
+    for (uint32_t i = 0; latencies && i < WAL_FLUSH_OPS; i++)
+    {
+        uint64_t t = now_ns();
+        mdb_wal_append(wal, &record, payload);
+        mdb_wal_flush(wal);
+        latencies[i] = now_ns() - t;
+    }
+    if (latencies) report("wal append + flush (fsync)", WAL_FLUSH_OPS, now_ns() - start, latencies, WAL_FLUSH_OPS);
+
+    free(latencies);
+    mdb_wal_close(wal);
+}
+
+/* YCSB-style workload */
+
+typedef struct
+{
+    MDBPageNumber* pages; // where each key's row lives
+    MDBSlotID* slots;
+    double* zipf_cdf;     // cumulative probability of rank i
+    MDBBufferPool* pool;
+} Ycsb;
+
+static void make_row(uint64_t key, char* field, MDBValue* row)
+{
+    for (int i = 0; i < YCSB_FIELD_LEN; i++)
+    {
+        field[i] = (char)('a' + (rng_next() % 26));
+    }
+    row[0] = mdb_value_int((int64_t)key);
+    row[1] = mdb_value_text(field, YCSB_FIELD_LEN);
+}
+
+/**
+ * Write YCSB_RECORDS rows into fresh heap pages.
+ */
+static ErrorCode ycsb_load(MiniDB* db, Ycsb* y)
+{
+    char field[YCSB_FIELD_LEN];
+    MDBValue row[2];
+    uint8_t buf[256];
+    uint16_t size;
+
+    MDBPage page;
+    mdb_heap_page_init(&page, 1);
+    uint32_t first = 0; // first key on the page being filled
+
+    for (uint32_t key = 0; key <= YCSB_RECORDS; key++)
+    {
+        MDBSlotID slot = 0;
+        if (key < YCSB_RECORDS)
+        {
+            make_row(key, field, row);
+            mdb_row_encode(row, 2, buf, sizeof(buf), &size);
+            if (mdb_heap_page_insert(&page, buf, size, &slot) == OK)
+            {
+                y->slots[key] = slot;
+                continue;
+            }
+        }
+
+        // The page is full (or this is the end): write it out.
+        MDBPageNumber page_num;
+        ErrorCode err = mdb_page_allocate(db, &page, &page_num);
+        if (err != OK) return err;
+        for (uint32_t k = first; k < key; k++)
+        {
+            y->pages[k] = page_num;
+        }
+        if (key == YCSB_RECORDS) break;
+
+        first = key;
+        mdb_heap_page_init(&page, 1);
+        mdb_heap_page_insert(&page, buf, size, &slot);
+        y->slots[key] = slot;
+    }
+    return OK;
+}
+
+/**
+ * Zipfian ranks with s = 1 by inverse CDF (exact, and needs no libm),
+ * scrambled into keys with a multiplicative hash.
+ */
+static uint32_t zipf_key(const Ycsb* y)
+{
+    double u = (double)(rng_next() >> 11) / 9007199254740992.0;
+    uint32_t lo = 0;
+    uint32_t hi = YCSB_RECORDS - 1;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (y->zipf_cdf[mid] < u)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return (uint32_t)(((uint64_t)lo * 0x9E3779B97F4A7C15ull >> 20) % YCSB_RECORDS);
+}
+
+static ErrorCode ycsb_read(Ycsb* y, uint32_t key)
+{
+    MDBPage* page;
+    ErrorCode err = mdb_buffer_pin(y->pool, y->pages[key], MDB_ACCESS_NORMAL, &page);
+    if (err != OK) return err;
+
+    const uint8_t* rec;
+    uint16_t size;
+    MDBValue row[2];
+    uint16_t ncols;
+    err = mdb_heap_page_get(page, y->slots[key], &rec, &size);
+    if (err == OK && !mdb_row_decode(rec, size, row, 2, &ncols)) err = ERR_CORRUPT;
+    if (err == OK) sink += (uint64_t)row[0].integer;
+
+    mdb_buffer_unpin(y->pool, page, false);
+    return err;
+}
+
+static ErrorCode ycsb_update(MiniDB* db, Ycsb* y, uint32_t key)
+{
+    char field[YCSB_FIELD_LEN];
+    MDBValue row[2];
+    uint8_t buf[256];
+    uint16_t size;
+    make_row(key, field, row);
+    mdb_row_encode(row, 2, buf, sizeof(buf), &size);
+
+    MDBPage* page;
+    ErrorCode err = mdb_buffer_pin(y->pool, y->pages[key], MDB_ACCESS_NORMAL, &page);
+    if (err != OK) return err;
+
+    // Rows are fixed-size, so the new version fits in the old one's place.
+    const uint8_t* rec;
+    uint16_t old_size;
+    err = mdb_heap_page_get(page, y->slots[key], &rec, &old_size);
+    if (err == OK && old_size != size) err = ERR_CORRUPT;
+    if (err == OK) memcpy(page->data + (rec - page->data), buf, size);
+    mdb_buffer_unpin(y->pool, page, err == OK);
+    if (err != OK) return err;
+
+    MDBWalRecord record = {WAL_OP_UPDATE, 0, y->pages[key], size};
+    return mdb_log(db, &record, buf);
+}
+
+static void ycsb_run(MiniDB* db, Ycsb* y, const char* name,
+                     uint32_t update_pct, bool zipfian, uint64_t* latencies)
+{
+    uint32_t updates = 0;
+    ErrorCode err = OK;
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < YCSB_OPS && err == OK; i++)
+    {
+        uint32_t key = zipfian ? zipf_key(y) : (uint32_t)(rng_next() % YCSB_RECORDS);
+        bool update = rng_next() % 100 < update_pct;
+
+        uint64_t t = now_ns();
+        if (update)
+        {
+            if (updates % UPDATE_GROUP == 0) err = mdb_begin(db);
+            if (err == OK) err = ycsb_update(db, y, key);
+            if (err == OK && ++updates % UPDATE_GROUP == 0) err = mdb_commit(db);
+        }
+        else
+        {
+            err = ycsb_read(y, key);
+        }
+        latencies[i] = now_ns() - t;
+    }
+    if (err == OK && updates % UPDATE_GROUP != 0) err = mdb_commit(db);
+    uint64_t elapsed = now_ns() - start;
+
+    if (err != OK)
+    {
+        fprintf(stderr, "bench: %s failed: %d\n", name, err);
+        return;
+    }
+    report(name, YCSB_OPS, elapsed, latencies, YCSB_OPS);
+}
+
+static void bench_ycsb(MiniDB* db)
+{
+    Ycsb y;
+    y.pages = malloc(sizeof(MDBPageNumber) * YCSB_RECORDS);
+    y.slots = malloc(sizeof(MDBSlotID) * YCSB_RECORDS);
+    y.zipf_cdf = malloc(sizeof(double) * YCSB_RECORDS);
+    uint64_t* latencies = malloc(sizeof(uint64_t) * YCSB_OPS);
+    if (!y.pages || !y.slots || !y.zipf_cdf || !latencies)
+    {
+        fprintf(stderr, "bench: out of memory\n");
+        goto done;
+    }
+
+    double total = 0.0;
+    for (uint32_t i = 0; i < YCSB_RECORDS; i++)
+    {
+        total += 1.0 / (i + 1);
+        y.zipf_cdf[i] = total;
+    }
+    for (uint32_t i = 0; i < YCSB_RECORDS; i++)
+    {
+        y.zipf_cdf[i] /= total;
+    }
+
+    uint64_t start = now_ns();
+    ErrorCode err = ycsb_load(db, &y);
+    if (err != OK)
+    {
+        fprintf(stderr, "bench: loading failed: %d\n", err);
+        goto done;
+    }
+    report("ycsb load", YCSB_RECORDS, now_ns() - start, NULL, 0);
+
+    if (mdb_buffer_pool_create(db, YCSB_POOL_PAGES, &y.pool) != OK)
+    {
+        fprintf(stderr, "bench: cannot create the buffer pool\n");
+        goto done;
+    }
+
+    ycsb_run(db, &y, "ycsb A uniform (50% update)", 50, false, latencies);
+    ycsb_run(db, &y, "ycsb A zipfian (50% update)", 50, true, latencies);
+    ycsb_run(db, &y, "ycsb B uniform (5% update)", 5, false, latencies);
+    ycsb_run(db, &y, "ycsb B zipfian (5% update)", 5, true, latencies);
+    ycsb_run(db, &y, "ycsb C uniform (read only)", 0, false, latencies);
+    ycsb_run(db, &y, "ycsb C zipfian (read only)", 0, true, latencies);
+
+    mdb_buffer_pool_destroy(y.pool);
+
+done:
+    free(y.pages);
+    free(y.slots);
+    free(y.zipf_cdf);
+    free(latencies);
+}
+
+int main(void)
+{
+    remove(BENCH_DB);
+    remove(BENCH_DB "-wal");
+
+    MiniDB* db;
+    if (mdb_open(BENCH_DB, &db) != OK)
+    {
+        fprintf(stderr, "bench: cannot open %s\n", BENCH_DB);
+        return EXIT_FAILURE;
+    }
+
+    printf("MiniDB benchmarks (page size %u)\n\n", (unsigned)MDB_PAGE_SIZE);
+    bench_row_codec();
+    bench_heap_page();
+    bench_btree_leaf();
+    bench_wal(db);
+    printf("\n");
+    bench_ycsb(db);
+
+    mdb_close(db);
+    remove(BENCH_DB);
+    remove(BENCH_DB "-wal");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include "db.h"
+#include "errors.h"
+#include <pthread.h>
+#include <stdint.h>
+
+#define MDB_BACKUP_CHUNK_PAGES 64
+#define MDB_BACKUP_MAX_PASSES 8
+#define MDB_BACKUP_FINAL_PAGES 256 // few enough to copy with writers paused
+#define MDB_INCREMENTAL_MAGIC "MDBINCR1"
+
+typedef struct MDBBackupTracker MDBBackupTracker;
+
+typedef struct
+{
+    uint32_t pages;     // pages in the database
+    uint32_t copied;    // page images written, recopies included
+    uint32_t recopied;  // copies of pages that changed after being copied
+    uint32_t passes;    // catch-up passes before the final one
+    uint64_t wal_bytes;
+    uint64_t lsn;       // the backup holds every page LSN below this
+} MDBBackupStats;
+
+// Where a backup ends; an incremental taken from it starts there.
+typedef struct
+{
+    uint64_t lsn;
+    uint64_t wal_size;
+} MDBBackupPoint;
+
+// Start of an incremental backup file, followed by
+// [uint32_t page number][page image] records. A page may appear more than
+// once; the last copy wins. Its WAL bytes [wal_from, wal_to) are in
+// "path-wal".
+typedef struct
+{
+    char magic[8];
+    uint32_t page_size;
+    uint32_t page_count;
+    uint64_t since_lsn;
+    uint64_t end_lsn;
+    uint64_t wal_from;
+    uint64_t wal_to;
+} MDBIncrementalHeader;
+
+ErrorCode mdb_backup(MiniDB* db, const char* path, const char* base_path,
+                     pthread_mutex_t* writer_lock, MDBBackupStats* out_stats);
+ErrorCode mdb_backup_point(const char* path, MDBBackupPoint* out_point);
+ErrorCode mdb_restore(const char* dest_path, const char* full_path,
+                      const char* const* incremental_paths, uint32_t n);
+
+void mdb_backup_note_write(MiniDB* db, MDBPageNumber first, uint32_t count);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include "db.h"
+#include "errors.h"
+#include "pages.h"
+#include "row.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Longest key the tree accepts, so that every page holds at least four.
+#define MDB_BTREE_KEY_MAX ((uint16_t)((MDB_PAGE_USABLE_SIZE - 64) / 4))
+#define MDB_BTREE_MAX_DEPTH 16
+
+typedef struct
+{
+    MDBPageType type;
+    uint16_t n_keys;
+    uint16_t prefix_len; // bytes shared by every key, stored once after the header
+    uint16_t free_start;
+    uint16_t free_end;
+} MDBBTreeLeafHeader;
+
+typedef struct
+{
+    MDBPageType type;
+    uint16_t n_keys;
+    uint16_t free_start;
+    uint16_t free_end;
+    MDBPageNumber first_child; // keys below the first separator
+} MDBBTreeInternalHeader;
+
+void mdb_btree_leaf_init(MDBPage* page);
+
+uint16_t mdb_btree_leaf_count(const MDBPage* page);
+
+uint16_t mdb_btree_leaf_prefix_len(const MDBPage* page);
+
+uint16_t mdb_btree_leaf_free_space(const MDBPage* page);
+
+bool mdb_btree_leaf_is_safe(const MDBPage* page, uint16_t max_key_len);
+
+bool mdb_btree_leaf_find(const MDBPage* page, UTF8String key,
+                         uint16_t* out_idx);
+
+ErrorCode mdb_btree_leaf_insert(MDBPage* page, UTF8String key,
+                                MDBRecord record);
+
+ErrorCode mdb_btree_leaf_delete(MDBPage* page, uint16_t idx);
+
+ErrorCode mdb_btree_leaf_get(const MDBPage* page, uint16_t idx, char* key_buf,
+                             uint16_t cap, uint16_t* out_len,
+                             MDBRecord* out_record);
+
+ErrorCode mdb_btree_leaf_split(MDBPage* left, MDBPage* right, char* sep_buf,
+                               uint16_t cap, uint16_t* out_sep_len);
+
+ErrorCode mdb_btree_separator(UTF8String lower, UTF8String upper, char* out,
+                              uint16_t cap, uint16_t* out_len);
+
+void mdb_btree_internal_init(MDBPage* page, MDBPageNumber first_child);
+
+uint16_t mdb_btree_internal_count(const MDBPage* page);
+
+MDBPageNumber mdb_btree_internal_child(const MDBPage* page, UTF8String key);
+
+ErrorCode mdb_btree_internal_insert(MDBPage* page, UTF8String sep,
+                                    MDBPageNumber child);
+
+ErrorCode mdb_btree_internal_split(MDBPage* left, MDBPage* right,
+                                   char* sep_buf, uint16_t cap,
+                                   uint16_t* out_sep_len);
+
+ErrorCode mdb_btree_create(MiniDB* db, MDBPageNumber* out_root);
+
+ErrorCode mdb_btree_insert(MiniDB* db, MDBPageNumber root, UTF8String key,
+                           MDBRecord record);
+
+ErrorCode mdb_btree_lookup(MiniDB* db, MDBPageNumber root, UTF8String key,
+                           MDBRecord* out_records, uint32_t cap,
+                           uint32_t* out_count);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include "db.h"
+#include "errors.h"
+#include "pages.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MDB_BUFFER_RING_SIZE 16
+
+typedef struct MDBBufferPool MDBBufferPool;
+
+typedef enum
+{
+    MDB_ACCESS_NORMAL,
+    MDB_ACCESS_SCAN, // large sequential read; must not displace hot pages
+} MDBBufferAccess;
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t ring_reads; // misses served from the scan ring
+} MDBBufferStats;
+
+// Sequential pass over pages [next, end) through the pool's scan ring.
+typedef struct
+{
+    MDBBufferPool* pool;
+    MDBPageNumber next;
+    MDBPageNumber end;
+    MDBPage* current;
+    MDBPageNumber current_num;
+    ErrorCode err;
+} MDBBufferScan;
+
+ErrorCode mdb_buffer_pool_create(MiniDB* db, uint32_t capacity,
+                                 MDBBufferPool** out_pool);
+
+ErrorCode mdb_buffer_pool_destroy(MDBBufferPool* pool);
+
+ErrorCode mdb_buffer_pin(MDBBufferPool* pool, MDBPageNumber page_num,
+                         MDBBufferAccess access, MDBPage** out_page);
+
+void mdb_buffer_unpin(MDBBufferPool* pool, MDBPage* page, bool dirty);
+
+ErrorCode mdb_buffer_flush(MDBBufferPool* pool);
+
+void mdb_buffer_pool_stats(MDBBufferPool* pool, MDBBufferStats* out_stats);
+
+void mdb_buffer_scan_open(MDBBufferPool* pool, MDBPageNumber start,
+                          MDBPageNumber end, MDBBufferScan* out_scan);
+
+bool mdb_buffer_scan_next(MDBBufferScan* scan, const MDBPage** out_page,
+                          MDBPageNumber* out_page_num);
+
+void mdb_buffer_scan_close(MDBBufferScan* scan);
+
+#endif
@@ -4,8 +4,15 @@
 #include "db.h"
 #include "errors.h"
 #include "index.h"
+#include "stats.h"
+#include "wal.h"
 #include <stdint.h>
 
+#define MDB_ROW_ID_BATCH 1024
+
+#define MDB_TABLE_COMPRESSED 0x0001 // heap pages stored compressed on disk
+#define MDB_TABLE_COLUMNAR 0x0002   // one PG_COLUMN chain per column, no heap
+
 typedef struct MDBCatalog MDBCatalog;
 
 typedef struct
@@ -19,6 +26,7 @@ typedef struct
     char name[MDB_TABLE_NAME_MAX];
     MDBPageNumber heap_root;
     uint16_t ncols;
+    uint32_t flags;
     uint64_t next_row_id;
 } MDBCatalogTableMetadata;
 
@@ -42,6 +50,29 @@ ErrorCode mdb_catalog_create_table(MDBCatalog* catalog, const char* table_name,
 
 ErrorCode mdb_catalog_drop_table(MDBCatalog* catalog, const char* table_name);
 
+ErrorCode mdb_catalog_set_table_flags(MDBCatalog* catalog,
+                                      const char* table_name, uint32_t flags);
+
+ErrorCode mdb_catalog_get_column(MDBCatalog* catalog, const char* table_name,
+                                 uint16_t col_idx, MDBCatalogColumn* out_col);
+
+ErrorCode mdb_catalog_get_column_root(MDBCatalog* catalog,
+                                      const char* table_name, uint16_t col_idx,
+                                      MDBPageNumber* out_root);
+
+ErrorCode mdb_catalog_set_column_root(MDBCatalog* catalog,
+                                      const char* table_name, uint16_t col_idx,
+                                      MDBPageNumber root);
+
+ErrorCode mdb_catalog_set_column_stats(MDBCatalog* catalog,
+                                       const char* table_name, uint16_t col_idx,
+                                       const MDBColumnStats* stats);
+
+ErrorCode mdb_catalog_get_column_stats(MDBCatalog* catalog,
+                                       const char* table_name, uint16_t col_idx,
+                                       MDBColumnStats* out_stats,
+                                       bool* out_analyzed);
+
 ErrorCode mdb_catalog_list_tables(MDBCatalog* catalog,
                                   MDBCatalogTableMetadata** out_array,
                                   uint32_t* out_count);
@@ -0,0 +1,52 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include "db.h"
+#include "errors.h"
+#include "pages.h"
+#include "row.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MDB_COLUMN_MAX_VALUES MDB_PAGE_SIZE // per page
+
+typedef enum
+{
+    MDB_COL_ENC_FOR = 1,  // INT: frame of reference, bit-packed offsets
+    MDB_COL_ENC_RLE = 2,  // TEXT: runs of equal values
+    MDB_COL_ENC_DICT = 3, // TEXT: up to 256 distinct values, one-byte codes
+} MDBColumnEncoding;
+
+typedef struct
+{
+    MDBPageType type;   // PG_COLUMN
+    MDBPageNumber next; // 0 ends the chain
+    uint32_t count;     // values on this page, NULLs included
+    uint8_t encoding;   // MDBColumnEncoding
+    uint8_t has_nulls;  // a bitmap of `count` bits precedes the data
+    uint16_t data_len;  // bytes following the header
+} MDBColumnPageHeader;
+
+// Page-at-a-time reader over one column's chain.
+typedef struct
+{
+    MiniDB* db;
+    MDBPageNumber next;
+    MDBPage page;      // decoded TEXT values point into this page
+    MDBValue* values;  // MDB_COLUMN_MAX_VALUES entries
+    ErrorCode err;
+} MDBColumnScan;
+
+ErrorCode mdb_column_append(MiniDB* db, MDBColumnType type,
+                            MDBPageNumber* io_first_page,
+                            const MDBValue* values, uint32_t n);
+
+ErrorCode mdb_column_scan_open(MiniDB* db, MDBPageNumber first_page,
+                               MDBColumnScan* out_scan);
+
+bool mdb_column_scan_next(MDBColumnScan* scan, const MDBValue** out_values,
+                          uint32_t* out_count);
+
+void mdb_column_scan_close(MDBColumnScan* scan);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t mdb_crc32c(uint32_t crc, const void* data, size_t len);
+
+uint32_t mdb_crc32c_sw(uint32_t crc, const void* data, size_t len);
+
+#endif
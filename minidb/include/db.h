@@ -6,8 +6,19 @@
 #include <stdio.h>
 
 #define MDB_MAGIC "MINIDB1"
+// Chosen at build time (make PAGE_SIZE=16384); recorded in every file's
+// header and checked when the file is opened.
+#ifndef MDB_PAGE_SIZE
 #define MDB_PAGE_SIZE 4096
-#define MDB_VERSION 1
+#endif
+
+_Static_assert(MDB_PAGE_SIZE >= 4096 && MDB_PAGE_SIZE <= 65536 &&
+                   (MDB_PAGE_SIZE & (MDB_PAGE_SIZE - 1)) == 0,
+               "MDB_PAGE_SIZE must be a power of two between 4096 and 65536");
+// 1: original layout
+// 2: checksummed page trailers with LSNs, compressed pages, free list
+// 3: catalog stored in the file
+#define MDB_VERSION 3
 
 #define MDB_TABLE_NAME_MAX 64
 
@@ -49,12 +60,21 @@ typedef struct
     uint32_t page_size;
     MDBEndianness endianness;
     uint32_t version;
+    MDBPageNumber free_trunk; // first trunk page of the free list, 0 if empty
+    uint32_t free_count;      // pages on the free list, trunks included
+    uint64_t lsn_reserved;    // page LSNs below this may already be in use
+    uint64_t backup_lsn;      // in a full backup: it holds every page LSN below this
+    uint64_t backup_wal_size; // in a full backup: WAL bytes it holds
+    MDBPageNumber catalog_root; // overflow chain holding the catalog, 0 if none
+    uint32_t catalog_size;      // bytes in that chain
 } MDBHeader;
 
 ErrorCode mdb_open(const char* filename, MiniDB** out_db);
 
 ErrorCode mdb_close(MiniDB* db);
 
+const char* mdb_filename(const MiniDB* db);
+
 ErrorCode mdb_header_write(FILE* fp);
 
 ErrorCode mdb_header_check(FILE* fp);
@@ -11,6 +11,8 @@ typedef enum
     ERR_PARSE,
     ERR_INVALID,
     ERR_UNSUPPORTED,
+    ERR_CONFLICT,
+    ERR_CORRUPT,
 } ErrorCode;
 
 #endif
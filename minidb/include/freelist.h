@@ -0,0 +1,36 @@
+#ifndef FREELIST_H
+#define FREELIST_H
+
+#include "db.h"
+#include "errors.h"
+#include "pages.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    MDBPageType type;   // PG_FREE
+    MDBPageNumber next; // next trunk, 0 ends the list
+    uint32_t count;     // leaf page numbers that follow
+} MDBFreeTrunkHeader;
+
+#define MDB_FREE_TRUNK_CAPACITY \
+    ((MDB_PAGE_USABLE_SIZE - sizeof(MDBFreeTrunkHeader)) / sizeof(MDBPageNumber))
+
+// Called when shrinking moves a live page; must repoint every reference.
+// Runs with page allocation locked, so it must not allocate or free pages.
+typedef ErrorCode (*MDBPageRelocateFn)(void* ctx, MDBPageNumber from,
+                                       MDBPageNumber to);
+
+ErrorCode mdb_page_free(MiniDB* db, MDBPageNumber page_num);
+
+ErrorCode mdb_freelist_pop(MiniDB* db, bool* out_found,
+                           MDBPageNumber* out_page_num);
+
+uint32_t mdb_freelist_count(MiniDB* db);
+
+ErrorCode mdb_page_shrink(MiniDB* db, uint32_t max_moves,
+                          MDBPageRelocateFn relocate, void* ctx,
+                          uint32_t* out_released);
+
+#endif
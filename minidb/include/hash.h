@@ -0,0 +1,76 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "db.h"
+#include "errors.h"
+#include "pages.h"
+#include "row.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    MDBPageType type;
+    uint8_t local_depth;
+    uint16_t n_entries;
+    MDBPageNumber overflow; // next bucket page in the chain, 0 if none
+    uint32_t reserved;      // keeps the entry array 8-byte aligned
+} MDBHashBucketHeader;
+
+typedef struct
+{
+    MDBPageType type;
+    uint8_t global_depth;
+    uint8_t reserved[3];
+} MDBHashDirHeader;
+
+#define MDB_HASH_DIR_CAPACITY \
+    ((MDB_PAGE_USABLE_SIZE - sizeof(MDBHashDirHeader)) / sizeof(MDBPageNumber))
+
+typedef struct
+{
+    uint64_t hash;
+    MDBRecord record;
+} MDBHashEntry;
+
+#define MDB_HASH_BUCKET_CAPACITY \
+    ((MDB_PAGE_USABLE_SIZE - sizeof(MDBHashBucketHeader)) / sizeof(MDBHashEntry))
+
+uint64_t mdb_hash_key(MDBValue key);
+
+static inline uint32_t mdb_hash_dir_slot(uint64_t hash, uint8_t global_depth)
+{
+    return (uint32_t)(hash & ((1ull << global_depth) - 1));
+}
+
+void mdb_hash_bucket_init(MDBPage* page, uint8_t local_depth);
+
+uint16_t mdb_hash_bucket_count(const MDBPage* page);
+
+uint8_t mdb_hash_bucket_local_depth(const MDBPage* page);
+
+ErrorCode mdb_hash_bucket_insert(MDBPage* page, uint64_t hash,
+                                 MDBRecord record);
+
+ErrorCode mdb_hash_bucket_delete(MDBPage* page, uint64_t hash,
+                                 MDBRecord record);
+
+ErrorCode mdb_hash_bucket_lookup(const MDBPage* page, uint64_t hash,
+                                 MDBRecord* out_records, uint32_t cap,
+                                 uint32_t* out_count);
+
+ErrorCode mdb_hash_bucket_split(MDBPage* page, MDBPage* out_image);
+
+ErrorCode mdb_hash_create(MiniDB* db, MDBPageNumber* out_dir);
+
+ErrorCode mdb_hash_insert(MiniDB* db, MDBPageNumber dir, uint64_t hash,
+                          MDBRecord record);
+
+ErrorCode mdb_hash_delete(MiniDB* db, MDBPageNumber dir, uint64_t hash,
+                          MDBRecord record);
+
+ErrorCode mdb_hash_lookup(MiniDB* db, MDBPageNumber dir, uint64_t hash,
+                          MDBRecord* out_records, uint32_t cap,
+                          uint32_t* out_count);
+
+#endif
@@ -10,6 +10,7 @@ typedef struct MDBIndex MDBIndex;
 typedef enum
 {
     MDB_INDEX_BTREE,
+    MDB_INDEX_HASH,
 } MDBIndexType;
 
 typedef struct
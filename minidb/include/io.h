@@ -0,0 +1,35 @@
+#ifndef IO_H
+#define IO_H
+
+#include "db.h"
+#include "errors.h"
+#include "pages.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MDB_IO_READAHEAD_PAGES 32
+
+ErrorCode mdb_io_init(MiniDB* db);
+
+uint32_t mdb_io_page_count(MiniDB* db);
+
+uint32_t mdb_io_block_size(const MiniDB* db);
+
+ErrorCode mdb_io_read(MiniDB* db, MDBPageNumber page_num, MDBPage* out_page);
+
+ErrorCode mdb_io_write(MiniDB* db, MDBPageNumber page_num, const MDBPage* page);
+
+ErrorCode mdb_io_read_batch(MiniDB* db, MDBIoRequest* reqs, uint32_t n);
+
+ErrorCode mdb_io_write_batch(MiniDB* db, MDBIoRequest* reqs, uint32_t n);
+
+ErrorCode mdb_io_write_sparse(MiniDB* db, MDBPageNumber page_num,
+                              const void* data, uint32_t len);
+
+void mdb_io_readahead(MiniDB* db, MDBPageNumber start, uint32_t count);
+
+ErrorCode mdb_io_sync(MiniDB* db);
+
+ErrorCode mdb_io_truncate(MiniDB* db, uint32_t page_count);
+
+#endif
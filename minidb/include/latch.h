@@ -0,0 +1,53 @@
+#ifndef LATCH_H
+#define LATCH_H
+
+#include "db.h"
+#include "errors.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MDB_LATCH_PATH_MAX 32
+
+typedef struct MDBLatchTable MDBLatchTable;
+
+typedef enum
+{
+    MDB_LATCH_SHARED,
+    MDB_LATCH_EXCLUSIVE,
+} MDBLatchMode;
+
+// Latches held along one root-to-leaf descent, oldest first.
+typedef struct
+{
+    MDBPageNumber pages[MDB_LATCH_PATH_MAX];
+    MDBLatchMode modes[MDB_LATCH_PATH_MAX];
+    uint16_t depth;
+} MDBLatchPath;
+
+ErrorCode mdb_latch_table_create(MDBLatchTable** out_table);
+
+void mdb_latch_table_destroy(MDBLatchTable* table);
+
+MDBLatchTable* mdb_latches(MiniDB* db);
+
+ErrorCode mdb_latch_acquire(MDBLatchTable* table, MDBPageNumber page_num,
+                            MDBLatchMode mode);
+
+bool mdb_latch_try_acquire(MDBLatchTable* table, MDBPageNumber page_num,
+                           MDBLatchMode mode);
+
+void mdb_latch_release(MDBLatchTable* table, MDBPageNumber page_num);
+
+static inline void mdb_latch_path_init(MDBLatchPath* path)
+{
+    path->depth = 0;
+}
+
+ErrorCode mdb_latch_path_push(MDBLatchTable* table, MDBLatchPath* path,
+                              MDBPageNumber page_num, MDBLatchMode mode);
+
+void mdb_latch_path_release_ancestors(MDBLatchTable* table, MDBLatchPath* path);
+
+void mdb_latch_path_release_all(MDBLatchTable* table, MDBLatchPath* path);
+
+#endif
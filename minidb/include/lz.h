@@ -0,0 +1,11 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+size_t mdb_lz_compress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap);
+
+size_t mdb_lz_decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "errors.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Latencies below 2^SUB_BITS ns get a bucket each; every power of two
+// above that is split into 2^SUB_BITS buckets, so a bucket is within ~6%
+// of the values it holds. Values from 2^MAX_BITS ns (~18 min) up share
+// the last bucket.
+#define MDB_METRICS_SUB_BITS 4
+#define MDB_METRICS_MAX_BITS 40
+#define MDB_METRICS_BUCKETS \
+    ((MDB_METRICS_MAX_BITS - MDB_METRICS_SUB_BITS + 1) << MDB_METRICS_SUB_BITS)
+#define MDB_METRICS_STATEMENT_KINDS 24
+
+typedef enum
+{
+    MDB_COUNTER_PAGE_READS,
+    MDB_COUNTER_PAGE_WRITES,
+    MDB_COUNTER_BUFFER_HITS,
+    MDB_COUNTER_BUFFER_MISSES,
+    MDB_COUNTER_WAL_FLUSHES,
+    MDB_COUNTER_FSYNCS,
+    MDB_COUNTER_LOCK_WAITS,
+    MDB_COUNTER_COUNT
+} MDBCounter;
+
+typedef enum
+{
+    MDB_LATENCY_WAL_FLUSH,
+    MDB_LATENCY_FSYNC,
+    MDB_LATENCY_LOCK_WAIT,
+    MDB_LATENCY_STATEMENT, // plus the StmtKind
+    MDB_LATENCY_COUNT = MDB_LATENCY_STATEMENT + MDB_METRICS_STATEMENT_KINDS
+} MDBLatency;
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[MDB_METRICS_BUCKETS];
+} MDBLatencyHistogram;
+
+typedef struct
+{
+    uint64_t counters[MDB_COUNTER_COUNT];
+    MDBLatencyHistogram latencies[MDB_LATENCY_COUNT];
+} MDBMetrics;
+
+uint64_t mdb_metrics_now(void);
+
+void mdb_metrics_add(MDBCounter counter, uint64_t n);
+
+void mdb_metrics_record(MDBLatency latency, uint64_t ns);
+
+void mdb_metrics_snapshot(MDBMetrics* out_metrics);
+
+uint64_t mdb_metrics_percentile(const MDBLatencyHistogram* histogram,
+                                double percentile);
+
+void mdb_metrics_format(const MDBMetrics* metrics, FILE* out,
+                        const char* const* statement_names,
+                        uint32_t nstatements);
+
+ErrorCode mdb_metrics_dump(FILE* out, const char* const* statement_names,
+                           uint32_t nstatements);
+
+#endif
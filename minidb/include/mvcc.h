@@ -0,0 +1,76 @@
+#ifndef MVCC_H
+#define MVCC_H
+
+#include "db.h"
+#include "errors.h"
+#include "heap.h"
+#include "pages.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint64_t MDBTxnID;
+
+#define MDB_TXN_INVALID 0
+#define MDB_XID_BATCH 1024 // transaction ids reserved per WAL write
+
+typedef struct MDBTxnManager MDBTxnManager;
+
+typedef enum
+{
+    MDB_TXN_IN_PROGRESS = 0,
+    MDB_TXN_COMMITTED = 1,
+    MDB_TXN_ABORTED = 2,
+} MDBTxnStatus;
+
+// Prepended to every row version stored in the heap.
+typedef struct
+{
+    MDBTxnID xmin; // transaction that created this version
+    MDBTxnID xmax; // transaction that deleted it, MDB_TXN_INVALID if live
+} MDBTupleHeader;
+
+typedef struct
+{
+    MDBTxnID self; // the snapshot's own transaction, sees its own writes
+    MDBTxnID xmin; // every transaction below this had finished
+    MDBTxnID xmax; // every transaction at or above this had not started
+    MDBTxnID* active;
+    uint32_t nactive;
+} MDBSnapshot;
+
+ErrorCode mdb_txn_manager_create(MiniDB* db, MDBTxnManager** out_mgr);
+
+void mdb_txn_manager_destroy(MDBTxnManager* mgr);
+
+ErrorCode mdb_txn_begin(MDBTxnManager* mgr, MDBTxnID* out_xid);
+
+ErrorCode mdb_txn_commit(MDBTxnManager* mgr, MDBTxnID xid);
+
+ErrorCode mdb_txn_abort(MDBTxnManager* mgr, MDBTxnID xid);
+
+MDBTxnStatus mdb_txn_status(MDBTxnManager* mgr, MDBTxnID xid);
+
+ErrorCode mdb_snapshot_take(MDBTxnManager* mgr, MDBTxnID self,
+                            MDBSnapshot* out_snapshot);
+
+void mdb_snapshot_release(MDBSnapshot* snapshot);
+
+bool mdb_tuple_visible(MDBTxnManager* mgr, const MDBSnapshot* snapshot,
+                       const MDBTupleHeader* tuple);
+
+ErrorCode mdb_mvcc_insert(MDBPage* page, MDBTxnID xid, const uint8_t* record,
+                          uint16_t size, MDBSlotID* out_slot);
+
+ErrorCode mdb_mvcc_delete(MDBTxnManager* mgr, MDBPageNumber page_num,
+                          MDBPage* page, MDBSlotID slot, MDBTxnID xid);
+
+ErrorCode mdb_mvcc_get(MDBTxnManager* mgr, const MDBPage* page, MDBSlotID slot,
+                       const MDBSnapshot* snapshot, const uint8_t** out_record,
+                       uint16_t* out_size);
+
+bool mdb_mvcc_iter_next(MDBTxnManager* mgr, const MDBPage* page,
+                        MDBHeapIter* it, const MDBSnapshot* snapshot,
+                        MDBSlotID* out_slot, const uint8_t** out_record,
+                        uint16_t* out_size);
+
+#endif
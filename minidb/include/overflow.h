@@ -0,0 +1,36 @@
+#ifndef OVERFLOW_H
+#define OVERFLOW_H
+
+#include "db.h"
+#include "errors.h"
+#include "pages.h"
+#include "row.h"
+#include <stdint.h>
+
+#define MDB_OVERFLOW_PREFIX 32
+#define MDB_ROW_TARGET_SIZE (MDB_PAGE_USABLE_SIZE / 4)
+
+typedef struct
+{
+    MDBPageType type;
+    MDBPageNumber next; // 0 ends the chain
+    uint16_t len;       // bytes of data on this page
+    uint16_t reserved;
+} MDBOverflowHeader;
+
+#define MDB_OVERFLOW_CAPACITY (MDB_PAGE_USABLE_SIZE - sizeof(MDBOverflowHeader))
+
+ErrorCode mdb_overflow_write(MiniDB* db, const uint8_t* data, uint32_t len,
+                             MDBPageNumber* out_first_page);
+
+ErrorCode mdb_overflow_read(MiniDB* db, MDBPageNumber first_page, uint8_t* out,
+                            uint32_t len);
+
+ErrorCode mdb_overflow_free(MiniDB* db, MDBPageNumber first_page);
+
+ErrorCode mdb_overflow_externalize(MiniDB* db, MDBValue* cols, uint16_t ncols);
+
+ErrorCode mdb_overflow_fetch(MiniDB* db, const MDBValue* value, char* buf,
+                             uint32_t cap, MDBValue* out_value);
+
+#endif
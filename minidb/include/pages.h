@@ -12,13 +12,59 @@ typedef enum
     PG_INDEX_INTERNAL = 2,
     PG_INDEX_LEAF = 3,
     PG_FREE = 4,
+    PG_HASH_BUCKET = 5,
+    PG_COMPRESSED = 6, // on-disk only; never seen above mdb_page_read
+    PG_OVERFLOW = 7,
+    PG_COLUMN = 8,
+    PG_HASH_DIR = 9,
 } MDBPageType;
 
+#define MDB_PAGE_FLAG_COMPRESS 0x0001 // store compressed on disk when it pays off
+
 typedef struct
 {
-    uint8_t data[MDB_PAGE_SIZE];
+    _Alignas(8) uint8_t data[MDB_PAGE_SIZE];
 } MDBPage;
 
+#define MDB_LSN_BATCH 1024 // page LSNs reserved per header write
+
+// Stored in the last bytes of every page, after the format's own data.
+typedef struct
+{
+    uint64_t lsn; // stamped on every write; increases across the whole file
+    uint16_t flags;
+    uint16_t reserved;
+    uint32_t checksum; // CRC32C of everything before it
+} MDBPageTrailer;
+
+#define MDB_PAGE_USABLE_SIZE (MDB_PAGE_SIZE - sizeof(MDBPageTrailer))
+
+// Header of a page image stored compressed; the rest of the slot is a hole.
+typedef struct
+{
+    MDBPageType type; // PG_COMPRESSED
+    uint32_t size;    // compressed bytes following the header
+    uint32_t checksum; // CRC32C of those bytes
+    uint64_t lsn;      // the page's own LSN, readable without expanding it
+} MDBCompressedPageHeader;
+
+typedef struct
+{
+    MDBPageNumber page_num;
+    MDBPage* page;
+} MDBIoRequest;
+
+// Sequential page scan that keeps the kernel reading ahead of the cursor.
+typedef struct
+{
+    MiniDB* db;
+    MDBPageNumber next;
+    MDBPageNumber end;
+    MDBPageNumber prefetched; // read-ahead issued up to here (exclusive)
+    uint32_t window;
+    ErrorCode err;
+} MDBPageScan;
+
 void mdb_page_zero(MDBPage* page);
 
 void mdb_page_set_type(MDBPage* page, MDBPageType type);
@@ -27,6 +73,22 @@ MDBPageType mdb_page_get_type(const MDBPage* page);
 
 bool mdb_page_is_type(const MDBPage* page, MDBPageType type);
 
+uint16_t mdb_page_flags(const MDBPage* page);
+
+void mdb_page_set_flags(MDBPage* page, uint16_t flags);
+
+uint64_t mdb_page_lsn(const MDBPage* page);
+
+uint64_t mdb_page_image_lsn(const MDBPage* image);
+
+ErrorCode mdb_page_lsn_next(MiniDB* db, uint64_t* out_lsn);
+
+ErrorCode mdb_page_lsn_peek(MiniDB* db, uint64_t* out_lsn);
+
+void mdb_page_checksum_set(MDBPage* page);
+
+bool mdb_page_checksum_ok(const MDBPage* page);
+
 uint32_t mdb_page_count(MiniDB* db);
 
 static inline void mdb_page_init(MDBPage* page, MDBPageType type)
@@ -37,10 +99,17 @@ static inline void mdb_page_init(MDBPage* page, MDBPageType type)
 
 ErrorCode mdb_page_read(MiniDB* db, MDBPageNumber page_num, MDBPage* out_page);
 
-ErrorCode mdb_page_write(MiniDB* db, MDBPageNumber page_num,
-                         const MDBPage* page);
+ErrorCode mdb_page_write(MiniDB* db, MDBPageNumber page_num, MDBPage* page);
 
-ErrorCode mdb_page_allocate(MiniDB* db, const MDBPage* page,
+ErrorCode mdb_page_write_batch(MiniDB* db, MDBIoRequest* reqs, uint32_t n);
+
+ErrorCode mdb_page_allocate(MiniDB* db, MDBPage* page,
                             MDBPageNumber* out_page_num);
 
+void mdb_page_scan_begin(MiniDB* db, MDBPageNumber start, MDBPageNumber end,
+                         uint32_t window, MDBPageScan* out_scan);
+
+bool mdb_page_scan_next(MDBPageScan* scan, MDBPage* out_page,
+                        MDBPageNumber* out_page_num);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef QCACHE_H
+#define QCACHE_H
+
+#include "db.h"
+#include "errors.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct MDBResultCache MDBResultCache;
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale; // lookups that found an entry for an older table version
+    uint64_t evictions;
+    size_t bytes;
+    uint32_t entries;
+} MDBResultCacheStats;
+
+ErrorCode mdb_result_cache_create(size_t max_bytes,
+                                  MDBResultCache** out_cache);
+
+void mdb_result_cache_destroy(MDBResultCache* cache);
+
+uint64_t mdb_result_cache_version(MDBResultCache* cache, const char* table_name);
+
+bool mdb_result_cache_get(MDBResultCache* cache, const char* key,
+                          const char* table_name, uint8_t** out_data,
+                          size_t* out_len);
+
+ErrorCode mdb_result_cache_put(MDBResultCache* cache, const char* key,
+                               const char* table_name, uint64_t version,
+                               const uint8_t* data, size_t len);
+
+void mdb_result_cache_invalidate(MDBResultCache* cache, const char* table_name);
+
+void mdb_result_cache_stats(MDBResultCache* cache, MDBResultCacheStats* out_stats);
+
+ErrorCode mdb_result_cache_enable(MiniDB* db, size_t max_bytes);
+
+MDBResultCache* mdb_result_cache(const MiniDB* db);
+
+#endif
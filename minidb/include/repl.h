@@ -2,9 +2,12 @@
 #define REPL_H
 
 #include "db.h"
+#include "index.h"
 #include "row.h"
 #include <ctype.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 typedef enum
@@ -18,6 +21,12 @@ typedef enum
     STMT_UPDATE,
     STMT_CREATE_INDEX,
     STMT_DROP_INDEX,
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_ROLLBACK,
+    STMT_ANALYZE,
+    STMT_STATS,
+    STMT_BACKUP,
     STMT_HELP,
     STMT_EXIT
 } StmtKind;
@@ -40,6 +49,8 @@ typedef struct
     const char* name;
     MDBColumnDef cols[64];
     uint16_t ncols;
+    bool compressed; // WITH (compression = lz)
+    bool columnar;   // WITH (storage = column)
 } StmtCreateTable;
 
 typedef struct
@@ -53,6 +64,7 @@ typedef struct
     const char* table_name;
     uint16_t col_idx;
     bool is_unique;
+    MDBIndexType type;
 } StmtCreateIndex;
 
 typedef struct
@@ -87,6 +99,17 @@ typedef struct
     WherePred where;
 } StmtDelete;
 
+typedef struct
+{
+    const char* table_name; // NULL analyzes every table
+} StmtAnalyze;
+
+typedef struct
+{
+    const char* path;
+    const char* base; // SINCE: the backup to start from, NULL for a full one
+} StmtBackup;
+
 typedef struct
 {
     StmtKind kind;
@@ -99,6 +122,8 @@ typedef struct
         StmtSelect select_;
         StmtDelete delete_;
         StmtUpdate update_;
+        StmtAnalyze analyze;
+        StmtBackup backup;
     };
 } Statement;
 
@@ -111,12 +136,46 @@ typedef struct
     int pos;
 } Tokens;
 
-void tokenize(const char* line, Tokens* out_tokens);
+ErrorCode tokenize(const char* line, Tokens* out_tokens);
 void free_tokens(Tokens* tokens);
 
 ErrorCode parse_statement(const Tokens* tokens, Statement* out_stmt);
 void free_statement(Statement* stmt);
 
-ErrorCode execute_statement(MiniDB* db, const Statement* stmt);
+/* Scripts */
+
+#define SCRIPT_CHUNK_SIZE 65536
+
+typedef struct
+{
+    FILE* in;
+    char* chunk; // read from `in`, consumed up to pos
+    size_t pos;
+    size_t len;
+    char* stmt; // the statement being assembled
+    size_t stmt_len;
+    size_t stmt_cap;
+} ScriptReader;
+
+ErrorCode script_reader_init(ScriptReader* reader, FILE* in);
+ErrorCode script_next_statement(ScriptReader* reader, const char** out_sql);
+void script_reader_free(ScriptReader* reader);
+
+char* statement_cache_key(const Statement* stmt);
+
+/* Execution */
+
+typedef struct
+{
+    ErrorCode (*row)(void* ctx, const MDBValue* cols, uint16_t ncols);
+    void* ctx;
+} RowSink;
+
+ErrorCode emit_row(const RowSink* rows, FILE* out, const MDBValue* cols,
+                   uint16_t ncols);
+ErrorCode execute_statement(MiniDB* db, const Statement* stmt, FILE* out,
+                            const RowSink* rows);
+ErrorCode execute_backup(MiniDB* db, const Statement* stmt, FILE* out,
+                         pthread_mutex_t* writer_lock);
 
 #endif
\ No newline at end of file
@@ -7,12 +7,21 @@
 
 #define MDB_TEXT_MAX UINT16_MAX
 
+#define MDB_ROW_EXTERNAL 0x80 // type flag: TEXT continues in overflow pages
+
 typedef struct
 {
     uint16_t length;
     const char* ptr;
 } UTF8String;
 
+// Where the full value of a large TEXT lives when only a prefix is inline.
+typedef struct
+{
+    MDBPageNumber first_page; // 0 if the value is stored inline
+    uint16_t length;          // full length of the value
+} MDBOverflowRef;
+
 typedef struct
 {
     bool is_null; // If true, ignore type and union
@@ -21,6 +30,7 @@ typedef struct
         int64_t integer;
         UTF8String text;
     };
+    MDBOverflowRef overflow; // TEXT only: text holds just the prefix if set
 } MDBValue;
 
 uint16_t mdb_row_encoded_size(const MDBValue* cols, uint16_t ncols);
@@ -49,4 +59,9 @@ static inline MDBValue mdb_value_text(const char* p, uint16_t len)
     return v;
 }
 
+static inline bool mdb_value_is_external(const MDBValue* v)
+{
+    return !v->is_null && v->type == COL_TYPE_TEXT && v->overflow.first_page != 0;
+}
+
 #endif
\ No newline at end of file
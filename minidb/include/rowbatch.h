@@ -0,0 +1,29 @@
+#ifndef ROWBATCH_H
+#define ROWBATCH_H
+
+#include "errors.h"
+#include "row.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct MDBRowBatch MDBRowBatch;
+
+ErrorCode mdb_row_batch_create(uint16_t ncols, MDBRowBatch** out_batch);
+void mdb_row_batch_destroy(MDBRowBatch* batch);
+void mdb_row_batch_reset(MDBRowBatch* batch);
+
+ErrorCode mdb_row_batch_append(MDBRowBatch* batch, const MDBValue* cols,
+                               uint16_t ncols);
+
+uint16_t mdb_row_batch_ncols(const MDBRowBatch* batch);
+uint32_t mdb_row_batch_nrows(const MDBRowBatch* batch);
+size_t mdb_row_batch_encoded_size(const MDBRowBatch* batch);
+ErrorCode mdb_row_batch_encode(const MDBRowBatch* batch, uint8_t* buffer,
+                               size_t cap, size_t* out_size);
+
+ErrorCode mdb_row_batch_decode(const uint8_t* data, size_t size,
+                               uint16_t* out_ncols, uint32_t* out_nrows);
+ErrorCode mdb_row_batch_column(const uint8_t* data, size_t size, uint16_t col,
+                               MDBValue* out_values);
+
+#endif
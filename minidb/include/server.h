@@ -0,0 +1,47 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "db.h"
+#include "errors.h"
+#include <stdint.h>
+
+// Every frame is [u32 length, little endian][u8 type][payload]; length
+// counts the type byte and the payload.
+#define MDB_FRAME_HEADER_SIZE 5
+#define MDB_FRAME_MAX_SIZE (1u << 20)
+#define MDB_SERVER_BATCH_SIZE 16384
+#define MDB_SERVER_SPOOL_SIZE (16u << 20)
+
+typedef enum
+{
+    MDB_MSG_QUERY = 1,      // client -> server: SQL text
+    MDB_MSG_TEXT = 2,       // server -> client: a batch of result output
+    MDB_MSG_DONE = 3,       // server -> client: i32 ErrorCode, ends a result
+    MDB_MSG_QUERY_ROWS = 4, // client -> server: SQL text, rows as MDB_MSG_ROWS
+    MDB_MSG_ROWS = 5,       // server -> client: rows encoded by rowbatch.h
+} MDBMessageType;
+
+typedef struct
+{
+    const char* address; // "host:port", ":port" or a Unix socket path
+    uint32_t workers;    // 0 picks a default
+    uint32_t spool_size; // output held per statement, 0: MDB_SERVER_SPOOL_SIZE
+} MDBServerConfig;
+
+typedef struct MDBServer MDBServer;
+
+ErrorCode mdb_server_start(MiniDB* db, const MDBServerConfig* config,
+                           MDBServer** out_server);
+void mdb_server_stop(MDBServer* server);
+
+/* Client side */
+
+ErrorCode mdb_wire_connect(const char* address, int* out_fd);
+ErrorCode mdb_wire_send(int fd, uint8_t type, const void* payload,
+                        uint32_t len);
+ErrorCode mdb_wire_recv(int fd, uint8_t* out_type, uint8_t** out_payload,
+                        uint32_t* out_len);
+ErrorCode mdb_wire_query(int fd, const char* sql, char** out_text,
+                         ErrorCode* out_result);
+
+#endif
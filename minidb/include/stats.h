@@ -0,0 +1,66 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "db.h"
+#include "errors.h"
+#include "row.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MDB_HLL_PRECISION 10
+#define MDB_HLL_REGISTERS (1u << MDB_HLL_PRECISION)
+#define MDB_HISTOGRAM_BUCKETS 16
+#define MDB_STATS_SAMPLE 4096
+
+typedef struct
+{
+    uint8_t registers[MDB_HLL_REGISTERS];
+} MDBHyperLogLog;
+
+typedef struct
+{
+    uint64_t row_count;
+    uint64_t null_count;
+    uint64_t distinct; // HyperLogLog estimate over non-NULL values
+    uint16_t nbuckets; // 0 if there is no histogram (TEXT, or no values)
+    int64_t bounds[MDB_HISTOGRAM_BUCKETS + 1]; // equi-depth, INT only
+} MDBColumnStats;
+
+typedef struct MDBStatsBuilder MDBStatsBuilder;
+
+typedef enum
+{
+    MDB_ACCESS_PATH_SCAN,
+    MDB_ACCESS_PATH_INDEX,
+} MDBAccessPath;
+
+void mdb_hll_init(MDBHyperLogLog* hll);
+
+void mdb_hll_add(MDBHyperLogLog* hll, uint64_t hash);
+
+uint64_t mdb_hll_estimate(const MDBHyperLogLog* hll);
+
+uint64_t mdb_value_hash(const MDBValue* value);
+
+ErrorCode mdb_stats_builder_create(MDBColumnType type,
+                                   MDBStatsBuilder** out_builder);
+
+void mdb_stats_builder_add(MDBStatsBuilder* builder, const MDBValue* value);
+
+void mdb_stats_builder_finish(MDBStatsBuilder* builder,
+                              MDBColumnStats* out_stats);
+
+void mdb_stats_builder_destroy(MDBStatsBuilder* builder);
+
+double mdb_stats_selectivity_eq(const MDBColumnStats* stats);
+
+double mdb_stats_selectivity_range(const MDBColumnStats* stats, int64_t lo,
+                                   int64_t hi);
+
+MDBAccessPath mdb_stats_choose_access(const MDBColumnStats* stats,
+                                      uint32_t heap_pages, double selectivity);
+
+void mdb_stats_order_joins(const double* cardinalities, uint16_t n,
+                           uint16_t* out_order);
+
+#endif
@@ -4,6 +4,7 @@
 #include "db.h"
 #include "errors.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct MDBWal MDBWal;
@@ -15,6 +16,9 @@ typedef enum
     WAL_OP_DELETE,
     WAL_OP_PAGE_WRITE,
     WAL_OP_COMMIT,
+    WAL_OP_ROW_ID_RESERVE,
+    WAL_OP_XID_RESERVE, // payload: u64, xids below it may be in use
+    WAL_OP_TXN_COMMIT,  // payload: u64, the MVCC transaction that committed
 } MDBWalOpType;
 
 typedef struct
@@ -34,6 +38,32 @@ ErrorCode mdb_wal_append(MDBWal* wal, const MDBWalRecord* record,
 
 ErrorCode mdb_wal_flush(MDBWal* wal);
 
+ErrorCode mdb_wal_write_direct(MDBWal* wal, const MDBWalRecord* record,
+                               const void* payload);
+
+typedef ErrorCode (*MDBWalScanFn)(void* ctx, const MDBWalRecord* record,
+                                  const void* payload);
+
+ErrorCode mdb_wal_scan(MDBWal* wal, MDBWalScanFn fn, void* ctx);
+
+size_t mdb_wal_buffered(MDBWal* wal);
+
+ErrorCode mdb_wal_discard(MDBWal* wal, size_t mark);
+
+ErrorCode mdb_wal_commit(MDBWal* wal);
+
+ErrorCode mdb_wal_get(MiniDB* db, MDBWal** out_wal);
+
+ErrorCode mdb_log(MiniDB* db, const MDBWalRecord* record, const void* payload);
+
+ErrorCode mdb_begin(MiniDB* db);
+
+ErrorCode mdb_commit(MiniDB* db);
+
+ErrorCode mdb_rollback(MiniDB* db);
+
+bool mdb_in_transaction(const MiniDB* db);
+
 ErrorCode mdb_wal_replay(MiniDB* db, MDBWal* wal);
 
 ErrorCode mdb_recover(const char* filename, MiniDB** out_db);
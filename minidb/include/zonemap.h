@@ -0,0 +1,34 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include "db.h"
+#include "errors.h"
+#include "row.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MDB_ZONE_BLOOM_BITS 256 // per TEXT column per page
+
+typedef struct MDBZoneMap MDBZoneMap;
+
+ErrorCode mdb_zone_map_create(const MDBColumnDef* cols, uint16_t ncols,
+                              MDBZoneMap** out_map);
+
+void mdb_zone_map_destroy(MDBZoneMap* map);
+
+ErrorCode mdb_zone_map_add_row(MDBZoneMap* map, MDBPageNumber page_num,
+                               const MDBValue* cols, uint16_t ncols);
+
+ErrorCode mdb_zone_map_reset_page(MDBZoneMap* map, MDBPageNumber page_num);
+
+void mdb_zone_map_drop_page(MDBZoneMap* map, MDBPageNumber page_num);
+
+ErrorCode mdb_zone_map_build(MDBZoneMap* map, MiniDB* db, uint32_t table_id);
+
+bool mdb_zone_map_may_contain(MDBZoneMap* map, MDBPageNumber page_num,
+                              uint16_t col, const MDBValue* value);
+
+bool mdb_zone_map_may_overlap(MDBZoneMap* map, MDBPageNumber page_num,
+                              uint16_t col, int64_t lo, int64_t hi);
+
+#endif
@@ -0,0 +1,669 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "backup.h"
+#include "db_internal.h"
+#include "io.h"
+#include "pages.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Online backup.
+ *
+ * BACKUP TO 'path' copies the database file page by page while other
+ * statements keep writing, and leaves a database that opens like the
+ * original: "path" plus "path-wal".
+ *
+ * While a backup runs, every page the data file receives is marked in a
+ * bitmap (io.c reports each write). The backup copies all pages once,
+ * then recopies the pages marked since, repeating until few enough are
+ * left. Only then are writers paused, for a final pass over the last
+ * marked pages and the end of the WAL; the file is cut to the source's
+ * page count at that moment. A page read while it was being written is
+ * marked by that write, so torn copies are always replaced.
+ *
+ * Committed changes reach the WAL before the data file, and the log is
+ * append-only, so most of it is copied while writers run and only the
+ * tail appended since then is copied during the pause. Records of a
+ * transaction that is still open sit in its in-memory buffer and are
+ * not part of the backup, exactly as after a crash.
+ *
+ * Writers are whoever holds `writer_lock`: the server passes its
+ * statement lock. A caller that already keeps writers out (the REPL runs
+ * one statement at a time) passes NULL.
+ *
+ * Incremental backups. Every page written carries an LSN (see pages.c),
+ * and while writers are paused the backup notes the next LSN to be handed
+ * out: every page in the copy has a smaller one. Given an earlier backup
+ * as its base, BACKUP TO 'path' SINCE 'base' goes through the same passes
+ * but keeps only the pages stamped at or after the base's end point, as
+ * [page number][image] records after an MDBIncrementalHeader, plus the
+ * WAL bytes appended since. Page 0 has no LSN and is always kept. The
+ * pages are still read to find their LSNs, but only the changed ones are
+ * written. A full backup records its end point in its file header, an
+ * incremental in its own header, so either can be the base of the next.
+ *
+ * mdb_restore rebuilds a database from a full backup and the chain of
+ * incrementals taken after it, checking that each starts where the one
+ * before ended.
+ */
+
+struct MDBBackupTracker
+{
+    pthread_mutex_t lock;
+    uint64_t* changed; // one bit per page written since the last take
+    uint32_t nwords;
+    uint32_t count;    // bits set
+    bool all;          // the bitmap couldn't grow: treat every page as changed
+};
+
+typedef struct
+{
+    MiniDB* db;
+    MDBBackupTracker* tracker;
+    int fd;
+    MDBPage* pages; // MDB_BACKUP_CHUNK_PAGES
+    uint32_t copied;
+    bool incremental;
+    uint64_t since; // incremental: keep pages stamped at or after this
+    off_t end;      // incremental: where the next record goes
+} BackupCopy;
+
+static void tracker_mark(MDBBackupTracker* t, MDBPageNumber first, uint32_t count)
+{
+    pthread_mutex_lock(&t->lock);
+
+    uint32_t needed = (uint32_t)(((uint64_t)first + count + 63) / 64);
+    if (needed > t->nwords && !t->all)
+    {
+        uint32_t nwords = t->nwords ? t->nwords : 64;
+        while (nwords < needed)
+        {
+            nwords *= 2;
+        }
+
+        uint64_t* changed = realloc(t->changed, nwords * sizeof(uint64_t));
+        if (changed)
+        {
+            memset(changed + t->nwords, 0, (nwords - t->nwords) * sizeof(uint64_t));
+            t->changed = changed;
+            t->nwords = nwords;
+        }
+        else
+        {
+            t->all = true;
+        }
+    }
+
+    for (uint32_t i = 0; i < count && !t->all; i++)
+    {
+        MDBPageNumber p = first + i;
+        uint64_t bit = 1ull << (p % 64);
+        if (!(t->changed[p / 64] & bit))
+        {
+            t->changed[p / 64] |= bit;
+            t->count++;
+        }
+    }
+
+    pthread_mutex_unlock(&t->lock);
+}
+
+static uint32_t tracker_pending(MDBBackupTracker* t)
+{
+    pthread_mutex_lock(&t->lock);
+    uint32_t count = t->all ? UINT32_MAX : t->count;
+    pthread_mutex_unlock(&t->lock);
+    return count;
+}
+
+/**
+ * Hand over the marks made so far and start collecting new ones.
+ */
+static void tracker_take(MDBBackupTracker* t, uint64_t** out_changed,
+                         uint32_t* out_nwords, bool* out_all)
+{
+    pthread_mutex_lock(&t->lock);
+    *out_changed = t->changed;
+    *out_nwords = t->nwords;
+    *out_all = t->all;
+    t->changed = NULL;
+    t->nwords = 0;
+    t->count = 0;
+    t->all = false;
+    pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * Called by io.c after pages reach the data file.
+ */
+void mdb_backup_note_write(MiniDB* db, MDBPageNumber first, uint32_t count)
+{
+    if (!db || !db->backup || count == 0) return;
+    tracker_mark(db->backup, first, count);
+}
+
+static ErrorCode write_all(int fd, const uint8_t* buf, size_t len, off_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, buf, len, offset);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return ERR_IO;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return OK;
+}
+
+/**
+ * Read exactly `len` bytes; running into the end of the file is
+ * ERR_CORRUPT.
+ */
+static ErrorCode read_all(int fd, void* buf, size_t len, off_t offset)
+{
+    uint8_t* p = buf;
+    while (len > 0)
+    {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return ERR_IO;
+        }
+        if (n == 0) return ERR_CORRUPT;
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return OK;
+}
+
+/**
+ * Append the run's pages stamped at or after c->since as records.
+ */
+static ErrorCode copy_run_changed(BackupCopy* c, MDBPageNumber first, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        MDBPageNumber page_num = first + i;
+        if (page_num != 0 && mdb_page_image_lsn(&c->pages[i]) < c->since) continue;
+
+        ErrorCode err = write_all(c->fd, (const uint8_t*)&page_num, sizeof(page_num), c->end);
+        if (err == OK)
+        {
+            err = write_all(c->fd, c->pages[i].data, MDB_PAGE_SIZE,
+                            c->end + (off_t)sizeof(page_num));
+        }
+        if (err != OK) return err;
+
+        c->end += (off_t)(sizeof(page_num) + MDB_PAGE_SIZE);
+        c->copied++;
+    }
+    return OK;
+}
+
+/**
+ * Copy pages [first, first + count), count <= MDB_BACKUP_CHUNK_PAGES, as
+ * raw images: compressed pages stay compressed.
+ */
+static ErrorCode copy_run(BackupCopy* c, MDBPageNumber first, uint32_t count)
+{
+    MDBIoRequest reqs[MDB_BACKUP_CHUNK_PAGES];
+    for (uint32_t i = 0; i < count; i++)
+    {
+        reqs[i].page_num = first + i;
+        reqs[i].page = &c->pages[i];
+    }
+
+    ErrorCode err = mdb_io_read_batch(c->db, reqs, count);
+    if (err != OK)
+    {
+        // The file shrank under us. What is left of the run gets
+        // another try; the final pass only copies pages that still exist.
+        if (first + count > mdb_io_page_count(c->db))
+        {
+            tracker_mark(c->tracker, first, count);
+            return OK;
+        }
+        return err;
+    }
+
+    if (c->incremental) return copy_run_changed(c, first, count);
+
+    c->copied += count;
+    return write_all(c->fd, c->pages[0].data, (size_t)count * MDB_PAGE_SIZE,
+                     (off_t)first * MDB_PAGE_SIZE);
+}
+
+static ErrorCode copy_range(BackupCopy* c, MDBPageNumber start, MDBPageNumber end)
+{
+    for (MDBPageNumber p = start; p < end; p += MDB_BACKUP_CHUNK_PAGES)
+    {
+        uint32_t count = end - p < MDB_BACKUP_CHUNK_PAGES ? end - p : MDB_BACKUP_CHUNK_PAGES;
+        ErrorCode err = copy_run(c, p, count);
+        if (err != OK) return err;
+    }
+    return OK;
+}
+
+/**
+ * Recopy every page marked since the last pass, in runs of consecutive
+ * pages.
+ */
+static ErrorCode copy_changed(BackupCopy* c)
+{
+    uint64_t* changed;
+    uint32_t nwords;
+    bool all;
+    tracker_take(c->tracker, &changed, &nwords, &all);
+
+    MDBPageNumber end = mdb_io_page_count(c->db);
+    if (all)
+    {
+        free(changed);
+        return copy_range(c, 0, end);
+    }
+
+    ErrorCode err = OK;
+    MDBPageNumber run_start = 0;
+    uint32_t run_len = 0;
+    for (uint32_t w = 0; w < nwords && err == OK; w++)
+    {
+        uint64_t bits = changed[w];
+        while (bits && err == OK)
+        {
+            MDBPageNumber p = w * 64 + (uint32_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (p >= end) break;
+
+            if (run_len > 0 && (p != run_start + run_len || run_len == MDB_BACKUP_CHUNK_PAGES))
+            {
+                err = copy_run(c, run_start, run_len);
+                run_len = 0;
+            }
+            if (run_len == 0) run_start = p;
+            run_len++;
+        }
+    }
+    if (err == OK && run_len > 0) err = copy_run(c, run_start, run_len);
+
+    free(changed);
+    return err;
+}
+
+/**
+ * Copy whatever the file at `src_path` holds past `from` to `dst_fd`,
+ * starting at `at`, and add the bytes copied to *copied. A missing file
+ * is just empty.
+ */
+static ErrorCode copy_tail(const char* src_path, uint64_t from, int dst_fd,
+                           uint64_t at, uint64_t* copied)
+{
+    int fd = open(src_path, O_RDONLY);
+    if (fd < 0) return errno == ENOENT ? OK : ERR_IO;
+
+    ErrorCode err = OK;
+    uint8_t buf[65536];
+    for (;;)
+    {
+        ssize_t n = pread(fd, buf, sizeof(buf), (off_t)from);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) err = ERR_IO;
+        if (n <= 0) break;
+
+        err = write_all(dst_fd, buf, (size_t)n, (off_t)at);
+        if (err != OK) break;
+        from += (uint64_t)n;
+        at += (uint64_t)n;
+        *copied += (uint64_t)n;
+    }
+
+    close(fd);
+    return err;
+}
+
+static uint64_t file_size(const char* path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+// True if `path` names the file `st` was taken from.
+static bool same_file(const char* path, const struct stat* st)
+{
+    struct stat path_st;
+    return stat(path, &path_st) == 0 && path_st.st_dev == st->st_dev && path_st.st_ino == st->st_ino;
+}
+
+static char* path_with_suffix(const char* path, const char* suffix)
+{
+    size_t len = strlen(path) + strlen(suffix) + 1;
+    char* out = malloc(len);
+    if (out) snprintf(out, len, "%s%s", path, suffix);
+    return out;
+}
+
+/**
+ * Record `point` in the file header of the database copy open on `fd`.
+ * A zero point marks it as an ordinary database again.
+ */
+static ErrorCode header_set_point(int fd, const MDBBackupPoint* point)
+{
+    MDBPage page;
+    ErrorCode err = read_all(fd, page.data, MDB_PAGE_SIZE, 0);
+    if (err != OK) return err;
+
+    MDBHeader header;
+    memcpy(&header, page.data, sizeof(header));
+    header.backup_lsn = point->lsn;
+    header.backup_wal_size = point->wal_size;
+    memcpy(page.data, &header, sizeof(header));
+    mdb_page_checksum_set(&page);
+    return write_all(fd, page.data, MDB_PAGE_SIZE, 0);
+}
+
+static ErrorCode point_read(const char* path, MDBBackupPoint* out_point,
+                            bool* out_incremental)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return ERR_IO;
+
+    // An incremental can be shorter than a page, so look at its header
+    // first.
+    MDBIncrementalHeader inc;
+    MDBPage page;
+    ErrorCode err = read_all(fd, &inc, sizeof(inc), 0);
+    bool incremental = err == OK && memcmp(inc.magic, MDB_INCREMENTAL_MAGIC, sizeof(inc.magic)) == 0;
+    if (err == OK && !incremental) err = read_all(fd, page.data, MDB_PAGE_SIZE, 0);
+    close(fd);
+
+    if (err != OK) return err == ERR_CORRUPT ? ERR_INVALID : err;
+    *out_incremental = incremental;
+
+    if (incremental)
+    {
+        if (inc.page_size != MDB_PAGE_SIZE) return ERR_INVALID;
+        *out_point = (MDBBackupPoint){inc.end_lsn, inc.wal_to};
+        return OK;
+    }
+
+    MDBHeader header;
+    memcpy(&header, page.data, sizeof(header));
+    if (memcmp(header.magic, MDB_MAGIC, sizeof(MDB_MAGIC)) != 0 ||
+        header.version != MDB_VERSION || header.backup_lsn == 0)
+    {
+        return ERR_INVALID;
+    }
+    *out_point = (MDBBackupPoint){header.backup_lsn, header.backup_wal_size};
+    return OK;
+}
+
+/**
+ * Where the backup at `path`, full or incremental, ends.
+ */
+ErrorCode mdb_backup_point(const char* path, MDBBackupPoint* out_point)
+{
+    if (!path || !out_point) return ERR_INVALID;
+
+    bool incremental;
+    return point_read(path, out_point, &incremental);
+}
+
+static void writers_pause(pthread_mutex_t* writer_lock)
+{
+    if (writer_lock) pthread_mutex_lock(writer_lock);
+}
+
+static void writers_resume(pthread_mutex_t* writer_lock)
+{
+    if (writer_lock) pthread_mutex_unlock(writer_lock);
+}
+
+/**
+ * Finish an incremental: its header goes in last, so a copy that stopped
+ * half way is never mistaken for a complete one.
+ */
+static ErrorCode incremental_finish(BackupCopy* c, const MDBBackupStats* stats,
+                                    const MDBBackupPoint* since, uint64_t wal_end)
+{
+    MDBIncrementalHeader h = {.magic = MDB_INCREMENTAL_MAGIC,
+                              .page_size = MDB_PAGE_SIZE,
+                              .page_count = stats->pages,
+                              .since_lsn = since->lsn,
+                              .end_lsn = stats->lsn,
+                              .wal_from = since->wal_size,
+                              .wal_to = wal_end};
+
+    ErrorCode err = write_all(c->fd, (const uint8_t*)&h, sizeof(h), 0);
+    if (err == OK && ftruncate(c->fd, c->end) != 0) err = ERR_IO;
+    return err;
+}
+
+/**
+ * Write a consistent copy of `db` to `path` (and `path`-wal) while writers
+ * holding `writer_lock` keep going. With a `base_path`, only what changed
+ * since that backup is written. Both files are created: ERR_INVALID if
+ * either exists or `path` is the database or its WAL. On failure the
+ * partial copy is removed.
+ */
+ErrorCode mdb_backup(MiniDB* db, const char* path, const char* base_path,
+                     pthread_mutex_t* writer_lock, MDBBackupStats* out_stats)
+{
+    if (!db || !path) return ERR_INVALID;
+
+    struct stat src_st;
+    if (fstat(fileno(db->fp), &src_st) != 0) return ERR_IO;
+    if (same_file(path, &src_st)) return ERR_INVALID;
+
+    MDBBackupPoint since = {0};
+    if (base_path)
+    {
+        ErrorCode err = mdb_backup_point(base_path, &since);
+        if (err != OK) return err;
+    }
+
+    MDBBackupTracker tracker = {.lock = PTHREAD_MUTEX_INITIALIZER};
+    BackupCopy c = {db, &tracker, -1, NULL, 0, base_path != NULL, since.lsn,
+                    sizeof(MDBIncrementalHeader)};
+    int wal_fd = -1;
+    uint64_t wal_end = since.wal_size; // source WAL bytes copied so far
+    MDBBackupStats stats = {0};
+
+    char* src_wal = path_with_suffix(db->filename, "-wal");
+    char* dst_wal = path_with_suffix(path, "-wal");
+    c.pages = malloc(sizeof(MDBPage) * MDB_BACKUP_CHUNK_PAGES);
+    ErrorCode err = src_wal && dst_wal && c.pages ? OK : ERR_UNKNOWN;
+
+    struct stat wal_st;
+    if (err == OK && stat(src_wal, &wal_st) == 0 && same_file(path, &wal_st)) err = ERR_INVALID;
+
+    // The WAL only grows; if it is shorter than the base's, the base is
+    // not from this database.
+    if (err == OK && file_size(src_wal) < since.wal_size) err = ERR_INVALID;
+    if (err != OK) goto done;
+
+    // From here on every page write is marked.
+    writers_pause(writer_lock);
+    if (db->backup) err = ERR_CONFLICT; // one backup at a time
+    if (err == OK) db->backup = &tracker;
+    writers_resume(writer_lock);
+    if (err != OK) goto done;
+
+    // O_EXCL: never overwrite a database, least of all this one.
+    c.fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (c.fd >= 0) wal_fd = open(dst_wal, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (c.fd < 0 || wal_fd < 0) err = errno == EEXIST ? ERR_INVALID : ERR_IO;
+
+    if (err == OK) err = copy_range(&c, 0, mdb_io_page_count(db));
+    uint32_t first_pass = c.copied;
+
+    while (err == OK && stats.passes < MDB_BACKUP_MAX_PASSES &&
+           tracker_pending(&tracker) > MDB_BACKUP_FINAL_PAGES)
+    {
+        err = copy_changed(&c);
+        stats.passes++;
+    }
+    if (err == OK) err = copy_tail(src_wal, wal_end, wal_fd, wal_end - since.wal_size, &wal_end);
+
+    writers_pause(writer_lock);
+    if (err == OK) err = copy_changed(&c);
+    if (err == OK)
+    {
+        stats.pages = mdb_io_page_count(db);
+        err = mdb_page_lsn_peek(db, &stats.lsn);
+    }
+    if (err == OK && !c.incremental && ftruncate(c.fd, (off_t)stats.pages * MDB_PAGE_SIZE) != 0)
+    {
+        err = ERR_IO;
+    }
+    if (err == OK) err = copy_tail(src_wal, wal_end, wal_fd, wal_end - since.wal_size, &wal_end);
+    db->backup = NULL;
+    writers_resume(writer_lock);
+
+    if (err == OK)
+    {
+        MDBBackupPoint end = {stats.lsn, wal_end};
+        err = c.incremental ? incremental_finish(&c, &stats, &since, wal_end)
+                            : header_set_point(c.fd, &end);
+    }
+    if (err == OK && (fsync(c.fd) != 0 || fsync(wal_fd) != 0)) err = ERR_IO;
+    if (c.fd >= 0) close(c.fd);
+    if (wal_fd >= 0) close(wal_fd);
+    // Only what this backup created.
+    if (err != OK && c.fd >= 0) remove(path);
+    if (err != OK && wal_fd >= 0) remove(dst_wal);
+
+    stats.copied = c.copied;
+    stats.recopied = c.copied - first_pass;
+    stats.wal_bytes = wal_end - since.wal_size;
+
+done:
+    free(tracker.changed);
+    pthread_mutex_destroy(&tracker.lock);
+    free(c.pages);
+    free(src_wal);
+    free(dst_wal);
+
+    if (err == OK && out_stats) *out_stats = stats;
+    return err;
+}
+
+/**
+ * Apply the incremental at `path` to the database being restored, which
+ * must be at `point`, and move `point` to where the incremental ends.
+ */
+static ErrorCode restore_apply(int fd, int wal_fd, const char* path,
+                               MDBBackupPoint* point)
+{
+    int in = open(path, O_RDONLY);
+    if (in < 0) return ERR_IO;
+
+    MDBIncrementalHeader h;
+    ErrorCode err = read_all(in, &h, sizeof(h), 0);
+    if (err == OK && (memcmp(h.magic, MDB_INCREMENTAL_MAGIC, sizeof(h.magic)) != 0 ||
+                      h.page_size != MDB_PAGE_SIZE))
+    {
+        err = ERR_INVALID;
+    }
+    // Each incremental starts where the one before it ended.
+    if (err == OK && (h.since_lsn != point->lsn || h.wal_from != point->wal_size))
+    {
+        err = ERR_INVALID;
+    }
+
+    struct stat st;
+    if (err == OK && fstat(in, &st) != 0) err = ERR_IO;
+
+    MDBPage page;
+    MDBPageNumber page_num;
+    off_t at = sizeof(h);
+    while (err == OK && at < st.st_size)
+    {
+        err = read_all(in, &page_num, sizeof(page_num), at);
+        // Every page must fall inside the database the incremental describes.
+        if (err == OK && page_num >= h.page_count) err = ERR_CORRUPT;
+        if (err == OK) err = read_all(in, page.data, MDB_PAGE_SIZE, at + (off_t)sizeof(page_num));
+        if (err == OK) err = write_all(fd, page.data, MDB_PAGE_SIZE, (off_t)page_num * MDB_PAGE_SIZE);
+        at += (off_t)(sizeof(page_num) + MDB_PAGE_SIZE);
+    }
+    close(in);
+
+    if (err == OK && ftruncate(fd, (off_t)h.page_count * MDB_PAGE_SIZE) != 0) err = ERR_IO;
+
+    char* wal_path = path_with_suffix(path, "-wal");
+    uint64_t wal_end = h.wal_from;
+    if (err == OK && !wal_path) err = ERR_UNKNOWN;
+    if (err == OK) err = copy_tail(wal_path, 0, wal_fd, h.wal_from, &wal_end);
+    if (err == OK && wal_end != h.wal_to) err = ERR_CORRUPT;
+    free(wal_path);
+
+    if (err == OK) *point = (MDBBackupPoint){h.end_lsn, h.wal_to};
+    return err;
+}
+
+/**
+ * Rebuild a database at `dest_path` from the full backup at `full_path`
+ * and the incrementals taken after it, oldest first. Neither `dest_path`
+ * nor its WAL may exist yet; on failure the files this call created are
+ * removed.
+ */
+ErrorCode mdb_restore(const char* dest_path, const char* full_path,
+                      const char* const* incremental_paths, uint32_t n)
+{
+    if (!dest_path || !full_path || (!incremental_paths && n > 0)) return ERR_INVALID;
+
+    MDBBackupPoint point;
+    bool incremental;
+    ErrorCode err = point_read(full_path, &point, &incremental);
+    if (err != OK) return err;
+    if (incremental) return ERR_INVALID;
+
+    char* dest_wal = path_with_suffix(dest_path, "-wal");
+    char* full_wal = path_with_suffix(full_path, "-wal");
+    if (!dest_wal || !full_wal)
+    {
+        free(dest_wal);
+        free(full_wal);
+        return ERR_UNKNOWN;
+    }
+
+    // O_EXCL: never overwrite a database or its log.
+    int wal_fd = -1;
+    int fd = open(dest_path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0) wal_fd = open(dest_wal, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || wal_fd < 0) err = errno == EEXIST ? ERR_INVALID : ERR_IO;
+
+    uint64_t size = 0;
+    if (err == OK) err = copy_tail(full_path, 0, fd, 0, &size);
+    size = 0;
+    if (err == OK) err = copy_tail(full_wal, 0, wal_fd, 0, &size);
+    if (err == OK && size != point.wal_size) err = ERR_CORRUPT;
+
+    for (uint32_t i = 0; i < n && err == OK; i++)
+    {
+        err = restore_apply(fd, wal_fd, incremental_paths[i], &point);
+    }
+
+    MDBBackupPoint none = {0};
+    if (err == OK) err = header_set_point(fd, &none);
+    if (err == OK && (fsync(fd) != 0 || fsync(wal_fd) != 0)) err = ERR_IO;
+    if (fd >= 0) close(fd);
+    if (wal_fd >= 0) close(wal_fd);
+    // Only what this restore created.
+    if (err != OK && fd >= 0) remove(dest_path);
+    if (err != OK && wal_fd >= 0) remove(dest_wal);
+
+    free(dest_wal);
+    free(full_wal);
+    return err;
+}
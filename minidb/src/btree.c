@@ -0,0 +1,902 @@
+#include "btree.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Leaf page layout for TEXT keys:
+ *
+ *   [header][prefix bytes][slot array ->]   free   [<- cells]
+ *
+ * Every key on the page shares `prefix_len` leading bytes, which are stored
+ * once right after the header. Each cell only holds the remaining suffix:
+ *
+ *   [uint16 suffix_len][uint32 page_num][uint16 slot][suffix bytes]
+ *
+ * Slots are kept in key order so lookups can binary search the suffixes
+ * after comparing the search key against the shared prefix a single time.
+ *
+ * Internal pages route searches with suffix-truncated separators:
+ *
+ *   [header][slot array ->]   free   [<- cells]
+ *   cell: [uint16 key_len][uint32 child][key bytes]
+ *
+ * The header's first_child holds the keys below the first separator;
+ * each cell's child holds the keys from its separator up to the next one.
+ * A separator taken from a split between equal keys is the full key, so
+ * keys equal to a separator can sit on both sides of it: inserts go right
+ * and lookups visit every child whose range includes the key.
+ *
+ * The root keeps its page number for the life of the tree. When it
+ * splits, its contents move to a new page and it becomes an internal page
+ * over the two halves. As with the hash index, a split writes the new
+ * right page and the parent before the shrunk left page, so a crash in
+ * between leaves the moved keys reachable.
+ */
+
+#define LEAF_CELL_OVERHEAD (sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint16_t))
+#define INTERNAL_CELL_OVERHEAD (sizeof(uint16_t) + sizeof(MDBPageNumber))
+
+typedef struct
+{
+    const uint8_t* key;
+    uint16_t len;
+    MDBRecord record;
+} LeafEntry;
+
+static MDBBTreeLeafHeader* leaf_header(MDBPage* page)
+{
+    return (MDBBTreeLeafHeader*)page->data;
+}
+
+static const MDBBTreeLeafHeader* leaf_header_const(const MDBPage* page)
+{
+    return (const MDBBTreeLeafHeader*)page->data;
+}
+
+static const uint8_t* leaf_prefix(const MDBPage* page)
+{
+    return page->data + sizeof(MDBBTreeLeafHeader);
+}
+
+static uint16_t leaf_slots_start(const MDBPage* page)
+{
+    return sizeof(MDBBTreeLeafHeader) + leaf_header_const(page)->prefix_len;
+}
+
+static uint16_t leaf_slot_get(const MDBPage* page, uint16_t idx)
+{
+    uint16_t offset;
+    memcpy(&offset, page->data + leaf_slots_start(page) + idx * sizeof(uint16_t), sizeof(uint16_t));
+    return offset;
+}
+
+static void leaf_slot_set(MDBPage* page, uint16_t idx, uint16_t offset)
+{
+    memcpy(page->data + leaf_slots_start(page) + idx * sizeof(uint16_t), &offset, sizeof(uint16_t));
+}
+
+/**
+ * Decode the cell at `offset` into its suffix and record.
+ */
+static void leaf_cell_read(const MDBPage* page, uint16_t offset,
+                           const uint8_t** out_suffix, uint16_t* out_len,
+                           MDBRecord* out_record)
+{
+    const uint8_t* cell = page->data + offset;
+
+    memcpy(out_len, cell, sizeof(uint16_t));
+    cell += sizeof(uint16_t);
+
+    if (out_record)
+    {
+        memcpy(&out_record->page_num, cell, sizeof(uint32_t));
+        memcpy(&out_record->slot, cell + sizeof(uint32_t), sizeof(uint16_t));
+    }
+    cell += sizeof(uint32_t) + sizeof(uint16_t);
+
+    *out_suffix = cell;
+}
+
+/**
+ * Bytewise lexicographic comparison; a shorter key sorts first on a tie.
+ */
+static int key_compare(const uint8_t* a, uint16_t a_len, const uint8_t* b,
+                       uint16_t b_len)
+{
+    uint16_t n = a_len < b_len ? a_len : b_len;
+    int c = memcmp(a, b, n);
+    if (c != 0) return c;
+    if (a_len == b_len) return 0;
+    return a_len < b_len ? -1 : 1;
+}
+
+static uint16_t common_prefix(const uint8_t* a, uint16_t a_len,
+                              const uint8_t* b, uint16_t b_len)
+{
+    uint16_t n = a_len < b_len ? a_len : b_len;
+    uint16_t i = 0;
+    while (i < n && a[i] == b[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+void mdb_btree_leaf_init(MDBPage* page)
+{
+    mdb_page_init(page, PG_INDEX_LEAF);
+
+    MDBBTreeLeafHeader* h = leaf_header(page);
+    h->n_keys = 0;
+    h->prefix_len = 0;
+    h->free_start = sizeof(MDBBTreeLeafHeader);
+    h->free_end = MDB_PAGE_USABLE_SIZE;
+}
+
+uint16_t mdb_btree_leaf_count(const MDBPage* page)
+{
+    return leaf_header_const(page)->n_keys;
+}
+
+uint16_t mdb_btree_leaf_prefix_len(const MDBPage* page)
+{
+    return leaf_header_const(page)->prefix_len;
+}
+
+uint16_t mdb_btree_leaf_free_space(const MDBPage* page)
+{
+    const MDBBTreeLeafHeader* h = leaf_header_const(page);
+    return h->free_end - h->free_start;
+}
+
+/**
+ * Can a key of up to `max_key_len` bytes be inserted without splitting?
+ *
+ * Used during latch crabbing: once the leaf is safe, nothing above it can
+ * change, so the latches on its ancestors can be dropped before inserting.
+ * The check is conservative because it ignores the shared prefix.
+ */
+bool mdb_btree_leaf_is_safe(const MDBPage* page, uint16_t max_key_len)
+{
+    uint32_t needed = (uint32_t)max_key_len + LEAF_CELL_OVERHEAD + sizeof(uint16_t);
+    return mdb_btree_leaf_free_space(page) >= needed;
+}
+
+bool mdb_btree_leaf_find(const MDBPage* page, UTF8String key,
+                         uint16_t* out_idx)
+{
+    const MDBBTreeLeafHeader* h = leaf_header_const(page);
+    const uint8_t* k = (const uint8_t*)key.ptr;
+
+    // Compare against the shared prefix once; if the key diverges there it
+    // sorts entirely before or after this page's keys.
+    uint16_t plen = h->prefix_len;
+    uint16_t n = key.length < plen ? key.length : plen;
+    int c = memcmp(k, leaf_prefix(page), n);
+    if (c < 0 || (c == 0 && key.length < plen))
+    {
+        *out_idx = 0;
+        return false;
+    }
+    if (c > 0)
+    {
+        *out_idx = h->n_keys;
+        return false;
+    }
+
+    const uint8_t* k_suffix = k + plen;
+    uint16_t k_suffix_len = key.length - plen;
+
+    uint16_t lo = 0;
+    uint16_t hi = h->n_keys;
+    while (lo < hi)
+    {
+        uint16_t mid = lo + (hi - lo) / 2;
+
+        const uint8_t* suffix;
+        uint16_t suffix_len;
+        leaf_cell_read(page, leaf_slot_get(page, mid), &suffix, &suffix_len, NULL);
+
+        if (key_compare(suffix, suffix_len, k_suffix, k_suffix_len) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    *out_idx = lo;
+    if (lo == h->n_keys) return false;
+
+    const uint8_t* suffix;
+    uint16_t suffix_len;
+    leaf_cell_read(page, leaf_slot_get(page, lo), &suffix, &suffix_len, NULL);
+    return key_compare(suffix, suffix_len, k_suffix, k_suffix_len) == 0;
+}
+
+/**
+ * Decompress every entry on the page into a freshly allocated buffer.
+ *
+ * The caller owns both `*out_entries` and `*out_scratch`. One extra entry
+ * slot is always reserved so a pending insert can be spliced in.
+ */
+static ErrorCode leaf_collect(const MDBPage* page, LeafEntry** out_entries,
+                              uint8_t** out_scratch)
+{
+    const MDBBTreeLeafHeader* h = leaf_header_const(page);
+
+    LeafEntry* entries = malloc(sizeof(LeafEntry) * (h->n_keys + 1));
+    uint8_t* scratch = malloc((size_t)h->n_keys * h->prefix_len + MDB_PAGE_SIZE);
+    if (!entries || !scratch)
+    {
+        free(entries);
+        free(scratch);
+        return ERR_UNKNOWN;
+    }
+
+    uint8_t* p = scratch;
+    for (uint16_t i = 0; i < h->n_keys; i++)
+    {
+        const uint8_t* suffix;
+        uint16_t suffix_len;
+        leaf_cell_read(page, leaf_slot_get(page, i), &suffix, &suffix_len, &entries[i].record);
+
+        memcpy(p, leaf_prefix(page), h->prefix_len);
+        memcpy(p + h->prefix_len, suffix, suffix_len);
+        entries[i].key = p;
+        entries[i].len = h->prefix_len + suffix_len;
+        p += entries[i].len;
+    }
+
+    *out_entries = entries;
+    *out_scratch = scratch;
+    return OK;
+}
+
+/**
+ * Rewrite the page from a sorted entry list, choosing the longest prefix
+ * shared by all keys. For sorted keys that is simply the common prefix of
+ * the first and the last one.
+ *
+ * Leaves the page untouched and returns ERR_FULL if the entries don't fit.
+ */
+static ErrorCode leaf_write(MDBPage* page, const LeafEntry* entries, uint16_t n)
+{
+    uint16_t plen = 0;
+    if (n > 1)
+    {
+        plen = common_prefix(entries[0].key, entries[0].len, entries[n - 1].key, entries[n - 1].len);
+    }
+
+    size_t needed = sizeof(MDBBTreeLeafHeader) + plen + (size_t)n * sizeof(uint16_t);
+    for (uint16_t i = 0; i < n; i++)
+    {
+        needed += LEAF_CELL_OVERHEAD + entries[i].len - plen;
+    }
+    if (needed > MDB_PAGE_USABLE_SIZE)
+    {
+        return ERR_FULL;
+    }
+
+    MDBPage out;
+    mdb_btree_leaf_init(&out);
+
+    MDBBTreeLeafHeader* h = leaf_header(&out);
+    h->prefix_len = plen;
+    if (n > 0)
+    {
+        memcpy(out.data + sizeof(MDBBTreeLeafHeader), entries[0].key, plen);
+    }
+    h->n_keys = n;
+    h->free_start = sizeof(MDBBTreeLeafHeader) + plen + n * sizeof(uint16_t);
+
+    for (uint16_t i = 0; i < n; i++)
+    {
+        uint16_t suffix_len = entries[i].len - plen;
+        h->free_end -= LEAF_CELL_OVERHEAD + suffix_len;
+
+        uint8_t* cell = out.data + h->free_end;
+        memcpy(cell, &suffix_len, sizeof(uint16_t));
+        memcpy(cell + sizeof(uint16_t), &entries[i].record.page_num, sizeof(uint32_t));
+        memcpy(cell + sizeof(uint16_t) + sizeof(uint32_t), &entries[i].record.slot, sizeof(uint16_t));
+        memcpy(cell + LEAF_CELL_OVERHEAD, entries[i].key + plen, suffix_len);
+
+        leaf_slot_set(&out, i, h->free_end);
+    }
+
+    memcpy(page, &out, sizeof(MDBPage));
+    return OK;
+}
+
+ErrorCode mdb_btree_leaf_insert(MDBPage* page, UTF8String key,
+                                MDBRecord record)
+{
+    if (!page || (!key.ptr && key.length > 0)) return ERR_INVALID;
+
+    MDBBTreeLeafHeader* h = leaf_header(page);
+
+    bool shares_prefix = key.length >= h->prefix_len &&
+                         memcmp(key.ptr, leaf_prefix(page), h->prefix_len) == 0;
+
+    // Insert after any equal keys so duplicates keep insertion order.
+    uint16_t idx;
+    mdb_btree_leaf_find(page, key, &idx);
+    while (shares_prefix && idx < h->n_keys)
+    {
+        const uint8_t* suffix;
+        uint16_t suffix_len;
+        leaf_cell_read(page, leaf_slot_get(page, idx), &suffix, &suffix_len, NULL);
+        if (suffix_len != key.length - h->prefix_len || memcmp(suffix, key.ptr + h->prefix_len, suffix_len) != 0)
+        {
+            break;
+        }
+        idx++;
+    }
+
+    uint16_t suffix_len = key.length - h->prefix_len;
+    uint32_t needed = LEAF_CELL_OVERHEAD + suffix_len + sizeof(uint16_t);
+
+    // Fast path: the key fits under the current prefix, append a cell.
+    if (shares_prefix && mdb_btree_leaf_free_space(page) >= needed)
+    {
+        h->free_end -= LEAF_CELL_OVERHEAD + suffix_len;
+
+        uint8_t* cell = page->data + h->free_end;
+        memcpy(cell, &suffix_len, sizeof(uint16_t));
+        memcpy(cell + sizeof(uint16_t), &record.page_num, sizeof(uint32_t));
+        memcpy(cell + sizeof(uint16_t) + sizeof(uint32_t), &record.slot, sizeof(uint16_t));
+        memcpy(cell + LEAF_CELL_OVERHEAD, key.ptr + h->prefix_len, suffix_len);
+
+        uint8_t* slots = page->data + leaf_slots_start(page);
+        memmove(slots + (idx + 1) * sizeof(uint16_t), slots + idx * sizeof(uint16_t),
+                (h->n_keys - idx) * sizeof(uint16_t));
+        leaf_slot_set(page, idx, h->free_end);
+
+        h->n_keys++;
+        h->free_start += sizeof(uint16_t);
+        return OK;
+    }
+
+    // Slow path: the prefix shrinks or the page needs compacting. Rebuild the
+    // page from scratch, which also reclaims space left behind by deletes.
+    LeafEntry* entries;
+    uint8_t* scratch;
+    ErrorCode err = leaf_collect(page, &entries, &scratch);
+    if (err != OK) return err;
+
+    memmove(&entries[idx + 1], &entries[idx], sizeof(LeafEntry) * (h->n_keys - idx));
+    entries[idx].key = (const uint8_t*)key.ptr;
+    entries[idx].len = key.length;
+    entries[idx].record = record;
+
+    err = leaf_write(page, entries, h->n_keys + 1);
+
+    free(entries);
+    free(scratch);
+    return err;
+}
+
+ErrorCode mdb_btree_leaf_delete(MDBPage* page, uint16_t idx)
+{
+    if (!page) return ERR_INVALID;
+
+    MDBBTreeLeafHeader* h = leaf_header(page);
+    if (idx >= h->n_keys) return ERR_INVALID;
+
+    // The cell bytes stay behind until the next rebuild. The prefix is still
+    // shared by the remaining keys, so nothing else has to change.
+    uint8_t* slots = page->data + leaf_slots_start(page);
+    memmove(slots + idx * sizeof(uint16_t), slots + (idx + 1) * sizeof(uint16_t),
+            (h->n_keys - idx - 1) * sizeof(uint16_t));
+
+    h->n_keys--;
+    h->free_start -= sizeof(uint16_t);
+    return OK;
+}
+
+ErrorCode mdb_btree_leaf_get(const MDBPage* page, uint16_t idx, char* key_buf,
+                             uint16_t cap, uint16_t* out_len,
+                             MDBRecord* out_record)
+{
+    if (!page || !key_buf || !out_len) return ERR_INVALID;
+
+    const MDBBTreeLeafHeader* h = leaf_header_const(page);
+    if (idx >= h->n_keys) return ERR_INVALID;
+
+    const uint8_t* suffix;
+    uint16_t suffix_len;
+    MDBRecord record;
+    leaf_cell_read(page, leaf_slot_get(page, idx), &suffix, &suffix_len, &record);
+
+    if ((uint32_t)h->prefix_len + suffix_len > cap) return ERR_FULL;
+
+    memcpy(key_buf, leaf_prefix(page), h->prefix_len);
+    memcpy(key_buf + h->prefix_len, suffix, suffix_len);
+    *out_len = h->prefix_len + suffix_len;
+    if (out_record) *out_record = record;
+
+    return OK;
+}
+
+/**
+ * Split a full leaf in half by size, moving the upper half into `right`.
+ *
+ * Both halves are rewritten so each gets the longest prefix its own key
+ * range allows, which is usually longer than the combined page had.
+ * The separator written to `sep_buf` is suffix-truncated: the shortest key
+ * that sorts after everything left and at or before everything right.
+ */
+ErrorCode mdb_btree_leaf_split(MDBPage* left, MDBPage* right, char* sep_buf,
+                               uint16_t cap, uint16_t* out_sep_len)
+{
+    if (!left || !right || !sep_buf || !out_sep_len) return ERR_INVALID;
+
+    uint16_t n = mdb_btree_leaf_count(left);
+    if (n < 2) return ERR_INVALID;
+
+    LeafEntry* entries;
+    uint8_t* scratch;
+    ErrorCode err = leaf_collect(left, &entries, &scratch);
+    if (err != OK) return err;
+
+    // Split by bytes, not keys, so both halves have room for another key.
+    size_t total = 0;
+    for (uint16_t i = 0; i < n; i++)
+    {
+        total += LEAF_CELL_OVERHEAD + entries[i].len;
+    }
+    uint16_t mid = 1;
+    size_t left_bytes = LEAF_CELL_OVERHEAD + entries[0].len;
+    while (mid < n - 1 && 2 * (left_bytes + LEAF_CELL_OVERHEAD + entries[mid].len) <= total)
+    {
+        left_bytes += LEAF_CELL_OVERHEAD + entries[mid].len;
+        mid++;
+    }
+
+    UTF8String lower = {entries[mid - 1].len, (const char*)entries[mid - 1].key};
+    UTF8String upper = {entries[mid].len, (const char*)entries[mid].key};
+
+    // Equal keys on both sides of the split need the full key as separator.
+    if (key_compare(entries[mid - 1].key, entries[mid - 1].len, entries[mid].key, entries[mid].len) == 0)
+    {
+        if (upper.length > cap)
+        {
+            err = ERR_FULL;
+        }
+        else
+        {
+            memcpy(sep_buf, upper.ptr, upper.length);
+            *out_sep_len = upper.length;
+        }
+    }
+    else
+    {
+        err = mdb_btree_separator(lower, upper, sep_buf, cap, out_sep_len);
+    }
+
+    if (err == OK) err = leaf_write(right, entries + mid, n - mid);
+    if (err == OK) err = leaf_write(left, entries, mid);
+
+    free(entries);
+    free(scratch);
+    return err;
+}
+
+/**
+ * Compute the shortest separator `s` with `lower < s <= upper`.
+ *
+ * Internal pages only need to route searches, not reproduce real keys, so
+ * storing this truncated form instead of `upper` keeps separators short.
+ * For keys like "https://example.com/a..." and "https://example.com/b..."
+ * the separator is just "https://example.com/b".
+ */
+ErrorCode mdb_btree_separator(UTF8String lower, UTF8String upper, char* out,
+                              uint16_t cap, uint16_t* out_len)
+{
+    if (!out || !out_len) return ERR_INVALID;
+
+    const uint8_t* lo = (const uint8_t*)lower.ptr;
+    const uint8_t* hi = (const uint8_t*)upper.ptr;
+    if (key_compare(lo, lower.length, hi, upper.length) >= 0) return ERR_INVALID;
+
+    // The first byte where upper diverges from lower decides the order, so
+    // everything in upper past that byte can be dropped.
+    uint16_t len = common_prefix(lo, lower.length, hi, upper.length) + 1;
+    if (len > cap) return ERR_FULL;
+
+    memcpy(out, hi, len);
+    *out_len = len;
+    return OK;
+}
+
+static MDBBTreeInternalHeader* internal_header(MDBPage* page)
+{
+    return (MDBBTreeInternalHeader*)page->data;
+}
+
+static const MDBBTreeInternalHeader* internal_header_const(const MDBPage* page)
+{
+    return (const MDBBTreeInternalHeader*)page->data;
+}
+
+static uint16_t internal_slot_get(const MDBPage* page, uint16_t idx)
+{
+    uint16_t offset;
+    memcpy(&offset, page->data + sizeof(MDBBTreeInternalHeader) + idx * sizeof(uint16_t), sizeof(uint16_t));
+    return offset;
+}
+
+/**
+ * Decode separator `idx` and the child it routes to.
+ */
+static void internal_cell_read(const MDBPage* page, uint16_t idx,
+                               const uint8_t** out_key, uint16_t* out_len,
+                               MDBPageNumber* out_child)
+{
+    const uint8_t* cell = page->data + internal_slot_get(page, idx);
+    memcpy(out_len, cell, sizeof(uint16_t));
+    memcpy(out_child, cell + sizeof(uint16_t), sizeof(MDBPageNumber));
+    *out_key = cell + INTERNAL_CELL_OVERHEAD;
+}
+
+/**
+ * Number of separators that sort at or before `key`.
+ */
+static uint16_t internal_upper_bound(const MDBPage* page, UTF8String key)
+{
+    uint16_t lo = 0;
+    uint16_t hi = internal_header_const(page)->n_keys;
+    while (lo < hi)
+    {
+        uint16_t mid = lo + (hi - lo) / 2;
+
+        const uint8_t* sep;
+        uint16_t sep_len;
+        MDBPageNumber child;
+        internal_cell_read(page, mid, &sep, &sep_len, &child);
+
+        if (key_compare(sep, sep_len, (const uint8_t*)key.ptr, key.length) <= 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static MDBPageNumber internal_child_at(const MDBPage* page, uint16_t idx)
+{
+    if (idx == 0) return internal_header_const(page)->first_child;
+
+    const uint8_t* sep;
+    uint16_t sep_len;
+    MDBPageNumber child;
+    internal_cell_read(page, idx - 1, &sep, &sep_len, &child);
+    return child;
+}
+
+void mdb_btree_internal_init(MDBPage* page, MDBPageNumber first_child)
+{
+    mdb_page_init(page, PG_INDEX_INTERNAL);
+
+    MDBBTreeInternalHeader* h = internal_header(page);
+    h->n_keys = 0;
+    h->free_start = sizeof(MDBBTreeInternalHeader);
+    h->free_end = MDB_PAGE_USABLE_SIZE;
+    h->first_child = first_child;
+}
+
+uint16_t mdb_btree_internal_count(const MDBPage* page)
+{
+    return internal_header_const(page)->n_keys;
+}
+
+/**
+ * The child whose key range holds `key`: the one after the last separator
+ * at or before it.
+ */
+MDBPageNumber mdb_btree_internal_child(const MDBPage* page, UTF8String key)
+{
+    return internal_child_at(page, internal_upper_bound(page, key));
+}
+
+/**
+ * Add separator `sep` routing to `child`, after any equal separators.
+ * Returns ERR_FULL if the page has no room; internal pages never lose
+ * separators, so there is nothing to compact.
+ */
+ErrorCode mdb_btree_internal_insert(MDBPage* page, UTF8String sep,
+                                    MDBPageNumber child)
+{
+    if (!page || (!sep.ptr && sep.length > 0)) return ERR_INVALID;
+
+    MDBBTreeInternalHeader* h = internal_header(page);
+    if ((uint32_t)(h->free_end - h->free_start) < INTERNAL_CELL_OVERHEAD + sep.length + sizeof(uint16_t))
+    {
+        return ERR_FULL;
+    }
+
+    uint16_t idx = internal_upper_bound(page, sep);
+
+    h->free_end -= INTERNAL_CELL_OVERHEAD + sep.length;
+    uint8_t* cell = page->data + h->free_end;
+    memcpy(cell, &sep.length, sizeof(uint16_t));
+    memcpy(cell + sizeof(uint16_t), &child, sizeof(MDBPageNumber));
+    memcpy(cell + INTERNAL_CELL_OVERHEAD, sep.ptr, sep.length);
+
+    uint8_t* slots = page->data + sizeof(MDBBTreeInternalHeader);
+    memmove(slots + (idx + 1) * sizeof(uint16_t), slots + idx * sizeof(uint16_t),
+            (h->n_keys - idx) * sizeof(uint16_t));
+    memcpy(slots + idx * sizeof(uint16_t), &h->free_end, sizeof(uint16_t));
+
+    h->n_keys++;
+    h->free_start += sizeof(uint16_t);
+    return OK;
+}
+
+/**
+ * Split a full internal page by size. The middle separator moves up into
+ * `sep_buf` rather than staying on either side; its child becomes the
+ * first child of `right`.
+ */
+ErrorCode mdb_btree_internal_split(MDBPage* left, MDBPage* right,
+                                   char* sep_buf, uint16_t cap,
+                                   uint16_t* out_sep_len)
+{
+    if (!left || !right || !sep_buf || !out_sep_len) return ERR_INVALID;
+
+    uint16_t n = mdb_btree_internal_count(left);
+    if (n < 2) return ERR_INVALID;
+
+    MDBPage src;
+    memcpy(&src, left, sizeof(MDBPage));
+
+    size_t total = MDB_PAGE_USABLE_SIZE - internal_header_const(&src)->free_end;
+    size_t left_bytes = 0;
+    uint16_t mid = 0;
+    while (mid < n - 1)
+    {
+        const uint8_t* key;
+        uint16_t len;
+        MDBPageNumber child;
+        internal_cell_read(&src, mid, &key, &len, &child);
+        if (mid > 0 && 2 * (left_bytes + INTERNAL_CELL_OVERHEAD + len) > total) break;
+        left_bytes += INTERNAL_CELL_OVERHEAD + len;
+        mid++;
+    }
+
+    const uint8_t* up;
+    uint16_t up_len;
+    MDBPageNumber up_child;
+    internal_cell_read(&src, mid, &up, &up_len, &up_child);
+    if (up_len > cap) return ERR_FULL;
+
+    mdb_btree_internal_init(left, internal_header_const(&src)->first_child);
+    mdb_btree_internal_init(right, up_child);
+    for (uint16_t i = 0; i < n; i++)
+    {
+        if (i == mid) continue;
+
+        const uint8_t* key;
+        uint16_t len;
+        MDBPageNumber child;
+        internal_cell_read(&src, i, &key, &len, &child);
+        UTF8String sep = {len, (const char*)key};
+        mdb_btree_internal_insert(i < mid ? left : right, sep, child);
+    }
+
+    memcpy(sep_buf, up, up_len);
+    *out_sep_len = up_len;
+    return OK;
+}
+
+static ErrorCode node_read(MiniDB* db, MDBPageNumber page_num, MDBPage* page)
+{
+    ErrorCode err = mdb_page_read(db, page_num, page);
+    if (err != OK) return err;
+    return mdb_page_is_type(page, PG_INDEX_LEAF) || mdb_page_is_type(page, PG_INDEX_INTERNAL) ? OK : ERR_CORRUPT;
+}
+
+/**
+ * Create an empty tree: a single leaf, which is also the root.
+ */
+ErrorCode mdb_btree_create(MiniDB* db, MDBPageNumber* out_root)
+{
+    if (!db || !out_root) return ERR_INVALID;
+
+    MDBPage leaf;
+    mdb_btree_leaf_init(&leaf);
+    return mdb_page_allocate(db, &leaf, out_root);
+}
+
+/**
+ * Split the full `page` and add the pending entry to whichever half it
+ * sorts into: `key` and `record` for a leaf, or separator `key` routing
+ * to `child` for an internal page. The separator for the parent goes to
+ * `sep_buf`. Nothing is written.
+ */
+static ErrorCode node_split_insert(MDBPage* page, MDBPage* right, UTF8String key,
+                                   MDBRecord record, MDBPageNumber child,
+                                   char* sep_buf, uint16_t* out_sep_len)
+{
+    bool leaf = mdb_page_is_type(page, PG_INDEX_LEAF);
+    ErrorCode err = leaf ? mdb_btree_leaf_split(page, right, sep_buf, MDB_BTREE_KEY_MAX, out_sep_len)
+                         : mdb_btree_internal_split(page, right, sep_buf, MDB_BTREE_KEY_MAX, out_sep_len);
+    if (err != OK) return err;
+
+    bool goes_right = key_compare((const uint8_t*)key.ptr, key.length,
+                                  (const uint8_t*)sep_buf, *out_sep_len) >= 0;
+    MDBPage* target = goes_right ? right : page;
+    return leaf ? mdb_btree_leaf_insert(target, key, record)
+                : mdb_btree_internal_insert(target, key, child);
+}
+
+/**
+ * Insert `key` into the tree rooted at `root`, splitting pages on the way
+ * back up as needed. Keys longer than MDB_BTREE_KEY_MAX are rejected with
+ * ERR_FULL.
+ */
+ErrorCode mdb_btree_insert(MiniDB* db, MDBPageNumber root, UTF8String key,
+                           MDBRecord record)
+{
+    if (!db || (!key.ptr && key.length > 0)) return ERR_INVALID;
+    if (key.length > MDB_BTREE_KEY_MAX) return ERR_FULL;
+
+    MDBPageNumber path[MDB_BTREE_MAX_DEPTH];
+    uint16_t depth = 0;
+    MDBPage page;
+    MDBPageNumber page_num = root;
+    ErrorCode err;
+    for (;;)
+    {
+        err = node_read(db, page_num, &page);
+        if (err != OK) return err;
+        if (mdb_page_is_type(&page, PG_INDEX_LEAF)) break;
+        if (depth == MDB_BTREE_MAX_DEPTH - 1) return ERR_CORRUPT;
+
+        path[depth++] = page_num;
+        page_num = mdb_btree_internal_child(&page, key);
+    }
+    path[depth] = page_num;
+
+    err = mdb_btree_leaf_insert(&page, key, record);
+    if (err != ERR_FULL) return err == OK ? mdb_page_write(db, page_num, &page) : err;
+
+    // Shrunk left halves, written top-down once every parent links their
+    // new right siblings.
+    MDBPage* lefts = malloc(sizeof(MDBPage) * (depth + 1));
+    char* seps = malloc(2 * (size_t)MDB_BTREE_KEY_MAX);
+    if (!lefts || !seps)
+    {
+        free(lefts);
+        free(seps);
+        return ERR_UNKNOWN;
+    }
+
+    uint16_t nlefts = 0;
+    MDBPageNumber child = 0;
+    char* sep = seps;
+    uint16_t sep_len;
+    for (;;)
+    {
+        MDBPage right;
+        err = node_split_insert(&page, &right, key, record, child, sep, &sep_len);
+        if (err == OK) err = mdb_page_allocate(db, &right, &child);
+        if (err != OK) break;
+
+        if (depth == 0)
+        {
+            // The root keeps its page number: its left half moves out.
+            MDBPageNumber moved;
+            err = mdb_page_allocate(db, &page, &moved);
+            if (err != OK) break;
+
+            mdb_btree_internal_init(&page, moved);
+            mdb_btree_internal_insert(&page, (UTF8String){sep_len, sep}, child);
+            err = mdb_page_write(db, root, &page);
+            break;
+        }
+
+        memcpy(&lefts[nlefts++], &page, sizeof(MDBPage));
+        key = (UTF8String){sep_len, sep};
+        sep = sep == seps ? seps + MDB_BTREE_KEY_MAX : seps;
+
+        err = node_read(db, path[--depth], &page);
+        if (err == OK) err = mdb_btree_internal_insert(&page, key, child);
+        if (err == OK) err = mdb_page_write(db, path[depth], &page);
+        if (err != ERR_FULL) break;
+    }
+
+    // lefts[i] is the page at path[depth + nlefts - i], deepest last.
+    for (uint16_t i = nlefts; err == OK && i > 0; i--)
+    {
+        err = mdb_page_write(db, path[depth + 1 + nlefts - i], &lefts[i - 1]);
+    }
+
+    free(lefts);
+    free(seps);
+    return err;
+}
+
+static bool leaf_key_equals(const MDBPage* page, uint16_t idx, UTF8String key)
+{
+    const MDBBTreeLeafHeader* h = leaf_header_const(page);
+    const uint8_t* suffix;
+    uint16_t suffix_len;
+    leaf_cell_read(page, leaf_slot_get(page, idx), &suffix, &suffix_len, NULL);
+
+    return key.length == h->prefix_len + suffix_len &&
+           memcmp(key.ptr, leaf_prefix(page), h->prefix_len) == 0 &&
+           memcmp(key.ptr + h->prefix_len, suffix, suffix_len) == 0;
+}
+
+static ErrorCode btree_lookup(MiniDB* db, MDBPageNumber page_num, UTF8String key,
+                              uint16_t depth, MDBRecord* out_records,
+                              uint32_t cap, uint32_t* total)
+{
+    if (depth == MDB_BTREE_MAX_DEPTH) return ERR_CORRUPT;
+
+    MDBPage page;
+    ErrorCode err = node_read(db, page_num, &page);
+    if (err != OK) return err;
+
+    if (mdb_page_is_type(&page, PG_INDEX_LEAF))
+    {
+        uint16_t idx;
+        mdb_btree_leaf_find(&page, key, &idx);
+        for (; idx < mdb_btree_leaf_count(&page) && leaf_key_equals(&page, idx, key); idx++)
+        {
+            if (out_records && *total < cap)
+            {
+                const uint8_t* suffix;
+                uint16_t suffix_len;
+                leaf_cell_read(&page, leaf_slot_get(&page, idx), &suffix, &suffix_len, &out_records[*total]);
+            }
+            (*total)++;
+        }
+        return OK;
+    }
+
+    // Children left of the routed one can hold the key too when it equals
+    // their upper separator.
+    uint16_t last = internal_upper_bound(&page, key);
+    uint16_t first = last;
+    while (first > 0)
+    {
+        const uint8_t* sep;
+        uint16_t sep_len;
+        MDBPageNumber child;
+        internal_cell_read(&page, first - 1, &sep, &sep_len, &child);
+        if (key_compare(sep, sep_len, (const uint8_t*)key.ptr, key.length) != 0) break;
+        first--;
+    }
+
+    for (uint16_t i = first; err == OK && i <= last; i++)
+    {
+        err = btree_lookup(db, internal_child_at(&page, i), key, depth + 1, out_records, cap, total);
+    }
+    return err;
+}
+
+/**
+ * Collect the records stored under `key`. Like mdb_hash_lookup, reports
+ * the full count and returns ERR_FULL when it exceeds `cap`.
+ */
+ErrorCode mdb_btree_lookup(MiniDB* db, MDBPageNumber root, UTF8String key,
+                           MDBRecord* out_records, uint32_t cap,
+                           uint32_t* out_count)
+{
+    if (!db || (!key.ptr && key.length > 0) || !out_count) return ERR_INVALID;
+
+    uint32_t total = 0;
+    ErrorCode err = btree_lookup(db, root, key, 0, out_records, cap, &total);
+    if (err != OK) return err;
+
+    *out_count = total;
+    return total > cap ? ERR_FULL : OK;
+}
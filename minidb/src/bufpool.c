@@ -0,0 +1,498 @@
+#include "bufpool.h"
+#include "io.h"
+#include "latch.h"
+#include "metrics.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Buffer pool.
+ *
+ * The main pool is replaced with the clock algorithm: every hit sets a
+ * frame's reference bit, and the clock hand clears bits as it sweeps, so a
+ * page survives as long as it keeps being used between sweeps.
+ *
+ * Large sequential reads would still push everything else out, so they go
+ * through a small, separate ring of MDB_BUFFER_RING_SIZE frames instead.
+ * A scan recycles its own ring frames and never evicts main-pool pages;
+ * one big SELECT * costs a handful of frames rather than the whole cache.
+ * Pages a scan finds already cached are used in place.
+ *
+ * Scans are recognised either explicitly (MDB_ACCESS_SCAN, or a
+ * MDBBufferScan) or by a run of consecutive page misses, and in both cases
+ * read-ahead is issued for the pages just past the cursor.
+ *
+ * The pool lock is never held across disk I/O. A frame being written back
+ * or filled is pinned and marked io_busy, and stays in the hash table under
+ * the page it is doing I/O for; a thread that looks it up waits on io_done
+ * instead of reading a stale or half-filled page. Flushing pins the dirty
+ * frames so they cannot be evicted while the batch is written.
+ *
+ * A pinned frame may be changed by its user while a flush runs, so the
+ * flush never stamps or writes the frame itself: it copies each page
+ * under the page's shared latch and writes the copies.
+ */
+
+#define SEQ_THRESHOLD 8
+#define FLUSH_BATCH 64 // pages copied and written at a time by a flush
+#define NO_FRAME (-1)
+
+typedef struct
+{
+    MDBPage page; // first member, so an MDBPage* handed out is also the frame
+    MDBPageNumber page_num;
+    uint32_t pins;
+    bool valid;
+    bool dirty;
+    bool referenced;
+    bool io_busy; // being written back or read in; wait on io_done
+    int32_t hash_next;
+} Frame;
+
+struct MDBBufferPool
+{
+    MiniDB* db;
+    pthread_mutex_t lock;
+    pthread_cond_t io_done;
+
+    Frame* frames; // [0, capacity) main pool, then the scan ring
+    uint32_t capacity;
+    uint32_t clock_hand;
+    uint32_t ring_hand;
+
+    int32_t* buckets;
+    uint32_t bucket_mask;
+
+    MDBPageNumber seq_next; // page that would continue the current run
+    uint32_t seq_run;
+    MDBPageNumber readahead_end;
+
+    MDBBufferStats stats;
+};
+
+static uint32_t bucket_of(const MDBBufferPool* pool, MDBPageNumber page_num)
+{
+    return (page_num * 2654435769u) & pool->bucket_mask;
+}
+
+static Frame* frame_lookup(MDBBufferPool* pool, MDBPageNumber page_num)
+{
+    int32_t i = pool->buckets[bucket_of(pool, page_num)];
+    while (i != NO_FRAME)
+    {
+        Frame* f = &pool->frames[i];
+        if (f->page_num == page_num) return f;
+        i = f->hash_next;
+    }
+    return NULL;
+}
+
+static void frame_hash_insert(MDBBufferPool* pool, Frame* f)
+{
+    uint32_t b = bucket_of(pool, f->page_num);
+    f->hash_next = pool->buckets[b];
+    pool->buckets[b] = (int32_t)(f - pool->frames);
+}
+
+static void frame_hash_remove(MDBBufferPool* pool, Frame* f)
+{
+    int32_t* link = &pool->buckets[bucket_of(pool, f->page_num)];
+    while (*link != NO_FRAME && &pool->frames[*link] != f)
+    {
+        link = &pool->frames[*link].hash_next;
+    }
+    if (*link != NO_FRAME) *link = f->hash_next;
+}
+
+ErrorCode mdb_buffer_pool_create(MiniDB* db, uint32_t capacity,
+                                 MDBBufferPool** out_pool)
+{
+    if (!db || capacity == 0 || !out_pool) return ERR_INVALID;
+
+    MDBBufferPool* pool = calloc(1, sizeof(MDBBufferPool));
+    if (!pool) return ERR_UNKNOWN;
+
+    uint32_t total = capacity + MDB_BUFFER_RING_SIZE;
+    uint32_t nbuckets = 1;
+    while (nbuckets < total * 2)
+    {
+        nbuckets <<= 1;
+    }
+
+    pool->frames = calloc(total, sizeof(Frame));
+    pool->buckets = malloc(sizeof(int32_t) * nbuckets);
+    if (!pool->frames || !pool->buckets)
+    {
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return ERR_UNKNOWN;
+    }
+
+    for (uint32_t i = 0; i < nbuckets; i++)
+    {
+        pool->buckets[i] = NO_FRAME;
+    }
+
+    pool->db = db;
+    pool->capacity = capacity;
+    pool->bucket_mask = nbuckets - 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->io_done, NULL);
+
+    *out_pool = pool;
+    return OK;
+}
+
+ErrorCode mdb_buffer_pool_destroy(MDBBufferPool* pool)
+{
+    if (!pool) return ERR_INVALID;
+
+    ErrorCode err = mdb_buffer_flush(pool);
+
+    pthread_cond_destroy(&pool->io_done);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->frames);
+    free(pool->buckets);
+    free(pool);
+    return err;
+}
+
+/**
+ * Clock sweep over the main pool. Two full turns are enough to clear every
+ * reference bit, so if nothing turns up by then every frame is pinned.
+ */
+static Frame* clock_victim(MDBBufferPool* pool)
+{
+    for (uint32_t step = 0; step < pool->capacity * 2; step++)
+    {
+        Frame* f = &pool->frames[pool->clock_hand];
+        pool->clock_hand = (pool->clock_hand + 1) % pool->capacity;
+
+        if (!f->valid) return f;
+        if (f->pins > 0) continue;
+        if (f->referenced)
+        {
+            f->referenced = false;
+            continue;
+        }
+        return f;
+    }
+    return NULL;
+}
+
+static Frame* ring_victim(MDBBufferPool* pool)
+{
+    Frame* ring = pool->frames + pool->capacity;
+    for (uint32_t step = 0; step < MDB_BUFFER_RING_SIZE; step++)
+    {
+        Frame* f = &ring[pool->ring_hand];
+        pool->ring_hand = (pool->ring_hand + 1) % MDB_BUFFER_RING_SIZE;
+        if (f->pins == 0) return f;
+    }
+    return NULL;
+}
+
+/**
+ * Track runs of consecutive page numbers. Returns true once the current
+ * run is long enough to be treated as a sequential scan.
+ */
+static bool seq_detect(MDBBufferPool* pool, MDBPageNumber page_num)
+{
+    pool->seq_run = page_num == pool->seq_next ? pool->seq_run + 1 : 0;
+    pool->seq_next = page_num + 1;
+    return pool->seq_run >= SEQ_THRESHOLD;
+}
+
+static void scan_readahead(MDBBufferPool* pool, MDBPageNumber page_num)
+{
+    if (page_num + MDB_IO_READAHEAD_PAGES / 2 < pool->readahead_end) return;
+
+    MDBPageNumber start = page_num + 1;
+    if (start < pool->readahead_end) start = pool->readahead_end;
+
+    mdb_io_readahead(pool->db, start, MDB_IO_READAHEAD_PAGES);
+    pool->readahead_end = start + MDB_IO_READAHEAD_PAGES;
+}
+
+/**
+ * Hand a frame whose I/O failed back to the clock, empty.
+ */
+static void frame_abandon(MDBBufferPool* pool, Frame* f, bool hashed)
+{
+    if (hashed) frame_hash_remove(pool, f);
+    f->valid = false;
+    f->pins = 0;
+    f->io_busy = false;
+    pthread_cond_broadcast(&pool->io_done);
+}
+
+/**
+ * Write back and unmap a victim the caller has pinned and marked io_busy.
+ * Called and returns with the pool lock held, but drops it for the write.
+ * The old mapping stays visible meanwhile, so nobody reads the page from
+ * disk before the write lands.
+ */
+static ErrorCode frame_evict(MDBBufferPool* pool, Frame* f)
+{
+    if (!f->valid) return OK;
+
+    if (f->dirty)
+    {
+        pthread_mutex_unlock(&pool->lock);
+        ErrorCode err = mdb_page_write(pool->db, f->page_num, &f->page);
+        pthread_mutex_lock(&pool->lock);
+        if (err != OK)
+        {
+            // Still dirty and still cached; just give the frame back.
+            f->pins = 0;
+            f->io_busy = false;
+            pthread_cond_broadcast(&pool->io_done);
+            return err;
+        }
+        f->dirty = false;
+    }
+
+    frame_hash_remove(pool, f);
+    f->valid = false;
+    pool->stats.evictions++;
+    return OK;
+}
+
+/**
+ * Pin `page_num` in the pool, reading it from disk on a miss. The page
+ * stays at the same address until the matching mdb_buffer_unpin.
+ */
+ErrorCode mdb_buffer_pin(MDBBufferPool* pool, MDBPageNumber page_num,
+                         MDBBufferAccess access, MDBPage** out_page)
+{
+    if (!pool || !out_page) return ERR_INVALID;
+
+    pthread_mutex_lock(&pool->lock);
+
+    bool scan = seq_detect(pool, page_num) || access == MDB_ACCESS_SCAN;
+    bool counted = false;
+
+    for (;;)
+    {
+        Frame* f = frame_lookup(pool, page_num);
+        if (f && f->io_busy)
+        {
+            pthread_cond_wait(&pool->io_done, &pool->lock);
+            continue;
+        }
+        if (f)
+        {
+            f->pins++;
+            if (!scan) f->referenced = true;
+            if (!counted)
+            {
+                pool->stats.hits++;
+                mdb_metrics_add(MDB_COUNTER_BUFFER_HITS, 1);
+            }
+            pthread_mutex_unlock(&pool->lock);
+
+            *out_page = &f->page;
+            return OK;
+        }
+
+        if (!counted)
+        {
+            pool->stats.misses++;
+            mdb_metrics_add(MDB_COUNTER_BUFFER_MISSES, 1);
+            counted = true;
+        }
+
+        Frame* victim = NULL;
+        if (scan)
+        {
+            scan_readahead(pool, page_num);
+            victim = ring_victim(pool);
+            if (victim) pool->stats.ring_reads++;
+        }
+        if (!victim) victim = clock_victim(pool);
+        if (!victim)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return ERR_FULL;
+        }
+
+        victim->pins = 1;
+        victim->io_busy = true;
+        ErrorCode err = frame_evict(pool, victim);
+        if (err != OK)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return err;
+        }
+
+        // Another thread may have brought the page in during the write.
+        if (frame_lookup(pool, page_num))
+        {
+            frame_abandon(pool, victim, false);
+            continue;
+        }
+
+        victim->page_num = page_num;
+        victim->valid = true;
+        victim->dirty = false;
+        victim->referenced = !scan;
+        frame_hash_insert(pool, victim);
+
+        pthread_mutex_unlock(&pool->lock);
+        err = mdb_page_read(pool->db, page_num, &victim->page);
+        pthread_mutex_lock(&pool->lock);
+
+        if (err != OK)
+        {
+            frame_abandon(pool, victim, true);
+            pthread_mutex_unlock(&pool->lock);
+            return err;
+        }
+
+        victim->io_busy = false;
+        pthread_cond_broadcast(&pool->io_done);
+        pthread_mutex_unlock(&pool->lock);
+
+        *out_page = &victim->page;
+        return OK;
+    }
+}
+
+void mdb_buffer_unpin(MDBBufferPool* pool, MDBPage* page, bool dirty)
+{
+    if (!pool || !page) return;
+
+    Frame* f = (Frame*)page;
+
+    pthread_mutex_lock(&pool->lock);
+    if (dirty) f->dirty = true;
+    if (f->pins > 0) f->pins--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Write every dirty page in one batch, then sync. The frames are pinned and
+ * marked clean before the lock is dropped for the write, so a page dirtied
+ * again meanwhile is written by the next flush.
+ */
+ErrorCode mdb_buffer_flush(MDBBufferPool* pool)
+{
+    if (!pool) return ERR_INVALID;
+
+    pthread_mutex_lock(&pool->lock);
+
+    uint32_t total = pool->capacity + MDB_BUFFER_RING_SIZE;
+    MDBIoRequest* reqs = malloc(sizeof(MDBIoRequest) * total);
+    if (!reqs)
+    {
+        pthread_mutex_unlock(&pool->lock);
+        return ERR_UNKNOWN;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < total; i++)
+    {
+        Frame* f = &pool->frames[i];
+        while (f->valid && f->dirty && f->io_busy)
+        {
+            // Being written back by an eviction; let it land first.
+            pthread_cond_wait(&pool->io_done, &pool->lock);
+        }
+        if (f->valid && f->dirty)
+        {
+            f->pins++;
+            f->dirty = false;
+            reqs[n].page_num = f->page_num;
+            reqs[n].page = &f->page;
+            n++;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    ErrorCode err = OK;
+    MDBPage* copies = n > 0 ? malloc(sizeof(MDBPage) * FLUSH_BATCH) : NULL;
+    if (n > 0 && !copies) err = ERR_UNKNOWN;
+
+    MDBLatchTable* latches = mdb_latches(pool->db);
+    for (uint32_t done = 0; err == OK && done < n;)
+    {
+        MDBIoRequest batch[FLUSH_BATCH];
+        uint32_t m = n - done < FLUSH_BATCH ? n - done : FLUSH_BATCH;
+        for (uint32_t j = 0; err == OK && j < m; j++)
+        {
+            const MDBIoRequest* req = &reqs[done + j];
+            err = mdb_latch_acquire(latches, req->page_num, MDB_LATCH_SHARED);
+            if (err != OK) break;
+            memcpy(&copies[j], req->page, sizeof(MDBPage));
+            mdb_latch_release(latches, req->page_num);
+            batch[j] = (MDBIoRequest){req->page_num, &copies[j]};
+        }
+        if (err == OK) err = mdb_page_write_batch(pool->db, batch, m);
+        done += m;
+    }
+    if (err == OK && n > 0) err = mdb_io_sync(pool->db);
+    free(copies);
+
+    pthread_mutex_lock(&pool->lock);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Frame* f = (Frame*)reqs[i].page;
+        if (err != OK) f->dirty = true;
+        f->pins--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    free(reqs);
+    return err;
+}
+
+void mdb_buffer_pool_stats(MDBBufferPool* pool, MDBBufferStats* out_stats)
+{
+    if (!pool || !out_stats) return;
+
+    pthread_mutex_lock(&pool->lock);
+    *out_stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void mdb_buffer_scan_open(MDBBufferPool* pool, MDBPageNumber start,
+                          MDBPageNumber end, MDBBufferScan* out_scan)
+{
+    out_scan->pool = pool;
+    out_scan->next = start;
+    out_scan->end = end;
+    out_scan->current = NULL;
+    out_scan->err = OK;
+}
+
+/**
+ * Advance to the next page. The previous page is unpinned, so only one
+ * ring frame is held at a time. Returns false at the end or on error;
+ * check scan->err to tell them apart.
+ */
+bool mdb_buffer_scan_next(MDBBufferScan* scan, const MDBPage** out_page,
+                          MDBPageNumber* out_page_num)
+{
+    if (scan->current)
+    {
+        mdb_buffer_unpin(scan->pool, scan->current, false);
+        scan->current = NULL;
+    }
+    if (scan->err != OK || scan->next >= scan->end) return false;
+
+    scan->err = mdb_buffer_pin(scan->pool, scan->next, MDB_ACCESS_SCAN, &scan->current);
+    if (scan->err != OK) return false;
+
+    scan->current_num = scan->next++;
+    if (out_page) *out_page = scan->current;
+    if (out_page_num) *out_page_num = scan->current_num;
+    return true;
+}
+
+void mdb_buffer_scan_close(MDBBufferScan* scan)
+{
+    if (scan->current) mdb_buffer_unpin(scan->pool, scan->current, false);
+    scan->current = NULL;
+}
@@ -0,0 +1,928 @@
+#include "catalog.h"
+#include "db_internal.h"
+#include "io.h"
+#include "overflow.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The catalog is kept as two chained hash tables keyed by name: one for
+ * tables and one for indexes. Each table additionally links the indexes
+ * defined on it, so listing a table's indexes never scans every index.
+ *
+ * Every statement resolves its table (and usually its indexes) through
+ * here, so lookups are a hash plus a short chain walk with no page I/O.
+ * DDL updates the tables in place, which keeps them coherent without a
+ * separate invalidation step.
+ *
+ * The hash tables are a cache of the catalog stored in the file: after
+ * every change the whole catalog is serialized into a new overflow chain,
+ * the file header is pointed at it and the old chain is freed, so a crash
+ * leaves either the old or the new catalog. mdb_catalog_open loads it
+ * back. If a save fails the change stays in memory, and the next save
+ * writes it out with everything else.
+ *
+ * Row ids come from a per-table atomic counter. Instead of persisting the
+ * counter on every insert, the catalog durably reserves MDB_ROW_ID_BATCH
+ * ids at a time by writing the new high-water mark straight to the WAL,
+ * outside any open transaction's buffered records; only the
+ * inserter that crosses the reserved range takes a lock. mdb_catalog_open
+ * attaches the database's WAL and resumes allocation at the last logged
+ * high-water mark, so ids handed out before a crash are never reused (the
+ * rest of that batch is skipped).
+ */
+
+#define CATALOG_INITIAL_BUCKETS 16
+
+typedef struct CatalogIndex CatalogIndex;
+
+typedef struct
+{
+    char table_name[MDB_TABLE_NAME_MAX];
+    uint64_t high_water;
+} RowIdReservation;
+
+typedef struct CatalogTable
+{
+    MDBCatalogTableMetadata meta; // meta.next_row_id is filled in on read
+    _Atomic uint64_t next_row_id;
+    _Atomic uint64_t reserved_until; // ids below this are durably reserved
+    MDBCatalogColumn* cols;
+    MDBPageNumber* col_roots; // columnar tables only
+    MDBColumnStats* col_stats; // NULL until the table is analyzed
+    CatalogIndex* indexes; // indexes on this table
+    uint32_t nindexes;
+    struct CatalogTable* next; // hash chain
+} CatalogTable;
+
+struct CatalogIndex
+{
+    MDBCatalogIndexMetadata meta;
+    CatalogIndex* next;          // hash chain
+    CatalogIndex* next_in_table; // CatalogTable.indexes list
+};
+
+struct MDBCatalog
+{
+    MiniDB* db;
+    MDBWal* wal;
+    pthread_mutex_t row_id_lock;
+
+    CatalogTable** tables;
+    uint32_t table_buckets;
+    uint32_t ntables;
+
+    CatalogIndex** indexes;
+    uint32_t index_buckets;
+    uint32_t nindexes;
+};
+
+/**
+ * 32-bit FNV-1a over a NUL-terminated name.
+ */
+static uint32_t name_hash(const char* name)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Serialized catalog: a CatalogImageHeader, then per table an
+// ImageTable, per column an ImageColumn plus its name bytes, the column
+// statistics if the table was analyzed, and finally the index metadata.
+typedef struct
+{
+    uint32_t ntables;
+    uint32_t nindexes;
+} CatalogImageHeader;
+
+typedef struct
+{
+    char name[MDB_TABLE_NAME_MAX];
+    MDBPageNumber heap_root;
+    uint32_t flags;
+    uint64_t reserved_until; // row ids resume here before WAL recovery
+    uint16_t ncols;
+    uint8_t analyzed;
+    uint8_t reserved[5];
+} ImageTable;
+
+typedef struct
+{
+    MDBColumnType type;
+    MDBPageNumber root;
+    uint16_t name_len;
+    uint16_t reserved[3];
+} ImageColumn;
+
+typedef struct
+{
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} ImageWriter;
+
+typedef struct
+{
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+} ImageReader;
+
+static void image_put(ImageWriter* w, const void* data, size_t len)
+{
+    if (w->failed) return;
+    if (w->len + len > w->cap)
+    {
+        size_t cap = w->cap ? w->cap : 4096;
+        while (cap < w->len + len)
+        {
+            cap *= 2;
+        }
+        uint8_t* grown = realloc(w->data, cap);
+        if (!grown)
+        {
+            w->failed = true;
+            return;
+        }
+        w->data = grown;
+        w->cap = cap;
+    }
+    memcpy(w->data + w->len, data, len);
+    w->len += len;
+}
+
+static bool image_get(ImageReader* r, void* out, size_t len)
+{
+    if (r->len - r->pos < len) return false;
+    memcpy(out, r->data + r->pos, len);
+    r->pos += len;
+    return true;
+}
+
+static MDBCatalogTableMetadata table_metadata(const CatalogTable* t)
+{
+    MDBCatalogTableMetadata meta = t->meta;
+    meta.next_row_id = atomic_load(&t->next_row_id);
+    return meta;
+}
+
+static bool name_valid(const char* name)
+{
+    return name && *name && strlen(name) < MDB_TABLE_NAME_MAX;
+}
+
+static CatalogTable* find_table(const MDBCatalog* catalog, const char* name)
+{
+    CatalogTable* t = catalog->tables[name_hash(name) & (catalog->table_buckets - 1)];
+    while (t && strcmp(t->meta.name, name) != 0)
+    {
+        t = t->next;
+    }
+    return t;
+}
+
+static CatalogIndex* find_index(const MDBCatalog* catalog, const char* name)
+{
+    CatalogIndex* ix = catalog->indexes[name_hash(name) & (catalog->index_buckets - 1)];
+    while (ix && strcmp(ix->meta.name, name) != 0)
+    {
+        ix = ix->next;
+    }
+    return ix;
+}
+
+/**
+ * Double the table bucket array once the load factor reaches 1.
+ */
+static ErrorCode grow_tables(MDBCatalog* catalog)
+{
+    if (catalog->ntables < catalog->table_buckets) return OK;
+
+    uint32_t nbuckets = catalog->table_buckets * 2;
+    CatalogTable** buckets = calloc(nbuckets, sizeof(CatalogTable*));
+    if (!buckets) return ERR_UNKNOWN;
+
+    for (uint32_t i = 0; i < catalog->table_buckets; i++)
+    {
+        CatalogTable* t = catalog->tables[i];
+        while (t)
+        {
+            CatalogTable* next = t->next;
+            uint32_t b = name_hash(t->meta.name) & (nbuckets - 1);
+            t->next = buckets[b];
+            buckets[b] = t;
+            t = next;
+        }
+    }
+
+    free(catalog->tables);
+    catalog->tables = buckets;
+    catalog->table_buckets = nbuckets;
+    return OK;
+}
+
+static ErrorCode grow_indexes(MDBCatalog* catalog)
+{
+    if (catalog->nindexes < catalog->index_buckets) return OK;
+
+    uint32_t nbuckets = catalog->index_buckets * 2;
+    CatalogIndex** buckets = calloc(nbuckets, sizeof(CatalogIndex*));
+    if (!buckets) return ERR_UNKNOWN;
+
+    for (uint32_t i = 0; i < catalog->index_buckets; i++)
+    {
+        CatalogIndex* ix = catalog->indexes[i];
+        while (ix)
+        {
+            CatalogIndex* next = ix->next;
+            uint32_t b = name_hash(ix->meta.name) & (nbuckets - 1);
+            ix->next = buckets[b];
+            buckets[b] = ix;
+            ix = next;
+        }
+    }
+
+    free(catalog->indexes);
+    catalog->indexes = buckets;
+    catalog->index_buckets = nbuckets;
+    return OK;
+}
+
+static void free_table(CatalogTable* t)
+{
+    for (uint16_t i = 0; i < t->meta.ncols; i++)
+    {
+        free((char*)t->cols[i].name);
+    }
+    free(t->cols);
+    free(t->col_roots);
+    free(t->col_stats);
+    free(t);
+}
+
+/**
+ * Unlink an index from both the name hash and its table's list.
+ */
+static void unlink_index(MDBCatalog* catalog, CatalogIndex* ix)
+{
+    CatalogIndex** pp = &catalog->indexes[name_hash(ix->meta.name) & (catalog->index_buckets - 1)];
+    while (*pp != ix)
+    {
+        pp = &(*pp)->next;
+    }
+    *pp = ix->next;
+    catalog->nindexes--;
+
+    CatalogTable* t = find_table(catalog, ix->meta.table_name);
+    if (t)
+    {
+        CatalogIndex** tp = &t->indexes;
+        while (*tp && *tp != ix)
+        {
+            tp = &(*tp)->next_in_table;
+        }
+        if (*tp) *tp = ix->next_in_table;
+        t->nindexes--;
+    }
+}
+
+/**
+ * Add a table to the hash tables only; callers persist the catalog.
+ */
+static CatalogTable* table_insert(MDBCatalog* catalog, const char* table_name,
+                                  const MDBCatalogColumn* cols, uint16_t ncols,
+                                  MDBPageNumber heap_root, ErrorCode* out_err)
+{
+    *out_err = ERR_INVALID;
+    if (!name_valid(table_name) || (!cols && ncols > 0)) return NULL;
+    if (find_table(catalog, table_name)) return NULL;
+
+    *out_err = grow_tables(catalog);
+    if (*out_err != OK) return NULL;
+
+    *out_err = ERR_UNKNOWN;
+    CatalogTable* t = calloc(1, sizeof(CatalogTable));
+    if (!t) return NULL;
+
+    t->cols = calloc(ncols ? ncols : 1, sizeof(MDBCatalogColumn));
+    t->col_roots = calloc(ncols ? ncols : 1, sizeof(MDBPageNumber));
+    if (!t->cols || !t->col_roots)
+    {
+        free(t->cols);
+        free(t->col_roots);
+        free(t);
+        return NULL;
+    }
+
+    for (uint16_t i = 0; i < ncols; i++)
+    {
+        t->cols[i].name = strdup(cols[i].name);
+        t->cols[i].type = cols[i].type;
+        t->meta.ncols++;
+        if (!t->cols[i].name)
+        {
+            free_table(t);
+            return NULL;
+        }
+    }
+
+    strcpy(t->meta.name, table_name);
+    t->meta.heap_root = heap_root;
+    atomic_init(&t->next_row_id, 1);
+    atomic_init(&t->reserved_until, 1);
+
+    uint32_t b = name_hash(table_name) & (catalog->table_buckets - 1);
+    t->next = catalog->tables[b];
+    catalog->tables[b] = t;
+    catalog->ntables++;
+
+    *out_err = OK;
+    return t;
+}
+
+static CatalogIndex* index_insert(MDBCatalog* catalog,
+                                  const MDBCatalogIndexMetadata* meta,
+                                  ErrorCode* out_err)
+{
+    *out_err = ERR_INVALID;
+    if (!name_valid(meta->name) || find_index(catalog, meta->name)) return NULL;
+
+    CatalogTable* t = find_table(catalog, meta->table_name);
+    if (!t || meta->col_idx >= t->meta.ncols) return NULL;
+
+    *out_err = grow_indexes(catalog);
+    if (*out_err != OK) return NULL;
+
+    *out_err = ERR_UNKNOWN;
+    CatalogIndex* ix = calloc(1, sizeof(CatalogIndex));
+    if (!ix) return NULL;
+
+    ix->meta = *meta;
+
+    uint32_t b = name_hash(meta->name) & (catalog->index_buckets - 1);
+    ix->next = catalog->indexes[b];
+    catalog->indexes[b] = ix;
+    catalog->nindexes++;
+
+    ix->next_in_table = t->indexes;
+    t->indexes = ix;
+    t->nindexes++;
+
+    *out_err = OK;
+    return ix;
+}
+
+static void image_put_table(ImageWriter* w, const CatalogTable* t)
+{
+    ImageTable it = {.heap_root = t->meta.heap_root,
+                     .flags = t->meta.flags,
+                     .reserved_until = atomic_load(&t->reserved_until),
+                     .ncols = t->meta.ncols,
+                     .analyzed = t->col_stats != NULL};
+    memcpy(it.name, t->meta.name, sizeof(it.name));
+    image_put(w, &it, sizeof(it));
+
+    for (uint16_t i = 0; i < t->meta.ncols; i++)
+    {
+        ImageColumn ic = {.type = t->cols[i].type,
+                          .root = t->col_roots[i],
+                          .name_len = (uint16_t)strlen(t->cols[i].name)};
+        image_put(w, &ic, sizeof(ic));
+        image_put(w, t->cols[i].name, ic.name_len);
+    }
+
+    if (t->col_stats) image_put(w, t->col_stats, t->meta.ncols * sizeof(MDBColumnStats));
+}
+
+/**
+ * Write the whole catalog to a new chain, point the file header at it and
+ * free the previous one.
+ */
+static ErrorCode catalog_save(MDBCatalog* catalog)
+{
+    CatalogImageHeader h = {catalog->ntables, catalog->nindexes};
+    ImageWriter w = {0};
+    image_put(&w, &h, sizeof(h));
+
+    for (uint32_t i = 0; i < catalog->table_buckets; i++)
+    {
+        for (CatalogTable* t = catalog->tables[i]; t; t = t->next)
+        {
+            image_put_table(&w, t);
+        }
+    }
+    for (uint32_t i = 0; i < catalog->index_buckets; i++)
+    {
+        for (CatalogIndex* ix = catalog->indexes[i]; ix; ix = ix->next)
+        {
+            image_put(&w, &ix->meta, sizeof(ix->meta));
+        }
+    }
+
+    MiniDB* db = catalog->db;
+    MDBPageNumber root = 0;
+    ErrorCode err = w.failed || w.len > UINT32_MAX ? ERR_UNKNOWN : OK;
+    if (err == OK) err = mdb_overflow_write(db, w.data, (uint32_t)w.len, &root);
+    free(w.data);
+    if (err != OK)
+    {
+        if (root) mdb_overflow_free(db, root);
+        return err;
+    }
+
+    pthread_mutex_lock(&db->header_lock);
+    MDBPageNumber old_root = 0;
+    err = mdb_header_load(db);
+    if (err == OK)
+    {
+        old_root = db->header.catalog_root;
+        db->header.catalog_root = root;
+        db->header.catalog_size = (uint32_t)w.len;
+        err = mdb_header_store(db);
+        if (err == OK) err = mdb_io_sync(db);
+    }
+    pthread_mutex_unlock(&db->header_lock);
+    if (err != OK)
+    {
+        // The header may or may not point at the new chain now; leave
+        // both chains alone rather than risk freeing the live one.
+        return err;
+    }
+
+    return old_root ? mdb_overflow_free(db, old_root) : OK;
+}
+
+static ErrorCode image_load_table(MDBCatalog* catalog, ImageReader* r)
+{
+    ImageTable it;
+    if (!image_get(r, &it, sizeof(it))) return ERR_CORRUPT;
+    it.name[MDB_TABLE_NAME_MAX - 1] = '\0';
+
+    MDBCatalogColumn* cols = calloc(it.ncols ? it.ncols : 1, sizeof(MDBCatalogColumn));
+    MDBPageNumber* roots = calloc(it.ncols ? it.ncols : 1, sizeof(MDBPageNumber));
+    ErrorCode err = cols && roots ? OK : ERR_UNKNOWN;
+
+    for (uint16_t i = 0; i < it.ncols && err == OK; i++)
+    {
+        ImageColumn ic;
+        char* name = NULL;
+        if (!image_get(r, &ic, sizeof(ic)))
+        {
+            err = ERR_CORRUPT;
+        }
+        else if (!(name = calloc(ic.name_len + 1u, 1)))
+        {
+            err = ERR_UNKNOWN;
+        }
+        else if (!image_get(r, name, ic.name_len))
+        {
+            err = ERR_CORRUPT;
+        }
+        cols[i].name = name;
+        cols[i].type = ic.type;
+        roots[i] = ic.root;
+    }
+
+    CatalogTable* t = NULL;
+    if (err == OK) t = table_insert(catalog, it.name, cols, it.ncols, it.heap_root, &err);
+    if (t)
+    {
+        t->meta.flags = it.flags;
+        memcpy(t->col_roots, roots, it.ncols * sizeof(MDBPageNumber));
+        atomic_store(&t->next_row_id, it.reserved_until);
+        atomic_store(&t->reserved_until, it.reserved_until);
+    }
+    if (t && it.analyzed)
+    {
+        t->col_stats = calloc(it.ncols ? it.ncols : 1, sizeof(MDBColumnStats));
+        if (!t->col_stats) err = ERR_UNKNOWN;
+        else if (!image_get(r, t->col_stats, it.ncols * sizeof(MDBColumnStats))) err = ERR_CORRUPT;
+    }
+
+    for (uint16_t i = 0; cols && i < it.ncols; i++)
+    {
+        free((char*)cols[i].name);
+    }
+    free(cols);
+    free(roots);
+    return err;
+}
+
+/**
+ * Fill the hash tables from the catalog stored in the file, if any.
+ */
+static ErrorCode catalog_load(MDBCatalog* catalog)
+{
+    MiniDB* db = catalog->db;
+    pthread_mutex_lock(&db->header_lock);
+    ErrorCode err = mdb_header_load(db);
+    MDBPageNumber root = db->header.catalog_root;
+    uint32_t len = db->header.catalog_size;
+    pthread_mutex_unlock(&db->header_lock);
+    if (err != OK || root == 0) return err;
+
+    uint8_t* data = malloc(len ? len : 1);
+    if (!data) return ERR_UNKNOWN;
+
+    err = mdb_overflow_read(db, root, data, len);
+    ImageReader r = {data, len, 0};
+    CatalogImageHeader h;
+    if (err == OK && !image_get(&r, &h, sizeof(h))) err = ERR_CORRUPT;
+
+    for (uint32_t i = 0; err == OK && i < h.ntables; i++)
+    {
+        err = image_load_table(catalog, &r);
+    }
+    for (uint32_t i = 0; err == OK && i < h.nindexes; i++)
+    {
+        MDBCatalogIndexMetadata meta;
+        if (!image_get(&r, &meta, sizeof(meta))) err = ERR_CORRUPT;
+        meta.name[MDB_TABLE_NAME_MAX - 1] = '\0';
+        meta.table_name[MDB_TABLE_NAME_MAX - 1] = '\0';
+        if (err == OK) index_insert(catalog, &meta, &err);
+    }
+
+    free(data);
+    return err;
+}
+
+static ErrorCode recover_row_id(void* ctx, const MDBWalRecord* record,
+                                const void* payload)
+{
+    MDBCatalog* catalog = ctx;
+    if (record->type != WAL_OP_ROW_ID_RESERVE || record->size != sizeof(RowIdReservation))
+    {
+        return OK;
+    }
+
+    RowIdReservation r;
+    memcpy(&r, payload, sizeof(r));
+    r.table_name[MDB_TABLE_NAME_MAX - 1] = '\0';
+
+    CatalogTable* t = find_table(catalog, r.table_name);
+    if (t && r.high_water > atomic_load(&t->reserved_until))
+    {
+        atomic_store(&t->next_row_id, r.high_water);
+        atomic_store(&t->reserved_until, r.high_water);
+    }
+
+    return OK;
+}
+
+ErrorCode mdb_catalog_open(MiniDB* db, MDBCatalog** out_catalog)
+{
+    if (!db || !out_catalog) return ERR_INVALID;
+
+    MDBCatalog* catalog = calloc(1, sizeof(MDBCatalog));
+    if (!catalog) return ERR_UNKNOWN;
+
+    catalog->db = db;
+    pthread_mutex_init(&catalog->row_id_lock, NULL);
+    catalog->table_buckets = CATALOG_INITIAL_BUCKETS;
+    catalog->index_buckets = CATALOG_INITIAL_BUCKETS;
+    catalog->tables = calloc(catalog->table_buckets, sizeof(CatalogTable*));
+    catalog->indexes = calloc(catalog->index_buckets, sizeof(CatalogIndex*));
+    if (!catalog->tables || !catalog->indexes)
+    {
+        pthread_mutex_destroy(&catalog->row_id_lock);
+        free(catalog->tables);
+        free(catalog->indexes);
+        free(catalog);
+        return ERR_UNKNOWN;
+    }
+
+    ErrorCode err = mdb_wal_get(db, &catalog->wal);
+    if (err == OK) err = catalog_load(catalog);
+    // Each table's row id counter resumes at its last logged reservation.
+    if (err == OK) err = mdb_wal_scan(catalog->wal, recover_row_id, catalog);
+    if (err != OK)
+    {
+        mdb_catalog_close(catalog);
+        return err;
+    }
+
+    *out_catalog = catalog;
+    return OK;
+}
+
+ErrorCode mdb_catalog_close(MDBCatalog* catalog)
+{
+    if (!catalog) return ERR_INVALID;
+
+    for (uint32_t i = 0; i < catalog->index_buckets; i++)
+    {
+        CatalogIndex* ix = catalog->indexes[i];
+        while (ix)
+        {
+            CatalogIndex* next = ix->next;
+            free(ix);
+            ix = next;
+        }
+    }
+
+    for (uint32_t i = 0; i < catalog->table_buckets; i++)
+    {
+        CatalogTable* t = catalog->tables[i];
+        while (t)
+        {
+            CatalogTable* next = t->next;
+            free_table(t);
+            t = next;
+        }
+    }
+
+    pthread_mutex_destroy(&catalog->row_id_lock);
+    free(catalog->indexes);
+    free(catalog->tables);
+    free(catalog);
+    return OK;
+}
+
+ErrorCode mdb_catalog_create_table(MDBCatalog* catalog, const char* table_name,
+                                   const MDBCatalogColumn* cols, uint16_t ncols,
+                                   MDBPageNumber heap_root)
+{
+    if (!catalog) return ERR_INVALID;
+
+    ErrorCode err;
+    if (!table_insert(catalog, table_name, cols, ncols, heap_root, &err)) return err;
+    return catalog_save(catalog);
+}
+
+ErrorCode mdb_catalog_drop_table(MDBCatalog* catalog, const char* table_name)
+{
+    if (!catalog || !table_name) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t) return ERR_INVALID;
+
+    // Indexes go with their table.
+    while (t->indexes)
+    {
+        CatalogIndex* ix = t->indexes;
+        unlink_index(catalog, ix);
+        free(ix);
+    }
+
+    CatalogTable** pp = &catalog->tables[name_hash(table_name) & (catalog->table_buckets - 1)];
+    while (*pp != t)
+    {
+        pp = &(*pp)->next;
+    }
+    *pp = t->next;
+    catalog->ntables--;
+
+    free_table(t);
+    return catalog_save(catalog);
+}
+
+ErrorCode mdb_catalog_set_table_flags(MDBCatalog* catalog,
+                                      const char* table_name, uint32_t flags)
+{
+    if (!catalog || !table_name) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t) return ERR_INVALID;
+
+    t->meta.flags = flags;
+    return catalog_save(catalog);
+}
+
+/**
+ * Name and type of one column. The name belongs to the catalog and stays
+ * valid until the table is dropped or the catalog closed.
+ */
+ErrorCode mdb_catalog_get_column(MDBCatalog* catalog, const char* table_name,
+                                 uint16_t col_idx, MDBCatalogColumn* out_col)
+{
+    if (!catalog || !table_name || !out_col) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t || col_idx >= t->meta.ncols) return ERR_INVALID;
+
+    *out_col = t->cols[col_idx];
+    return OK;
+}
+
+/**
+ * First page of a columnar table's column chain, 0 while it holds no rows.
+ */
+ErrorCode mdb_catalog_get_column_root(MDBCatalog* catalog,
+                                      const char* table_name, uint16_t col_idx,
+                                      MDBPageNumber* out_root)
+{
+    if (!catalog || !table_name || !out_root) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t || col_idx >= t->meta.ncols) return ERR_INVALID;
+
+    *out_root = t->col_roots[col_idx];
+    return OK;
+}
+
+ErrorCode mdb_catalog_set_column_root(MDBCatalog* catalog,
+                                      const char* table_name, uint16_t col_idx,
+                                      MDBPageNumber root)
+{
+    if (!catalog || !table_name) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t || !(t->meta.flags & MDB_TABLE_COLUMNAR) || col_idx >= t->meta.ncols) return ERR_INVALID;
+
+    t->col_roots[col_idx] = root;
+    return catalog_save(catalog);
+}
+
+/**
+ * Record ANALYZE results for one column. Columns not analyzed yet read
+ * back as all-zero statistics.
+ */
+ErrorCode mdb_catalog_set_column_stats(MDBCatalog* catalog,
+                                       const char* table_name, uint16_t col_idx,
+                                       const MDBColumnStats* stats)
+{
+    if (!catalog || !table_name || !stats) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t || col_idx >= t->meta.ncols) return ERR_INVALID;
+
+    if (!t->col_stats)
+    {
+        t->col_stats = calloc(t->meta.ncols, sizeof(MDBColumnStats));
+        if (!t->col_stats) return ERR_UNKNOWN;
+    }
+
+    t->col_stats[col_idx] = *stats;
+    return catalog_save(catalog);
+}
+
+ErrorCode mdb_catalog_get_column_stats(MDBCatalog* catalog,
+                                       const char* table_name, uint16_t col_idx,
+                                       MDBColumnStats* out_stats,
+                                       bool* out_analyzed)
+{
+    if (!catalog || !table_name || !out_stats || !out_analyzed) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t || col_idx >= t->meta.ncols) return ERR_INVALID;
+
+    *out_analyzed = t->col_stats != NULL;
+    if (t->col_stats)
+    {
+        *out_stats = t->col_stats[col_idx];
+    }
+    else
+    {
+        memset(out_stats, 0, sizeof(MDBColumnStats));
+    }
+    return OK;
+}
+
+ErrorCode mdb_catalog_list_tables(MDBCatalog* catalog,
+                                  MDBCatalogTableMetadata** out_array,
+                                  uint32_t* out_count)
+{
+    if (!catalog || !out_array || !out_count) return ERR_INVALID;
+
+    MDBCatalogTableMetadata* array = malloc(sizeof(MDBCatalogTableMetadata) * (catalog->ntables ? catalog->ntables : 1));
+    if (!array) return ERR_UNKNOWN;
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < catalog->table_buckets; i++)
+    {
+        for (CatalogTable* t = catalog->tables[i]; t; t = t->next)
+        {
+            array[n++] = table_metadata(t);
+        }
+    }
+
+    *out_array = array;
+    *out_count = n;
+    return OK;
+}
+
+ErrorCode mdb_catalog_get(MDBCatalog* catalog, const char* table_name,
+                          MDBCatalogTableMetadata* out_metadata)
+{
+    if (!catalog || !table_name || !out_metadata) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t) return ERR_INVALID;
+
+    *out_metadata = table_metadata(t);
+    return OK;
+}
+
+ErrorCode mdb_catalog_alloc_row_id(MDBCatalog* catalog, const char* table_name,
+                                   MDBRowID* out_row_id)
+{
+    if (!catalog || !table_name || !out_row_id) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t) return ERR_INVALID;
+
+    uint64_t id = atomic_fetch_add(&t->next_row_id, 1);
+    if (id < atomic_load(&t->reserved_until))
+    {
+        *out_row_id = id;
+        return OK;
+    }
+
+    // Slow path: this id is past the reserved range. Extend the reservation
+    // (possibly already done by a concurrent inserter) before handing it out.
+    ErrorCode err = OK;
+    pthread_mutex_lock(&catalog->row_id_lock);
+
+    uint64_t reserved = atomic_load(&t->reserved_until);
+    if (id >= reserved)
+    {
+        uint64_t high_water = reserved;
+        while (high_water <= id)
+        {
+            high_water += MDB_ROW_ID_BATCH;
+        }
+
+        RowIdReservation r = {0};
+        strcpy(r.table_name, t->meta.name);
+        r.high_water = high_water;
+
+        MDBWalRecord record = {.type = WAL_OP_ROW_ID_RESERVE, .size = sizeof(r)};
+        // Durable now, but without flushing (or later losing to a
+        // ROLLBACK) the records of a transaction that is still open.
+        err = mdb_wal_write_direct(catalog->wal, &record, &r);
+
+        if (err == OK) atomic_store(&t->reserved_until, high_water);
+    }
+
+    pthread_mutex_unlock(&catalog->row_id_lock);
+
+    if (err != OK) return err;
+
+    *out_row_id = id;
+    return OK;
+}
+
+ErrorCode mdb_catalog_add_index(MDBCatalog* catalog,
+                                const MDBCatalogIndexMetadata* meta)
+{
+    if (!catalog || !meta) return ERR_INVALID;
+
+    ErrorCode err;
+    if (!index_insert(catalog, meta, &err)) return err;
+    return catalog_save(catalog);
+}
+
+ErrorCode mdb_catalog_drop_index(MDBCatalog* catalog, const char* index_name)
+{
+    if (!catalog || !index_name) return ERR_INVALID;
+
+    CatalogIndex* ix = find_index(catalog, index_name);
+    if (!ix) return ERR_INVALID;
+
+    unlink_index(catalog, ix);
+    free(ix);
+    return catalog_save(catalog);
+}
+
+ErrorCode mdb_catalog_get_index(MDBCatalog* catalog, const char* index_name,
+                                MDBCatalogIndexMetadata* out_meta)
+{
+    if (!catalog || !index_name || !out_meta) return ERR_INVALID;
+
+    CatalogIndex* ix = find_index(catalog, index_name);
+    if (!ix) return ERR_INVALID;
+
+    *out_meta = ix->meta;
+    return OK;
+}
+
+ErrorCode mdb_catalog_list_indexes(MDBCatalog* catalog, const char* table_name,
+                                   MDBCatalogIndexMetadata** out_array,
+                                   uint32_t* out_count)
+{
+    if (!catalog || !table_name || !out_array || !out_count) return ERR_INVALID;
+
+    CatalogTable* t = find_table(catalog, table_name);
+    if (!t) return ERR_INVALID;
+
+    MDBCatalogIndexMetadata* array = malloc(sizeof(MDBCatalogIndexMetadata) * (t->nindexes ? t->nindexes : 1));
+    if (!array) return ERR_UNKNOWN;
+
+    uint32_t n = 0;
+    for (CatalogIndex* ix = t->indexes; ix; ix = ix->next_in_table)
+    {
+        array[n++] = ix->meta;
+    }
+
+    *out_array = array;
+    *out_count = n;
+    return OK;
+}
@@ -0,0 +1,544 @@
+#include "column.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Column storage.
+ *
+ * Tables created WITH (storage = column) keep every column in its own
+ * chain of PG_COLUMN pages instead of row-at-a-time heap pages. A query
+ * that aggregates two columns of a thirty-column table reads only those
+ * two chains, and because a page holds values of a single type they can
+ * be encoded far more tightly than rows:
+ *
+ * - INT pages use frame of reference: the page minimum is stored once
+ *   and every value as a bit-packed offset from it, using just enough
+ *   bits for the largest offset on the page.
+ * - TEXT pages use dictionary encoding (a table of up to 256 distinct
+ *   strings plus one-byte codes) or run-length encoding (runs of equal
+ *   strings), whichever comes out smaller for the page.
+ *
+ * NULLs are kept in a bitmap in front of the data, and only non-NULL
+ * values are encoded. Each page is encoded on its own, so a reader never
+ * needs more than the page in hand, and appends never rewrite existing
+ * pages apart from the old tail's `next` link.
+ *
+ * A single TEXT value must fit on one page; columnar tables don't use
+ * overflow chains.
+ */
+
+#define COLUMN_CAPACITY (MDB_PAGE_USABLE_SIZE - sizeof(MDBColumnPageHeader))
+#define DICT_MAX 256
+#define DICT_SLOTS 512
+
+typedef struct
+{
+    uint8_t* p;
+    uint32_t len;
+    uint32_t cap;
+} ColumnBuf;
+
+static bool buf_put(ColumnBuf* b, const void* data, uint32_t len)
+{
+    if (len > b->cap - b->len) return false;
+    memcpy(b->p + b->len, data, len);
+    b->len += len;
+    return true;
+}
+
+static bool buf_put_text(ColumnBuf* b, UTF8String s)
+{
+    return buf_put(b, &s.length, sizeof(uint16_t)) && buf_put(b, s.ptr, s.length);
+}
+
+static bool text_eq(UTF8String a, UTF8String b)
+{
+    return a.length == b.length && memcmp(a.ptr, b.ptr, a.length) == 0;
+}
+
+static uint32_t text_hash(UTF8String s)
+{
+    uint32_t h = 2166136261u;
+    for (uint16_t i = 0; i < s.length; i++)
+    {
+        h ^= (uint8_t)s.ptr[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Write the low `width` bits of `v` at bit offset `pos`. The buffer must
+ * start out zeroed.
+ */
+static void bits_put(uint8_t* buf, uint64_t pos, uint64_t v, uint8_t width)
+{
+    for (uint8_t done = 0; done < width;)
+    {
+        uint8_t shift = pos & 7;
+        uint8_t take = 8 - shift;
+        if (take > width - done) take = width - done;
+
+        buf[pos >> 3] |= (uint8_t)(((v >> done) & ((1u << take) - 1)) << shift);
+        done += take;
+        pos += take;
+    }
+}
+
+static uint64_t bits_get(const uint8_t* buf, uint64_t pos, uint8_t width)
+{
+    uint64_t v = 0;
+    for (uint8_t done = 0; done < width;)
+    {
+        uint8_t shift = pos & 7;
+        uint8_t take = 8 - shift;
+        if (take > width - done) take = width - done;
+
+        v |= (uint64_t)((buf[pos >> 3] >> shift) & ((1u << take) - 1)) << done;
+        done += take;
+        pos += take;
+    }
+    return v;
+}
+
+static bool encode_for(const MDBValue* values, uint32_t n, ColumnBuf* b)
+{
+    int64_t base = INT64_MAX;
+    int64_t max = INT64_MIN;
+    uint32_t nonnull = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (values[i].is_null) continue;
+        if (values[i].integer < base) base = values[i].integer;
+        if (values[i].integer > max) max = values[i].integer;
+        nonnull++;
+    }
+    if (nonnull == 0) base = max = 0;
+
+    // Offsets are taken modulo 2^64, so even INT64_MIN..INT64_MAX fits.
+    uint64_t range = (uint64_t)max - (uint64_t)base;
+    uint8_t width = 0;
+    while (width < 64 && (range >> width) != 0)
+    {
+        width++;
+    }
+
+    uint64_t packed = ((uint64_t)nonnull * width + 7) / 8;
+    if (!buf_put(b, &base, sizeof(base)) || !buf_put(b, &width, 1)) return false;
+    if (packed > b->cap - b->len) return false;
+
+    uint8_t* bits = b->p + b->len;
+    memset(bits, 0, packed);
+
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (values[i].is_null) continue;
+        bits_put(bits, pos, (uint64_t)values[i].integer - (uint64_t)base, width);
+        pos += width;
+    }
+
+    b->len += (uint32_t)packed;
+    return true;
+}
+
+static bool encode_rle(const MDBValue* values, uint32_t n, ColumnBuf* b)
+{
+    uint32_t i = 0;
+    while (i < n)
+    {
+        if (values[i].is_null)
+        {
+            i++;
+            continue;
+        }
+
+        // Runs skip over NULLs, which live in the bitmap.
+        UTF8String s = values[i].text;
+        uint16_t run = 0;
+        while (i < n && run < UINT16_MAX && (values[i].is_null || text_eq(values[i].text, s)))
+        {
+            run += !values[i].is_null;
+            i++;
+        }
+
+        if (!buf_put(b, &run, sizeof(run)) || !buf_put_text(b, s)) return false;
+    }
+    return true;
+}
+
+/**
+ * Dictionary-encode the page's non-NULL values. Fails if there are more
+ * than DICT_MAX distinct values or the result doesn't fit.
+ */
+static bool encode_dict(const MDBValue* values, uint32_t n, ColumnBuf* b)
+{
+    UTF8String dict[DICT_MAX];
+    int16_t slots[DICT_SLOTS];
+    memset(slots, -1, sizeof(slots));
+
+    uint8_t* codes = malloc(n ? n : 1);
+    if (!codes) return false;
+
+    uint16_t ndict = 0;
+    uint32_t ncodes = 0;
+    bool ok = true;
+
+    for (uint32_t i = 0; ok && i < n; i++)
+    {
+        if (values[i].is_null) continue;
+
+        UTF8String s = values[i].text;
+        uint32_t slot = text_hash(s) & (DICT_SLOTS - 1);
+        while (slots[slot] >= 0 && !text_eq(dict[slots[slot]], s))
+        {
+            slot = (slot + 1) & (DICT_SLOTS - 1);
+        }
+
+        if (slots[slot] < 0)
+        {
+            if (ndict == DICT_MAX)
+            {
+                ok = false;
+                break;
+            }
+            dict[ndict] = s;
+            slots[slot] = (int16_t)ndict++;
+        }
+        codes[ncodes++] = (uint8_t)slots[slot];
+    }
+
+    ok = ok && buf_put(b, &ndict, sizeof(ndict));
+    for (uint16_t i = 0; ok && i < ndict; i++)
+    {
+        ok = buf_put_text(b, dict[i]);
+    }
+    ok = ok && buf_put(b, codes, ncodes);
+
+    free(codes);
+    return ok;
+}
+
+/**
+ * Encode `n` values as one PG_COLUMN page. Returns false if they don't
+ * fit, leaving the page contents undefined.
+ */
+static bool encode_page(MDBColumnType type, const MDBValue* values, uint32_t n,
+                        MDBPageNumber next, MDBPage* page)
+{
+    mdb_page_init(page, PG_COLUMN);
+
+    MDBColumnPageHeader h = {.type = PG_COLUMN, .next = next, .count = n};
+    ColumnBuf b = {page->data + sizeof(h), 0, COLUMN_CAPACITY};
+
+    for (uint32_t i = 0; i < n && !h.has_nulls; i++)
+    {
+        h.has_nulls = values[i].is_null;
+    }
+    if (h.has_nulls)
+    {
+        uint32_t bytes = (n + 7) / 8;
+        if (bytes > b.cap) return false;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (values[i].is_null) b.p[i / 8] |= (uint8_t)(1u << (i % 8));
+        }
+        b.len = bytes;
+    }
+
+    bool ok;
+    if (type == COL_TYPE_INT)
+    {
+        h.encoding = MDB_COL_ENC_FOR;
+        ok = encode_for(values, n, &b);
+    }
+    else
+    {
+        // Try both TEXT encodings and keep the smaller one.
+        uint32_t start = b.len;
+        ColumnBuf rle = b;
+        bool rle_ok = encode_rle(values, n, &rle);
+
+        b.len = start;
+        if (encode_dict(values, n, &b) && (!rle_ok || b.len <= rle.len))
+        {
+            h.encoding = MDB_COL_ENC_DICT;
+            ok = true;
+        }
+        else
+        {
+            b.len = start;
+            h.encoding = MDB_COL_ENC_RLE;
+            ok = rle_ok && encode_rle(values, n, &b);
+        }
+    }
+    if (!ok) return false;
+
+    h.data_len = (uint16_t)b.len;
+    memcpy(page->data, &h, sizeof(h));
+    return true;
+}
+
+/**
+ * Largest number of values starting at `values` that fit on one page.
+ */
+static uint32_t segment_size(MDBColumnType type, const MDBValue* values,
+                             uint32_t n, MDBPage* scratch)
+{
+    uint32_t hi = n < MDB_COLUMN_MAX_VALUES ? n : MDB_COLUMN_MAX_VALUES;
+    if (encode_page(type, values, hi, 0, scratch)) return hi;
+
+    uint32_t lo = 0; // encode_page(lo) fits, encode_page(hi) doesn't
+    while (hi - lo > 1)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (encode_page(type, values, mid, 0, scratch))
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Append `n` values to a column chain, creating the chain if
+ * *io_first_page is 0. New pages are written back to front so each one
+ * knows its successor, then linked behind the existing tail.
+ */
+ErrorCode mdb_column_append(MiniDB* db, MDBColumnType type,
+                            MDBPageNumber* io_first_page,
+                            const MDBValue* values, uint32_t n)
+{
+    if (!db || !io_first_page || (!values && n > 0)) return ERR_INVALID;
+    if (type != COL_TYPE_INT && type != COL_TYPE_TEXT) return ERR_INVALID;
+    if (n == 0) return OK;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (values[i].is_null) continue;
+        if (values[i].type != type || mdb_value_is_external(&values[i])) return ERR_INVALID;
+    }
+
+    // Split the values into page-sized segments.
+    uint32_t* starts = malloc(sizeof(uint32_t) * (n + 1));
+    if (!starts) return ERR_UNKNOWN;
+
+    MDBPage page;
+    uint32_t nsegs = 0;
+    for (uint32_t i = 0; i < n;)
+    {
+        uint32_t count = segment_size(type, values + i, n - i, &page);
+        if (count == 0)
+        {
+            free(starts);
+            return ERR_FULL; // a single value larger than a page
+        }
+        starts[nsegs++] = i;
+        i += count;
+    }
+    starts[nsegs] = n;
+
+    ErrorCode err = OK;
+    MDBPageNumber next = 0;
+    for (uint32_t s = nsegs; err == OK && s-- > 0;)
+    {
+        encode_page(type, values + starts[s], starts[s + 1] - starts[s], next, &page);
+        err = mdb_page_allocate(db, &page, &next);
+    }
+    free(starts);
+    if (err != OK) return err;
+
+    if (*io_first_page == 0)
+    {
+        *io_first_page = next;
+        return OK;
+    }
+
+    // Link the new pages behind the current tail.
+    MDBPageNumber tail = *io_first_page;
+    for (;;)
+    {
+        err = mdb_page_read(db, tail, &page);
+        if (err != OK) return err;
+        if (!mdb_page_is_type(&page, PG_COLUMN)) return ERR_CORRUPT;
+
+        MDBColumnPageHeader h;
+        memcpy(&h, page.data, sizeof(h));
+        if (h.next == 0)
+        {
+            h.next = next;
+            memcpy(page.data, &h, sizeof(h));
+            return mdb_page_write(db, tail, &page);
+        }
+        tail = h.next;
+    }
+}
+
+static bool read_text(const uint8_t* data, uint32_t len, uint32_t* pos,
+                      UTF8String* out)
+{
+    uint16_t n;
+    if (len - *pos < sizeof(n)) return false;
+    memcpy(&n, data + *pos, sizeof(n));
+    *pos += sizeof(n);
+
+    if (len - *pos < n) return false;
+    out->length = n;
+    out->ptr = (const char*)data + *pos;
+    *pos += n;
+    return true;
+}
+
+/**
+ * Decode every value on a PG_COLUMN page. TEXT values point into `page`.
+ */
+static ErrorCode decode_page(const MDBPage* page, MDBValue* out)
+{
+    MDBColumnPageHeader h;
+    memcpy(&h, page->data, sizeof(h));
+    if (h.count > MDB_COLUMN_MAX_VALUES || h.data_len > COLUMN_CAPACITY) return ERR_CORRUPT;
+
+    const uint8_t* data = page->data + sizeof(h);
+    uint32_t len = h.data_len;
+    uint32_t pos = 0;
+
+    const uint8_t* nulls = NULL;
+    if (h.has_nulls)
+    {
+        nulls = data;
+        pos = (h.count + 7) / 8;
+        if (pos > len) return ERR_CORRUPT;
+    }
+
+    uint32_t nonnull = 0;
+    for (uint32_t i = 0; i < h.count; i++)
+    {
+        out[i].is_null = nulls && (nulls[i / 8] >> (i % 8)) & 1;
+        out[i].overflow.first_page = 0;
+        if (out[i].is_null)
+        {
+            out[i].type = COL_TYPE_INVALID;
+        }
+        else
+        {
+            nonnull++;
+        }
+    }
+
+    if (h.encoding == MDB_COL_ENC_FOR)
+    {
+        int64_t base;
+        uint8_t width;
+        if (len - pos < sizeof(base) + 1) return ERR_CORRUPT;
+        memcpy(&base, data + pos, sizeof(base));
+        width = data[pos + sizeof(base)];
+        pos += sizeof(base) + 1;
+        if (width > 64 || ((uint64_t)nonnull * width + 7) / 8 > len - pos) return ERR_CORRUPT;
+
+        uint64_t bit = 0;
+        for (uint32_t i = 0; i < h.count; i++)
+        {
+            if (out[i].is_null) continue;
+            out[i].type = COL_TYPE_INT;
+            out[i].integer = (int64_t)((uint64_t)base + bits_get(data + pos, bit, width));
+            bit += width;
+        }
+    }
+    else if (h.encoding == MDB_COL_ENC_RLE)
+    {
+        uint16_t run = 0;
+        UTF8String s = {0, NULL};
+        for (uint32_t i = 0; i < h.count; i++)
+        {
+            if (out[i].is_null) continue;
+            while (run == 0)
+            {
+                if (len - pos < sizeof(run)) return ERR_CORRUPT;
+                memcpy(&run, data + pos, sizeof(run));
+                pos += sizeof(run);
+                if (!read_text(data, len, &pos, &s)) return ERR_CORRUPT;
+            }
+            out[i].type = COL_TYPE_TEXT;
+            out[i].text = s;
+            run--;
+        }
+    }
+    else if (h.encoding == MDB_COL_ENC_DICT)
+    {
+        UTF8String dict[DICT_MAX];
+        uint16_t ndict;
+        if (len - pos < sizeof(ndict)) return ERR_CORRUPT;
+        memcpy(&ndict, data + pos, sizeof(ndict));
+        pos += sizeof(ndict);
+        if (ndict > DICT_MAX) return ERR_CORRUPT;
+
+        for (uint16_t d = 0; d < ndict; d++)
+        {
+            if (!read_text(data, len, &pos, &dict[d])) return ERR_CORRUPT;
+        }
+        if (len - pos < nonnull) return ERR_CORRUPT;
+
+        for (uint32_t i = 0; i < h.count; i++)
+        {
+            if (out[i].is_null) continue;
+            uint8_t code = data[pos++];
+            if (code >= ndict) return ERR_CORRUPT;
+            out[i].type = COL_TYPE_TEXT;
+            out[i].text = dict[code];
+        }
+    }
+    else
+    {
+        return ERR_CORRUPT;
+    }
+
+    return OK;
+}
+
+ErrorCode mdb_column_scan_open(MiniDB* db, MDBPageNumber first_page,
+                               MDBColumnScan* out_scan)
+{
+    if (!db || !out_scan) return ERR_INVALID;
+
+    out_scan->values = malloc(sizeof(MDBValue) * MDB_COLUMN_MAX_VALUES);
+    if (!out_scan->values) return ERR_UNKNOWN;
+
+    out_scan->db = db;
+    out_scan->next = first_page;
+    out_scan->err = OK;
+    return OK;
+}
+
+/**
+ * Decode the next page of the column. The values stay valid until the
+ * following call. Returns false at the end or on error; check scan->err
+ * to tell them apart.
+ */
+bool mdb_column_scan_next(MDBColumnScan* scan, const MDBValue** out_values,
+                          uint32_t* out_count)
+{
+    if (scan->err != OK || scan->next == 0) return false;
+
+    scan->err = mdb_page_read(scan->db, scan->next, &scan->page);
+    if (scan->err == OK && !mdb_page_is_type(&scan->page, PG_COLUMN)) scan->err = ERR_CORRUPT;
+    if (scan->err == OK) scan->err = decode_page(&scan->page, scan->values);
+    if (scan->err != OK) return false;
+
+    MDBColumnPageHeader h;
+    memcpy(&h, scan->page.data, sizeof(h));
+    scan->next = h.next;
+
+    if (out_values) *out_values = scan->values;
+    if (out_count) *out_count = h.count;
+    return true;
+}
+
+void mdb_column_scan_close(MDBColumnScan* scan)
+{
+    free(scan->values);
+    scan->values = NULL;
+}
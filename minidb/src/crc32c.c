@@ -0,0 +1,174 @@
+#include "crc32c.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+/*
+ * CRC32C (Castagnoli), the checksum used for pages.
+ *
+ * On x86-64 with SSE4.2 we use the crc32 instruction. It has a three cycle
+ * latency but can issue every cycle, so large inputs are split into three
+ * independent streams that run in parallel and are then stitched together
+ * by shifting the earlier CRCs past the later blocks (multiplying by
+ * x^(8 * block) mod P). That keeps a 4 KiB page well under a microsecond.
+ * Elsewhere we fall back
+ * to slicing-by-8: eight 256-entry tables let the loop consume 8 bytes per
+ * iteration with independent lookups instead of one byte at a time.
+ *
+ * Both paths compute the same value, so pages written on one machine
+ * verify on another.
+ */
+
+#define CRC32C_POLY 0x82F63B78u
+#define CRC32C_BLOCK 1344 // bytes per stream; 3 blocks cover most of a page
+
+static uint32_t crc_tables[8][256];
+static pthread_once_t crc_tables_once = PTHREAD_ONCE_INIT;
+
+static uint32_t crc_block_shift; // x^(8 * CRC32C_BLOCK) mod P
+
+/**
+ * Multiply two polynomials modulo P, in the bit-reflected representation.
+ */
+static uint32_t crc_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1u << 31;
+    uint32_t p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+static void crc_tables_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc_tables[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int t = 1; t < 8; t++)
+        {
+            uint32_t prev = crc_tables[t - 1][i];
+            crc_tables[t][i] = (prev >> 8) ^ crc_tables[0][prev & 0xFF];
+        }
+    }
+
+    uint32_t shift = 1u << 31; // x^0
+    for (int bit = 0; bit < 8 * CRC32C_BLOCK; bit++)
+    {
+        shift = shift & 1 ? (shift >> 1) ^ CRC32C_POLY : shift >> 1;
+    }
+    crc_block_shift = shift;
+}
+
+/**
+ * Portable slicing-by-8 implementation. `crc` is the value returned by a
+ * previous call, or 0 to start.
+ */
+uint32_t mdb_crc32c_sw(uint32_t crc, const void* data, size_t len)
+{
+    pthread_once(&crc_tables_once, crc_tables_init);
+
+    const uint8_t* p = data;
+    crc = ~crc;
+
+    while (len >= 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, p, sizeof(lo));
+        memcpy(&hi, p + 4, sizeof(hi));
+        lo ^= crc;
+
+        crc = crc_tables[7][lo & 0xFF] ^ crc_tables[6][(lo >> 8) & 0xFF] ^
+              crc_tables[5][(lo >> 16) & 0xFF] ^ crc_tables[4][lo >> 24] ^
+              crc_tables[3][hi & 0xFF] ^ crc_tables[2][(hi >> 8) & 0xFF] ^
+              crc_tables[1][(hi >> 16) & 0xFF] ^ crc_tables[0][hi >> 24];
+
+        p += 8;
+        len -= 8;
+    }
+
+    while (len-- > 0)
+    {
+        crc = (crc >> 8) ^ crc_tables[0][(crc ^ *p++) & 0xFF];
+    }
+
+    return ~crc;
+}
+
+#ifdef CRC32C_HAVE_SSE42
+__attribute__((target("sse4.2"))) static uint32_t crc32c_hw(uint32_t crc, const void* data,
+                                                            size_t len)
+{
+    const uint8_t* p = data;
+    uint64_t c = ~crc;
+
+    if (len >= 3 * CRC32C_BLOCK) pthread_once(&crc_tables_once, crc_tables_init);
+
+    while (len >= 3 * CRC32C_BLOCK)
+    {
+        uint64_t c1 = 0;
+        uint64_t c2 = 0;
+        for (size_t i = 0; i < CRC32C_BLOCK; i += 8)
+        {
+            uint64_t w0, w1, w2;
+            memcpy(&w0, p + i, sizeof(w0));
+            memcpy(&w1, p + CRC32C_BLOCK + i, sizeof(w1));
+            memcpy(&w2, p + 2 * CRC32C_BLOCK + i, sizeof(w2));
+            c = _mm_crc32_u64(c, w0);
+            c1 = _mm_crc32_u64(c1, w1);
+            c2 = _mm_crc32_u64(c2, w2);
+        }
+
+        c = crc_multmodp(crc_block_shift, (uint32_t)c) ^ (uint32_t)c1;
+        c = crc_multmodp(crc_block_shift, (uint32_t)c) ^ (uint32_t)c2;
+
+        p += 3 * CRC32C_BLOCK;
+        len -= 3 * CRC32C_BLOCK;
+    }
+
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+        p += 8;
+        len -= 8;
+    }
+
+    uint32_t c32 = (uint32_t)c;
+    while (len-- > 0)
+    {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+
+    return ~c32;
+}
+#endif
+
+uint32_t mdb_crc32c(uint32_t crc, const void* data, size_t len)
+{
+#ifdef CRC32C_HAVE_SSE42
+    if (__builtin_cpu_supports("sse4.2")) return crc32c_hw(crc, data, len);
+#endif
+    return mdb_crc32c_sw(crc, data, len);
+}
@@ -1,18 +1,19 @@
+#define _GNU_SOURCE 1
+
 #include "db.h"
+#include "db_internal.h"
 #include "errors.h"
+#include "io.h"
+#include "pages.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-struct MiniDB
-{
-    FILE* fp;
-};
-
 ErrorCode mdb_header_write(FILE* fp)
 {
-    char page[MDB_PAGE_SIZE] = {0};
+    MDBPage page;
+    mdb_page_zero(&page);
 
     MDBHeader header = {
         .magic = MDB_MAGIC,
@@ -20,9 +21,10 @@ ErrorCode mdb_header_write(FILE* fp)
         .endianness = MDB_ENDIAN_LITTLE,
         .version = MDB_VERSION};
 
-    memcpy(page, &header, sizeof(MDBHeader));
+    memcpy(page.data, &header, sizeof(MDBHeader));
+    mdb_page_checksum_set(&page);
 
-    if (fwrite(page, 1, MDB_PAGE_SIZE, fp) != MDB_PAGE_SIZE)
+    if (fwrite(page.data, 1, MDB_PAGE_SIZE, fp) != MDB_PAGE_SIZE)
     {
         return ERR_IO;
     }
@@ -34,17 +36,33 @@ ErrorCode mdb_header_check(FILE* fp)
 {
     if (!fp) return ERR_INVALID;
 
-    MDBHeader header;
-    if (fread(&header, sizeof(MDBHeader), 1, fp) != 1)
+    MDBPage page;
+    size_t n = fread(page.data, 1, MDB_PAGE_SIZE, fp);
+    if (n < sizeof(MDBHeader))
     {
         return ERR_IO;
     }
 
+    MDBHeader header;
+    memcpy(&header, page.data, sizeof(MDBHeader));
     if (memcmp(header.magic, MDB_MAGIC, sizeof(MDB_MAGIC)) != 0 || header.version != MDB_VERSION)
     {
         return ERR_INVALID;
     }
 
+    // Page offsets and every page layout depend on the page size, so a file
+    // created with a different one can't be read by this build.
+    if (header.page_size != MDB_PAGE_SIZE || header.endianness != MDB_ENDIAN_LITTLE)
+    {
+        return ERR_UNSUPPORTED_FORMAT;
+    }
+
+    // Only now is it safe to read the page as one of ours.
+    if (n < MDB_PAGE_SIZE || !mdb_page_checksum_ok(&page))
+    {
+        return ERR_CORRUPT;
+    }
+
     return OK;
 }
 
@@ -71,7 +89,9 @@ ErrorCode mdb_open(const char* filename, MiniDB** out_db)
             return ERR_IO;
         }
 
-        if (mdb_header_write(fp) != OK)
+        // Pages are accessed with positional I/O from here on, so the
+        // header must not linger in the stdio buffer.
+        if (mdb_header_write(fp) != OK || fflush(fp) != 0)
         {
             fclose(fp);
             return ERR_IO;
@@ -79,21 +99,51 @@ ErrorCode mdb_open(const char* filename, MiniDB** out_db)
     }
     else
     {
-        if (mdb_header_check(fp) != OK)
+        ErrorCode err = mdb_header_check(fp);
+        if (err != OK)
         {
             fclose(fp);
-            return ERR_INVALID;
+            return err == ERR_UNSUPPORTED_FORMAT || err == ERR_CORRUPT ? err : ERR_INVALID;
         }
     }
 
-    MiniDB* db = (MiniDB*)malloc(sizeof(MiniDB));
+    MiniDB* db = (MiniDB*)calloc(1, sizeof(MiniDB));
     if (!db)
     {
         fclose(fp);
         return ERR_UNKNOWN;
     }
 
+    db->filename = strdup(filename);
+    if (!db->filename)
+    {
+        fclose(fp);
+        free(db);
+        return ERR_UNKNOWN;
+    }
+
     db->fp = fp;
+    if (mdb_io_init(db) != OK)
+    {
+        fclose(fp);
+        free(db->filename);
+        free(db);
+        return ERR_IO;
+    }
+    if (mdb_latch_table_create(&db->latches) != OK)
+    {
+        fclose(fp);
+        free(db->filename);
+        free(db);
+        return ERR_UNKNOWN;
+    }
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&db->header_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&db->alloc_lock, NULL);
     *out_db = db;
 
     return OK;
@@ -103,8 +153,25 @@ ErrorCode mdb_close(MiniDB* db)
 {
     if (!db) return ERR_INVALID;
 
+    // An explicit transaction still open at close is rolled back.
+    if (db->wal)
+    {
+        if (db->in_txn) mdb_rollback(db);
+        mdb_wal_close(db->wal);
+    }
+
+    mdb_result_cache_destroy(db->result_cache);
+    mdb_latch_table_destroy(db->latches);
+    pthread_mutex_destroy(&db->alloc_lock);
+    pthread_mutex_destroy(&db->header_lock);
     fclose(db->fp);
+    free(db->filename);
     free(db);
 
     return OK;
 }
+
+const char* mdb_filename(const MiniDB* db)
+{
+    return db ? db->filename : NULL;
+}
@@ -0,0 +1,50 @@
+#ifndef DB_INTERNAL_H
+#define DB_INTERNAL_H
+
+#include "backup.h"
+#include "db.h"
+#include "latch.h"
+#include "qcache.h"
+#include "wal.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+struct MiniDB
+{
+    FILE* fp;
+    char* filename;
+
+    MDBWal* wal;      // opened on first use
+    bool in_txn;      // inside an explicit BEGIN ... COMMIT/ROLLBACK
+    size_t txn_start; // WAL buffer position at BEGIN
+
+    _Atomic uint32_t page_count; // pages in the file, kept current by io.c
+    uint32_t block_size;         // file system block size, set at open
+    pthread_mutex_t alloc_lock;  // serializes growing the file
+
+    // Guards the in-memory header and the LSN clock below. Recursive,
+    // since free-list updates write pages and every write draws an LSN.
+    pthread_mutex_t header_lock;
+
+    MDBHeader header;   // page 0, loaded on first use by the free list
+    bool header_loaded;
+
+    uint64_t next_lsn;        // valid once the header is loaded
+    bool lsn_loaded;
+
+    MDBResultCache* result_cache; // NULL unless enabled
+
+    MDBLatchTable* latches; // page latches, shared by everything that edits pages in place
+
+    MDBBackupTracker* backup; // set while mdb_backup runs
+};
+
+// Both require header_lock.
+ErrorCode mdb_header_load(MiniDB* db);
+
+ErrorCode mdb_header_store(MiniDB* db);
+
+#endif
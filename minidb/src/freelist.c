@@ -0,0 +1,383 @@
+#include "freelist.h"
+#include "db_internal.h"
+#include "io.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Free-page list.
+ *
+ * Freed pages are kept in a persistent list rooted in the file header
+ * (page 0). The list is a chain of trunk pages, each holding up to
+ * MDB_FREE_TRUNK_CAPACITY numbers of free leaf pages:
+ *
+ *   header.free_trunk -> [trunk: next, count, leaves...] -> [trunk] -> 0
+ *
+ * Freeing a page appends it to the first trunk, or turns the page itself
+ * into a new first trunk when that one is full. Allocation takes the last
+ * leaf of the first trunk, and the trunk page itself once it is empty, so
+ * both operations touch at most one trunk page plus the header. Leaf pages
+ * are never written while they sit on the list.
+ *
+ * mdb_page_shrink gives space back to the file system: free pages at the
+ * end of the file are dropped, live pages at the end are moved into the
+ * lowest free pages (the caller repoints references through a callback),
+ * and the file is truncated. Moves may land on trunk pages, so the list is
+ * first detached from the header and synced, and only rebuilt from the
+ * pages that stay free once the moves are done. A crash in between leaks
+ * the free pages rather than leaving the header pointing at live data.
+ *
+ * Every entry point holds header_lock for its whole update, so free-list
+ * changes and page LSN reservations never interleave their header writes.
+ * Shrinking also holds alloc_lock so no page is appended while the tail
+ * is being cut off.
+ *
+ * Pages handed to the free list must no longer be cached in a buffer pool.
+ */
+
+ErrorCode mdb_header_load(MiniDB* db)
+{
+    if (db->header_loaded) return OK;
+
+    MDBPage page;
+    ErrorCode err = mdb_page_read(db, 0, &page);
+    if (err != OK) return err;
+
+    memcpy(&db->header, page.data, sizeof(MDBHeader));
+    db->header_loaded = true;
+    return OK;
+}
+
+ErrorCode mdb_header_store(MiniDB* db)
+{
+    MDBPage page;
+    mdb_page_zero(&page);
+    memcpy(page.data, &db->header, sizeof(MDBHeader));
+    mdb_page_checksum_set(&page);
+    return mdb_io_write(db, 0, &page);
+}
+
+static ErrorCode trunk_read(MiniDB* db, MDBPageNumber page_num, MDBPage* page,
+                            MDBFreeTrunkHeader* out_header)
+{
+    ErrorCode err = mdb_page_read(db, page_num, page);
+    if (err != OK) return err;
+    if (!mdb_page_is_type(page, PG_FREE)) return ERR_CORRUPT;
+
+    memcpy(out_header, page->data, sizeof(MDBFreeTrunkHeader));
+    if (out_header->count > MDB_FREE_TRUNK_CAPACITY) return ERR_CORRUPT;
+    return OK;
+}
+
+static MDBPageNumber trunk_leaf(const MDBPage* page, uint32_t idx)
+{
+    MDBPageNumber leaf;
+    memcpy(&leaf, page->data + sizeof(MDBFreeTrunkHeader) + idx * sizeof(MDBPageNumber),
+           sizeof(MDBPageNumber));
+    return leaf;
+}
+
+static void trunk_set_leaf(MDBPage* page, uint32_t idx, MDBPageNumber leaf)
+{
+    memcpy(page->data + sizeof(MDBFreeTrunkHeader) + idx * sizeof(MDBPageNumber), &leaf,
+           sizeof(MDBPageNumber));
+}
+
+static void trunk_init(MDBPage* page, MDBPageNumber next)
+{
+    mdb_page_init(page, PG_FREE);
+
+    MDBFreeTrunkHeader h = {.type = PG_FREE, .next = next, .count = 0};
+    memcpy(page->data, &h, sizeof(h));
+}
+
+static ErrorCode freelist_push(MiniDB* db, MDBPageNumber page_num)
+{
+    ErrorCode err = mdb_header_load(db);
+    if (err != OK) return err;
+
+    MDBPage trunk;
+    MDBFreeTrunkHeader h;
+    MDBPageNumber first = db->header.free_trunk;
+
+    if (first != 0)
+    {
+        err = trunk_read(db, first, &trunk, &h);
+        if (err != OK) return err;
+    }
+
+    if (first != 0 && h.count < MDB_FREE_TRUNK_CAPACITY)
+    {
+        trunk_set_leaf(&trunk, h.count++, page_num);
+        memcpy(trunk.data, &h, sizeof(h));
+        err = mdb_page_write(db, first, &trunk);
+    }
+    else
+    {
+        // No room: the freed page becomes the new first trunk.
+        trunk_init(&trunk, first);
+        err = mdb_page_write(db, page_num, &trunk);
+        db->header.free_trunk = page_num;
+    }
+    if (err != OK) return err;
+
+    db->header.free_count++;
+    return mdb_header_store(db);
+}
+
+ErrorCode mdb_page_free(MiniDB* db, MDBPageNumber page_num)
+{
+    if (!db || page_num == 0 || page_num >= mdb_page_count(db)) return ERR_INVALID;
+
+    pthread_mutex_lock(&db->header_lock);
+    ErrorCode err = freelist_push(db, page_num);
+    pthread_mutex_unlock(&db->header_lock);
+    return err;
+}
+
+static ErrorCode freelist_take(MiniDB* db, bool* out_found,
+                               MDBPageNumber* out_page_num)
+{
+    ErrorCode err = mdb_header_load(db);
+    if (err != OK) return err;
+
+    *out_found = false;
+    MDBPageNumber first = db->header.free_trunk;
+    if (first == 0) return OK;
+
+    MDBPage trunk;
+    MDBFreeTrunkHeader h;
+    err = trunk_read(db, first, &trunk, &h);
+    if (err != OK) return err;
+
+    MDBPageNumber page_num;
+    if (h.count > 0)
+    {
+        page_num = trunk_leaf(&trunk, --h.count);
+        memcpy(trunk.data, &h, sizeof(h));
+        err = mdb_page_write(db, first, &trunk);
+        if (err != OK) return err;
+    }
+    else
+    {
+        page_num = first;
+        db->header.free_trunk = h.next;
+    }
+
+    db->header.free_count--;
+    err = mdb_header_store(db);
+    if (err != OK) return err;
+
+    *out_found = true;
+    *out_page_num = page_num;
+    return OK;
+}
+
+/**
+ * Take a page off the free list. *out_found is false if the list is empty.
+ */
+ErrorCode mdb_freelist_pop(MiniDB* db, bool* out_found,
+                           MDBPageNumber* out_page_num)
+{
+    if (!db || !out_found || !out_page_num) return ERR_INVALID;
+
+    pthread_mutex_lock(&db->header_lock);
+    ErrorCode err = freelist_take(db, out_found, out_page_num);
+    pthread_mutex_unlock(&db->header_lock);
+    return err;
+}
+
+uint32_t mdb_freelist_count(MiniDB* db)
+{
+    if (!db) return 0;
+
+    pthread_mutex_lock(&db->header_lock);
+    uint32_t count = mdb_header_load(db) == OK ? db->header.free_count : 0;
+    pthread_mutex_unlock(&db->header_lock);
+    return count;
+}
+
+/**
+ * Collect every page on the free list (trunks and leaves), sorted.
+ */
+static ErrorCode freelist_collect(MiniDB* db, MDBPageNumber** out_pages,
+                                  uint32_t* out_count)
+{
+    uint32_t cap = db->header.free_count;
+    MDBPageNumber* pages = malloc(sizeof(MDBPageNumber) * (cap ? cap : 1));
+    if (!pages) return ERR_UNKNOWN;
+
+    uint32_t n = 0;
+    MDBPageNumber t = db->header.free_trunk;
+    while (t != 0)
+    {
+        MDBPage trunk;
+        MDBFreeTrunkHeader h;
+        ErrorCode err = trunk_read(db, t, &trunk, &h);
+        if (err == OK && n + 1 + h.count > cap) err = ERR_CORRUPT;
+        if (err != OK)
+        {
+            free(pages);
+            return err;
+        }
+
+        pages[n++] = t;
+        for (uint32_t i = 0; i < h.count; i++)
+        {
+            pages[n++] = trunk_leaf(&trunk, i);
+        }
+        t = h.next;
+    }
+
+    for (uint32_t i = 1; i < n; i++)
+    {
+        MDBPageNumber p = pages[i];
+        uint32_t j = i;
+        while (j > 0 && pages[j - 1] > p)
+        {
+            pages[j] = pages[j - 1];
+            j--;
+        }
+        pages[j] = p;
+    }
+
+    *out_pages = pages;
+    *out_count = n;
+    return OK;
+}
+
+/**
+ * Write a fresh free list holding exactly `pages`.
+ */
+static ErrorCode freelist_rebuild(MiniDB* db, const MDBPageNumber* pages,
+                                  uint32_t n)
+{
+    MDBPageNumber next = 0;
+    uint32_t end = n;
+
+    // Build back to front so each trunk can point at the one after it.
+    while (end > 0)
+    {
+        uint32_t group = end < MDB_FREE_TRUNK_CAPACITY + 1 ? end : MDB_FREE_TRUNK_CAPACITY + 1;
+        uint32_t start = end - group;
+
+        MDBPage trunk;
+        trunk_init(&trunk, next);
+
+        MDBFreeTrunkHeader h = {.type = PG_FREE, .next = next, .count = group - 1};
+        memcpy(trunk.data, &h, sizeof(h));
+        for (uint32_t i = 0; i + 1 < group; i++)
+        {
+            trunk_set_leaf(&trunk, i, pages[start + 1 + i]);
+        }
+
+        ErrorCode err = mdb_page_write(db, pages[start], &trunk);
+        if (err != OK) return err;
+
+        next = pages[start];
+        end = start;
+    }
+
+    db->header.free_trunk = next;
+    db->header.free_count = n;
+    return mdb_header_store(db);
+}
+
+static ErrorCode shrink(MiniDB* db, uint32_t max_moves,
+                        MDBPageRelocateFn relocate, void* ctx,
+                        uint32_t* out_released)
+{
+    ErrorCode err = mdb_header_load(db);
+    if (err != OK) return err;
+
+    MDBPageNumber* free_pages = NULL;
+    uint32_t nfree = 0;
+    err = freelist_collect(db, &free_pages, &nfree);
+    if (err != OK) return err;
+
+    uint32_t old_end = mdb_page_count(db);
+    uint32_t end = old_end;
+    uint32_t lo = 0;
+    uint32_t hi = nfree; // free_pages[lo, hi) are free and below `end`
+    uint32_t moves = 0;
+
+    bool tail_free = nfree > 0 && free_pages[nfree - 1] == old_end - 1;
+    if (!tail_free && (!relocate || max_moves == 0 || nfree == 0))
+    {
+        free(free_pages);
+        if (out_released) *out_released = 0;
+        return OK;
+    }
+
+    MDBPageNumber trunk = db->header.free_trunk;
+    db->header.free_trunk = 0;
+    db->header.free_count = 0;
+    err = mdb_header_store(db);
+    if (err == OK) err = mdb_io_sync(db);
+    if (err != OK)
+    {
+        db->header.free_trunk = trunk;
+        db->header.free_count = nfree;
+        free(free_pages);
+        return err;
+    }
+
+    while (lo < hi)
+    {
+        if (free_pages[hi - 1] == end - 1)
+        {
+            hi--;
+            end--;
+            continue;
+        }
+
+        // The last page is live; move it into the lowest free page.
+        if (!relocate || moves >= max_moves) break;
+
+        MDBPageNumber from = end - 1;
+        MDBPageNumber to = free_pages[lo];
+
+        MDBPage page;
+        err = mdb_page_read(db, from, &page);
+        if (err == OK) err = mdb_page_write(db, to, &page);
+        if (err == OK) err = relocate(ctx, from, to);
+        if (err != OK) break;
+
+        lo++;
+        end--;
+        moves++;
+    }
+
+    // Even after a failed move, everything from `end` on is unreferenced
+    // and free_pages[lo, hi) is still free, so the shrink can finish there.
+    ErrorCode done = freelist_rebuild(db, free_pages + lo, hi - lo);
+    if (done == OK) done = mdb_io_sync(db);
+    if (done == OK && end < old_end) done = mdb_io_truncate(db, end);
+    if (err == OK) err = done;
+
+    free(free_pages);
+    if (err != OK) return err;
+
+    if (out_released) *out_released = old_end - end;
+    return OK;
+}
+
+/**
+ * Shrink the file. Free pages at the tail are dropped outright; live tail
+ * pages are moved into the lowest free pages, at most `max_moves` of them
+ * per call so the work can be spread out. Pass a NULL `relocate` to only
+ * drop free tail pages.
+ */
+ErrorCode mdb_page_shrink(MiniDB* db, uint32_t max_moves,
+                          MDBPageRelocateFn relocate, void* ctx,
+                          uint32_t* out_released)
+{
+    if (!db) return ERR_INVALID;
+
+    pthread_mutex_lock(&db->alloc_lock);
+    pthread_mutex_lock(&db->header_lock);
+    ErrorCode err = shrink(db, max_moves, relocate, ctx, out_released);
+    pthread_mutex_unlock(&db->header_lock);
+    pthread_mutex_unlock(&db->alloc_lock);
+    return err;
+}
@@ -0,0 +1,432 @@
+#include "hash.h"
+#include <string.h>
+
+/*
+ * Extendible hashing buckets.
+ *
+ * The directory maps the low `global_depth` bits of a key hash to a bucket
+ * page. A bucket with `local_depth` < global_depth is shared by several
+ * directory slots; when it fills up it is split on bit `local_depth`, and
+ * only when local_depth reaches global_depth does the directory double.
+ * An equality lookup therefore reads exactly one bucket page.
+ *
+ * Buckets store the full 64-bit hash next to each record, so a probe can
+ * skip non-matching entries without touching the heap. Callers still
+ * re-check the key on the heap row to rule out hash collisions.
+ *
+ * The directory is a single PG_HASH_DIR page, so global_depth stops at
+ * the largest power of two that fits in it. Splitting can't help a bucket
+ * whose entries all share one hash (duplicates of a key), nor one whose
+ * slot can't be doubled any more; such a bucket gets a chain of overflow
+ * bucket pages instead, linked through `overflow`. A bucket with a chain
+ * is not split again. Pages emptied by deletes stay in place.
+ */
+
+static MDBHashBucketHeader* bucket_header(MDBPage* page)
+{
+    return (MDBHashBucketHeader*)page->data;
+}
+
+static const MDBHashBucketHeader* bucket_header_const(const MDBPage* page)
+{
+    return (const MDBHashBucketHeader*)page->data;
+}
+
+static MDBHashEntry* bucket_entries(MDBPage* page)
+{
+    return (MDBHashEntry*)(page->data + sizeof(MDBHashBucketHeader));
+}
+
+static const MDBHashEntry* bucket_entries_const(const MDBPage* page)
+{
+    return (const MDBHashEntry*)(page->data + sizeof(MDBHashBucketHeader));
+}
+
+/**
+ * 64-bit FNV-1a over the key bytes, followed by a murmur-style finalizer so
+ * the low bits used for directory addressing are well mixed even for
+ * sequential integer keys.
+ */
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t len)
+{
+    const uint8_t* p = data;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint64_t mdb_hash_key(MDBValue key)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    if (key.is_null)
+    {
+        h = hash_bytes(h, "\0", 1);
+    }
+    else if (key.type == COL_TYPE_INT)
+    {
+        h = hash_bytes(h, &key.integer, sizeof(key.integer));
+    }
+    else if (key.type == COL_TYPE_TEXT)
+    {
+        h = hash_bytes(h, key.text.ptr, key.text.length);
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+void mdb_hash_bucket_init(MDBPage* page, uint8_t local_depth)
+{
+    mdb_page_init(page, PG_HASH_BUCKET);
+
+    MDBHashBucketHeader* h = bucket_header(page);
+    h->local_depth = local_depth;
+    h->n_entries = 0;
+    h->overflow = 0;
+}
+
+uint16_t mdb_hash_bucket_count(const MDBPage* page)
+{
+    return bucket_header_const(page)->n_entries;
+}
+
+uint8_t mdb_hash_bucket_local_depth(const MDBPage* page)
+{
+    return bucket_header_const(page)->local_depth;
+}
+
+ErrorCode mdb_hash_bucket_insert(MDBPage* page, uint64_t hash,
+                                 MDBRecord record)
+{
+    if (!page) return ERR_INVALID;
+
+    MDBHashBucketHeader* h = bucket_header(page);
+    if (h->n_entries >= MDB_HASH_BUCKET_CAPACITY) return ERR_FULL;
+
+    MDBHashEntry* e = &bucket_entries(page)[h->n_entries++];
+    e->hash = hash;
+    e->record = record;
+    return OK;
+}
+
+ErrorCode mdb_hash_bucket_delete(MDBPage* page, uint64_t hash,
+                                 MDBRecord record)
+{
+    if (!page) return ERR_INVALID;
+
+    MDBHashBucketHeader* h = bucket_header(page);
+    MDBHashEntry* entries = bucket_entries(page);
+
+    for (uint16_t i = 0; i < h->n_entries; i++)
+    {
+        if (entries[i].hash == hash &&
+            entries[i].record.page_num == record.page_num &&
+            entries[i].record.slot == record.slot)
+        {
+            // Order inside a bucket doesn't matter; fill the hole with the last entry.
+            entries[i] = entries[--h->n_entries];
+            return OK;
+        }
+    }
+
+    return ERR_INVALID;
+}
+
+ErrorCode mdb_hash_bucket_lookup(const MDBPage* page, uint64_t hash,
+                                 MDBRecord* out_records, uint32_t cap,
+                                 uint32_t* out_count)
+{
+    if (!page || !out_count) return ERR_INVALID;
+
+    const MDBHashBucketHeader* h = bucket_header_const(page);
+    const MDBHashEntry* entries = bucket_entries_const(page);
+
+    uint32_t count = 0;
+    for (uint16_t i = 0; i < h->n_entries; i++)
+    {
+        if (entries[i].hash != hash) continue;
+
+        if (count < cap && out_records)
+        {
+            out_records[count] = entries[i].record;
+        }
+        count++;
+    }
+
+    // Report the full number of matches so callers can retry with more room.
+    *out_count = count;
+    return count > cap ? ERR_FULL : OK;
+}
+
+/**
+ * Split a full bucket on hash bit `local_depth`.
+ *
+ * Entries with that bit set move into `out_image`; both pages end up with
+ * local_depth + 1. The caller then points the directory slots that have
+ * the bit set at the image page (doubling the directory first if the old
+ * local depth equalled the global depth).
+ */
+ErrorCode mdb_hash_bucket_split(MDBPage* page, MDBPage* out_image)
+{
+    if (!page || !out_image) return ERR_INVALID;
+
+    MDBHashBucketHeader* h = bucket_header(page);
+    if (h->local_depth >= 63) return ERR_FULL;
+
+    uint8_t depth = h->local_depth;
+    mdb_hash_bucket_init(out_image, depth + 1);
+
+    MDBHashEntry* entries = bucket_entries(page);
+    MDBHashEntry* image_entries = bucket_entries(out_image);
+    MDBHashBucketHeader* ih = bucket_header(out_image);
+
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < h->n_entries; i++)
+    {
+        if (entries[i].hash & (1ull << depth))
+        {
+            image_entries[ih->n_entries++] = entries[i];
+        }
+        else
+        {
+            entries[kept++] = entries[i];
+        }
+    }
+
+    h->n_entries = kept;
+    h->local_depth = depth + 1;
+    return OK;
+}
+
+static MDBHashDirHeader* dir_header(MDBPage* page)
+{
+    return (MDBHashDirHeader*)page->data;
+}
+
+static MDBPageNumber* dir_slots(MDBPage* page)
+{
+    return (MDBPageNumber*)(page->data + sizeof(MDBHashDirHeader));
+}
+
+static uint8_t dir_max_depth(void)
+{
+    uint8_t depth = 0;
+    while ((2ull << depth) <= MDB_HASH_DIR_CAPACITY)
+    {
+        depth++;
+    }
+    return depth;
+}
+
+static ErrorCode dir_read(MiniDB* db, MDBPageNumber dir_num, MDBPage* dir)
+{
+    ErrorCode err = mdb_page_read(db, dir_num, dir);
+    if (err != OK) return err;
+    if (!mdb_page_is_type(dir, PG_HASH_DIR) || dir_header(dir)->global_depth > dir_max_depth())
+    {
+        return ERR_CORRUPT;
+    }
+    return OK;
+}
+
+static ErrorCode bucket_read(MiniDB* db, MDBPageNumber page_num, MDBPage* page)
+{
+    ErrorCode err = mdb_page_read(db, page_num, page);
+    if (err != OK) return err;
+    return mdb_page_is_type(page, PG_HASH_BUCKET) ? OK : ERR_CORRUPT;
+}
+
+/**
+ * Create an empty index: a directory of depth 0 pointing at one bucket.
+ */
+ErrorCode mdb_hash_create(MiniDB* db, MDBPageNumber* out_dir)
+{
+    if (!db || !out_dir) return ERR_INVALID;
+
+    MDBPage bucket, dir;
+    MDBPageNumber bucket_num;
+    mdb_hash_bucket_init(&bucket, 0);
+    ErrorCode err = mdb_page_allocate(db, &bucket, &bucket_num);
+    if (err != OK) return err;
+
+    mdb_page_init(&dir, PG_HASH_DIR);
+    dir_slots(&dir)[0] = bucket_num;
+    return mdb_page_allocate(db, &dir, out_dir);
+}
+
+// Splitting only separates entries whose hashes differ.
+static bool bucket_all_same(const MDBPage* page, uint64_t hash)
+{
+    const MDBHashBucketHeader* h = bucket_header_const(page);
+    const MDBHashEntry* entries = bucket_entries_const(page);
+    for (uint16_t i = 0; i < h->n_entries; i++)
+    {
+        if (entries[i].hash != hash) return false;
+    }
+    return true;
+}
+
+/**
+ * Split the bucket that directory slot `slot` points at, doubling the
+ * directory first if the bucket is its only slot. The new image page and
+ * the directory are written before the shrunk bucket, so a crash in
+ * between leaves the moved entries reachable.
+ */
+static ErrorCode hash_split(MiniDB* db, MDBPageNumber dir_num, MDBPage* dir,
+                            uint32_t slot, MDBPageNumber bucket_num, MDBPage* bucket)
+{
+    MDBHashDirHeader* dh = dir_header(dir);
+    MDBPageNumber* slots = dir_slots(dir);
+    uint8_t depth = mdb_hash_bucket_local_depth(bucket);
+
+    if (depth == dh->global_depth)
+    {
+        uint32_t n = 1u << dh->global_depth;
+        memcpy(slots + n, slots, n * sizeof(MDBPageNumber));
+        dh->global_depth++;
+    }
+
+    MDBPage image;
+    MDBPageNumber image_num;
+    ErrorCode err = mdb_hash_bucket_split(bucket, &image);
+    if (err == OK) err = mdb_page_allocate(db, &image, &image_num);
+    if (err != OK) return err;
+
+    // The slots that shared the bucket and have bit `depth` set move over.
+    uint32_t low = slot & ((1u << depth) - 1);
+    for (uint32_t s = 0; s < (1u << dh->global_depth); s++)
+    {
+        if ((s & ((1u << depth) - 1)) == low && (s & (1u << depth))) slots[s] = image_num;
+    }
+
+    err = mdb_page_write(db, dir_num, dir);
+    if (err != OK) return err;
+    return mdb_page_write(db, bucket_num, bucket);
+}
+
+/**
+ * Add the entry to the first overflow page with room, or to a new one
+ * linked in right after the bucket.
+ */
+static ErrorCode chain_insert(MiniDB* db, MDBPageNumber bucket_num, MDBPage* bucket,
+                              uint64_t hash, MDBRecord record)
+{
+    MDBPage page;
+    MDBPageNumber page_num = bucket_header(bucket)->overflow;
+    while (page_num != 0)
+    {
+        ErrorCode err = bucket_read(db, page_num, &page);
+        if (err != OK) return err;
+        if (mdb_hash_bucket_insert(&page, hash, record) == OK) return mdb_page_write(db, page_num, &page);
+        page_num = bucket_header(&page)->overflow;
+    }
+
+    mdb_hash_bucket_init(&page, mdb_hash_bucket_local_depth(bucket));
+    bucket_header(&page)->overflow = bucket_header(bucket)->overflow;
+    mdb_hash_bucket_insert(&page, hash, record);
+
+    ErrorCode err = mdb_page_allocate(db, &page, &page_num);
+    if (err != OK) return err;
+
+    bucket_header(bucket)->overflow = page_num;
+    return mdb_page_write(db, bucket_num, bucket);
+}
+
+ErrorCode mdb_hash_insert(MiniDB* db, MDBPageNumber dir_num, uint64_t hash,
+                          MDBRecord record)
+{
+    if (!db) return ERR_INVALID;
+
+    MDBPage dir, bucket;
+    ErrorCode err = dir_read(db, dir_num, &dir);
+    if (err != OK) return err;
+
+    for (;;)
+    {
+        uint8_t global_depth = dir_header(&dir)->global_depth;
+        uint32_t slot = mdb_hash_dir_slot(hash, global_depth);
+        MDBPageNumber bucket_num = dir_slots(&dir)[slot];
+        err = bucket_read(db, bucket_num, &bucket);
+        if (err != OK) return err;
+
+        if (mdb_hash_bucket_insert(&bucket, hash, record) == OK)
+        {
+            return mdb_page_write(db, bucket_num, &bucket);
+        }
+
+        bool can_split = mdb_hash_bucket_local_depth(&bucket) < global_depth ||
+                         global_depth < dir_max_depth();
+        if (!can_split || bucket_header(&bucket)->overflow != 0 || bucket_all_same(&bucket, hash))
+        {
+            return chain_insert(db, bucket_num, &bucket, hash, record);
+        }
+
+        err = hash_split(db, dir_num, &dir, slot, bucket_num, &bucket);
+        if (err != OK) return err;
+    }
+}
+
+ErrorCode mdb_hash_delete(MiniDB* db, MDBPageNumber dir_num, uint64_t hash,
+                          MDBRecord record)
+{
+    if (!db) return ERR_INVALID;
+
+    MDBPage dir, page;
+    ErrorCode err = dir_read(db, dir_num, &dir);
+    if (err != OK) return err;
+
+    MDBPageNumber page_num = dir_slots(&dir)[mdb_hash_dir_slot(hash, dir_header(&dir)->global_depth)];
+    while (page_num != 0)
+    {
+        err = bucket_read(db, page_num, &page);
+        if (err != OK) return err;
+        if (mdb_hash_bucket_delete(&page, hash, record) == OK) return mdb_page_write(db, page_num, &page);
+        page_num = bucket_header(&page)->overflow;
+    }
+
+    return ERR_INVALID;
+}
+
+/**
+ * Collect the records stored under `hash` from its bucket and the
+ * bucket's overflow chain. Like mdb_hash_bucket_lookup, reports the full
+ * count and returns ERR_FULL when it exceeds `cap`.
+ */
+ErrorCode mdb_hash_lookup(MiniDB* db, MDBPageNumber dir_num, uint64_t hash,
+                          MDBRecord* out_records, uint32_t cap,
+                          uint32_t* out_count)
+{
+    if (!db || !out_count) return ERR_INVALID;
+
+    MDBPage dir, page;
+    ErrorCode err = dir_read(db, dir_num, &dir);
+    if (err != OK) return err;
+
+    uint32_t total = 0;
+    MDBPageNumber page_num = dir_slots(&dir)[mdb_hash_dir_slot(hash, dir_header(&dir)->global_depth)];
+    while (page_num != 0)
+    {
+        err = bucket_read(db, page_num, &page);
+        if (err != OK) return err;
+
+        uint32_t room = total < cap ? cap - total : 0;
+        uint32_t count;
+        err = mdb_hash_bucket_lookup(&page, hash, room && out_records ? out_records + total : NULL,
+                                     room, &count);
+        if (err != OK && err != ERR_FULL) return err;
+
+        total += count;
+        page_num = bucket_header(&page)->overflow;
+    }
+
+    *out_count = total;
+    return total > cap ? ERR_FULL : OK;
+}
@@ -0,0 +1,148 @@
+#include "heap.h"
+#include <string.h>
+
+/*
+ * Slotted heap page:
+ *
+ *   [header][slot array ->]   free   [<- records]
+ *
+ * Slot ids are stable for the lifetime of a record, so an MDBRecord
+ * (page, slot) keeps pointing at the same row while other rows come and
+ * go. Deleted slots are marked with MDB_SLOT_DELETED and reused by later
+ * inserts.
+ */
+
+static MDBHeapHeader* heap_header(MDBPage* page)
+{
+    return (MDBHeapHeader*)page->data;
+}
+
+static const MDBHeapHeader* heap_header_const(const MDBPage* page)
+{
+    return (const MDBHeapHeader*)page->data;
+}
+
+static MDBSlot* heap_slots(MDBPage* page)
+{
+    return (MDBSlot*)(page->data + sizeof(MDBHeapHeader));
+}
+
+static const MDBSlot* heap_slots_const(const MDBPage* page)
+{
+    return (const MDBSlot*)(page->data + sizeof(MDBHeapHeader));
+}
+
+void mdb_heap_page_init(MDBPage* page, uint32_t table_id)
+{
+    mdb_page_init(page, PG_HEAP);
+
+    MDBHeapHeader* h = heap_header(page);
+    h->table_id = table_id;
+    h->n_slots = 0;
+    h->free_start = sizeof(MDBHeapHeader);
+    h->free_end = MDB_PAGE_USABLE_SIZE;
+}
+
+uint16_t mdb_heap_page_free_space(const MDBPage* page)
+{
+    const MDBHeapHeader* h = heap_header_const(page);
+    return h->free_end - h->free_start;
+}
+
+/**
+ * Find a deleted slot to reuse, or n_slots if a new one is needed.
+ */
+static MDBSlotID heap_free_slot(const MDBPage* page)
+{
+    const MDBHeapHeader* h = heap_header_const(page);
+    const MDBSlot* slots = heap_slots_const(page);
+
+    for (MDBSlotID i = 0; i < h->n_slots; i++)
+    {
+        if (slots[i].offset == MDB_SLOT_DELETED) return i;
+    }
+    return h->n_slots;
+}
+
+bool mdb_heap_page_has_space(const MDBPage* page, uint16_t size)
+{
+    uint32_t needed = size;
+    if (heap_free_slot(page) == heap_header_const(page)->n_slots)
+    {
+        needed += sizeof(MDBSlot);
+    }
+    return mdb_heap_page_free_space(page) >= needed;
+}
+
+ErrorCode mdb_heap_page_insert(MDBPage* page, const uint8_t* record,
+                               uint16_t size, MDBSlotID* out_slot)
+{
+    if (!page || (!record && size > 0) || !out_slot) return ERR_INVALID;
+    if (!mdb_heap_page_has_space(page, size)) return ERR_FULL;
+
+    MDBHeapHeader* h = heap_header(page);
+    MDBSlotID slot = heap_free_slot(page);
+    if (slot == h->n_slots)
+    {
+        h->n_slots++;
+        h->free_start += sizeof(MDBSlot);
+    }
+
+    h->free_end -= size;
+    memcpy(page->data + h->free_end, record, size);
+
+    MDBSlot* slots = heap_slots(page);
+    slots[slot].offset = h->free_end;
+    slots[slot].size = size;
+
+    *out_slot = slot;
+    return OK;
+}
+
+ErrorCode mdb_heap_page_delete(MDBPage* page, MDBSlotID slot)
+{
+    if (!page) return ERR_INVALID;
+
+    MDBHeapHeader* h = heap_header(page);
+    MDBSlot* slots = heap_slots(page);
+    if (slot >= h->n_slots || slots[slot].offset == MDB_SLOT_DELETED) return ERR_INVALID;
+
+    slots[slot].offset = MDB_SLOT_DELETED;
+    slots[slot].size = 0;
+    return OK;
+}
+
+ErrorCode mdb_heap_page_get(const MDBPage* page, MDBSlotID slot,
+                            const uint8_t** out_record, uint16_t* out_size)
+{
+    if (!page || !out_record || !out_size) return ERR_INVALID;
+
+    const MDBHeapHeader* h = heap_header_const(page);
+    const MDBSlot* slots = heap_slots_const(page);
+    if (slot >= h->n_slots || slots[slot].offset == MDB_SLOT_DELETED) return ERR_INVALID;
+
+    *out_record = page->data + slots[slot].offset;
+    *out_size = slots[slot].size;
+    return OK;
+}
+
+bool mdb_heap_page_iter_next(const MDBPage* page, MDBHeapIter* it,
+                             MDBSlotID* out_slot, const uint8_t** out_record,
+                             uint16_t* out_size)
+{
+    const MDBHeapHeader* h = heap_header_const(page);
+    const MDBSlot* slots = heap_slots_const(page);
+
+    while (it->next_slot < h->n_slots)
+    {
+        MDBSlotID slot = it->next_slot++;
+        if (slots[slot].offset == MDB_SLOT_DELETED) continue;
+
+        if (out_slot) *out_slot = slot;
+        if (out_record) *out_record = page->data + slots[slot].offset;
+        if (out_size) *out_size = slots[slot].size;
+        return true;
+    }
+
+    return false;
+}
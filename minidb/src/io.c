@@ -0,0 +1,289 @@
+#define _GNU_SOURCE 1
+
+#include "io.h"
+#include "backup.h"
+#include "db_internal.h"
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * Page I/O.
+ *
+ * Pages are read and written with positional I/O (pread/pwrite) on the
+ * database file descriptor, so there is no shared file position and
+ * several threads can do page I/O at once. Page N lives at byte offset
+ * N * MDB_PAGE_SIZE; page 0 is the file header.
+ *
+ * Batches are sorted by page number and runs of consecutive pages are
+ * issued as a single preadv/pwritev, which turns a checkpoint's dirty
+ * pages or a scan's next few heap pages into a handful of large requests.
+ * Sequential scans additionally hint the kernel (POSIX_FADV_WILLNEED) to
+ * start reading the next window of pages before the cursor gets there.
+ *
+ * Every write is reported to the online backup, if one is running, so it
+ * can recopy the pages that changed behind it (see backup.c).
+ *
+ * The number of pages in the file is read once at open and then kept in
+ * MiniDB: writes past the end raise it and truncation lowers it, so the
+ * page layer can bounds-check every read and write without an fstat.
+ */
+
+#define IO_MAX_RUN 64
+
+static int db_fd(MiniDB* db)
+{
+    return fileno(db->fp);
+}
+
+static off_t page_offset(MDBPageNumber page_num)
+{
+    return (off_t)page_num * MDB_PAGE_SIZE;
+}
+
+/**
+ * Load the page count from the file size and note the file system block
+ * size. Called once by mdb_open.
+ */
+ErrorCode mdb_io_init(MiniDB* db)
+{
+    if (!db) return ERR_INVALID;
+
+    struct stat st;
+    if (fstat(db_fd(db), &st) != 0) return ERR_IO;
+    atomic_init(&db->page_count, (uint32_t)(st.st_size / MDB_PAGE_SIZE));
+    db->block_size = st.st_blksize > 0 ? (uint32_t)st.st_blksize : MDB_PAGE_SIZE;
+    return OK;
+}
+
+uint32_t mdb_io_page_count(MiniDB* db)
+{
+    return db ? atomic_load(&db->page_count) : 0;
+}
+
+/**
+ * Unit the file system allocates in; a punched hole only gives back whole
+ * blocks of this size.
+ */
+uint32_t mdb_io_block_size(const MiniDB* db)
+{
+    return db ? db->block_size : MDB_PAGE_SIZE;
+}
+
+/**
+ * Record that pages [first, first + count) now exist in the file.
+ */
+static void io_extend(MiniDB* db, MDBPageNumber first, uint32_t count)
+{
+    uint32_t end = first + count;
+    uint32_t cur = atomic_load(&db->page_count);
+    while (cur < end)
+    {
+        if (atomic_compare_exchange_weak(&db->page_count, &cur, end)) break;
+    }
+}
+
+/**
+ * Transfer every byte described by `iov`, resuming after short transfers
+ * and EINTR. A read that hits end of file fails with ERR_IO.
+ */
+static ErrorCode io_vector(int fd, struct iovec* iov, int iovcnt, off_t offset,
+                           bool is_write)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t n = is_write ? pwritev(fd, iov, iovcnt, offset)
+                             : preadv(fd, iov, iovcnt, offset);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return ERR_IO;
+        }
+        if (n == 0) return ERR_IO;
+
+        offset += n;
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return OK;
+}
+
+ErrorCode mdb_io_read(MiniDB* db, MDBPageNumber page_num, MDBPage* out_page)
+{
+    if (!db || !out_page) return ERR_INVALID;
+
+    mdb_metrics_add(MDB_COUNTER_PAGE_READS, 1);
+    struct iovec iov = {out_page->data, MDB_PAGE_SIZE};
+    return io_vector(db_fd(db), &iov, 1, page_offset(page_num), false);
+}
+
+ErrorCode mdb_io_write(MiniDB* db, MDBPageNumber page_num, const MDBPage* page)
+{
+    if (!db || !page) return ERR_INVALID;
+
+    mdb_metrics_add(MDB_COUNTER_PAGE_WRITES, 1);
+    struct iovec iov = {(void*)page->data, MDB_PAGE_SIZE};
+    ErrorCode err = io_vector(db_fd(db), &iov, 1, page_offset(page_num), true);
+    if (err == OK) io_extend(db, page_num, 1);
+    mdb_backup_note_write(db, page_num, 1);
+    return err;
+}
+
+static int request_compare(const void* a, const void* b)
+{
+    MDBPageNumber x = ((const MDBIoRequest*)a)->page_num;
+    MDBPageNumber y = ((const MDBIoRequest*)b)->page_num;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sort the batch, then issue one vectored call per run of consecutive
+ * page numbers. Stops at the first failure.
+ */
+static ErrorCode io_batch(MiniDB* db, MDBIoRequest* reqs, uint32_t n,
+                          bool is_write)
+{
+    if (!db || (!reqs && n > 0)) return ERR_INVALID;
+
+    qsort(reqs, n, sizeof(MDBIoRequest), request_compare);
+    mdb_metrics_add(is_write ? MDB_COUNTER_PAGE_WRITES : MDB_COUNTER_PAGE_READS, n);
+
+    struct iovec iov[IO_MAX_RUN];
+    uint32_t i = 0;
+    while (i < n)
+    {
+        MDBPageNumber first = reqs[i].page_num;
+        int count = 0;
+        while (i < n && count < IO_MAX_RUN && reqs[i].page_num == first + (MDBPageNumber)count)
+        {
+            iov[count].iov_base = reqs[i].page->data;
+            iov[count].iov_len = MDB_PAGE_SIZE;
+            count++;
+            i++;
+        }
+
+        ErrorCode err = io_vector(db_fd(db), iov, count, page_offset(first), is_write);
+        if (is_write && err == OK) io_extend(db, first, (uint32_t)count);
+        if (is_write) mdb_backup_note_write(db, first, (uint32_t)count);
+        if (err != OK) return err;
+    }
+
+    return OK;
+}
+
+/**
+ * Read every requested page. The batch is reordered by page number.
+ */
+ErrorCode mdb_io_read_batch(MiniDB* db, MDBIoRequest* reqs, uint32_t n)
+{
+    return io_batch(db, reqs, n, false);
+}
+
+/**
+ * Write every requested page. The batch is reordered by page number.
+ * Nothing is durable until mdb_io_sync.
+ */
+ErrorCode mdb_io_write_batch(MiniDB* db, MDBIoRequest* reqs, uint32_t n)
+{
+    return io_batch(db, reqs, n, true);
+}
+
+/**
+ * Write the first `len` bytes of a page slot and punch a hole over the rest,
+ * so the file system can release those blocks. The file size is unchanged
+ * and the hole reads back as zeros. Where hole punching is unsupported the
+ * rest of the slot just keeps its old bytes, which callers must ignore.
+ */
+ErrorCode mdb_io_write_sparse(MiniDB* db, MDBPageNumber page_num,
+                              const void* data, uint32_t len)
+{
+    if (!db || !data || len > MDB_PAGE_SIZE) return ERR_INVALID;
+
+    mdb_metrics_add(MDB_COUNTER_PAGE_WRITES, 1);
+    struct iovec iov = {(void*)data, len};
+    ErrorCode err = io_vector(db_fd(db), &iov, 1, page_offset(page_num), true);
+    mdb_backup_note_write(db, page_num, 1);
+    if (err != OK) return err;
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (len < MDB_PAGE_SIZE)
+    {
+        fallocate(db_fd(db), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  page_offset(page_num) + len, MDB_PAGE_SIZE - len);
+    }
+#endif
+
+    return OK;
+}
+
+/**
+ * Ask the kernel to start reading pages [start, start + count). Purely a
+ * hint: failures are ignored and nothing is copied to the caller. Where
+ * posix_fadvise is unavailable (macOS) this does nothing.
+ */
+void mdb_io_readahead(MiniDB* db, MDBPageNumber start, uint32_t count)
+{
+    if (!db || count == 0) return;
+
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(db_fd(db), page_offset(start), (off_t)count * MDB_PAGE_SIZE,
+                  POSIX_FADV_WILLNEED);
+#else
+    (void)start;
+#endif
+}
+
+/**
+ * Flush the file's data to stable storage. On macOS fsync only reaches the
+ * drive's cache, so F_FULLFSYNC is used there, falling back to fsync on
+ * file systems that reject it. Elsewhere fdatasync skips the metadata that
+ * page writes don't need, and plain fsync covers systems without it.
+ */
+static int io_datasync(int fd)
+{
+#if defined(F_FULLFSYNC)
+    if (fcntl(fd, F_FULLFSYNC) == 0) return 0;
+    return fsync(fd);
+#elif defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+    return fdatasync(fd);
+#else
+    return fsync(fd);
+#endif
+}
+
+ErrorCode mdb_io_sync(MiniDB* db)
+{
+    if (!db) return ERR_INVALID;
+
+    uint64_t start = mdb_metrics_now();
+    int rc = io_datasync(db_fd(db));
+    mdb_metrics_add(MDB_COUNTER_FSYNCS, 1);
+    mdb_metrics_record(MDB_LATENCY_FSYNC, mdb_metrics_now() - start);
+    return rc == 0 ? OK : ERR_IO;
+}
+
+/**
+ * Cut the file down to its first `page_count` pages.
+ */
+ErrorCode mdb_io_truncate(MiniDB* db, uint32_t page_count)
+{
+    if (!db || page_count == 0) return ERR_INVALID;
+    if (ftruncate(db_fd(db), page_offset(page_count)) != 0) return ERR_IO;
+
+    atomic_store(&db->page_count, page_count);
+    return OK;
+}
@@ -0,0 +1,272 @@
+#include "latch.h"
+#include "db_internal.h"
+#include "metrics.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/*
+ * Page latch table.
+ *
+ * Latches are short-lived reader/writer locks on individual pages, keyed
+ * by page number. The table is split into independently locked buckets so
+ * threads working on different pages never touch the same mutex; the
+ * bucket mutex is only held to find or create the latch entry, never
+ * while waiting for the latch itself.
+ *
+ * Entries are reference counted and freed once nobody holds or waits on
+ * them, so the table stays proportional to the pages currently in use.
+ *
+ * B-tree descents use latch crabbing on top of this: latch the child,
+ * then release the parent once the child is known to be safe (always for
+ * lookups; for inserts when the child cannot split). Only the part of the
+ * path that may change stays latched, so concurrent operations in
+ * different subtrees proceed in parallel.
+ */
+
+#define LATCH_BUCKETS 256
+
+typedef struct LatchEntry
+{
+    MDBPageNumber page_num;
+    uint32_t refs; // holders plus waiters, guarded by the bucket mutex
+    pthread_rwlock_t lock;
+    struct LatchEntry* next;
+} LatchEntry;
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    LatchEntry* entries;
+} LatchBucket;
+
+struct MDBLatchTable
+{
+    LatchBucket buckets[LATCH_BUCKETS];
+};
+
+static LatchBucket* latch_bucket(MDBLatchTable* table, MDBPageNumber page_num)
+{
+    // Fibonacci hashing spreads consecutive page numbers across buckets.
+    return &table->buckets[(page_num * 2654435769u) >> 24];
+}
+
+ErrorCode mdb_latch_table_create(MDBLatchTable** out_table)
+{
+    if (!out_table) return ERR_INVALID;
+
+    MDBLatchTable* table = calloc(1, sizeof(MDBLatchTable));
+    if (!table) return ERR_UNKNOWN;
+
+    for (int i = 0; i < LATCH_BUCKETS; i++)
+    {
+        pthread_mutex_init(&table->buckets[i].mutex, NULL);
+    }
+
+    *out_table = table;
+    return OK;
+}
+
+void mdb_latch_table_destroy(MDBLatchTable* table)
+{
+    if (!table) return;
+
+    for (int i = 0; i < LATCH_BUCKETS; i++)
+    {
+        LatchEntry* e = table->buckets[i].entries;
+        while (e)
+        {
+            LatchEntry* next = e->next;
+            pthread_rwlock_destroy(&e->lock);
+            free(e);
+            e = next;
+        }
+        pthread_mutex_destroy(&table->buckets[i].mutex);
+    }
+
+    free(table);
+}
+
+/**
+ * The latch table of an open database, created by mdb_open.
+ */
+MDBLatchTable* mdb_latches(MiniDB* db)
+{
+    return db ? db->latches : NULL;
+}
+
+/**
+ * Find the entry for a page, creating it if needed, and take a reference.
+ */
+static LatchEntry* latch_ref(MDBLatchTable* table, MDBPageNumber page_num)
+{
+    LatchBucket* b = latch_bucket(table, page_num);
+    pthread_mutex_lock(&b->mutex);
+
+    LatchEntry* e = b->entries;
+    while (e && e->page_num != page_num)
+    {
+        e = e->next;
+    }
+
+    if (!e)
+    {
+        e = malloc(sizeof(LatchEntry));
+        if (e)
+        {
+            e->page_num = page_num;
+            e->refs = 0;
+            pthread_rwlock_init(&e->lock, NULL);
+            e->next = b->entries;
+            b->entries = e;
+        }
+    }
+
+    if (e) e->refs++;
+
+    pthread_mutex_unlock(&b->mutex);
+    return e;
+}
+
+static void latch_unref(MDBLatchTable* table, LatchEntry* entry)
+{
+    LatchBucket* b = latch_bucket(table, entry->page_num);
+    pthread_mutex_lock(&b->mutex);
+
+    if (--entry->refs == 0)
+    {
+        LatchEntry** pp = &b->entries;
+        while (*pp != entry)
+        {
+            pp = &(*pp)->next;
+        }
+        *pp = entry->next;
+
+        pthread_rwlock_destroy(&entry->lock);
+        free(entry);
+    }
+
+    pthread_mutex_unlock(&b->mutex);
+}
+
+static LatchEntry* latch_find(MDBLatchTable* table, MDBPageNumber page_num)
+{
+    LatchBucket* b = latch_bucket(table, page_num);
+    pthread_mutex_lock(&b->mutex);
+
+    LatchEntry* e = b->entries;
+    while (e && e->page_num != page_num)
+    {
+        e = e->next;
+    }
+
+    pthread_mutex_unlock(&b->mutex);
+    return e;
+}
+
+ErrorCode mdb_latch_acquire(MDBLatchTable* table, MDBPageNumber page_num,
+                            MDBLatchMode mode)
+{
+    if (!table) return ERR_INVALID;
+
+    LatchEntry* e = latch_ref(table, page_num);
+    if (!e) return ERR_UNKNOWN;
+
+    int rc = mode == MDB_LATCH_EXCLUSIVE ? pthread_rwlock_trywrlock(&e->lock)
+                                         : pthread_rwlock_tryrdlock(&e->lock);
+    if (rc == EBUSY)
+    {
+        // Contended: only now is it worth timing the wait.
+        uint64_t start = mdb_metrics_now();
+        rc = mode == MDB_LATCH_EXCLUSIVE ? pthread_rwlock_wrlock(&e->lock)
+                                         : pthread_rwlock_rdlock(&e->lock);
+        mdb_metrics_add(MDB_COUNTER_LOCK_WAITS, 1);
+        mdb_metrics_record(MDB_LATENCY_LOCK_WAIT, mdb_metrics_now() - start);
+    }
+    if (rc != 0)
+    {
+        latch_unref(table, e);
+        return ERR_UNKNOWN;
+    }
+
+    return OK;
+}
+
+bool mdb_latch_try_acquire(MDBLatchTable* table, MDBPageNumber page_num,
+                           MDBLatchMode mode)
+{
+    if (!table) return false;
+
+    LatchEntry* e = latch_ref(table, page_num);
+    if (!e) return false;
+
+    int rc = mode == MDB_LATCH_EXCLUSIVE ? pthread_rwlock_trywrlock(&e->lock)
+                                         : pthread_rwlock_tryrdlock(&e->lock);
+    if (rc != 0)
+    {
+        latch_unref(table, e);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Release a latch taken with mdb_latch_acquire or mdb_latch_try_acquire.
+ * The entry can't disappear underneath us: our own reference keeps it alive.
+ */
+void mdb_latch_release(MDBLatchTable* table, MDBPageNumber page_num)
+{
+    if (!table) return;
+
+    LatchEntry* e = latch_find(table, page_num);
+    if (!e) return;
+
+    pthread_rwlock_unlock(&e->lock);
+    latch_unref(table, e);
+}
+
+/**
+ * Latch the next page on a descent. The ancestors stay latched until the
+ * caller decides the new page is safe and calls
+ * mdb_latch_path_release_ancestors.
+ */
+ErrorCode mdb_latch_path_push(MDBLatchTable* table, MDBLatchPath* path,
+                              MDBPageNumber page_num, MDBLatchMode mode)
+{
+    if (!table || !path) return ERR_INVALID;
+    if (path->depth >= MDB_LATCH_PATH_MAX) return ERR_FULL;
+
+    ErrorCode err = mdb_latch_acquire(table, page_num, mode);
+    if (err != OK) return err;
+
+    path->pages[path->depth] = page_num;
+    path->modes[path->depth] = mode;
+    path->depth++;
+    return OK;
+}
+
+void mdb_latch_path_release_ancestors(MDBLatchTable* table, MDBLatchPath* path)
+{
+    if (!table || !path || path->depth <= 1) return;
+
+    for (uint16_t i = 0; i + 1 < path->depth; i++)
+    {
+        mdb_latch_release(table, path->pages[i]);
+    }
+
+    path->pages[0] = path->pages[path->depth - 1];
+    path->modes[0] = path->modes[path->depth - 1];
+    path->depth = 1;
+}
+
+void mdb_latch_path_release_all(MDBLatchTable* table, MDBLatchPath* path)
+{
+    if (!table || !path) return;
+
+    while (path->depth > 0)
+    {
+        path->depth--;
+        mdb_latch_release(table, path->pages[path->depth]);
+    }
+}
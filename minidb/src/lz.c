@@ -0,0 +1,197 @@
+#include "lz.h"
+#include <string.h>
+
+/*
+ * A small LZ77 codec in the style of LZ4, bundled so page compression has
+ * no external dependency. It favours speed over ratio: one hash probe per
+ * position and no entropy coding.
+ *
+ * The output is a series of sequences:
+ *
+ *   [token][extra literal length][literals][uint16 offset][extra match length]
+ *
+ * The token's high nibble is the literal count and its low nibble the match
+ * length minus LZ_MIN_MATCH; a nibble of 15 means more length bytes follow,
+ * each adding 0-255 and continuing while the byte is 255. The final
+ * sequence has literals only and ends the stream.
+ */
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+
+static uint32_t lz_read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * Write a length continuation (the part beyond the nibble's 15).
+ * Returns the new output position, or NULL if it would not fit.
+ */
+static uint8_t* lz_put_length(uint8_t* op, const uint8_t* oend, size_t len)
+{
+    while (len >= 255)
+    {
+        if (op >= oend) return NULL;
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op >= oend) return NULL;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t* lz_put_sequence(uint8_t* op, const uint8_t* oend,
+                                const uint8_t* literals, size_t nlit,
+                                size_t offset, size_t match_len)
+{
+    if (op >= oend) return NULL;
+
+    size_t mcode = match_len ? match_len - LZ_MIN_MATCH : 0;
+    uint8_t* token = op++;
+    *token = (uint8_t)((nlit >= 15 ? 15 : nlit) << 4 | (mcode >= 15 ? 15 : mcode));
+
+    if (nlit >= 15 && !(op = lz_put_length(op, oend, nlit - 15))) return NULL;
+
+    if ((size_t)(oend - op) < nlit) return NULL;
+    memcpy(op, literals, nlit);
+    op += nlit;
+
+    if (match_len == 0) return op;
+
+    if (oend - op < 2) return NULL;
+    uint16_t off16 = (uint16_t)offset;
+    memcpy(op, &off16, sizeof(off16));
+    op += sizeof(off16);
+
+    if (mcode >= 15 && !(op = lz_put_length(op, oend, mcode - 15))) return NULL;
+    return op;
+}
+
+/**
+ * Compress `len` bytes into `dst`. Returns the compressed size, or 0 if
+ * the result would not fit in `cap` bytes (the input is incompressible
+ * for the caller's purposes).
+ */
+size_t mdb_lz_compress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap)
+{
+    if (!src || !dst) return 0;
+
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* iend = src + len;
+    uint8_t* op = dst;
+    const uint8_t* oend = dst + cap;
+
+    while (len >= LZ_MIN_MATCH && ip <= iend - LZ_MIN_MATCH)
+    {
+        uint32_t v = lz_read32(ip);
+        uint32_t h = lz_hash(v);
+        uint32_t cand = table[h];
+        table[h] = (uint32_t)(ip - src);
+
+        if (cand == UINT32_MAX || (size_t)(ip - src) - cand > LZ_MAX_OFFSET ||
+            lz_read32(src + cand) != v)
+        {
+            ip++;
+            continue;
+        }
+
+        const uint8_t* match = src + cand;
+        size_t match_len = LZ_MIN_MATCH;
+        while (ip + match_len < iend && ip[match_len] == match[match_len])
+        {
+            match_len++;
+        }
+
+        op = lz_put_sequence(op, oend, anchor, ip - anchor, ip - match, match_len);
+        if (!op) return 0;
+
+        ip += match_len;
+        anchor = ip;
+    }
+
+    op = lz_put_sequence(op, oend, anchor, iend - anchor, 0, 0);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+static const uint8_t* lz_get_length(const uint8_t* ip, const uint8_t* iend,
+                                    size_t* len)
+{
+    uint8_t b;
+    do
+    {
+        if (ip >= iend) return NULL;
+        b = *ip++;
+        *len += b;
+    } while (b == 255);
+    return ip;
+}
+
+/**
+ * Decompress into `dst`. Returns the decompressed size, or 0 if the input
+ * is malformed or would overflow `cap`. Never reads or writes out of bounds.
+ */
+size_t mdb_lz_decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t cap)
+{
+    if (!src || !dst) return 0;
+
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + cap;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+
+        size_t nlit = token >> 4;
+        if (nlit == 15 && !(ip = lz_get_length(ip, iend, &nlit))) return 0;
+        if ((size_t)(iend - ip) < nlit || (size_t)(oend - op) < nlit) return 0;
+        memcpy(op, ip, nlit);
+        ip += nlit;
+        op += nlit;
+
+        if (ip == iend) break; // Final literal-only sequence
+
+        if (iend - ip < 2) return 0;
+        uint16_t offset;
+        memcpy(&offset, ip, sizeof(offset));
+        ip += sizeof(offset);
+        if (offset == 0 || offset > op - dst) return 0;
+
+        size_t match_len = token & 0x0F;
+        if (match_len == 15 && !(ip = lz_get_length(ip, iend, &match_len))) return 0;
+        match_len += LZ_MIN_MATCH;
+        if ((size_t)(oend - op) < match_len) return 0;
+
+        // An overlapping match (offset < length) repeats the bytes it is
+        // producing, so it has to be copied forwards one byte at a time.
+        const uint8_t* match = op - offset;
+        if (offset >= match_len)
+        {
+            memcpy(op, match, match_len);
+        }
+        else
+        {
+            for (size_t i = 0; i < match_len; i++)
+            {
+                op[i] = match[i];
+            }
+        }
+        op += match_len;
+    }
+
+    return (size_t)(op - dst);
+}
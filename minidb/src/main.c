@@ -1,16 +1,167 @@
+#define _POSIX_C_SOURCE 200809L
+#include "backup.h"
 #include "db.h"
+#include "qcache.h"
 #include "repl.h"
+#include "server.h"
 #include <errors.h>
+#include <pthread.h>
 #include <readline/history.h>
 #include <readline/readline.h>
+#include <signal.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Serve the database until SIGINT or SIGTERM. The signals are blocked
+ * before the server's threads start, so they all inherit the mask and
+ * only the sigwait below sees them.
+ */
+static int serve(MiniDB* db, const char* address, uint32_t workers)
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    MDBServerConfig config = {address, workers, 0};
+    MDBServer* server;
+    ErrorCode err = mdb_server_start(db, &config, &server);
+    if (err != OK)
+    {
+        fprintf(stderr, "Failed to listen on %s: %d\n", address, err);
+        return EXIT_FAILURE;
+    }
+
+    printf("Serving on %s\n", address);
+    fflush(stdout);
+
+    int sig;
+    sigwait(&signals, &sig);
+    mdb_server_stop(server);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Run every statement of a script without readline, then report the
+ * elapsed time and throughput on stderr. Failing statements are reported
+ * and skipped; EXIT ends the script early.
+ */
+static int run_script(MiniDB* db, FILE* in)
+{
+    ScriptReader reader;
+    if (script_reader_init(&reader, in) != OK)
+    {
+        fprintf(stderr, "Failed to start the script reader\n");
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    unsigned long count = 0;
+    unsigned long failed = 0;
+    const char* sql;
+    ErrorCode err;
+    while ((err = script_next_statement(&reader, &sql)) == OK && sql)
+    {
+        count++;
+
+        Tokens tokens;
+        ErrorCode serr = tokenize(sql, &tokens);
+
+        Statement stmt;
+        memset(&stmt, 0, sizeof(stmt));
+        if (serr == OK) serr = parse_statement(&tokens, &stmt);
+        bool done = serr == OK && stmt.kind == STMT_EXIT;
+        if (serr == OK && !done) serr = execute_statement(db, &stmt, stdout, NULL);
+        if (serr != OK)
+        {
+            failed++;
+            fprintf(stderr, "Statement %lu failed: %d\n", count, serr);
+        }
+
+        free_tokens(&tokens);
+        free_statement(&stmt);
+        if (done) break;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    fflush(stdout);
+
+    if (err != OK) fprintf(stderr, "Failed to read the script: %d\n", err);
+    fprintf(stderr, "%lu statements (%lu failed) in %.3f s, %.0f statements/sec\n",
+            count, failed, elapsed, elapsed > 0 ? (double)count / elapsed : 0.0);
+
+    script_reader_free(&reader);
+    return err == OK && failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * --restore DEST FULL [INCREMENTAL...]: rebuild a database from backups.
+ */
+static int restore(int argc, char** argv)
+{
+    ErrorCode err = mdb_restore(argv[0], argv[1], (const char* const*)argv + 2,
+                                (uint32_t)(argc - 2));
+    if (err != OK)
+    {
+        fprintf(stderr, "Failed to restore: %d\n", err);
+        return EXIT_FAILURE;
+    }
+
+    printf("Restored '%s' from %d backups\n", argv[0], argc - 1);
+    return EXIT_SUCCESS;
+}
 
 int main(int argc, char** argv)
 {
-    const char* path = argc > 1 ? argv[1] : NULL;
+    if (argc >= 4 && strcmp(argv[1], "--restore") == 0) return restore(argc - 2, argv + 2);
+
+    const char* path = NULL;
+    const char* serve_address = NULL;
+    const char* script_path = NULL;
+    unsigned long cache_mb = 0;
+    unsigned long workers = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--result-cache") == 0 && i + 1 < argc)
+        {
+            cache_mb = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            serve_address = argv[++i];
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            script_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            workers = strtoul(argv[++i], NULL, 10);
+        }
+        else if (!path && argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+
     if (!path)
     {
-        fprintf(stderr, "Usage: %s <database-file>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--result-cache MB] [-f script.sql | --serve ADDRESS [--workers N]] <database-file>\n"
+                        "       %s --restore <database-file> <full-backup> [incremental-backup...]\n",
+                argv[0], argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -22,6 +173,37 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
+    if (cache_mb > 0 && mdb_result_cache_enable(db, (size_t)cache_mb << 20) != OK)
+    {
+        fprintf(stderr, "Failed to enable the result cache\n");
+        mdb_close(db);
+        return EXIT_FAILURE;
+    }
+
+    if (serve_address)
+    {
+        int status = serve(db, serve_address, (uint32_t)workers);
+        mdb_close(db);
+        return status;
+    }
+
+    // Scripts, given with -f or piped in, skip readline entirely.
+    if (script_path || !isatty(STDIN_FILENO))
+    {
+        FILE* in = script_path ? fopen(script_path, "r") : stdin;
+        if (!in)
+        {
+            fprintf(stderr, "Failed to open %s\n", script_path);
+            mdb_close(db);
+            return EXIT_FAILURE;
+        }
+
+        int status = run_script(db, in);
+        if (in != stdin) fclose(in);
+        mdb_close(db);
+        return status;
+    }
+
     for (;;)
     {
         char* line = readline("minidb> ");
@@ -29,10 +211,11 @@ int main(int argc, char** argv)
         if (*line) add_history(line);
 
         Tokens tokens;
-        tokenize(line, &tokens);
+        ErrorCode perr = tokenize(line, &tokens);
 
         Statement stmt;
-        ErrorCode perr = parse_statement(&tokens, &stmt);
+        memset(&stmt, 0, sizeof(stmt));
+        if (perr == OK) perr = parse_statement(&tokens, &stmt);
         if (perr != OK)
         {
             printf("Parse error: %d\n", perr);
@@ -42,7 +225,7 @@ int main(int argc, char** argv)
             continue;
         }
 
-        ErrorCode rerr = execute_statement(db, &stmt);
+        ErrorCode rerr = execute_statement(db, &stmt, stdout, NULL);
         if (rerr != OK)
         {
             printf("Execution error: %d\n", rerr);
@@ -0,0 +1,293 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Runtime metrics.
+ *
+ * Counters and latency histograms live in per-thread shards, so recording
+ * never contends: each shard has a single writer, which updates it with
+ * plain relaxed loads and stores (no locked instructions). Readers merge
+ * every live shard under the registry lock. When a thread exits, its shard
+ * is folded into a retired total and freed, so nothing it counted is lost.
+ *
+ * Histograms are HDR-style: the bucket of a value is its power of two plus
+ * the next MDB_METRICS_SUB_BITS bits below the leading one. That gives a
+ * fixed relative error over the whole range from nanoseconds to minutes
+ * with a few hundred buckets, and merging two histograms is just adding
+ * them bucket by bucket.
+ *
+ * The text format is one metric per line, name first, so a dump can be
+ * grepped or diffed between two points in time.
+ */
+
+typedef struct
+{
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t buckets[MDB_METRICS_BUCKETS];
+} ShardHistogram;
+
+typedef struct Shard
+{
+    _Atomic uint64_t counters[MDB_COUNTER_COUNT];
+    ShardHistogram latencies[MDB_LATENCY_COUNT];
+    struct Shard* next;
+} Shard;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static Shard* shards;       // live threads, guarded by registry_lock
+static MDBMetrics retired;  // exited threads, guarded by registry_lock
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t shard_key;
+static _Thread_local Shard* local_shard;
+
+static void shard_merge(const Shard* shard, MDBMetrics* into)
+{
+    for (int i = 0; i < MDB_COUNTER_COUNT; i++)
+    {
+        into->counters[i] += atomic_load_explicit(&shard->counters[i], memory_order_relaxed);
+    }
+
+    for (int i = 0; i < MDB_LATENCY_COUNT; i++)
+    {
+        const ShardHistogram* h = &shard->latencies[i];
+        MDBLatencyHistogram* out = &into->latencies[i];
+
+        uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+        if (count == 0) continue;
+
+        out->count += count;
+        out->sum_ns += atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+        uint64_t max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+        if (max > out->max_ns) out->max_ns = max;
+        for (int b = 0; b < MDB_METRICS_BUCKETS; b++)
+        {
+            out->buckets[b] += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Thread exit: keep the shard's totals, then drop it.
+ */
+static void shard_retire(void* arg)
+{
+    Shard* shard = arg;
+
+    pthread_mutex_lock(&registry_lock);
+    Shard** pp = &shards;
+    while (*pp && *pp != shard)
+    {
+        pp = &(*pp)->next;
+    }
+    if (*pp) *pp = shard->next;
+    shard_merge(shard, &retired);
+    pthread_mutex_unlock(&registry_lock);
+
+    free(shard);
+}
+
+static void key_create(void)
+{
+    pthread_key_create(&shard_key, shard_retire);
+}
+
+/**
+ * The calling thread's shard, created on first use. NULL if it can't be
+ * allocated, in which case the thread's metrics are dropped.
+ */
+static Shard* shard_get(void)
+{
+    if (local_shard) return local_shard;
+
+    Shard* shard = calloc(1, sizeof(Shard));
+    if (!shard) return NULL;
+
+    pthread_once(&key_once, key_create);
+    pthread_setspecific(shard_key, shard);
+
+    pthread_mutex_lock(&registry_lock);
+    shard->next = shards;
+    shards = shard;
+    pthread_mutex_unlock(&registry_lock);
+
+    local_shard = shard;
+    return shard;
+}
+
+// Only the owning thread writes a shard, so a load and a store suffice.
+static inline void bump(_Atomic uint64_t* value, uint64_t n)
+{
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+static uint32_t bucket_index(uint64_t ns)
+{
+    if (ns >> MDB_METRICS_MAX_BITS) return MDB_METRICS_BUCKETS - 1;
+    if (ns < (1u << MDB_METRICS_SUB_BITS)) return (uint32_t)ns;
+
+    uint32_t exp = 63 - (uint32_t)__builtin_clzll(ns);
+    uint32_t sub = (uint32_t)(ns >> (exp - MDB_METRICS_SUB_BITS)) & ((1u << MDB_METRICS_SUB_BITS) - 1);
+    return ((exp - MDB_METRICS_SUB_BITS + 1) << MDB_METRICS_SUB_BITS) + sub;
+}
+
+/**
+ * Smallest value that lands in `index`.
+ */
+static uint64_t bucket_low(uint32_t index)
+{
+    if (index < (1u << MDB_METRICS_SUB_BITS)) return index;
+
+    uint32_t exp = (index >> MDB_METRICS_SUB_BITS) + MDB_METRICS_SUB_BITS - 1;
+    uint64_t sub = index & ((1u << MDB_METRICS_SUB_BITS) - 1);
+    return ((1ull << MDB_METRICS_SUB_BITS) + sub) << (exp - MDB_METRICS_SUB_BITS);
+}
+
+uint64_t mdb_metrics_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void mdb_metrics_add(MDBCounter counter, uint64_t n)
+{
+    if ((unsigned)counter >= MDB_COUNTER_COUNT) return;
+
+    Shard* shard = shard_get();
+    if (shard) bump(&shard->counters[counter], n);
+}
+
+void mdb_metrics_record(MDBLatency latency, uint64_t ns)
+{
+    if ((unsigned)latency >= MDB_LATENCY_COUNT) return;
+
+    Shard* shard = shard_get();
+    if (!shard) return;
+
+    ShardHistogram* h = &shard->latencies[latency];
+    bump(&h->count, 1);
+    bump(&h->sum_ns, ns);
+    bump(&h->buckets[bucket_index(ns)], 1);
+    if (ns > atomic_load_explicit(&h->max_ns, memory_order_relaxed))
+    {
+        atomic_store_explicit(&h->max_ns, ns, memory_order_relaxed);
+    }
+}
+
+/**
+ * Totals over every thread, live or exited.
+ */
+void mdb_metrics_snapshot(MDBMetrics* out_metrics)
+{
+    if (!out_metrics) return;
+
+    pthread_mutex_lock(&registry_lock);
+    memcpy(out_metrics, &retired, sizeof(MDBMetrics));
+    for (Shard* s = shards; s; s = s->next)
+    {
+        shard_merge(s, out_metrics);
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+/**
+ * Estimate the value below which `percentile` percent of the recorded
+ * values fall: the midpoint of the bucket that holds it, capped at the
+ * largest value seen.
+ */
+uint64_t mdb_metrics_percentile(const MDBLatencyHistogram* histogram,
+                                double percentile)
+{
+    if (!histogram || histogram->count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count);
+    if (rank >= histogram->count) rank = histogram->count - 1;
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < MDB_METRICS_BUCKETS; b++)
+    {
+        seen += histogram->buckets[b];
+        if (seen > rank)
+        {
+            uint64_t low = bucket_low(b);
+            uint64_t high = b + 1 < MDB_METRICS_BUCKETS ? bucket_low(b + 1) : low;
+            uint64_t mid = low + (high - low) / 2;
+            return mid < histogram->max_ns ? mid : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+static void format_latency(FILE* out, const char* name, const char* kind,
+                           const MDBLatencyHistogram* h)
+{
+    fprintf(out, "%s", name);
+    if (kind) fprintf(out, "{kind=%s}", kind);
+
+    double mean = h->count ? (double)h->sum_ns / (double)h->count : 0.0;
+    fprintf(out, " count=%llu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+            (unsigned long long)h->count, mean / 1e3,
+            mdb_metrics_percentile(h, 50.0) / 1e3, mdb_metrics_percentile(h, 90.0) / 1e3,
+            mdb_metrics_percentile(h, 99.0) / 1e3, mdb_metrics_percentile(h, 99.9) / 1e3,
+            h->max_ns / 1e3);
+}
+
+/**
+ * Write `metrics` as text. Latencies are in microseconds. Statement
+ * latencies are listed per kind, named by `statement_names`, and only
+ * for kinds that have run.
+ */
+void mdb_metrics_format(const MDBMetrics* metrics, FILE* out,
+                        const char* const* statement_names,
+                        uint32_t nstatements)
+{
+    if (!metrics || !out) return;
+
+    const uint64_t* c = metrics->counters;
+    uint64_t lookups = c[MDB_COUNTER_BUFFER_HITS] + c[MDB_COUNTER_BUFFER_MISSES];
+
+    fprintf(out, "page_reads %llu\n", (unsigned long long)c[MDB_COUNTER_PAGE_READS]);
+    fprintf(out, "page_writes %llu\n", (unsigned long long)c[MDB_COUNTER_PAGE_WRITES]);
+    fprintf(out, "buffer_hits %llu\n", (unsigned long long)c[MDB_COUNTER_BUFFER_HITS]);
+    fprintf(out, "buffer_misses %llu\n", (unsigned long long)c[MDB_COUNTER_BUFFER_MISSES]);
+    fprintf(out, "buffer_hit_ratio %.4f\n",
+            lookups ? (double)c[MDB_COUNTER_BUFFER_HITS] / (double)lookups : 0.0);
+    fprintf(out, "wal_flushes %llu\n", (unsigned long long)c[MDB_COUNTER_WAL_FLUSHES]);
+    fprintf(out, "fsyncs %llu\n", (unsigned long long)c[MDB_COUNTER_FSYNCS]);
+    fprintf(out, "lock_waits %llu\n", (unsigned long long)c[MDB_COUNTER_LOCK_WAITS]);
+
+    format_latency(out, "wal_flush_us", NULL, &metrics->latencies[MDB_LATENCY_WAL_FLUSH]);
+    format_latency(out, "fsync_us", NULL, &metrics->latencies[MDB_LATENCY_FSYNC]);
+    format_latency(out, "lock_wait_us", NULL, &metrics->latencies[MDB_LATENCY_LOCK_WAIT]);
+
+    for (uint32_t i = 0; statement_names && i < nstatements && i < MDB_METRICS_STATEMENT_KINDS; i++)
+    {
+        const MDBLatencyHistogram* h = &metrics->latencies[MDB_LATENCY_STATEMENT + i];
+        if (h->count == 0 || !statement_names[i]) continue;
+        format_latency(out, "statement_us", statement_names[i], h);
+    }
+}
+
+ErrorCode mdb_metrics_dump(FILE* out, const char* const* statement_names,
+                           uint32_t nstatements)
+{
+    if (!out) return ERR_INVALID;
+
+    // Too big for the stack of a server worker.
+    MDBMetrics* metrics = malloc(sizeof(MDBMetrics));
+    if (!metrics) return ERR_UNKNOWN;
+
+    mdb_metrics_snapshot(metrics);
+    mdb_metrics_format(metrics, out, statement_names, nstatements);
+    free(metrics);
+    return OK;
+}
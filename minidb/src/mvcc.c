@@ -0,0 +1,503 @@
+#include "mvcc.h"
+#include "latch.h"
+#include "wal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Multi-version concurrency control.
+ *
+ * Every row version in the heap carries the id of the transaction that
+ * created it (xmin) and of the one that deleted it (xmax). Writers never
+ * overwrite a row in place: an update marks the old version's xmax and
+ * inserts a new version, so a reader working from an older snapshot keeps
+ * seeing the version that was current when it started.
+ *
+ * A snapshot records which transactions had committed when it was taken:
+ * everything below `xmin`, nothing at or above `xmax`, and in between
+ * everything except the ids in `active`. Taking a snapshot is the only
+ * place readers touch shared state, and it just copies the active list
+ * under a short mutex; readers never wait for a writer to finish.
+ *
+ * Transaction outcomes live in an in-memory commit log indexed by xid,
+ * rebuilt from the WAL when the manager is created, since the heap keeps
+ * xids across restarts. Ids are reserved MDB_XID_BATCH at a time with a
+ * WAL_OP_XID_RESERVE record and every commit logs a WAL_OP_TXN_COMMIT,
+ * both written straight to the file. After a restart numbering resumes
+ * above the last reservation, and a reserved xid with no commit record
+ * is aborted: it either rolled back or was still running at the crash.
+ */
+
+#define CLOG_INITIAL_CAPACITY 1024
+
+struct MDBTxnManager
+{
+    MiniDB* db;
+    MDBWal* wal;
+
+    pthread_mutex_t lock; // guards next_xid, reserved_until and the active list
+    MDBTxnID next_xid;
+    MDBTxnID reserved_until; // xids below this are durably reserved
+    MDBTxnID* active;
+    uint32_t nactive;
+    uint32_t active_cap;
+
+    pthread_rwlock_t clog_lock; // guards the commit log
+    uint8_t* clog;              // MDBTxnStatus per xid
+    size_t clog_cap;
+};
+
+void mdb_txn_manager_destroy(MDBTxnManager* mgr)
+{
+    if (!mgr) return;
+
+    pthread_mutex_destroy(&mgr->lock);
+    pthread_rwlock_destroy(&mgr->clog_lock);
+    free(mgr->active);
+    free(mgr->clog);
+    free(mgr);
+}
+
+/**
+ * Make sure the commit log has an entry for `xid`.
+ */
+static ErrorCode clog_reserve(MDBTxnManager* mgr, MDBTxnID xid)
+{
+    pthread_rwlock_wrlock(&mgr->clog_lock);
+
+    ErrorCode err = OK;
+    if (xid >= mgr->clog_cap)
+    {
+        size_t cap = mgr->clog_cap;
+        while (cap <= xid)
+        {
+            cap *= 2;
+        }
+
+        uint8_t* clog = realloc(mgr->clog, cap);
+        if (clog)
+        {
+            memset(clog + mgr->clog_cap, MDB_TXN_IN_PROGRESS, cap - mgr->clog_cap);
+            mgr->clog = clog;
+            mgr->clog_cap = cap;
+        }
+        else
+        {
+            err = ERR_UNKNOWN;
+        }
+    }
+
+    pthread_rwlock_unlock(&mgr->clog_lock);
+    return err;
+}
+
+typedef struct
+{
+    MDBTxnManager* mgr;
+    MDBTxnID reserved_until;
+} XidRecovery;
+
+static ErrorCode recover_xid(void* ctx, const MDBWalRecord* record,
+                             const void* payload)
+{
+    XidRecovery* rec = ctx;
+    if ((record->type != WAL_OP_XID_RESERVE && record->type != WAL_OP_TXN_COMMIT) ||
+        record->size != sizeof(MDBTxnID))
+    {
+        return OK;
+    }
+
+    MDBTxnID xid;
+    memcpy(&xid, payload, sizeof(xid));
+    if (record->type == WAL_OP_XID_RESERVE)
+    {
+        if (xid > rec->reserved_until) rec->reserved_until = xid;
+        return OK;
+    }
+
+    // Reserved, and so logged, before anything could commit under it.
+    ErrorCode err = clog_reserve(rec->mgr, xid);
+    if (err == OK) rec->mgr->clog[xid] = MDB_TXN_COMMITTED;
+    return err;
+}
+
+/**
+ * Rebuild the commit log from the WAL: numbering resumes at the last
+ * reservation and every reserved xid without a commit record is aborted.
+ */
+static ErrorCode txn_recover(MDBTxnManager* mgr)
+{
+    XidRecovery rec = {mgr, 1}; // 0 is MDB_TXN_INVALID
+    ErrorCode err = mdb_wal_scan(mgr->wal, recover_xid, &rec);
+    if (err == OK) err = clog_reserve(mgr, rec.reserved_until);
+    if (err != OK) return err;
+
+    for (MDBTxnID xid = 1; xid < rec.reserved_until; xid++)
+    {
+        if (mgr->clog[xid] != MDB_TXN_COMMITTED) mgr->clog[xid] = MDB_TXN_ABORTED;
+    }
+    mgr->next_xid = rec.reserved_until;
+    mgr->reserved_until = rec.reserved_until;
+    return OK;
+}
+
+/**
+ * Transactions on `db`, logged to its WAL so that their outcomes survive
+ * a restart.
+ */
+ErrorCode mdb_txn_manager_create(MiniDB* db, MDBTxnManager** out_mgr)
+{
+    if (!db || !out_mgr) return ERR_INVALID;
+
+    MDBTxnManager* mgr = calloc(1, sizeof(MDBTxnManager));
+    if (!mgr) return ERR_UNKNOWN;
+
+    mgr->clog = calloc(CLOG_INITIAL_CAPACITY, 1);
+    if (!mgr->clog)
+    {
+        free(mgr);
+        return ERR_UNKNOWN;
+    }
+    mgr->clog_cap = CLOG_INITIAL_CAPACITY;
+    mgr->db = db;
+
+    pthread_mutex_init(&mgr->lock, NULL);
+    pthread_rwlock_init(&mgr->clog_lock, NULL);
+
+    ErrorCode err = mdb_wal_get(db, &mgr->wal);
+    if (err == OK) err = txn_recover(mgr);
+    if (err != OK)
+    {
+        mdb_txn_manager_destroy(mgr);
+        return err;
+    }
+
+    *out_mgr = mgr;
+    return OK;
+}
+
+/**
+ * Make sure `xid` is covered by a durable reservation. Called with
+ * mgr->lock held.
+ */
+static ErrorCode xid_reserve(MDBTxnManager* mgr, MDBTxnID xid)
+{
+    if (xid < mgr->reserved_until) return OK;
+
+    MDBTxnID high_water = mgr->reserved_until;
+    while (high_water <= xid)
+    {
+        high_water += MDB_XID_BATCH;
+    }
+
+    // Durable now, but without flushing (or later losing to a ROLLBACK)
+    // the records of a WAL transaction that is still open.
+    MDBWalRecord record = {.type = WAL_OP_XID_RESERVE, .size = sizeof(high_water)};
+    ErrorCode err = mdb_wal_write_direct(mgr->wal, &record, &high_water);
+    if (err == OK) mgr->reserved_until = high_water;
+    return err;
+}
+
+/**
+ * Start a transaction. The xid only joins the active list once its commit
+ * log entry and reservation exist, so a failure leaves nothing behind.
+ */
+ErrorCode mdb_txn_begin(MDBTxnManager* mgr, MDBTxnID* out_xid)
+{
+    if (!mgr || !out_xid) return ERR_INVALID;
+
+    pthread_mutex_lock(&mgr->lock);
+
+    ErrorCode err = OK;
+    if (mgr->nactive == mgr->active_cap)
+    {
+        uint32_t cap = mgr->active_cap ? mgr->active_cap * 2 : 16;
+        MDBTxnID* active = realloc(mgr->active, sizeof(MDBTxnID) * cap);
+        if (active)
+        {
+            mgr->active = active;
+            mgr->active_cap = cap;
+        }
+        else
+        {
+            err = ERR_UNKNOWN;
+        }
+    }
+
+    MDBTxnID xid = mgr->next_xid;
+    if (err == OK) err = xid_reserve(mgr, xid);
+    if (err == OK) err = clog_reserve(mgr, xid);
+    if (err == OK)
+    {
+        mgr->next_xid++;
+        mgr->active[mgr->nactive++] = xid;
+    }
+
+    pthread_mutex_unlock(&mgr->lock);
+
+    if (err != OK) return err;
+
+    *out_xid = xid;
+    return OK;
+}
+
+static bool txn_active(MDBTxnManager* mgr, MDBTxnID xid)
+{
+    bool active = false;
+
+    pthread_mutex_lock(&mgr->lock);
+    for (uint32_t i = 0; i < mgr->nactive && !active; i++)
+    {
+        active = mgr->active[i] == xid;
+    }
+    pthread_mutex_unlock(&mgr->lock);
+
+    return active;
+}
+
+/**
+ * Record the outcome, then drop the transaction from the active list.
+ *
+ * The order matters: a snapshot taken in between still lists the xid as
+ * active and so ignores it, which is the same answer it would have got a
+ * moment earlier. The reverse order could let one snapshot see a
+ * transaction as both in progress and committed.
+ *
+ * A commit is logged before anyone can see it. If that fails the
+ * transaction is still in progress and should be aborted. Aborts are not
+ * logged: after a restart an xid without a commit record is aborted.
+ */
+static ErrorCode txn_finish(MDBTxnManager* mgr, MDBTxnID xid, MDBTxnStatus status)
+{
+    if (!mgr || xid == MDB_TXN_INVALID) return ERR_INVALID;
+    if (!txn_active(mgr, xid)) return ERR_INVALID;
+
+    if (status == MDB_TXN_COMMITTED)
+    {
+        MDBWalRecord record = {.type = WAL_OP_TXN_COMMIT, .size = sizeof(xid)};
+        ErrorCode err = mdb_wal_write_direct(mgr->wal, &record, &xid);
+        if (err != OK) return err;
+    }
+
+    pthread_rwlock_wrlock(&mgr->clog_lock);
+    bool valid = xid < mgr->clog_cap && mgr->clog[xid] == MDB_TXN_IN_PROGRESS;
+    if (valid) mgr->clog[xid] = (uint8_t)status;
+    pthread_rwlock_unlock(&mgr->clog_lock);
+
+    if (!valid) return ERR_INVALID;
+
+    pthread_mutex_lock(&mgr->lock);
+    for (uint32_t i = 0; i < mgr->nactive; i++)
+    {
+        if (mgr->active[i] == xid)
+        {
+            mgr->active[i] = mgr->active[--mgr->nactive];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mgr->lock);
+
+    return OK;
+}
+
+ErrorCode mdb_txn_commit(MDBTxnManager* mgr, MDBTxnID xid)
+{
+    return txn_finish(mgr, xid, MDB_TXN_COMMITTED);
+}
+
+ErrorCode mdb_txn_abort(MDBTxnManager* mgr, MDBTxnID xid)
+{
+    return txn_finish(mgr, xid, MDB_TXN_ABORTED);
+}
+
+MDBTxnStatus mdb_txn_status(MDBTxnManager* mgr, MDBTxnID xid)
+{
+    MDBTxnStatus status = MDB_TXN_IN_PROGRESS;
+
+    pthread_rwlock_rdlock(&mgr->clog_lock);
+    if (xid < mgr->clog_cap) status = (MDBTxnStatus)mgr->clog[xid];
+    pthread_rwlock_unlock(&mgr->clog_lock);
+
+    return status;
+}
+
+ErrorCode mdb_snapshot_take(MDBTxnManager* mgr, MDBTxnID self,
+                            MDBSnapshot* out_snapshot)
+{
+    if (!mgr || !out_snapshot) return ERR_INVALID;
+
+    pthread_mutex_lock(&mgr->lock);
+
+    MDBTxnID* active = NULL;
+    if (mgr->nactive > 0)
+    {
+        active = malloc(sizeof(MDBTxnID) * mgr->nactive);
+        if (!active)
+        {
+            pthread_mutex_unlock(&mgr->lock);
+            return ERR_UNKNOWN;
+        }
+        memcpy(active, mgr->active, sizeof(MDBTxnID) * mgr->nactive);
+    }
+
+    out_snapshot->self = self;
+    out_snapshot->xmax = mgr->next_xid;
+    out_snapshot->xmin = mgr->next_xid;
+    out_snapshot->active = active;
+    out_snapshot->nactive = mgr->nactive;
+
+    pthread_mutex_unlock(&mgr->lock);
+
+    for (uint32_t i = 0; i < out_snapshot->nactive; i++)
+    {
+        if (active[i] < out_snapshot->xmin) out_snapshot->xmin = active[i];
+    }
+
+    return OK;
+}
+
+void mdb_snapshot_release(MDBSnapshot* snapshot)
+{
+    if (!snapshot) return;
+
+    free(snapshot->active);
+    snapshot->active = NULL;
+    snapshot->nactive = 0;
+}
+
+/**
+ * Did `xid` commit before the snapshot was taken (or is it the snapshot's
+ * own transaction)?
+ */
+static bool xid_visible(MDBTxnManager* mgr, const MDBSnapshot* snapshot,
+                        MDBTxnID xid)
+{
+    if (xid == snapshot->self) return true;
+    if (xid >= snapshot->xmax) return false;
+
+    if (xid >= snapshot->xmin)
+    {
+        for (uint32_t i = 0; i < snapshot->nactive; i++)
+        {
+            if (snapshot->active[i] == xid) return false;
+        }
+    }
+
+    return mdb_txn_status(mgr, xid) == MDB_TXN_COMMITTED;
+}
+
+bool mdb_tuple_visible(MDBTxnManager* mgr, const MDBSnapshot* snapshot,
+                       const MDBTupleHeader* tuple)
+{
+    if (!xid_visible(mgr, snapshot, tuple->xmin)) return false;
+    if (tuple->xmax == MDB_TXN_INVALID) return true;
+    return !xid_visible(mgr, snapshot, tuple->xmax);
+}
+
+ErrorCode mdb_mvcc_insert(MDBPage* page, MDBTxnID xid, const uint8_t* record,
+                          uint16_t size, MDBSlotID* out_slot)
+{
+    if (!page || (!record && size > 0) || !out_slot) return ERR_INVALID;
+
+    uint8_t buffer[MDB_PAGE_SIZE];
+    uint32_t total = sizeof(MDBTupleHeader) + (uint32_t)size;
+    if (total > MDB_PAGE_USABLE_SIZE) return ERR_FULL;
+
+    MDBTupleHeader tuple = {.xmin = xid, .xmax = MDB_TXN_INVALID};
+    memcpy(buffer, &tuple, sizeof(tuple));
+    memcpy(buffer + sizeof(tuple), record, size);
+
+    return mdb_heap_page_insert(page, buffer, (uint16_t)total, out_slot);
+}
+
+static ErrorCode mvcc_delete(MDBTxnManager* mgr, MDBPage* page, MDBSlotID slot,
+                             MDBTxnID xid)
+{
+    const uint8_t* record;
+    uint16_t size;
+    ErrorCode err = mdb_heap_page_get(page, slot, &record, &size);
+    if (err != OK) return err;
+    if (size < sizeof(MDBTupleHeader)) return ERR_INVALID;
+
+    MDBTupleHeader tuple;
+    memcpy(&tuple, record, sizeof(tuple));
+
+    if (tuple.xmax != MDB_TXN_INVALID && tuple.xmax != xid &&
+        mdb_txn_status(mgr, tuple.xmax) != MDB_TXN_ABORTED)
+    {
+        return ERR_CONFLICT;
+    }
+
+    tuple.xmax = xid;
+    memcpy(page->data + (record - page->data), &tuple, sizeof(tuple));
+    return OK;
+}
+
+/**
+ * Mark a version on page `page_num` as deleted by `xid`, under that
+ * page's exclusive latch.
+ *
+ * Fails with ERR_CONFLICT if another transaction that has not aborted
+ * already deleted it (first updater wins).
+ */
+ErrorCode mdb_mvcc_delete(MDBTxnManager* mgr, MDBPageNumber page_num,
+                          MDBPage* page, MDBSlotID slot, MDBTxnID xid)
+{
+    if (!mgr || !page) return ERR_INVALID;
+
+    MDBLatchTable* latches = mdb_latches(mgr->db);
+    ErrorCode err = mdb_latch_acquire(latches, page_num, MDB_LATCH_EXCLUSIVE);
+    if (err != OK) return err;
+
+    err = mvcc_delete(mgr, page, slot, xid);
+    mdb_latch_release(latches, page_num);
+    return err;
+}
+
+ErrorCode mdb_mvcc_get(MDBTxnManager* mgr, const MDBPage* page, MDBSlotID slot,
+                       const MDBSnapshot* snapshot, const uint8_t** out_record,
+                       uint16_t* out_size)
+{
+    if (!mgr || !page || !snapshot || !out_record || !out_size) return ERR_INVALID;
+
+    const uint8_t* record;
+    uint16_t size;
+    ErrorCode err = mdb_heap_page_get(page, slot, &record, &size);
+    if (err != OK) return err;
+    if (size < sizeof(MDBTupleHeader)) return ERR_INVALID;
+
+    MDBTupleHeader tuple;
+    memcpy(&tuple, record, sizeof(tuple));
+    if (!mdb_tuple_visible(mgr, snapshot, &tuple)) return ERR_INVALID;
+
+    *out_record = record + sizeof(MDBTupleHeader);
+    *out_size = size - sizeof(MDBTupleHeader);
+    return OK;
+}
+
+bool mdb_mvcc_iter_next(MDBTxnManager* mgr, const MDBPage* page,
+                        MDBHeapIter* it, const MDBSnapshot* snapshot,
+                        MDBSlotID* out_slot, const uint8_t** out_record,
+                        uint16_t* out_size)
+{
+    MDBSlotID slot;
+    const uint8_t* record;
+    uint16_t size;
+
+    while (mdb_heap_page_iter_next(page, it, &slot, &record, &size))
+    {
+        if (size < sizeof(MDBTupleHeader)) continue;
+
+        MDBTupleHeader tuple;
+        memcpy(&tuple, record, sizeof(tuple));
+        if (!mdb_tuple_visible(mgr, snapshot, &tuple)) continue;
+
+        if (out_slot) *out_slot = slot;
+        if (out_record) *out_record = record + sizeof(MDBTupleHeader);
+        if (out_size) *out_size = size - sizeof(MDBTupleHeader);
+        return true;
+    }
+
+    return false;
+}
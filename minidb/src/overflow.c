@@ -0,0 +1,217 @@
+#include "overflow.h"
+#include "freelist.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Overflow pages for large TEXT values.
+ *
+ * A heap page can't hold a 64 KiB value, and even values that would fit
+ * make rows fat enough that a scan touches far more pages than it needs.
+ * Before a row is stored, mdb_overflow_externalize moves its biggest TEXT
+ * values out into chains of PG_OVERFLOW pages until the row is below
+ * MDB_ROW_TARGET_SIZE. The row keeps the first MDB_OVERFLOW_PREFIX bytes
+ * inline plus a reference to the chain, so scans that don't need the full
+ * value (or only compare a short prefix) never read overflow pages.
+ *
+ * Each overflow page is an MDBOverflowHeader followed by up to
+ * MDB_OVERFLOW_CAPACITY bytes of the value; `next` links the chain.
+ */
+
+/**
+ * Store `len` bytes in a new overflow chain. The chain is written back to
+ * front so every page already knows its successor when it is allocated.
+ * If that fails partway, the pages written so far are freed again.
+ */
+ErrorCode mdb_overflow_write(MiniDB* db, const uint8_t* data, uint32_t len,
+                             MDBPageNumber* out_first_page)
+{
+    if (!db || !data || len == 0 || !out_first_page) return ERR_INVALID;
+
+    uint32_t npages = (len + MDB_OVERFLOW_CAPACITY - 1) / MDB_OVERFLOW_CAPACITY;
+    MDBPageNumber next = 0;
+
+    for (uint32_t i = npages; i-- > 0;)
+    {
+        uint32_t offset = i * MDB_OVERFLOW_CAPACITY;
+        uint32_t chunk = len - offset < MDB_OVERFLOW_CAPACITY ? len - offset : MDB_OVERFLOW_CAPACITY;
+
+        MDBPage page;
+        mdb_page_init(&page, PG_OVERFLOW);
+
+        MDBOverflowHeader h = {.type = PG_OVERFLOW, .next = next, .len = (uint16_t)chunk};
+        memcpy(page.data, &h, sizeof(h));
+        memcpy(page.data + sizeof(h), data + offset, chunk);
+
+        MDBPageNumber page_num;
+        ErrorCode err = mdb_page_allocate(db, &page, &page_num);
+        if (err != OK)
+        {
+            if (next != 0) mdb_overflow_free(db, next);
+            return err;
+        }
+        next = page_num;
+    }
+
+    *out_first_page = next;
+    return OK;
+}
+
+/**
+ * Read exactly `len` bytes from the chain starting at `first_page`.
+ */
+ErrorCode mdb_overflow_read(MiniDB* db, MDBPageNumber first_page, uint8_t* out,
+                            uint32_t len)
+{
+    if (!db || !out || first_page == 0) return ERR_INVALID;
+
+    MDBPageNumber page_num = first_page;
+    uint32_t done = 0;
+
+    while (done < len)
+    {
+        if (page_num == 0) return ERR_CORRUPT;
+
+        MDBPage page;
+        ErrorCode err = mdb_page_read(db, page_num, &page);
+        if (err != OK) return err;
+        if (!mdb_page_is_type(&page, PG_OVERFLOW)) return ERR_CORRUPT;
+
+        MDBOverflowHeader h;
+        memcpy(&h, page.data, sizeof(h));
+        if (h.len > MDB_OVERFLOW_CAPACITY || h.len > len - done) return ERR_CORRUPT;
+
+        memcpy(out + done, page.data + sizeof(h), h.len);
+        done += h.len;
+        page_num = h.next;
+    }
+
+    return OK;
+}
+
+/**
+ * Hand every page of a chain back to the free list.
+ */
+ErrorCode mdb_overflow_free(MiniDB* db, MDBPageNumber first_page)
+{
+    if (!db || first_page == 0) return ERR_INVALID;
+
+    MDBPageNumber page_num = first_page;
+    while (page_num != 0)
+    {
+        MDBPage page;
+        ErrorCode err = mdb_page_read(db, page_num, &page);
+        if (err != OK) return err;
+        if (!mdb_page_is_type(&page, PG_OVERFLOW)) return ERR_CORRUPT;
+
+        MDBOverflowHeader h;
+        memcpy(&h, page.data, sizeof(h));
+
+        err = mdb_page_free(db, page_num);
+        if (err != OK) return err;
+        page_num = h.next;
+    }
+
+    return OK;
+}
+
+/**
+ * Put the values moved out by a failed mdb_overflow_externalize back
+ * inline and free their chains.
+ */
+static void externalize_undo(MiniDB* db, MDBValue* cols, uint16_t ncols,
+                             const bool* moved)
+{
+    for (uint16_t i = 0; i < ncols; i++)
+    {
+        if (!moved[i]) continue;
+
+        mdb_overflow_free(db, cols[i].overflow.first_page);
+        cols[i].text.length = cols[i].overflow.length;
+        cols[i].overflow.first_page = 0;
+        cols[i].overflow.length = 0;
+    }
+}
+
+/**
+ * Move large TEXT values out of the row until it fits MDB_ROW_TARGET_SIZE,
+ * biggest first. Externalized values keep pointing at the caller's text,
+ * with the length cut to the inline prefix. On failure every value moved
+ * here is put back and its chain freed.
+ */
+ErrorCode mdb_overflow_externalize(MiniDB* db, MDBValue* cols, uint16_t ncols)
+{
+    if (!db || (!cols && ncols > 0)) return ERR_INVALID;
+
+    bool* moved = NULL; // values this call moved out
+    ErrorCode err = OK;
+
+    for (;;)
+    {
+        uint16_t size = mdb_row_encoded_size(cols, ncols);
+        if (size != 0 && size <= MDB_ROW_TARGET_SIZE) break;
+
+        int biggest = -1;
+        for (uint16_t i = 0; i < ncols; i++)
+        {
+            MDBValue* v = &cols[i];
+            if (v->is_null || v->type != COL_TYPE_TEXT || mdb_value_is_external(v)) continue;
+            if (v->text.length <= MDB_OVERFLOW_PREFIX) continue;
+            if (biggest < 0 || v->text.length > cols[biggest].text.length) biggest = i;
+        }
+
+        // Nothing left to move out: the row is as small as it gets.
+        if (biggest < 0)
+        {
+            if (size == 0) err = ERR_FULL;
+            break;
+        }
+
+        if (!moved) moved = calloc(ncols, sizeof(bool));
+        if (!moved)
+        {
+            err = ERR_UNKNOWN;
+            break;
+        }
+
+        MDBValue* v = &cols[biggest];
+        err = mdb_overflow_write(db, (const uint8_t*)v->text.ptr, v->text.length,
+                                 &v->overflow.first_page);
+        if (err != OK) break;
+
+        moved[biggest] = true;
+        v->overflow.length = v->text.length;
+        v->text.length = MDB_OVERFLOW_PREFIX;
+    }
+
+    if (err != OK && moved) externalize_undo(db, cols, ncols, moved);
+    free(moved);
+    return err;
+}
+
+/**
+ * Produce the full value of `value` in `out_value`. Inline values are
+ * returned as they are; external ones are read from their overflow chain
+ * into `buf`, which must hold at least value->overflow.length bytes.
+ */
+ErrorCode mdb_overflow_fetch(MiniDB* db, const MDBValue* value, char* buf,
+                             uint32_t cap, MDBValue* out_value)
+{
+    if (!value || !out_value) return ERR_INVALID;
+
+    if (!mdb_value_is_external(value))
+    {
+        *out_value = *value;
+        return OK;
+    }
+
+    if (!buf || cap < value->overflow.length) return ERR_FULL;
+
+    ErrorCode err = mdb_overflow_read(db, value->overflow.first_page, (uint8_t*)buf,
+                                      value->overflow.length);
+    if (err != OK) return err;
+
+    *out_value = mdb_value_text(buf, value->overflow.length);
+    return OK;
+}
@@ -0,0 +1,370 @@
+#include "pages.h"
+#include "crc32c.h"
+#include "db_internal.h"
+#include "freelist.h"
+#include "io.h"
+#include "lz.h"
+#include <stddef.h>
+#include <string.h>
+
+void mdb_page_zero(MDBPage* page)
+{
+    memset(page->data, 0, sizeof(page->data));
+}
+
+void mdb_page_set_type(MDBPage* page, MDBPageType type)
+{
+    // Every page format starts with its MDBPageType, so the type always
+    // lives in the first bytes of the page.
+    memcpy(page->data, &type, sizeof(MDBPageType));
+}
+
+MDBPageType mdb_page_get_type(const MDBPage* page)
+{
+    MDBPageType type;
+    memcpy(&type, page->data, sizeof(MDBPageType));
+    return type;
+}
+
+bool mdb_page_is_type(const MDBPage* page, MDBPageType type)
+{
+    return mdb_page_get_type(page) == type;
+}
+
+/*
+ * Every page ends with an MDBPageTrailer. Its checksum is stamped on every
+ * write to disk and verified on every read from disk, so a page that was
+ * only half written by a crash (a torn write) or rotted on disk is caught
+ * before anything parses it.
+ *
+ * Pages flagged MDB_PAGE_FLAG_COMPRESS are stored as an
+ * MDBCompressedPageHeader plus the compressed image, with the rest of the
+ * slot punched out. Page numbers and offsets stay fixed; only the bytes the
+ * file system has to store and read shrink. mdb_page_read expands them
+ * again, so everything above this layer sees ordinary pages. The hole only
+ * frees whole file system blocks, so a page is stored compressed only when
+ * that frees at least one; with the default 4K pages on a 4K-block file
+ * system, the flag never changes what is written.
+ *
+ * Every write also stamps the page with the next value of a page LSN clock
+ * that only moves forward, so comparing LSNs tells which pages changed
+ * after a given point; incremental backups copy exactly those. The clock
+ * is reserved MDB_LSN_BATCH values at a time through the file header, so
+ * after a crash it resumes past anything that may have been stamped.
+ * Page 0, the header itself, carries no LSN.
+ */
+
+// Only store compressed if it saves at least this fraction of the page.
+#define COMPRESS_MIN_SAVING (MDB_PAGE_SIZE / 8)
+
+#define CHECKSUM_COVERED (MDB_PAGE_SIZE - sizeof(uint32_t))
+
+static MDBPageTrailer* page_trailer(MDBPage* page)
+{
+    return (MDBPageTrailer*)(page->data + MDB_PAGE_USABLE_SIZE);
+}
+
+static const MDBPageTrailer* page_trailer_const(const MDBPage* page)
+{
+    return (const MDBPageTrailer*)(page->data + MDB_PAGE_USABLE_SIZE);
+}
+
+uint16_t mdb_page_flags(const MDBPage* page)
+{
+    return page_trailer_const(page)->flags;
+}
+
+void mdb_page_set_flags(MDBPage* page, uint16_t flags)
+{
+    page_trailer(page)->flags = flags;
+}
+
+uint64_t mdb_page_lsn(const MDBPage* page)
+{
+    return page_trailer_const(page)->lsn;
+}
+
+/**
+ * LSN of a page as stored on disk, compressed or not.
+ */
+uint64_t mdb_page_image_lsn(const MDBPage* image)
+{
+    if (!mdb_page_is_type(image, PG_COMPRESSED)) return mdb_page_lsn(image);
+
+    MDBCompressedPageHeader h;
+    memcpy(&h, image->data, sizeof(h));
+    return h.lsn;
+}
+
+// Caller holds header_lock.
+static ErrorCode lsn_load(MiniDB* db)
+{
+    if (db->lsn_loaded) return OK;
+
+    ErrorCode err = mdb_header_load(db);
+    if (err != OK) return err;
+
+    db->next_lsn = db->header.lsn_reserved ? db->header.lsn_reserved : 1;
+    db->lsn_loaded = true;
+    return OK;
+}
+
+ErrorCode mdb_page_lsn_next(MiniDB* db, uint64_t* out_lsn)
+{
+    if (!db || !out_lsn) return ERR_INVALID;
+
+    pthread_mutex_lock(&db->header_lock);
+    ErrorCode err = lsn_load(db);
+    if (err == OK && db->next_lsn >= db->header.lsn_reserved)
+    {
+        uint64_t reserved = db->header.lsn_reserved;
+        db->header.lsn_reserved = db->next_lsn + MDB_LSN_BATCH;
+        // Durable before any page carries an LSN from the new batch.
+        err = mdb_header_store(db);
+        if (err == OK) err = mdb_io_sync(db);
+        if (err != OK) db->header.lsn_reserved = reserved;
+    }
+    if (err == OK) *out_lsn = db->next_lsn++;
+    pthread_mutex_unlock(&db->header_lock);
+    return err;
+}
+
+/**
+ * The LSN the next page write will get; every page written so far has a
+ * smaller one.
+ */
+ErrorCode mdb_page_lsn_peek(MiniDB* db, uint64_t* out_lsn)
+{
+    if (!db || !out_lsn) return ERR_INVALID;
+
+    pthread_mutex_lock(&db->header_lock);
+    ErrorCode err = lsn_load(db);
+    if (err == OK) *out_lsn = db->next_lsn;
+    pthread_mutex_unlock(&db->header_lock);
+    return err;
+}
+
+static ErrorCode page_stamp(MiniDB* db, MDBPage* page)
+{
+    uint64_t lsn;
+    ErrorCode err = mdb_page_lsn_next(db, &lsn);
+    if (err != OK) return err;
+
+    page_trailer(page)->lsn = lsn;
+    mdb_page_checksum_set(page);
+    return OK;
+}
+
+void mdb_page_checksum_set(MDBPage* page)
+{
+    page_trailer(page)->checksum = mdb_crc32c(0, page->data, CHECKSUM_COVERED);
+}
+
+bool mdb_page_checksum_ok(const MDBPage* page)
+{
+    return page_trailer_const(page)->checksum == mdb_crc32c(0, page->data, CHECKSUM_COVERED);
+}
+
+uint32_t mdb_page_count(MiniDB* db)
+{
+    return mdb_io_page_count(db);
+}
+
+/**
+ * Expand a PG_COMPRESSED image in place.
+ */
+static ErrorCode page_expand(MDBPage* page)
+{
+    MDBCompressedPageHeader h;
+    memcpy(&h, page->data, sizeof(h));
+
+    const uint8_t* payload = page->data + sizeof(h);
+    if (h.size > MDB_PAGE_SIZE - sizeof(h)) return ERR_CORRUPT;
+    if (mdb_crc32c(0, payload, h.size) != h.checksum) return ERR_CORRUPT;
+
+    MDBPage out;
+    if (mdb_lz_decompress(payload, h.size, out.data, MDB_PAGE_SIZE) != MDB_PAGE_SIZE)
+    {
+        return ERR_CORRUPT;
+    }
+
+    memcpy(page->data, out.data, MDB_PAGE_SIZE);
+    return OK;
+}
+
+/**
+ * Read a page from disk and verify its checksum. Cached copies (buffer
+ * pool hits) never come through here, so the check costs nothing on hits.
+ */
+ErrorCode mdb_page_read(MiniDB* db, MDBPageNumber page_num, MDBPage* out_page)
+{
+    if (page_num >= mdb_page_count(db)) return ERR_INVALID;
+
+    ErrorCode err = mdb_io_read(db, page_num, out_page);
+    if (err != OK) return err;
+
+    if (mdb_page_is_type(out_page, PG_COMPRESSED))
+    {
+        err = page_expand(out_page);
+        if (err != OK) return err;
+    }
+
+    return mdb_page_checksum_ok(out_page) ? OK : ERR_CORRUPT;
+}
+
+/**
+ * Try to store `page` compressed. Sets *out_written to false, without
+ * touching the file, when compression does not save enough to bother.
+ */
+static ErrorCode page_write_compressed(MiniDB* db, MDBPageNumber page_num,
+                                       const MDBPage* page, bool* out_written)
+{
+    MDBPage image;
+    MDBCompressedPageHeader h = {.type = PG_COMPRESSED};
+    uint8_t* payload = image.data + sizeof(h);
+
+    *out_written = false;
+    uint32_t saving = mdb_io_block_size(db);
+    if (saving < COMPRESS_MIN_SAVING) saving = COMPRESS_MIN_SAVING;
+    if (saving >= MDB_PAGE_SIZE) return OK;
+
+    h.size = mdb_lz_compress(page->data, MDB_PAGE_SIZE, payload,
+                             MDB_PAGE_SIZE - saving - sizeof(h));
+    if (h.size == 0) return OK;
+
+    h.checksum = mdb_crc32c(0, payload, h.size);
+    h.lsn = mdb_page_lsn(page);
+    memcpy(image.data, &h, sizeof(h));
+
+    ErrorCode err = mdb_io_write_sparse(db, page_num, image.data, sizeof(h) + h.size);
+    if (err == OK) *out_written = true;
+    return err;
+}
+
+/**
+ * Write a page to disk. Its LSN and checksum are stamped into `page` first.
+ */
+ErrorCode mdb_page_write(MiniDB* db, MDBPageNumber page_num, MDBPage* page)
+{
+    // Page 0 is the file header and is only written by mdb_open and the
+    // free list.
+    if (page_num == 0 || page_num >= mdb_page_count(db)) return ERR_INVALID;
+
+    ErrorCode err = page_stamp(db, page);
+    if (err != OK) return err;
+
+    if (mdb_page_flags(page) & MDB_PAGE_FLAG_COMPRESS)
+    {
+        bool written;
+        err = page_write_compressed(db, page_num, page, &written);
+        if (err != OK || written) return err;
+    }
+
+    return mdb_io_write(db, page_num, page);
+}
+
+/**
+ * Write many pages. Plain pages go out as one sorted vectored batch;
+ * compressed ones are written individually since their sizes differ.
+ * The batch is reordered.
+ */
+ErrorCode mdb_page_write_batch(MiniDB* db, MDBIoRequest* reqs, uint32_t n)
+{
+    if (!db || (!reqs && n > 0)) return ERR_INVALID;
+
+    uint32_t plain = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (mdb_page_flags(reqs[i].page) & MDB_PAGE_FLAG_COMPRESS)
+        {
+            ErrorCode err = mdb_page_write(db, reqs[i].page_num, reqs[i].page);
+            if (err != OK) return err;
+            continue;
+        }
+
+        ErrorCode err = page_stamp(db, reqs[i].page);
+        if (err != OK) return err;
+        reqs[plain++] = reqs[i];
+    }
+
+    return mdb_io_write_batch(db, reqs, plain);
+}
+
+/**
+ * Append `page` to the end of the file. New pages are always written in
+ * full so the file grows by exactly one page; compression applies from
+ * the first mdb_page_write on. alloc_lock is held from picking the page
+ * number until the write has raised the page count, so two appends never
+ * get the same page.
+ */
+ErrorCode mdb_page_allocate(MiniDB* db, MDBPage* page,
+                            MDBPageNumber* out_page_num)
+{
+    if (!db || !page || !out_page_num) return ERR_INVALID;
+
+    // Reuse a freed page before growing the file.
+    bool found;
+    MDBPageNumber page_num;
+    ErrorCode err = mdb_freelist_pop(db, &found, &page_num);
+    if (err != OK) return err;
+
+    if (found)
+    {
+        err = mdb_page_write(db, page_num, page);
+        if (err != OK) return err;
+
+        *out_page_num = page_num;
+        return OK;
+    }
+
+    pthread_mutex_lock(&db->alloc_lock);
+    page_num = mdb_page_count(db);
+    err = page_num == 0 ? ERR_IO : page_stamp(db, page);
+    if (err == OK) err = mdb_io_write(db, page_num, page);
+    pthread_mutex_unlock(&db->alloc_lock);
+    if (err != OK) return err;
+
+    *out_page_num = page_num;
+    return OK;
+}
+
+void mdb_page_scan_begin(MiniDB* db, MDBPageNumber start, MDBPageNumber end,
+                         uint32_t window, MDBPageScan* out_scan)
+{
+    out_scan->db = db;
+    out_scan->next = start;
+    out_scan->end = end;
+    out_scan->prefetched = start;
+    out_scan->window = window ? window : MDB_IO_READAHEAD_PAGES;
+    out_scan->err = OK;
+}
+
+/**
+ * Read the next page of the scan through mdb_page_read, so it is verified
+ * and expanded like any other read. Returns false at the end or on error;
+ * check scan->err to tell them apart.
+ *
+ * Read-ahead is issued a full window at a time once the cursor is half a
+ * window away from the end of what was already requested, so the disk
+ * always has the next pages in flight while the current ones are used.
+ */
+bool mdb_page_scan_next(MDBPageScan* scan, MDBPage* out_page,
+                        MDBPageNumber* out_page_num)
+{
+    if (scan->err != OK || scan->next >= scan->end) return false;
+
+    if (scan->prefetched < scan->end && scan->prefetched - scan->next <= scan->window / 2)
+    {
+        uint32_t count = scan->end - scan->prefetched;
+        if (count > scan->window) count = scan->window;
+        mdb_io_readahead(scan->db, scan->prefetched, count);
+        scan->prefetched += count;
+    }
+
+    scan->err = mdb_page_read(scan->db, scan->next, out_page);
+    if (scan->err != OK) return false;
+
+    if (out_page_num) *out_page_num = scan->next;
+    scan->next++;
+    return true;
+}
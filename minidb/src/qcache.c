@@ -0,0 +1,390 @@
+#include "qcache.h"
+#include "db_internal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Query result cache.
+ *
+ * Dashboards issue the same SELECTs every few seconds against tables that
+ * change every few minutes, so the formatted results of SELECTs are kept
+ * in an LRU cache bounded by bytes. Entries are keyed by the normalized
+ * statement (built from the parsed Statement, so spacing and keyword case
+ * don't matter) and remember the version of the table they were read from.
+ *
+ * Every write to a table bumps its version. That invalidates all of the
+ * table's entries at once without touching them; a stale entry is dropped
+ * the next time it is looked up, or falls off the end of the LRU list.
+ *
+ * A result is only stored if the table version is still the one the
+ * caller saw before running the query, so a write that lands while a
+ * SELECT is running can't leave an outdated result behind.
+ */
+
+#define QCACHE_INITIAL_BUCKETS 64
+
+typedef struct Entry
+{
+    char* key;
+    char* table_name;
+    uint64_t version;
+    uint8_t* data;
+    size_t len;
+    struct Entry* prev; // LRU list, most recent first
+    struct Entry* next;
+    struct Entry* hash_next;
+} Entry;
+
+typedef struct TableVersion
+{
+    char* name;
+    uint64_t version;
+    struct TableVersion* next;
+} TableVersion;
+
+struct MDBResultCache
+{
+    pthread_mutex_t lock;
+    size_t max_bytes;
+
+    Entry** buckets;
+    uint32_t nbuckets;
+    Entry* head;
+    Entry* tail;
+
+    TableVersion* versions;
+    MDBResultCacheStats stats;
+};
+
+static uint32_t key_hash(const char* key)
+{
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t entry_bytes(const Entry* e)
+{
+    return sizeof(Entry) + e->len + strlen(e->key) + strlen(e->table_name) + 2;
+}
+
+ErrorCode mdb_result_cache_create(size_t max_bytes,
+                                  MDBResultCache** out_cache)
+{
+    if (max_bytes == 0 || !out_cache) return ERR_INVALID;
+
+    MDBResultCache* cache = calloc(1, sizeof(MDBResultCache));
+    if (!cache) return ERR_UNKNOWN;
+
+    cache->buckets = calloc(QCACHE_INITIAL_BUCKETS, sizeof(Entry*));
+    if (!cache->buckets)
+    {
+        free(cache);
+        return ERR_UNKNOWN;
+    }
+
+    cache->nbuckets = QCACHE_INITIAL_BUCKETS;
+    cache->max_bytes = max_bytes;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    *out_cache = cache;
+    return OK;
+}
+
+static void entry_free(Entry* e)
+{
+    free(e->key);
+    free(e->table_name);
+    free(e->data);
+    free(e);
+}
+
+void mdb_result_cache_destroy(MDBResultCache* cache)
+{
+    if (!cache) return;
+
+    Entry* e = cache->head;
+    while (e)
+    {
+        Entry* next = e->next;
+        entry_free(e);
+        e = next;
+    }
+
+    TableVersion* v = cache->versions;
+    while (v)
+    {
+        TableVersion* next = v->next;
+        free(v->name);
+        free(v);
+        v = next;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache);
+}
+
+static TableVersion* find_version(MDBResultCache* cache, const char* table_name)
+{
+    for (TableVersion* v = cache->versions; v; v = v->next)
+    {
+        if (strcmp(v->name, table_name) == 0) return v;
+    }
+    return NULL;
+}
+
+static uint64_t table_version(MDBResultCache* cache, const char* table_name)
+{
+    TableVersion* v = find_version(cache, table_name);
+    return v ? v->version : 0;
+}
+
+/**
+ * Current version of a table. Read it before running a query and hand it
+ * to mdb_result_cache_put with the result.
+ */
+uint64_t mdb_result_cache_version(MDBResultCache* cache, const char* table_name)
+{
+    if (!cache || !table_name) return 0;
+
+    pthread_mutex_lock(&cache->lock);
+    uint64_t version = table_version(cache, table_name);
+    pthread_mutex_unlock(&cache->lock);
+    return version;
+}
+
+static Entry* find_entry(MDBResultCache* cache, const char* key)
+{
+    Entry* e = cache->buckets[key_hash(key) & (cache->nbuckets - 1)];
+    while (e && strcmp(e->key, key) != 0)
+    {
+        e = e->hash_next;
+    }
+    return e;
+}
+
+static void lru_unlink(MDBResultCache* cache, Entry* e)
+{
+    Entry** prev_link = e->prev ? &e->prev->next : &cache->head;
+    Entry** next_link = e->next ? &e->next->prev : &cache->tail;
+    *prev_link = e->next;
+    *next_link = e->prev;
+}
+
+static void lru_push_front(MDBResultCache* cache, Entry* e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head) cache->head->prev = e;
+    cache->head = e;
+    if (!cache->tail) cache->tail = e;
+}
+
+static void entry_remove(MDBResultCache* cache, Entry* e)
+{
+    Entry** pp = &cache->buckets[key_hash(e->key) & (cache->nbuckets - 1)];
+    while (*pp != e)
+    {
+        pp = &(*pp)->hash_next;
+    }
+    *pp = e->hash_next;
+
+    lru_unlink(cache, e);
+    cache->stats.bytes -= entry_bytes(e);
+    cache->stats.entries--;
+    entry_free(e);
+}
+
+/**
+ * Look up a cached result. On a hit *out_data is a copy the caller frees.
+ */
+bool mdb_result_cache_get(MDBResultCache* cache, const char* key,
+                          const char* table_name, uint8_t** out_data,
+                          size_t* out_len)
+{
+    if (!cache || !key || !table_name || !out_data || !out_len) return false;
+
+    pthread_mutex_lock(&cache->lock);
+
+    Entry* e = find_entry(cache, key);
+    if (e && e->version != table_version(cache, table_name))
+    {
+        cache->stats.stale++;
+        entry_remove(cache, e);
+        e = NULL;
+    }
+
+    uint8_t* copy = e ? malloc(e->len ? e->len : 1) : NULL;
+    if (!copy)
+    {
+        cache->stats.misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return false;
+    }
+
+    memcpy(copy, e->data, e->len);
+    *out_data = copy;
+    *out_len = e->len;
+
+    lru_unlink(cache, e);
+    lru_push_front(cache, e);
+    cache->stats.hits++;
+
+    pthread_mutex_unlock(&cache->lock);
+    return true;
+}
+
+static void grow_buckets(MDBResultCache* cache)
+{
+    if (cache->stats.entries < cache->nbuckets) return;
+
+    uint32_t nbuckets = cache->nbuckets * 2;
+    Entry** buckets = calloc(nbuckets, sizeof(Entry*));
+    if (!buckets) return; // longer chains, still correct
+
+    for (Entry* e = cache->head; e; e = e->next)
+    {
+        uint32_t b = key_hash(e->key) & (nbuckets - 1);
+        e->hash_next = buckets[b];
+        buckets[b] = e;
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->nbuckets = nbuckets;
+}
+
+/**
+ * Store a result computed against `version` of its table. Results that
+ * are already stale, or bigger than the whole cache, are not stored.
+ */
+ErrorCode mdb_result_cache_put(MDBResultCache* cache, const char* key,
+                               const char* table_name, uint64_t version,
+                               const uint8_t* data, size_t len)
+{
+    if (!cache || !key || !table_name || (!data && len > 0)) return ERR_INVALID;
+
+    Entry* e = calloc(1, sizeof(Entry));
+    if (!e) return ERR_UNKNOWN;
+
+    e->key = strdup(key);
+    e->table_name = strdup(table_name);
+    e->data = malloc(len ? len : 1);
+    if (!e->key || !e->table_name || !e->data)
+    {
+        entry_free(e);
+        return ERR_UNKNOWN;
+    }
+    if (len > 0) memcpy(e->data, data, len);
+    e->len = len;
+    e->version = version;
+
+    pthread_mutex_lock(&cache->lock);
+
+    if (version != table_version(cache, table_name) || entry_bytes(e) > cache->max_bytes)
+    {
+        pthread_mutex_unlock(&cache->lock);
+        entry_free(e);
+        return OK;
+    }
+
+    Entry* old = find_entry(cache, key);
+    if (old) entry_remove(cache, old);
+
+    grow_buckets(cache);
+    uint32_t b = key_hash(key) & (cache->nbuckets - 1);
+    e->hash_next = cache->buckets[b];
+    cache->buckets[b] = e;
+    lru_push_front(cache, e);
+    cache->stats.bytes += entry_bytes(e);
+    cache->stats.entries++;
+
+    while (cache->stats.bytes > cache->max_bytes)
+    {
+        entry_remove(cache, cache->tail);
+        cache->stats.evictions++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+    return OK;
+}
+
+/**
+ * Mark every cached result read from `table_name` as stale. Call on each
+ * write to the table, including DDL.
+ */
+void mdb_result_cache_invalidate(MDBResultCache* cache, const char* table_name)
+{
+    if (!cache || !table_name) return;
+
+    pthread_mutex_lock(&cache->lock);
+
+    TableVersion* v = find_version(cache, table_name);
+    if (!v)
+    {
+        v = calloc(1, sizeof(TableVersion));
+        if (v) v->name = strdup(table_name);
+        if (v && !v->name)
+        {
+            free(v);
+            v = NULL;
+        }
+        if (v)
+        {
+            v->next = cache->versions;
+            cache->versions = v;
+        }
+    }
+
+    if (v)
+    {
+        v->version++;
+    }
+    else
+    {
+        // Out of memory: drop everything rather than risk serving stale rows.
+        while (cache->head)
+        {
+            entry_remove(cache, cache->head);
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void mdb_result_cache_stats(MDBResultCache* cache, MDBResultCacheStats* out_stats)
+{
+    if (!cache || !out_stats) return;
+
+    pthread_mutex_lock(&cache->lock);
+    *out_stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Turn on result caching for a database, replacing any existing cache.
+ * The cache is freed by mdb_close.
+ */
+ErrorCode mdb_result_cache_enable(MiniDB* db, size_t max_bytes)
+{
+    if (!db) return ERR_INVALID;
+
+    MDBResultCache* cache;
+    ErrorCode err = mdb_result_cache_create(max_bytes, &cache);
+    if (err != OK) return err;
+
+    mdb_result_cache_destroy(db->result_cache);
+    db->result_cache = cache;
+    return OK;
+}
+
+MDBResultCache* mdb_result_cache(const MiniDB* db)
+{
+    return db ? db->result_cache : NULL;
+}
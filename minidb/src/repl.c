@@ -1,5 +1,14 @@
 #include "repl.h"
+#include "backup.h"
+#include "catalog.h"
+#include "column.h"
 #include "errors.h"
+#include "heap.h"
+#include "metrics.h"
+#include "mvcc.h"
+#include "qcache.h"
+#include "stats.h"
+#include "wal.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -83,12 +92,15 @@ static void add_token(Tokens* tokens, const char* token)
  *
  * Example: "CREATE TABLE users (id INT)" becomes:
  * ["CREATE", "TABLE", "users", "(", "id", "INT", ")"]
+ *
+ * Returns ERR_PARSE if a quoted string is too long for one token. The
+ * tokens read so far are kept; free them with free_tokens either way.
  */
-void tokenize(const char* line, Tokens* out_tokens)
+ErrorCode tokenize(const char* line, Tokens* out_tokens)
 {
     if (!line || !out_tokens)
     {
-        return;
+        return ERR_INVALID;
     }
 
     // Initialize the output tokens structure
@@ -139,6 +151,11 @@ void tokenize(const char* line, Tokens* out_tokens)
                 // Read until matching closing quote
                 while (*ptr && *ptr != quote_char)
                 {
+                    // Leave room for the closing quote and the terminator
+                    if (buf_idx >= (int)sizeof(buffer) - 2)
+                    {
+                        return ERR_PARSE;
+                    }
                     buffer[buf_idx++] = *ptr++;
                 }
 
@@ -181,6 +198,7 @@ void tokenize(const char* line, Tokens* out_tokens)
         buffer[buf_idx] = '\0';
         add_token(out_tokens, buffer);
     }
+    return OK;
 }
 
 /**
@@ -209,6 +227,128 @@ void free_tokens(Tokens* tokens)
     tokens->pos = 0;
 }
 
+/**
+ * Set up a reader that splits a SQL script into statements. The input is
+ * read in SCRIPT_CHUNK_SIZE blocks rather than a line at a time.
+ */
+ErrorCode script_reader_init(ScriptReader* reader, FILE* in)
+{
+    if (!reader || !in) return ERR_INVALID;
+
+    memset(reader, 0, sizeof(ScriptReader));
+    reader->in = in;
+    reader->chunk = malloc(SCRIPT_CHUNK_SIZE);
+    reader->stmt_cap = 256;
+    reader->stmt = malloc(reader->stmt_cap);
+    if (!reader->chunk || !reader->stmt)
+    {
+        script_reader_free(reader);
+        return ERR_UNKNOWN;
+    }
+    return OK;
+}
+
+static bool script_append(ScriptReader* reader, char c)
+{
+    if (reader->stmt_len + 1 >= reader->stmt_cap)
+    {
+        char* grown = realloc(reader->stmt, reader->stmt_cap * 2);
+        if (!grown) return false;
+        reader->stmt = grown;
+        reader->stmt_cap *= 2;
+    }
+    reader->stmt[reader->stmt_len++] = c;
+    return true;
+}
+
+/**
+ * Read the next statement: everything up to a ';' outside quotes, or to
+ * the end of input.
+ *
+ * `--` comments run to the end of their line and read as a single space.
+ * Empty statements are skipped.
+ *
+ * *out_sql stays valid until the next call. It is NULL once the script
+ * is exhausted.
+ */
+ErrorCode script_next_statement(ScriptReader* reader, const char** out_sql)
+{
+    if (!reader || !out_sql) return ERR_INVALID;
+
+    char quote = 0;
+    bool comment = false;
+    bool dash = false; // the last character appended was a '-' outside quotes
+    reader->stmt_len = 0;
+
+    for (;;)
+    {
+        if (reader->pos == reader->len)
+        {
+            reader->len = fread(reader->chunk, 1, SCRIPT_CHUNK_SIZE, reader->in);
+            reader->pos = 0;
+            if (reader->len == 0) break;
+        }
+
+        char c = reader->chunk[reader->pos++];
+        if (comment)
+        {
+            if (c != '\n') continue;
+            // The newline ending a comment still separates the tokens around it.
+            comment = false;
+            c = ' ';
+        }
+
+        if (quote)
+        {
+            if (c == quote) quote = 0;
+        }
+        else if (c == '\'' || c == '"')
+        {
+            quote = c;
+        }
+        else if (c == '-' && dash)
+        {
+            reader->stmt_len--;
+            dash = false;
+            comment = true;
+            continue;
+        }
+        else if (c == ';')
+        {
+            if (reader->stmt_len > 0) break;
+            continue;
+        }
+
+        // Leading whitespace is dropped, so a blank statement stays empty.
+        if (reader->stmt_len == 0 && isspace((unsigned char)c)) continue;
+        if (!script_append(reader, c)) return ERR_UNKNOWN;
+        dash = !quote && c == '-';
+    }
+
+    if (ferror(reader->in)) return ERR_IO;
+
+    reader->stmt[reader->stmt_len] = '\0';
+    *out_sql = reader->stmt_len > 0 ? reader->stmt : NULL;
+    return OK;
+}
+
+void script_reader_free(ScriptReader* reader)
+{
+    if (!reader) return;
+
+    free(reader->chunk);
+    free(reader->stmt);
+    reader->chunk = NULL;
+    reader->stmt = NULL;
+}
+
+// A non-empty single-quoted token: 'path'
+static bool is_quoted_path(const char* token)
+{
+    size_t len = token ? strlen(token) : 0;
+    return len >= 3 && token[0] == '\'' && token[len - 1] == '\'';
+}
+
 /**
  * Parse an optional WHERE clause.
  *
@@ -382,6 +522,92 @@ static ErrorCode parse_column_definitions(Tokens* t, MDBColumnDef* cols, uint16_
     return OK;
 }
 
+/**
+ * Parse the optional table options after CREATE TABLE's column list.
+ *
+ * Expected format: WITH (option = value, ...)
+ *
+ * Supported options:
+ * - compression = lz | none: store heap pages compressed on disk
+ * - storage = row | column: keep rows in heap pages, or each column in
+ *   its own encoded page chain
+ */
+static ErrorCode parse_table_options(Tokens* t, StmtCreateTable* out)
+{
+    const char* token = tokens_peek(t);
+    if (!token || tokens_ieq(token, "WITH") != 0)
+    {
+        return OK; // No options
+    }
+    tokens_next(t); // Consume "WITH"
+
+    token = tokens_next(t);
+    if (!token || strcmp(token, "(") != 0)
+    {
+        return ERR_PARSE;
+    }
+
+    for (;;)
+    {
+        const char* option = tokens_next(t);
+        const char* eq = tokens_next(t);
+        const char* value = tokens_next(t);
+        if (!option || !eq || strcmp(eq, "=") != 0 || !value)
+        {
+            return ERR_PARSE;
+        }
+
+        if (tokens_ieq(option, "COMPRESSION") == 0)
+        {
+            if (tokens_ieq(value, "LZ") == 0)
+            {
+                out->compressed = true;
+            }
+            else if (tokens_ieq(value, "NONE") == 0)
+            {
+                out->compressed = false;
+            }
+            else
+            {
+                return ERR_PARSE; // Unknown codec
+            }
+        }
+        else if (tokens_ieq(option, "STORAGE") == 0)
+        {
+            if (tokens_ieq(value, "COLUMN") == 0)
+            {
+                out->columnar = true;
+            }
+            else if (tokens_ieq(value, "ROW") == 0)
+            {
+                out->columnar = false;
+            }
+            else
+            {
+                return ERR_PARSE; // Unknown layout
+            }
+        }
+        else
+        {
+            return ERR_PARSE; // Unknown option
+        }
+
+        token = tokens_next(t);
+        if (!token)
+        {
+            return ERR_PARSE;
+        }
+        if (strcmp(token, ")") == 0)
+        {
+            return OK;
+        }
+        if (strcmp(token, ",") != 0)
+        {
+            return ERR_PARSE;
+        }
+    }
+}
+
 /**
  *
  * This is the main entry point for parsing. It examines the first token
@@ -389,15 +615,17 @@ static ErrorCode parse_column_definitions(Tokens* t, MDBColumnDef* cols, uint16_
  * logic for each statement type.
  *
  * Supported statements:
- * - CREATE TABLE name (columns...)
+ * - CREATE TABLE name (columns...) [WITH (compression = lz|none, storage = row|column)]
  * - DROP TABLE name
- * - CREATE INDEX name ON table (column)
+ * - CREATE INDEX name ON table (column) [USING BTREE|HASH]
  * - DROP INDEX name
  * - INSERT INTO table VALUES (values...)
  * - SELECT * FROM table [WHERE condition]
  * - UPDATE table SET assignments... [WHERE condition]
  * - DELETE FROM table [WHERE condition]
  * - LIST TABLES
+ * - BEGIN [TRANSACTION], COMMIT, ROLLBACK
+ * - ANALYZE [table]
  * - HELP
  * - EXIT/QUIT
  */
@@ -436,10 +664,19 @@ ErrorCode parse_statement(const Tokens* tokens, Statement* out_stmt)
 
             out_stmt->kind = STMT_CREATE_TABLE;
             out_stmt->create_table.name = strdup(name);
+            out_stmt->create_table.compressed = false;
+            out_stmt->create_table.columnar = false;
 
             // Parse the column definitions: (col1 type1, col2 type2, ...)
-            return parse_column_definitions(&t, out_stmt->create_table.cols,
-                                            &out_stmt->create_table.ncols);
+            ErrorCode err = parse_column_definitions(&t, out_stmt->create_table.cols,
+                                                     &out_stmt->create_table.ncols);
+            if (err != OK)
+            {
+                return err;
+            }
+
+            // Then any table options: WITH (option = value, ...)
+            return parse_table_options(&t, &out_stmt->create_table);
         }
         else if (tokens_ieq(second, "INDEX") == 0)
         {
@@ -493,11 +730,39 @@ ErrorCode parse_statement(const Tokens* tokens, Statement* out_stmt)
                 return ERR_PARSE;
             }
 
+            // Optional access method: USING BTREE (default) or USING HASH
+            MDBIndexType type = MDB_INDEX_BTREE;
+            const char* using_kw = tokens_peek(&t);
+            if (using_kw && tokens_ieq(using_kw, "USING") == 0)
+            {
+                tokens_next(&t); // Consume "USING"
+
+                const char* method = tokens_next(&t);
+                if (!method)
+                {
+                    return ERR_PARSE;
+                }
+
+                if (tokens_ieq(method, "BTREE") == 0)
+                {
+                    type = MDB_INDEX_BTREE;
+                }
+                else if (tokens_ieq(method, "HASH") == 0)
+                {
+                    type = MDB_INDEX_HASH;
+                }
+                else
+                {
+                    return ERR_PARSE; // Unknown index type
+                }
+            }
+
             out_stmt->kind = STMT_CREATE_INDEX;
             out_stmt->create_index.name = strdup(name);
             out_stmt->create_index.table_name = strdup(table_name);
             out_stmt->create_index.col_idx = (uint16_t)col_idx;
             out_stmt->create_index.is_unique = false; // Default to non-unique
+            out_stmt->create_index.type = type;
 
             return OK;
         }
@@ -742,6 +1007,75 @@ ErrorCode parse_statement(const Tokens* tokens, Statement* out_stmt)
         out_stmt->kind = STMT_LIST_TABLES;
         return OK;
     }
+    else if (tokens_ieq(first, "BEGIN") == 0)
+    {
+        tokens_next(&t);
+
+        // Optional TRANSACTION keyword
+        const char* second = tokens_peek(&t);
+        if (second && tokens_ieq(second, "TRANSACTION") == 0) tokens_next(&t);
+        if (tokens_peek(&t)) return ERR_PARSE;
+
+        out_stmt->kind = STMT_BEGIN;
+        return OK;
+    }
+    else if (tokens_ieq(first, "COMMIT") == 0)
+    {
+        tokens_next(&t);
+        if (tokens_peek(&t)) return ERR_PARSE;
+
+        out_stmt->kind = STMT_COMMIT;
+        return OK;
+    }
+    else if (tokens_ieq(first, "ROLLBACK") == 0)
+    {
+        tokens_next(&t);
+        if (tokens_peek(&t)) return ERR_PARSE;
+
+        out_stmt->kind = STMT_ROLLBACK;
+        return OK;
+    }
+    else if (tokens_ieq(first, "ANALYZE") == 0)
+    {
+        tokens_next(&t);
+
+        // Optional table name; without one every table is analyzed
+        const char* name = tokens_next(&t);
+        if (tokens_peek(&t)) return ERR_PARSE;
+
+        out_stmt->kind = STMT_ANALYZE;
+        out_stmt->analyze.table_name = name ? strdup(name) : NULL;
+        return OK;
+    }
+    else if (tokens_ieq(first, "BACKUP") == 0)
+    {
+        tokens_next(&t);
+        if (tokens_ieq(tokens_next(&t), "TO") != 0) return ERR_PARSE;
+
+        // BACKUP TO 'path' [SINCE 'base']
+        const char* path = tokens_next(&t);
+        const char* base = NULL;
+        if (tokens_peek(&t))
+        {
+            if (tokens_ieq(tokens_next(&t), "SINCE") != 0) return ERR_PARSE;
+            base = tokens_next(&t);
+            if (!base || tokens_peek(&t)) return ERR_PARSE;
+        }
+        if (!is_quoted_path(path) || (base && !is_quoted_path(base))) return ERR_PARSE;
+
+        out_stmt->kind = STMT_BACKUP;
+        out_stmt->backup.path = strndup(path + 1, strlen(path) - 2);
+        out_stmt->backup.base = base ? strndup(base + 1, strlen(base) - 2) : NULL;
+        return out_stmt->backup.path && (!base || out_stmt->backup.base) ? OK : ERR_UNKNOWN;
+    }
+    else if (tokens_ieq(first, "STATS") == 0)
+    {
+        tokens_next(&t);
+        if (tokens_peek(&t)) return ERR_PARSE;
+
+        out_stmt->kind = STMT_STATS;
+        return OK;
+    }
     else if (tokens_ieq(first, "HELP") == 0)
     {
         out_stmt->kind = STMT_HELP;
@@ -842,7 +1176,18 @@ void free_statement(Statement* stmt)
             free((char*)stmt->update_.where.value.text.ptr);
         }
         break;
+    case STMT_ANALYZE:
+        free((char*)stmt->analyze.table_name);
+        break;
+    case STMT_BACKUP:
+        free((char*)stmt->backup.path);
+        free((char*)stmt->backup.base);
+        break;
     case STMT_LIST_TABLES:
+    case STMT_BEGIN:
+    case STMT_COMMIT:
+    case STMT_ROLLBACK:
+    case STMT_STATS:
     case STMT_HELP:
     case STMT_EXIT:
         // No resources to free
@@ -852,6 +1197,356 @@ void free_statement(Statement* stmt)
     }
 }
 
+/**
+ * Append a data change to the WAL.
+ *
+ * The payload is the NUL-terminated table name followed by the encoded
+ * row values. Outside an explicit transaction mdb_log commits (and
+ * fsyncs) right away; inside one the record waits for COMMIT.
+ */
+static ErrorCode log_change(MiniDB* db, MDBWalOpType type, const char* table_name,
+                            const MDBValue* values, uint16_t nvalues)
+{
+    uint16_t row_size = mdb_row_encoded_size(values, nvalues);
+    if (row_size == 0) return ERR_FULL;
+
+    size_t name_len = strlen(table_name) + 1;
+    uint8_t* payload = malloc(name_len + row_size);
+    if (!payload) return ERR_UNKNOWN;
+
+    memcpy(payload, table_name, name_len);
+    mdb_row_encode(values, nvalues, payload + name_len, row_size, &row_size);
+
+    MDBWalRecord record = {.type = type, .size = (uint32_t)(name_len + row_size)};
+    ErrorCode err = mdb_log(db, &record, payload);
+
+    free(payload);
+    return err;
+}
+
+/**
+ * Append a value to a cache key. Every value carries a type tag and TEXT
+ * its length, so different statements can never render to the same key.
+ */
+static void key_append_value(char* key, size_t* len, const MDBValue* v)
+{
+    if (v->is_null)
+    {
+        *len += sprintf(key + *len, "n");
+    }
+    else if (v->type == COL_TYPE_INT)
+    {
+        *len += sprintf(key + *len, "i%lld", (long long)v->integer);
+    }
+    else
+    {
+        *len += sprintf(key + *len, "t%u:", v->text.length);
+        memcpy(key + *len, v->text.ptr, v->text.length);
+        *len += v->text.length;
+        key[*len] = '\0';
+    }
+}
+
+/**
+ * Build the result-cache key for a statement from its parsed form, so
+ * "select * from t" and "SELECT  *  FROM t" share an entry. Returns NULL
+ * for statements whose results aren't cached; the caller frees the key.
+ */
+char* statement_cache_key(const Statement* stmt)
+{
+    if (!stmt || stmt->kind != STMT_SELECT) return NULL;
+
+    const StmtSelect* select = &stmt->select_;
+    const MDBValue* v = &select->where.value;
+    size_t text_len = !v->is_null && v->type == COL_TYPE_TEXT ? v->text.length : 0;
+
+    char* key = malloc(strlen(select->table_name) + text_len + 64);
+    if (!key) return NULL;
+
+    size_t len = (size_t)sprintf(key, "SELECT|%s", select->table_name);
+    if (select->where.has_pred)
+    {
+        len += sprintf(key + len, "|WHERE %u %d ", select->where.col, (int)select->where.op);
+        key_append_value(key, &len, v);
+    }
+    return key;
+}
+
+/**
+ * Hand one result row to the caller's sink, or print it to `out` as
+ * " | "-separated text when there is none.
+ */
+ErrorCode emit_row(const RowSink* rows, FILE* out, const MDBValue* cols,
+                   uint16_t ncols)
+{
+    if (!cols && ncols > 0) return ERR_INVALID;
+    if (rows && rows->row) return rows->row(rows->ctx, cols, ncols);
+    if (!out) return ERR_INVALID;
+
+    for (uint16_t c = 0; c < ncols; c++)
+    {
+        const MDBValue* v = &cols[c];
+        if (c > 0) fputs(" | ", out);
+
+        if (v->is_null)
+        {
+            fputs("NULL", out);
+        }
+        else if (v->type == COL_TYPE_INT)
+        {
+            fprintf(out, "%lld", (long long)v->integer);
+        }
+        else
+        {
+            fwrite(v->text.ptr, 1, v->text.length, out);
+        }
+    }
+    fputc('\n', out);
+    return OK;
+}
+
+/**
+ * Run a SELECT, serving it from the result cache when one is enabled.
+ *
+ * Inside an explicit transaction the cache is bypassed: results there can
+ * include the transaction's own uncommitted writes. So is it when rows go
+ * to a sink, since only text output is cached.
+ */
+static ErrorCode execute_select(MiniDB* db, const Statement* stmt, FILE* out,
+                                const RowSink* rows)
+{
+    const StmtSelect* select = &stmt->select_;
+    MDBResultCache* cache = mdb_in_transaction(db) || rows ? NULL : mdb_result_cache(db);
+    char* key = cache ? statement_cache_key(stmt) : NULL;
+
+    uint8_t* cached;
+    size_t cached_len;
+    if (key && mdb_result_cache_get(cache, key, select->table_name, &cached, &cached_len))
+    {
+        fwrite(cached, 1, cached_len, out);
+        free(cached);
+        free(key);
+        return OK;
+    }
+
+    // Taken before running the query, so a concurrent write keeps the
+    // result out of the cache.
+    uint64_t version = mdb_result_cache_version(cache, select->table_name);
+
+    char where[64] = "";
+    if (select->where.has_pred)
+    {
+        snprintf(where, sizeof(where), " with WHERE clause on column %d", select->where.col);
+    }
+
+    int len = snprintf(NULL, 0, "Selecting from table '%s'%s\n", select->table_name, where);
+    char* result = malloc((size_t)len + 1);
+    if (!result)
+    {
+        free(key);
+        return ERR_UNKNOWN;
+    }
+    snprintf(result, (size_t)len + 1, "Selecting from table '%s'%s\n", select->table_name, where);
+    // TODO: Implement actual row selection
+
+    fwrite(result, 1, (size_t)len, out);
+    if (key) mdb_result_cache_put(cache, key, select->table_name, version, (const uint8_t*)result, (size_t)len);
+
+    free(result);
+    free(key);
+    return OK;
+}
+
+/**
+ * Feed the row versions of a heap table that no transaction has deleted
+ * into `builders`, one per column. Every heap page of the table carries
+ * the table id found on its root page.
+ */
+static ErrorCode analyze_heap(MiniDB* db, MDBPageNumber root, uint16_t ncols,
+                              MDBStatsBuilder** builders)
+{
+    MDBPage page;
+    ErrorCode err = mdb_page_read(db, root, &page);
+    if (err != OK) return err;
+
+    MDBHeapHeader h;
+    memcpy(&h, page.data, sizeof(h));
+    if (h.type != PG_HEAP) return ERR_CORRUPT;
+    uint32_t table_id = h.table_id;
+
+    MDBValue* vals = malloc(sizeof(MDBValue) * ncols);
+    if (!vals) return ERR_UNKNOWN;
+
+    MDBPageScan scan;
+    mdb_page_scan_begin(db, 1, mdb_page_count(db), 0, &scan);
+    while (err == OK && mdb_page_scan_next(&scan, &page, NULL))
+    {
+        memcpy(&h, page.data, sizeof(h));
+        if (h.type != PG_HEAP || h.table_id != table_id) continue;
+
+        MDBHeapIter it;
+        mdb_heap_iter_init(&it);
+        const uint8_t* record;
+        uint16_t size;
+        while (err == OK && mdb_heap_page_iter_next(&page, &it, NULL, &record, &size))
+        {
+            MDBTupleHeader tuple;
+            uint16_t n;
+            if (size < sizeof(tuple) ||
+                !mdb_row_decode(record + sizeof(tuple), size - sizeof(tuple), vals, ncols, &n))
+            {
+                err = ERR_CORRUPT;
+                break;
+            }
+            memcpy(&tuple, record, sizeof(tuple));
+            if (tuple.xmax != MDB_TXN_INVALID) continue;
+
+            // Columns added after the row was written read as NULL.
+            for (uint16_t c = 0; c < ncols; c++)
+            {
+                MDBValue v = c < n ? vals[c] : mdb_value_null();
+                mdb_stats_builder_add(builders[c], &v);
+            }
+        }
+    }
+    if (err == OK) err = scan.err;
+
+    free(vals);
+    return err;
+}
+
+static ErrorCode analyze_column(MiniDB* db, MDBPageNumber root, MDBStatsBuilder* builder)
+{
+    if (root == 0) return OK;
+
+    MDBColumnScan scan;
+    ErrorCode err = mdb_column_scan_open(db, root, &scan);
+    if (err != OK) return err;
+
+    const MDBValue* values;
+    uint32_t count;
+    while (mdb_column_scan_next(&scan, &values, &count))
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            mdb_stats_builder_add(builder, &values[i]);
+        }
+    }
+    err = scan.err;
+    mdb_column_scan_close(&scan);
+    return err;
+}
+
+/**
+ * Summarise every column of one table and store the results in the
+ * catalog. Columnar tables are read from their column chains, heap
+ * tables from their heap pages.
+ */
+static ErrorCode analyze_table(MiniDB* db, MDBCatalog* catalog,
+                               const MDBCatalogTableMetadata* meta,
+                               uint64_t* out_rows)
+{
+    MDBStatsBuilder** builders = calloc(meta->ncols ? meta->ncols : 1, sizeof(MDBStatsBuilder*));
+    if (!builders) return ERR_UNKNOWN;
+
+    ErrorCode err = OK;
+    for (uint16_t c = 0; err == OK && c < meta->ncols; c++)
+    {
+        MDBCatalogColumn col;
+        err = mdb_catalog_get_column(catalog, meta->name, c, &col);
+        if (err == OK) err = mdb_stats_builder_create(col.type, &builders[c]);
+    }
+
+    if (meta->flags & MDB_TABLE_COLUMNAR)
+    {
+        for (uint16_t c = 0; err == OK && c < meta->ncols; c++)
+        {
+            MDBPageNumber root;
+            err = mdb_catalog_get_column_root(catalog, meta->name, c, &root);
+            if (err == OK) err = analyze_column(db, root, builders[c]);
+        }
+    }
+    else if (err == OK && meta->heap_root != 0)
+    {
+        err = analyze_heap(db, meta->heap_root, meta->ncols, builders);
+    }
+
+    *out_rows = 0;
+    for (uint16_t c = 0; err == OK && c < meta->ncols; c++)
+    {
+        MDBColumnStats stats;
+        mdb_stats_builder_finish(builders[c], &stats);
+        err = mdb_catalog_set_column_stats(catalog, meta->name, c, &stats);
+        if (stats.row_count > *out_rows) *out_rows = stats.row_count;
+    }
+
+    for (uint16_t c = 0; c < meta->ncols; c++)
+    {
+        mdb_stats_builder_destroy(builders[c]);
+    }
+    free(builders);
+    return err;
+}
+
+/**
+ * Gather column statistics for the named table, or for every table, so
+ * the planner can cost access paths from them.
+ */
+static ErrorCode execute_analyze(MiniDB* db, const Statement* stmt, FILE* out)
+{
+    MDBCatalog* catalog;
+    ErrorCode err = mdb_catalog_open(db, &catalog);
+    if (err != OK) return err;
+
+    MDBCatalogTableMetadata* tables = NULL;
+    uint32_t ntables = 0;
+    if (stmt->analyze.table_name)
+    {
+        tables = malloc(sizeof(MDBCatalogTableMetadata));
+        ntables = 1;
+        err = tables ? mdb_catalog_get(catalog, stmt->analyze.table_name, tables) : ERR_UNKNOWN;
+    }
+    else
+    {
+        err = mdb_catalog_list_tables(catalog, &tables, &ntables);
+    }
+
+    for (uint32_t i = 0; err == OK && i < ntables; i++)
+    {
+        uint64_t rows;
+        err = analyze_table(db, catalog, &tables[i], &rows);
+        if (err == OK) fprintf(out, "Analyzed table '%s': %llu rows\n", tables[i].name, (unsigned long long)rows);
+    }
+
+    free(tables);
+    mdb_catalog_close(catalog);
+    return err;
+}
+
+// Names for STATS output, indexed by StmtKind.
+static const char* const stmt_kind_names[] = {
+    [STMT_LIST_TABLES] = "list_tables",
+    [STMT_CREATE_TABLE] = "create_table",
+    [STMT_DROP_TABLE] = "drop_table",
+    [STMT_INSERT] = "insert",
+    [STMT_SELECT] = "select",
+    [STMT_DELETE] = "delete",
+    [STMT_UPDATE] = "update",
+    [STMT_CREATE_INDEX] = "create_index",
+    [STMT_DROP_INDEX] = "drop_index",
+    [STMT_BEGIN] = "begin",
+    [STMT_COMMIT] = "commit",
+    [STMT_ROLLBACK] = "rollback",
+    [STMT_ANALYZE] = "analyze",
+    [STMT_STATS] = "stats",
+    [STMT_BACKUP] = "backup",
+    [STMT_HELP] = "help",
+    [STMT_EXIT] = "exit",
+};
+
+_Static_assert(sizeof(stmt_kind_names) / sizeof(stmt_kind_names[0]) <= MDB_METRICS_STATEMENT_KINDS,
+               "MDB_METRICS_STATEMENT_KINDS is too small for StmtKind");
+
 /**
  * Execute a parsed SQL statement.
  *
@@ -865,107 +1560,186 @@ void free_statement(Statement* stmt)
  * - Query data and return results
  *
  * For now, it serves as a demonstration of the parsing results and
- * provides a framework for future implementation.
+ * provides a framework for future implementation. Data changes are
+ * already written to the WAL, and BEGIN/COMMIT/ROLLBACK control when
+ * they are committed.
+ *
+ * Output goes to `out`: stdout for the REPL, the client's socket for the
+ * server. Result rows go to `rows` if set, and are printed to `out`
+ * otherwise.
  */
-ErrorCode execute_statement(MiniDB* db, const Statement* stmt)
+static ErrorCode run_statement(MiniDB* db, const Statement* stmt, FILE* out,
+                               const RowSink* rows)
 {
-    if (!stmt)
-    {
-        return ERR_INVALID;
-    }
-
-    // Database parameter is unused in placeholder implementation
-    (void)db;
+    ErrorCode err = OK;
 
     switch (stmt->kind)
     {
     case STMT_LIST_TABLES:
-        printf("Listing tables...\n");
+        fprintf(out, "Listing tables...\n");
         // TODO: Implement actual table listing
         break;
 
     case STMT_CREATE_TABLE:
-        printf("Creating table '%s' with %d columns\n",
-               stmt->create_table.name, stmt->create_table.ncols);
+        fprintf(out, "Creating table '%s' with %d columns%s%s\n",
+                stmt->create_table.name, stmt->create_table.ncols,
+                stmt->create_table.compressed ? " (compressed)" : "",
+                stmt->create_table.columnar ? " (columnar)" : "");
         // TODO: Implement actual table creation
+        mdb_result_cache_invalidate(mdb_result_cache(db), stmt->create_table.name);
         break;
 
     case STMT_DROP_TABLE:
-        printf("Dropping table '%s'\n", stmt->drop_table.name);
+        fprintf(out, "Dropping table '%s'\n", stmt->drop_table.name);
         // TODO: Implement actual table dropping
+        mdb_result_cache_invalidate(mdb_result_cache(db), stmt->drop_table.name);
         break;
 
     case STMT_CREATE_INDEX:
-        printf("Creating index '%s' on table '%s' column %d\n",
-               stmt->create_index.name, stmt->create_index.table_name,
-               stmt->create_index.col_idx);
+        fprintf(out, "Creating %s index '%s' on table '%s' column %d\n",
+                stmt->create_index.type == MDB_INDEX_HASH ? "hash" : "btree",
+                stmt->create_index.name, stmt->create_index.table_name,
+                stmt->create_index.col_idx);
         // TODO: Implement actual index creation
         break;
 
     case STMT_DROP_INDEX:
-        printf("Dropping index '%s'\n", stmt->drop_index.name);
+        fprintf(out, "Dropping index '%s'\n", stmt->drop_index.name);
         // TODO: Implement actual index dropping
         break;
 
     case STMT_INSERT:
-        printf("Inserting %d values into table '%s'\n",
-               stmt->insert_.nvalues, stmt->insert_.table_name);
+        fprintf(out, "Inserting %d values into table '%s'\n",
+                stmt->insert_.nvalues, stmt->insert_.table_name);
         // TODO: Implement actual row insertion
+        err = log_change(db, WAL_OP_INSERT, stmt->insert_.table_name,
+                         stmt->insert_.values, stmt->insert_.nvalues);
+        mdb_result_cache_invalidate(mdb_result_cache(db), stmt->insert_.table_name);
         break;
 
     case STMT_SELECT:
-        printf("Selecting from table '%s'", stmt->select_.table_name);
-        if (stmt->select_.where.has_pred)
-        {
-            printf(" with WHERE clause on column %d", stmt->select_.where.col);
-        }
-        printf("\n");
-        // TODO: Implement actual row selection
+        err = execute_select(db, stmt, out, rows);
         break;
 
     case STMT_DELETE:
-        printf("Deleting from table '%s'", stmt->delete_.table_name);
+        fprintf(out, "Deleting from table '%s'", stmt->delete_.table_name);
         if (stmt->delete_.where.has_pred)
         {
-            printf(" with WHERE clause on column %d", stmt->delete_.where.col);
+            fprintf(out, " with WHERE clause on column %d", stmt->delete_.where.col);
         }
-        printf("\n");
+        fprintf(out, "\n");
         // TODO: Implement actual row deletion
+        err = log_change(db, WAL_OP_DELETE, stmt->delete_.table_name,
+                         &stmt->delete_.where.value, stmt->delete_.where.has_pred ? 1 : 0);
+        mdb_result_cache_invalidate(mdb_result_cache(db), stmt->delete_.table_name);
         break;
 
     case STMT_UPDATE:
-        printf("Updating table '%s' with %d values",
-               stmt->update_.table_name, stmt->update_.nvalues);
+        fprintf(out, "Updating table '%s' with %d values",
+                stmt->update_.table_name, stmt->update_.nvalues);
         if (stmt->update_.where.has_pred)
         {
-            printf(" with WHERE clause on column %d", stmt->update_.where.col);
+            fprintf(out, " with WHERE clause on column %d", stmt->update_.where.col);
         }
-        printf("\n");
+        fprintf(out, "\n");
         // TODO: Implement actual row updating
+        err = log_change(db, WAL_OP_UPDATE, stmt->update_.table_name,
+                         stmt->update_.values, stmt->update_.nvalues);
+        mdb_result_cache_invalidate(mdb_result_cache(db), stmt->update_.table_name);
+        break;
+
+    case STMT_BEGIN:
+        err = mdb_begin(db);
+        if (err == OK) fprintf(out, "BEGIN\n");
+        break;
+
+    case STMT_COMMIT:
+        err = mdb_commit(db);
+        if (err == OK) fprintf(out, "COMMIT\n");
+        break;
+
+    case STMT_ROLLBACK:
+        err = mdb_rollback(db);
+        if (err == OK) fprintf(out, "ROLLBACK\n");
+        break;
+
+    case STMT_ANALYZE:
+        err = execute_analyze(db, stmt, out);
+        break;
+
+    case STMT_BACKUP:
+        err = execute_backup(db, stmt, out, NULL);
+        break;
+
+    case STMT_STATS:
+        err = mdb_metrics_dump(out, stmt_kind_names,
+                               sizeof(stmt_kind_names) / sizeof(stmt_kind_names[0]));
         break;
 
     case STMT_HELP:
-        printf("Available commands:\n");
-        printf("  CREATE TABLE name (col1 type1, col2 type2, ...)\n");
-        printf("  DROP TABLE name\n");
-        printf("  CREATE INDEX name ON table (column_index)\n");
-        printf("  DROP INDEX name\n");
-        printf("  INSERT INTO table VALUES (val1, val2, ...)\n");
-        printf("  SELECT * FROM table [WHERE col = value]\n");
-        printf("  UPDATE table SET col1 = val1 [WHERE col = value]\n");
-        printf("  DELETE FROM table [WHERE col = value]\n");
-        printf("  LIST TABLES\n");
-        printf("  HELP\n");
-        printf("  EXIT\n");
+        fprintf(out, "Available commands:\n");
+        fprintf(out, "  CREATE TABLE name (col1 type1, col2 type2, ...) [WITH (compression = lz, storage = column)]\n");
+        fprintf(out, "  DROP TABLE name\n");
+        fprintf(out, "  CREATE INDEX name ON table (column_index) [USING BTREE|HASH]\n");
+        fprintf(out, "  DROP INDEX name\n");
+        fprintf(out, "  INSERT INTO table VALUES (val1, val2, ...)\n");
+        fprintf(out, "  SELECT * FROM table [WHERE col = value]\n");
+        fprintf(out, "  UPDATE table SET col1 = val1 [WHERE col = value]\n");
+        fprintf(out, "  DELETE FROM table [WHERE col = value]\n");
+        fprintf(out, "  LIST TABLES\n");
+        fprintf(out, "  BEGIN, COMMIT, ROLLBACK\n");
+        fprintf(out, "  ANALYZE [table]\n");
+        fprintf(out, "  STATS\n");
+        fprintf(out, "  BACKUP TO 'path' [SINCE 'base']\n");
+        fprintf(out, "  HELP\n");
+        fprintf(out, "  EXIT\n");
         break;
 
     case STMT_EXIT:
-        printf("Goodbye!\n");
+        fprintf(out, "Goodbye!\n");
         return ERR_UNSUPPORTED; // Signal to exit the REPL
 
     default:
         return ERR_UNSUPPORTED;
     }
 
-    return OK;
+    return err;
+}
+
+/**
+ * Copy the database, or with SINCE what changed after the base backup, to
+ * the statement's path while statements holding `writer_lock` keep
+ * running (NULL if none can run meanwhile).
+ */
+ErrorCode execute_backup(MiniDB* db, const Statement* stmt, FILE* out,
+                         pthread_mutex_t* writer_lock)
+{
+    if (!db || !stmt || stmt->kind != STMT_BACKUP || !out) return ERR_INVALID;
+
+    MDBBackupStats stats;
+    ErrorCode err = mdb_backup(db, stmt->backup.path, stmt->backup.base, writer_lock, &stats);
+    if (err == OK)
+    {
+        fprintf(out, "Backed up %u of %u pages and %llu WAL bytes to '%s' up to LSN %llu (%u pages recopied)\n",
+                stats.copied - stats.recopied, stats.pages, (unsigned long long)stats.wal_bytes,
+                stmt->backup.path, (unsigned long long)stats.lsn, stats.recopied);
+    }
+    return err;
+}
+
+/**
+ * Run one statement and record how long it took under its kind.
+ */
+ErrorCode execute_statement(MiniDB* db, const Statement* stmt, FILE* out,
+                            const RowSink* rows)
+{
+    if (!db || !stmt || !out)
+    {
+        return ERR_INVALID;
+    }
+
+    uint64_t start = mdb_metrics_now();
+    ErrorCode err = run_statement(db, stmt, out, rows);
+    mdb_metrics_record(MDB_LATENCY_STATEMENT + stmt->kind, mdb_metrics_now() - start);
+    return err;
 }
@@ -0,0 +1,160 @@
+#include "row.h"
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Encoded row layout:
+ *
+ *   [uint16 ncols] then for each column [uint8 type][data]
+ *
+ * where data is nothing for NULL, an int64 for COL_TYPE_INT, and
+ * [uint16 length][bytes] for COL_TYPE_TEXT. Decoded text values point
+ * straight into the buffer, so the buffer must outlive them.
+ *
+ * A TEXT value moved to overflow pages is tagged COL_TYPE_TEXT |
+ * MDB_ROW_EXTERNAL and stored as
+ *
+ *   [uint16 full length][uint32 first overflow page][uint16 length][prefix]
+ *
+ * so the row keeps a short inline prefix and the rest is only read when
+ * someone asks for it (see overflow.c).
+ */
+
+#define EXTERNAL_REF_SIZE (sizeof(uint16_t) + sizeof(uint32_t))
+
+static uint32_t value_encoded_size(const MDBValue* v)
+{
+    uint32_t size = sizeof(uint8_t);
+    if (v->is_null) return size;
+
+    switch (v->type)
+    {
+    case COL_TYPE_INT:
+        return size + sizeof(int64_t);
+    case COL_TYPE_TEXT:
+        if (mdb_value_is_external(v)) size += EXTERNAL_REF_SIZE;
+        return size + sizeof(uint16_t) + v->text.length;
+    default:
+        return size;
+    }
+}
+
+/**
+ * Returns 0 if the row would not fit in a uint16 size.
+ */
+uint16_t mdb_row_encoded_size(const MDBValue* cols, uint16_t ncols)
+{
+    uint32_t size = sizeof(uint16_t);
+    for (uint16_t i = 0; i < ncols; i++)
+    {
+        size += value_encoded_size(&cols[i]);
+    }
+    return size > UINT16_MAX ? 0 : (uint16_t)size;
+}
+
+bool mdb_row_encode(const MDBValue* cols, uint16_t ncols, uint8_t* buffer,
+                    uint16_t cap, uint16_t* out_size)
+{
+    if ((!cols && ncols > 0) || !buffer || !out_size) return false;
+
+    uint16_t size = mdb_row_encoded_size(cols, ncols);
+    if (size == 0 || size > cap) return false;
+
+    uint8_t* p = buffer;
+    memcpy(p, &ncols, sizeof(uint16_t));
+    p += sizeof(uint16_t);
+
+    for (uint16_t i = 0; i < ncols; i++)
+    {
+        const MDBValue* v = &cols[i];
+        uint8_t type = v->is_null ? COL_TYPE_INVALID : (uint8_t)v->type;
+        *p++ = mdb_value_is_external(v) ? type | MDB_ROW_EXTERNAL : type;
+
+        if (type == COL_TYPE_INT)
+        {
+            memcpy(p, &v->integer, sizeof(int64_t));
+            p += sizeof(int64_t);
+        }
+        else if (type == COL_TYPE_TEXT)
+        {
+            if (mdb_value_is_external(v))
+            {
+                memcpy(p, &v->overflow.length, sizeof(uint16_t));
+                p += sizeof(uint16_t);
+                memcpy(p, &v->overflow.first_page, sizeof(uint32_t));
+                p += sizeof(uint32_t);
+            }
+            memcpy(p, &v->text.length, sizeof(uint16_t));
+            p += sizeof(uint16_t);
+            memcpy(p, v->text.ptr, v->text.length);
+            p += v->text.length;
+        }
+    }
+
+    *out_size = size;
+    return true;
+}
+
+bool mdb_row_decode(const uint8_t* buffer, uint16_t size, MDBValue* out_cols,
+                    uint16_t max_cols, uint16_t* out_ncols)
+{
+    if (!buffer || !out_cols || !out_ncols) return false;
+    if (size < sizeof(uint16_t)) return false;
+
+    const uint8_t* p = buffer;
+    const uint8_t* end = buffer + size;
+
+    uint16_t ncols;
+    memcpy(&ncols, p, sizeof(uint16_t));
+    p += sizeof(uint16_t);
+    if (ncols > max_cols) return false;
+
+    for (uint16_t i = 0; i < ncols; i++)
+    {
+        if (p >= end) return false;
+        uint8_t type = *p++;
+
+        MDBOverflowRef overflow = {0, 0};
+        if (type == (COL_TYPE_TEXT | MDB_ROW_EXTERNAL))
+        {
+            if (end - p < (ptrdiff_t)EXTERNAL_REF_SIZE) return false;
+            memcpy(&overflow.length, p, sizeof(uint16_t));
+            p += sizeof(uint16_t);
+            memcpy(&overflow.first_page, p, sizeof(uint32_t));
+            p += sizeof(uint32_t);
+            if (overflow.first_page == 0) return false;
+            type = COL_TYPE_TEXT;
+        }
+
+        if (type == COL_TYPE_INVALID)
+        {
+            out_cols[i] = mdb_value_null();
+        }
+        else if (type == COL_TYPE_INT)
+        {
+            if (end - p < (ptrdiff_t)sizeof(int64_t)) return false;
+            int64_t x;
+            memcpy(&x, p, sizeof(int64_t));
+            p += sizeof(int64_t);
+            out_cols[i] = mdb_value_int(x);
+        }
+        else if (type == COL_TYPE_TEXT)
+        {
+            if (end - p < (ptrdiff_t)sizeof(uint16_t)) return false;
+            uint16_t len;
+            memcpy(&len, p, sizeof(uint16_t));
+            p += sizeof(uint16_t);
+            if (end - p < len) return false;
+            out_cols[i] = mdb_value_text((const char*)p, len);
+            out_cols[i].overflow = overflow;
+            p += len;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    *out_ncols = ncols;
+    return true;
+}
@@ -0,0 +1,383 @@
+#include "rowbatch.h"
+#include "byteorder.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Column-batched result rows.
+ *
+ * Results sent to binary clients are not formatted as text. Rows are
+ * gathered into a batch and sent column by column, so a client reads a
+ * whole column of INTs as one array of fixed-width values and converts
+ * (or doesn't) as it likes. Layout, all integers little endian:
+ *
+ *   u16 ncols, u32 nrows
+ *   per column:
+ *     u8  type         COL_TYPE_INVALID if every value is NULL
+ *     u32 size         bytes of this column after this field
+ *     null bitmap      (nrows + 7) / 8 bytes, bit set = NULL
+ *     INT:  i64 per row (0 for NULL)
+ *     TEXT: u32 length per row (0 for NULL), then the bytes back to back
+ *
+ * The per-column size lets a reader jump straight to the column it
+ * wants. A column's type is that of its first non-NULL value; a value of
+ * another type doesn't fit the batch and the caller starts a new one.
+ */
+
+#define BATCH_HEADER_SIZE 6
+#define COLUMN_HEADER_SIZE 5
+#define INITIAL_ROWS 64
+
+typedef struct
+{
+    MDBColumnType type;
+    uint8_t* nulls;
+    uint64_t* fixed; // INT: the value, TEXT: the length
+    char* text;
+    size_t text_len;
+    size_t text_cap;
+} BatchColumn;
+
+struct MDBRowBatch
+{
+    uint16_t ncols;
+    uint32_t nrows;
+    uint32_t cap;
+    BatchColumn* cols;
+};
+
+static size_t bitmap_size(uint32_t nrows)
+{
+    return ((size_t)nrows + 7) / 8;
+}
+
+ErrorCode mdb_row_batch_create(uint16_t ncols, MDBRowBatch** out_batch)
+{
+    if (ncols == 0 || !out_batch) return ERR_INVALID;
+
+    MDBRowBatch* batch = calloc(1, sizeof(MDBRowBatch));
+    if (!batch) return ERR_UNKNOWN;
+
+    batch->cols = calloc(ncols, sizeof(BatchColumn));
+    if (!batch->cols)
+    {
+        free(batch);
+        return ERR_UNKNOWN;
+    }
+    batch->ncols = ncols;
+
+    *out_batch = batch;
+    return OK;
+}
+
+void mdb_row_batch_destroy(MDBRowBatch* batch)
+{
+    if (!batch) return;
+
+    for (uint16_t c = 0; c < batch->ncols; c++)
+    {
+        free(batch->cols[c].nulls);
+        free(batch->cols[c].fixed);
+        free(batch->cols[c].text);
+    }
+    free(batch->cols);
+    free(batch);
+}
+
+/**
+ * Empty the batch for reuse, keeping its memory. Column types are
+ * forgotten too.
+ */
+void mdb_row_batch_reset(MDBRowBatch* batch)
+{
+    if (!batch) return;
+
+    for (uint16_t c = 0; c < batch->ncols; c++)
+    {
+        BatchColumn* col = &batch->cols[c];
+        col->type = COL_TYPE_INVALID;
+        col->text_len = 0;
+        if (col->nulls) memset(col->nulls, 0, bitmap_size(batch->cap));
+    }
+    batch->nrows = 0;
+}
+
+static ErrorCode grow_rows(MDBRowBatch* batch)
+{
+    if (batch->nrows < batch->cap) return OK;
+
+    uint32_t cap = batch->cap ? batch->cap * 2 : INITIAL_ROWS;
+    for (uint16_t c = 0; c < batch->ncols; c++)
+    {
+        BatchColumn* col = &batch->cols[c];
+
+        uint8_t* nulls = realloc(col->nulls, bitmap_size(cap));
+        if (!nulls) return ERR_UNKNOWN;
+        memset(nulls + bitmap_size(batch->cap), 0, bitmap_size(cap) - bitmap_size(batch->cap));
+        col->nulls = nulls;
+
+        uint64_t* fixed = realloc(col->fixed, sizeof(uint64_t) * cap);
+        if (!fixed) return ERR_UNKNOWN;
+        col->fixed = fixed;
+    }
+    batch->cap = cap;
+    return OK;
+}
+
+static ErrorCode reserve_text(BatchColumn* col, uint16_t len)
+{
+    if (col->text_len + len <= col->text_cap) return OK;
+
+    size_t cap = col->text_cap ? col->text_cap : 256;
+    while (cap < col->text_len + len)
+    {
+        cap *= 2;
+    }
+    char* text = realloc(col->text, cap);
+    if (!text) return ERR_UNKNOWN;
+    col->text = text;
+    col->text_cap = cap;
+    return OK;
+}
+
+/**
+ * Add one row. ERR_INVALID if the row has the wrong number of columns, a
+ * value whose type differs from its column's, or a TEXT value still in
+ * overflow pages (resolve it first); the batch is unchanged.
+ */
+ErrorCode mdb_row_batch_append(MDBRowBatch* batch, const MDBValue* cols,
+                               uint16_t ncols)
+{
+    if (!batch || !cols || ncols != batch->ncols) return ERR_INVALID;
+
+    for (uint16_t c = 0; c < ncols; c++)
+    {
+        const MDBValue* v = &cols[c];
+        if (v->is_null) continue;
+        if (v->type != COL_TYPE_INT && v->type != COL_TYPE_TEXT) return ERR_INVALID;
+        if (mdb_value_is_external(v)) return ERR_INVALID;
+        if (batch->cols[c].type != COL_TYPE_INVALID && batch->cols[c].type != v->type) return ERR_INVALID;
+    }
+
+    ErrorCode err = grow_rows(batch);
+    for (uint16_t c = 0; err == OK && c < ncols; c++)
+    {
+        if (cols[c].is_null || cols[c].type != COL_TYPE_TEXT) continue;
+        err = reserve_text(&batch->cols[c], cols[c].text.length);
+    }
+    if (err != OK) return err;
+
+    uint32_t row = batch->nrows;
+    for (uint16_t c = 0; c < ncols; c++)
+    {
+        const MDBValue* v = &cols[c];
+        BatchColumn* col = &batch->cols[c];
+
+        if (v->is_null)
+        {
+            col->nulls[row / 8] |= (uint8_t)(1u << (row % 8));
+            col->fixed[row] = 0;
+            continue;
+        }
+
+        col->type = v->type;
+        if (v->type == COL_TYPE_INT)
+        {
+            col->fixed[row] = (uint64_t)v->integer;
+            continue;
+        }
+
+        memcpy(col->text + col->text_len, v->text.ptr, v->text.length);
+        col->text_len += v->text.length;
+        col->fixed[row] = v->text.length;
+    }
+
+    batch->nrows++;
+    return OK;
+}
+
+uint16_t mdb_row_batch_ncols(const MDBRowBatch* batch)
+{
+    return batch ? batch->ncols : 0;
+}
+
+uint32_t mdb_row_batch_nrows(const MDBRowBatch* batch)
+{
+    return batch ? batch->nrows : 0;
+}
+
+static size_t column_size(const BatchColumn* col, uint32_t nrows)
+{
+    size_t size = bitmap_size(nrows);
+    if (col->type == COL_TYPE_INT) size += (size_t)nrows * 8;
+    if (col->type == COL_TYPE_TEXT) size += (size_t)nrows * 4 + col->text_len;
+    return size;
+}
+
+size_t mdb_row_batch_encoded_size(const MDBRowBatch* batch)
+{
+    if (!batch) return 0;
+
+    size_t size = BATCH_HEADER_SIZE;
+    for (uint16_t c = 0; c < batch->ncols; c++)
+    {
+        size += COLUMN_HEADER_SIZE + column_size(&batch->cols[c], batch->nrows);
+    }
+    return size;
+}
+
+ErrorCode mdb_row_batch_encode(const MDBRowBatch* batch, uint8_t* buffer,
+                               size_t cap, size_t* out_size)
+{
+    if (!batch || !buffer || !out_size) return ERR_INVALID;
+
+    size_t size = mdb_row_batch_encoded_size(batch);
+    if (size > cap) return ERR_FULL;
+
+    uint8_t* p = buffer;
+    mdb_put_u16(p, batch->ncols);
+    mdb_put_u32(p + 2, batch->nrows);
+    p += BATCH_HEADER_SIZE;
+
+    for (uint16_t c = 0; c < batch->ncols; c++)
+    {
+        const BatchColumn* col = &batch->cols[c];
+        size_t col_size = column_size(col, batch->nrows);
+        *p = (uint8_t)col->type;
+        mdb_put_u32(p + 1, (uint32_t)col_size);
+        p += COLUMN_HEADER_SIZE;
+
+        size_t nulls = bitmap_size(batch->nrows);
+        if (nulls) memcpy(p, col->nulls, nulls);
+        p += nulls;
+
+        if (col->type == COL_TYPE_INT)
+        {
+            for (uint32_t r = 0; r < batch->nrows; r++, p += 8)
+            {
+                mdb_put_u64(p, col->fixed[r]);
+            }
+        }
+        else if (col->type == COL_TYPE_TEXT)
+        {
+            for (uint32_t r = 0; r < batch->nrows; r++, p += 4)
+            {
+                mdb_put_u32(p, (uint32_t)col->fixed[r]);
+            }
+            memcpy(p, col->text, col->text_len);
+            p += col->text_len;
+        }
+    }
+
+    *out_size = size;
+    return OK;
+}
+
+/**
+ * Check one column's encoding; *out_size is its size including header.
+ */
+static ErrorCode check_column(const uint8_t* p, size_t avail, uint32_t nrows,
+                              size_t* out_size)
+{
+    if (avail < COLUMN_HEADER_SIZE) return ERR_CORRUPT;
+
+    uint8_t type = p[0];
+    size_t size = mdb_get_u32(p + 1);
+    if (size > avail - COLUMN_HEADER_SIZE) return ERR_CORRUPT;
+
+    size_t fixed = bitmap_size(nrows);
+    if (type == COL_TYPE_INT) fixed += (size_t)nrows * 8;
+    if (type == COL_TYPE_TEXT) fixed += (size_t)nrows * 4;
+    if (type != COL_TYPE_INVALID && type != COL_TYPE_INT && type != COL_TYPE_TEXT) return ERR_CORRUPT;
+    if (type == COL_TYPE_TEXT ? size < fixed : size != fixed) return ERR_CORRUPT;
+
+    if (type == COL_TYPE_TEXT)
+    {
+        const uint8_t* lens = p + COLUMN_HEADER_SIZE + bitmap_size(nrows);
+        size_t text = 0;
+        for (uint32_t r = 0; r < nrows; r++)
+        {
+            uint32_t len = mdb_get_u32(lens + (size_t)r * 4);
+            if (len > MDB_TEXT_MAX) return ERR_CORRUPT;
+            text += len;
+        }
+        if (fixed + text != size) return ERR_CORRUPT;
+    }
+
+    *out_size = COLUMN_HEADER_SIZE + size;
+    return OK;
+}
+
+/**
+ * Validate an encoded batch and report its shape. Call before reading
+ * columns out of data from the network.
+ */
+ErrorCode mdb_row_batch_decode(const uint8_t* data, size_t size,
+                               uint16_t* out_ncols, uint32_t* out_nrows)
+{
+    if (!data || !out_ncols || !out_nrows) return ERR_INVALID;
+    if (size < BATCH_HEADER_SIZE) return ERR_CORRUPT;
+
+    uint16_t ncols = mdb_get_u16(data);
+    uint32_t nrows = mdb_get_u32(data + 2);
+
+    size_t pos = BATCH_HEADER_SIZE;
+    for (uint16_t c = 0; c < ncols; c++)
+    {
+        size_t col_size;
+        ErrorCode err = check_column(data + pos, size - pos, nrows, &col_size);
+        if (err != OK) return err;
+        pos += col_size;
+    }
+    if (pos != size) return ERR_CORRUPT;
+
+    *out_ncols = ncols;
+    *out_nrows = nrows;
+    return OK;
+}
+
+/**
+ * Read column `col` of a batch that passed mdb_row_batch_decode into
+ * out_values (nrows entries). TEXT values point into `data`.
+ */
+ErrorCode mdb_row_batch_column(const uint8_t* data, size_t size, uint16_t col,
+                               MDBValue* out_values)
+{
+    if (!data || !out_values || size < BATCH_HEADER_SIZE) return ERR_INVALID;
+
+    uint16_t ncols = mdb_get_u16(data);
+    uint32_t nrows = mdb_get_u32(data + 2);
+    if (col >= ncols) return ERR_INVALID;
+
+    const uint8_t* p = data + BATCH_HEADER_SIZE;
+    for (uint16_t c = 0; c < col; c++)
+    {
+        p += COLUMN_HEADER_SIZE + mdb_get_u32(p + 1);
+    }
+
+    MDBColumnType type = (MDBColumnType)p[0];
+    const uint8_t* nulls = p + COLUMN_HEADER_SIZE;
+    const uint8_t* fixed = nulls + bitmap_size(nrows);
+    const char* text = (const char*)fixed + (size_t)nrows * 4;
+
+    for (uint32_t r = 0; r < nrows; r++)
+    {
+        MDBValue* v = &out_values[r];
+        if (type == COL_TYPE_INVALID || (nulls[r / 8] & (1u << (r % 8))))
+        {
+            *v = mdb_value_null();
+        }
+        else if (type == COL_TYPE_INT)
+        {
+            *v = mdb_value_int((int64_t)mdb_get_u64(fixed + (size_t)r * 8));
+        }
+        else
+        {
+            uint16_t len = (uint16_t)mdb_get_u32(fixed + (size_t)r * 4);
+            *v = mdb_value_text(text, len);
+            text += len;
+        }
+    }
+
+    return OK;
+}
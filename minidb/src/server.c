@@ -0,0 +1,1052 @@
+#define _GNU_SOURCE 1
+#include "server.h"
+#include "byteorder.h"
+#include "metrics.h"
+#include "repl.h"
+#include "rowbatch.h"
+#include "wal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Server mode.
+ *
+ * `minidb --serve` lets many application processes share one open
+ * database over TCP or a Unix socket. Requests and responses are
+ * length-prefixed frames (see server.h). A client sends MDB_MSG_QUERY
+ * frames holding one statement each and may send the next before the
+ * previous one has finished; every statement is answered, in order, by
+ * zero or more MDB_MSG_TEXT frames carrying its output in batches of up
+ * to MDB_SERVER_BATCH_SIZE bytes, then one MDB_MSG_DONE frame with its
+ * ErrorCode.
+ *
+ * A statement sent as MDB_MSG_QUERY_ROWS gets its result rows back in
+ * binary instead: column-major MDB_MSG_ROWS frames (see rowbatch.c) of
+ * about MDB_SERVER_BATCH_SIZE bytes, so no value is ever formatted as
+ * text. Clients that pipeline should keep reading while they send, or a
+ * long backlog of results can fill both socket buffers.
+ *
+ * One event-loop thread owns the sockets: it accepts connections, reads
+ * whatever has arrived and cuts it into requests. Complete requests go on
+ * a queue served by a pool of worker threads, which parse and execute
+ * them and write the response straight to the client. A connection has
+ * at most one request in flight, which keeps its responses in order;
+ * further requests wait in its buffer, and the worker that finishes one
+ * queues the next itself, so a pipelined stream doesn't bounce through
+ * the event loop between statements.
+ *
+ * The MiniDB handle is not thread-safe, so statements run one at a time
+ * under exec_lock. Nothing is sent to a client while the lock is held:
+ * the frames a statement produces are spooled in memory and sent once it
+ * has released the lock, so a client that reads slowly only ever holds up
+ * its own worker, never the other connections' statements. The spool is
+ * capped (MDBServerConfig.spool_size); output past the cap is dropped, a
+ * row scan feeding it is stopped, and the statement ends with ERR_FULL.
+ *
+ * Only one connection can be inside an explicit transaction: other
+ * connections' statements fail with ERR_CONFLICT until it commits or
+ * rolls back (waiting instead could tie up every worker while the owner's
+ * COMMIT sits in the queue). A connection that hangs up mid-transaction
+ * is rolled back. That is checked before a statement is refused, not left
+ * to the event loop, so once the owner's close() has returned the next
+ * statement from anyone else runs. BACKUP is the exception to running
+ * under exec_lock: it copies pages while other statements run and takes
+ * the lock only for its final pass (see backup.c).
+ */
+
+#define DEFAULT_WORKERS 4
+#define READ_CHUNK 16384
+
+// Without MSG_NOSIGNAL (macOS), sockets get SO_NOSIGPIPE instead.
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+// A FILE with our own write hook: funopen() on macOS and the BSDs,
+// fopencookie() elsewhere.
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#define HAVE_FUNOPEN 1
+#endif
+
+typedef struct Conn
+{
+    int fd;
+    uint8_t* buf; // received, not yet dispatched; guarded by server->lock
+    size_t len;
+    size_t cap;
+    bool busy;      // a worker is running one of its requests
+    bool executing; // that request has not finished executing yet
+    bool closing;   // hung up or broke the protocol; freed once idle
+    struct Conn* next;
+} Conn;
+
+typedef struct Job
+{
+    Conn* conn;
+    char* sql;
+    bool binary_rows; // MDB_MSG_QUERY_ROWS
+    struct Job* next;
+} Job;
+
+struct MDBServer
+{
+    MiniDB* db;
+    int listen_fd;
+    char* unix_path; // unlinked on stop
+    int wake[2];     // workers poke the event loop through this pipe
+
+    pthread_mutex_t lock; // conns, the job queue, busy/closing, stopping
+    pthread_cond_t work;
+    Conn* conns;
+    Job* head;
+    Job* tail;
+    bool stopping;
+
+    pthread_mutex_t exec_lock; // the MiniDB handle and txn_owner
+    size_t spool_size;
+    Conn* txn_owner;
+
+    pthread_t loop;
+    bool loop_started;
+    pthread_t* workers;
+    uint32_t nworkers;
+};
+
+static ErrorCode send_all(int fd, const void* data, size_t len)
+{
+    const uint8_t* p = data;
+    while (len > 0)
+    {
+        ssize_t n = send(fd, p, len, SEND_FLAGS);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return ERR_IO;
+        p += n;
+        len -= (size_t)n;
+    }
+    return OK;
+}
+
+static ErrorCode recv_all(int fd, void* data, size_t len)
+{
+    uint8_t* p = data;
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return ERR_IO;
+        p += n;
+        len -= (size_t)n;
+    }
+    return OK;
+}
+
+ErrorCode mdb_wire_send(int fd, uint8_t type, const void* payload,
+                        uint32_t len)
+{
+    if (fd < 0 || (!payload && len > 0) || len >= MDB_FRAME_MAX_SIZE) return ERR_INVALID;
+
+    uint8_t header[MDB_FRAME_HEADER_SIZE];
+    mdb_put_u32(header, len + 1);
+    header[4] = type;
+
+    ErrorCode err = send_all(fd, header, sizeof(header));
+    if (err == OK && len > 0) err = send_all(fd, payload, len);
+    return err;
+}
+
+/**
+ * Read one frame. The payload is NUL-terminated for convenience and
+ * freed by the caller.
+ */
+ErrorCode mdb_wire_recv(int fd, uint8_t* out_type, uint8_t** out_payload,
+                        uint32_t* out_len)
+{
+    if (fd < 0 || !out_type || !out_payload || !out_len) return ERR_INVALID;
+
+    uint8_t header[MDB_FRAME_HEADER_SIZE];
+    ErrorCode err = recv_all(fd, header, sizeof(header));
+    if (err != OK) return err;
+
+    uint32_t len = mdb_get_u32(header);
+    if (len == 0 || len > MDB_FRAME_MAX_SIZE) return ERR_CORRUPT;
+
+    uint8_t* payload = malloc(len);
+    if (!payload) return ERR_UNKNOWN;
+
+    err = recv_all(fd, payload, len - 1);
+    if (err != OK)
+    {
+        free(payload);
+        return err;
+    }
+    payload[len - 1] = '\0';
+
+    *out_type = header[4];
+    *out_payload = payload;
+    *out_len = len - 1;
+    return OK;
+}
+
+/**
+ * Run one statement and wait for its result. The output text (freed by
+ * the caller) is optional; *out_result is the statement's ErrorCode.
+ */
+ErrorCode mdb_wire_query(int fd, const char* sql, char** out_text,
+                         ErrorCode* out_result)
+{
+    if (!sql || !out_result) return ERR_INVALID;
+
+    ErrorCode err = mdb_wire_send(fd, MDB_MSG_QUERY, sql, (uint32_t)strlen(sql));
+    if (err != OK) return err;
+
+    char* text = NULL;
+    size_t text_len = 0;
+    for (;;)
+    {
+        uint8_t type;
+        uint8_t* payload;
+        uint32_t len;
+        err = mdb_wire_recv(fd, &type, &payload, &len);
+        if (err != OK) break;
+
+        if (type == MDB_MSG_DONE && len == 4)
+        {
+            *out_result = (ErrorCode)(int32_t)mdb_get_u32(payload);
+            free(payload);
+            break;
+        }
+        if (type != MDB_MSG_TEXT)
+        {
+            free(payload);
+            err = ERR_CORRUPT;
+            break;
+        }
+
+        char* grown = out_text ? realloc(text, text_len + len + 1) : NULL;
+        if (grown)
+        {
+            memcpy(grown + text_len, payload, len + 1);
+            text = grown;
+            text_len += len;
+        }
+        free(payload);
+    }
+
+    if (err == OK && out_text)
+    {
+        *out_text = text ? text : strdup("");
+        return *out_text ? OK : ERR_UNKNOWN;
+    }
+    free(text);
+    return err;
+}
+
+static bool set_nonblocking(int fd, bool on)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) return false;
+    flags = on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+/**
+ * Make a new socket close-on-exec and, where sends can't ask for it,
+ * keep a write to a hung-up peer from raising SIGPIPE.
+ */
+static bool socket_setup(int fd)
+{
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) return false;
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one)) != 0) return false;
+#endif
+    return true;
+}
+
+static bool is_unix_address(const char* address)
+{
+    return strchr(address, '/') != NULL;
+}
+
+static ErrorCode open_unix_socket(const char* path, bool listening, int* out_fd)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return ERR_INVALID;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return ERR_IO;
+
+    int rc = -1;
+    if (socket_setup(fd))
+    {
+        rc = listening ? bind(fd, (struct sockaddr*)&addr, sizeof(addr))
+                       : connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    }
+    if (rc == 0 && listening) rc = listen(fd, SOMAXCONN);
+    if (rc != 0)
+    {
+        close(fd);
+        return ERR_IO;
+    }
+
+    *out_fd = fd;
+    return OK;
+}
+
+/**
+ * "host:port" or ":port". An empty host listens on every interface and
+ * connects to the loopback address.
+ */
+static ErrorCode open_tcp_socket(const char* address, bool listening, int* out_fd)
+{
+    const char* colon = strrchr(address, ':');
+    if (!colon || colon[1] == '\0') return ERR_INVALID;
+
+    char host[256];
+    size_t host_len = (size_t)(colon - address);
+    if (host_len >= sizeof(host)) return ERR_INVALID;
+    memcpy(host, address, host_len);
+    host[host_len] = '\0';
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+
+    struct addrinfo* res;
+    if (getaddrinfo(host_len ? host : NULL, colon + 1, &hints, &res) != 0) return ERR_INVALID;
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+
+        if (!socket_setup(fd))
+        {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+
+        int one = 1;
+        if (listening)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0) break;
+        }
+        else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            // Frames are written as header + payload; don't let Nagle hold
+            // the payload back waiting for an ACK.
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) return ERR_IO;
+    *out_fd = fd;
+    return OK;
+}
+
+ErrorCode mdb_wire_connect(const char* address, int* out_fd)
+{
+    if (!address || !out_fd) return ERR_INVALID;
+
+    return is_unix_address(address) ? open_unix_socket(address, false, out_fd)
+                                    : open_tcp_socket(address, false, out_fd);
+}
+
+static void wake_loop(MDBServer* server)
+{
+    ssize_t n = write(server->wake[1], "", 1);
+    (void)n; // a full pipe means the loop is already due to wake up
+}
+
+typedef struct
+{
+    int fd;
+    bool failed;
+    bool spooling;  // exec_lock is held: queue frames in `spool` instead
+    bool truncated; // the spool filled up; the rest of the output is dropped
+    uint8_t* spool;
+    size_t spool_len;
+    size_t spool_cap;
+    size_t spool_max;
+} Output;
+
+/**
+ * Send one frame of a statement's response, or spool it while the
+ * statement holds exec_lock. After a failure the rest is dropped and the
+ * connection closed once the statement is done; past the spool's cap the
+ * rest is dropped too, and the statement ends with ERR_FULL.
+ */
+static void output_frame(Output* out, uint8_t type, const void* data, uint32_t len)
+{
+    if (out->failed || out->truncated) return;
+
+    if (!out->spooling)
+    {
+        if (mdb_wire_send(out->fd, type, data, len) != OK) out->failed = true;
+        return;
+    }
+
+    size_t need = out->spool_len + MDB_FRAME_HEADER_SIZE + len;
+    if (need > out->spool_max)
+    {
+        out->truncated = true;
+        return;
+    }
+    if (need > out->spool_cap)
+    {
+        size_t cap = out->spool_cap ? out->spool_cap : MDB_SERVER_BATCH_SIZE;
+        while (cap < need)
+        {
+            cap *= 2;
+        }
+        if (cap > out->spool_max) cap = out->spool_max;
+        uint8_t* spool = realloc(out->spool, cap);
+        if (!spool)
+        {
+            out->failed = true;
+            return;
+        }
+        out->spool = spool;
+        out->spool_cap = cap;
+    }
+
+    uint8_t* p = out->spool + out->spool_len;
+    mdb_put_u32(p, len + 1);
+    p[4] = type;
+    memcpy(p + MDB_FRAME_HEADER_SIZE, data, len);
+    out->spool_len = need;
+}
+
+/**
+ * Send everything spooled under exec_lock; frames go out directly after.
+ */
+static void output_unspool(Output* out)
+{
+    out->spooling = false;
+    if (!out->failed && out->spool_len > 0 && send_all(out->fd, out->spool, out->spool_len) != OK)
+    {
+        out->failed = true;
+    }
+    free(out->spool);
+    out->spool = NULL;
+    out->spool_len = out->spool_cap = 0;
+}
+
+/**
+ * stdio write hook for a statement's output: every flushed buffer becomes
+ * MDB_MSG_TEXT frames.
+ */
+static ssize_t output_write(void* cookie, const char* data, size_t len)
+{
+    Output* out = cookie;
+
+    for (size_t done = 0; done < len && !out->failed;)
+    {
+        size_t n = len - done < MDB_SERVER_BATCH_SIZE ? len - done : MDB_SERVER_BATCH_SIZE;
+        output_frame(out, MDB_MSG_TEXT, data + done, (uint32_t)n);
+        done += n;
+    }
+    return (ssize_t)len;
+}
+
+#ifdef HAVE_FUNOPEN
+static int output_write_int(void* cookie, const char* data, int len)
+{
+    return (int)output_write(cookie, data, (size_t)len);
+}
+#endif
+
+/**
+ * A FILE whose flushed output goes to output_write.
+ */
+static FILE* output_open(Output* out)
+{
+#ifdef HAVE_FUNOPEN
+    return funopen(out, NULL, output_write_int, NULL, NULL);
+#else
+    cookie_io_functions_t io = {.write = output_write};
+    return fopencookie(out, "w", io);
+#endif
+}
+
+/**
+ * Queue the connection's next request if it has a complete one and none
+ * in flight. Called with server->lock held.
+ */
+static void dispatch(MDBServer* server, Conn* conn)
+{
+    if (conn->busy || conn->closing || conn->len < MDB_FRAME_HEADER_SIZE) return;
+
+    uint32_t len = mdb_get_u32(conn->buf);
+    uint8_t type = conn->buf[4];
+    if (len == 0 || len > MDB_FRAME_MAX_SIZE || (type != MDB_MSG_QUERY && type != MDB_MSG_QUERY_ROWS))
+    {
+        conn->closing = true;
+        return;
+    }
+    if (conn->len < 4 + (size_t)len) return;
+
+    Job* job = malloc(sizeof(Job));
+    char* sql = malloc(len);
+    if (!job || !sql)
+    {
+        free(job);
+        free(sql);
+        conn->closing = true;
+        return;
+    }
+    memcpy(sql, conn->buf + MDB_FRAME_HEADER_SIZE, len - 1);
+    sql[len - 1] = '\0';
+
+    conn->len -= 4 + (size_t)len;
+    memmove(conn->buf, conn->buf + 4 + len, conn->len);
+
+    job->conn = conn;
+    job->sql = sql;
+    job->binary_rows = type == MDB_MSG_QUERY_ROWS;
+    job->next = NULL;
+    if (server->tail)
+    {
+        server->tail->next = job;
+    }
+    else
+    {
+        server->head = job;
+    }
+    server->tail = job;
+
+    conn->busy = true;
+    conn->executing = true;
+    pthread_cond_signal(&server->work);
+}
+
+typedef struct
+{
+    Output* output;
+    FILE* out;
+    MDBRowBatch* batch;
+} BatchSink;
+
+/**
+ * Send the rows gathered so far as one MDB_MSG_ROWS frame. Text written
+ * before them goes out first, so the client sees output in order.
+ */
+static ErrorCode flush_rows(BatchSink* sink)
+{
+    if (mdb_row_batch_nrows(sink->batch) == 0) return OK;
+
+    size_t size = mdb_row_batch_encoded_size(sink->batch);
+    uint8_t* buffer = malloc(size);
+    if (!buffer) return ERR_UNKNOWN;
+
+    ErrorCode err = mdb_row_batch_encode(sink->batch, buffer, size, &size);
+    fflush(sink->out);
+    if (err == OK) output_frame(sink->output, MDB_MSG_ROWS, buffer, (uint32_t)size);
+    if (err == OK && sink->output->truncated) err = ERR_FULL; // stops the scan
+
+    free(buffer);
+    mdb_row_batch_reset(sink->batch);
+    return err;
+}
+
+/**
+ * RowSink callback for binary clients: gather rows into a batch and send
+ * it whenever it reaches MDB_SERVER_BATCH_SIZE.
+ */
+static ErrorCode batch_row(void* ctx, const MDBValue* cols, uint16_t ncols)
+{
+    BatchSink* sink = ctx;
+    ErrorCode err = OK;
+
+    if (sink->batch && mdb_row_batch_ncols(sink->batch) != ncols)
+    {
+        err = flush_rows(sink);
+        mdb_row_batch_destroy(sink->batch);
+        sink->batch = NULL;
+    }
+    if (err == OK && !sink->batch) err = mdb_row_batch_create(ncols, &sink->batch);
+    if (err != OK) return err;
+
+    err = mdb_row_batch_append(sink->batch, cols, ncols);
+    if (err == ERR_INVALID && mdb_row_batch_nrows(sink->batch) > 0)
+    {
+        // A column changed type from earlier rows: start a new batch.
+        err = flush_rows(sink);
+        if (err == OK) err = mdb_row_batch_append(sink->batch, cols, ncols);
+    }
+    if (err == OK && mdb_row_batch_encoded_size(sink->batch) >= MDB_SERVER_BATCH_SIZE)
+    {
+        err = flush_rows(sink);
+    }
+    return err;
+}
+
+/**
+ * Take exec_lock, counting the wait as lock contention if another
+ * connection's statement is running.
+ */
+static void lock_exec(MDBServer* server)
+{
+    if (pthread_mutex_trylock(&server->exec_lock) == 0) return;
+
+    uint64_t start = mdb_metrics_now();
+    pthread_mutex_lock(&server->exec_lock);
+    mdb_metrics_add(MDB_COUNTER_LOCK_WAITS, 1);
+    mdb_metrics_record(MDB_LATENCY_LOCK_WAIT, mdb_metrics_now() - start);
+}
+
+/**
+ * Mark the connection's request as done executing; from here on it only
+ * sends its response.
+ */
+static void finish_exec(MDBServer* server, Conn* conn)
+{
+    pthread_mutex_lock(&server->lock);
+    conn->executing = false;
+    pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Has the transaction owner hung up with nothing left to run? If so its
+ * transaction is rolled back on the spot. Called with exec_lock held,
+ * which also keeps the loop from freeing `owner` meanwhile.
+ */
+static bool release_abandoned_txn(MDBServer* server, Conn* owner)
+{
+    pthread_mutex_lock(&server->lock);
+    bool idle = !owner->executing && owner->len == 0;
+    pthread_mutex_unlock(&server->lock);
+
+    // EOF with nothing unread: every request it sent has been answered.
+    uint8_t byte;
+    if (!idle || recv(owner->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) != 0) return false;
+
+    mdb_rollback(server->db);
+    server->txn_owner = NULL;
+
+    pthread_mutex_lock(&server->lock);
+    owner->closing = true;
+    pthread_mutex_unlock(&server->lock);
+    wake_loop(server);
+    return true;
+}
+
+static void run_job(MDBServer* server, Job* job)
+{
+    Conn* conn = job->conn;
+    Output output = {.fd = conn->fd, .spool_max = server->spool_size};
+    bool hang_up = false;
+
+    Tokens tokens;
+    ErrorCode err = tokenize(job->sql, &tokens);
+
+    Statement stmt;
+    memset(&stmt, 0, sizeof(stmt));
+    if (err == OK) err = parse_statement(&tokens, &stmt);
+
+    FILE* out = output_open(&output);
+    if (!out) err = ERR_UNKNOWN;
+    if (out) setvbuf(out, NULL, _IOFBF, MDB_SERVER_BATCH_SIZE);
+
+    BatchSink batch = {&output, out, NULL};
+    RowSink rows = {batch_row, &batch};
+
+    if (err == OK && stmt.kind == STMT_EXIT)
+    {
+        hang_up = true;
+        finish_exec(server, conn);
+    }
+    else if (err == OK && stmt.kind == STMT_BACKUP)
+    {
+        // Runs outside exec_lock so other connections keep writing; the
+        // backup takes the lock itself only for its final pass.
+        err = execute_backup(server->db, &stmt, out, &server->exec_lock);
+        finish_exec(server, conn);
+    }
+    else if (err == OK)
+    {
+        lock_exec(server);
+        output.spooling = true;
+        if (server->txn_owner && server->txn_owner != conn &&
+            !release_abandoned_txn(server, server->txn_owner))
+        {
+            err = ERR_CONFLICT;
+        }
+        else
+        {
+            err = execute_statement(server->db, &stmt, out, job->binary_rows ? &rows : NULL);
+            server->txn_owner = mdb_in_transaction(server->db) ? conn : NULL;
+        }
+        fflush(out); // all of its text counts against the spool's cap
+        // Before unlocking, so whoever runs next sees this one finished.
+        finish_exec(server, conn);
+        pthread_mutex_unlock(&server->exec_lock);
+        output_unspool(&output);
+    }
+    else
+    {
+        finish_exec(server, conn);
+    }
+
+    if (batch.batch)
+    {
+        ErrorCode flush_err = flush_rows(&batch);
+        if (err == OK) err = flush_err;
+        mdb_row_batch_destroy(batch.batch);
+    }
+    if (out) fclose(out); // sends the last batch
+    if (err == OK && output.truncated) err = ERR_FULL;
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    uint8_t result[4];
+    mdb_put_u32(result, (uint32_t)err);
+    if (output.failed || mdb_wire_send(conn->fd, MDB_MSG_DONE, result, sizeof(result)) != OK)
+    {
+        hang_up = true;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    conn->busy = false;
+    conn->closing |= hang_up;
+    dispatch(server, conn);
+    bool idle = !conn->busy;
+    pthread_mutex_unlock(&server->lock);
+
+    // The loop reaps closed connections and polls idle ones again.
+    if (idle) wake_loop(server);
+}
+
+static void* worker_main(void* arg)
+{
+    MDBServer* server = arg;
+
+    pthread_mutex_lock(&server->lock);
+    for (;;)
+    {
+        while (!server->head && !server->stopping)
+        {
+            pthread_cond_wait(&server->work, &server->lock);
+        }
+        if (!server->head) break; // stopping, and the queue is drained
+
+        Job* job = server->head;
+        server->head = job->next;
+        if (!server->head) server->tail = NULL;
+        pthread_mutex_unlock(&server->lock);
+
+        run_job(server, job);
+        free(job->sql);
+        free(job);
+
+        pthread_mutex_lock(&server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+static void close_conn(MDBServer* server, Conn* conn)
+{
+    lock_exec(server);
+    if (server->txn_owner == conn)
+    {
+        mdb_rollback(server->db);
+        server->txn_owner = NULL;
+    }
+    pthread_mutex_unlock(&server->exec_lock);
+
+    close(conn->fd);
+    free(conn->buf);
+    free(conn);
+}
+
+static void accept_conn(MDBServer* server)
+{
+    // The BSDs hand O_NONBLOCK down from the listening socket; workers
+    // send with blocking writes.
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+    if (!socket_setup(fd) || !set_nonblocking(fd, false))
+    {
+        close(fd);
+        return;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on Unix sockets
+
+    Conn* conn = calloc(1, sizeof(Conn));
+    if (!conn)
+    {
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+
+    pthread_mutex_lock(&server->lock);
+    conn->next = server->conns;
+    server->conns = conn;
+    pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Append whatever the client has sent to its buffer.
+ */
+static void read_conn(MDBServer* server, Conn* conn)
+{
+    uint8_t chunk[READ_CHUNK];
+    ssize_t n = recv(conn->fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    bool failed = n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+
+    pthread_mutex_lock(&server->lock);
+
+    if (n > 0 && conn->cap - conn->len < (size_t)n)
+    {
+        size_t cap = conn->cap ? conn->cap * 2 : 2 * READ_CHUNK;
+        uint8_t* buf = realloc(conn->buf, cap);
+        if (buf)
+        {
+            conn->buf = buf;
+            conn->cap = cap;
+        }
+        failed = !buf;
+    }
+    if (n > 0 && !failed)
+    {
+        memcpy(conn->buf + conn->len, chunk, (size_t)n);
+        conn->len += (size_t)n;
+    }
+    conn->closing |= failed;
+
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void* loop_main(void* arg)
+{
+    MDBServer* server = arg;
+    struct pollfd* fds = NULL;
+    Conn** polled = NULL;
+    size_t cap = 0;
+
+    for (;;)
+    {
+        Conn* dead = NULL;
+        size_t nfds = 2;
+
+        pthread_mutex_lock(&server->lock);
+        if (server->stopping)
+        {
+            pthread_mutex_unlock(&server->lock);
+            break;
+        }
+
+        size_t nconns = 0;
+        for (Conn** pp = &server->conns; *pp;)
+        {
+            Conn* conn = *pp;
+            dispatch(server, conn);
+            if (conn->closing && !conn->busy)
+            {
+                *pp = conn->next;
+                conn->next = dead;
+                dead = conn;
+                continue;
+            }
+            nconns++;
+            pp = &conn->next;
+        }
+
+        if (nconns + 2 > cap)
+        {
+            size_t new_cap = (nconns + 2) * 2;
+            struct pollfd* new_fds = realloc(fds, sizeof(struct pollfd) * new_cap);
+            if (new_fds) fds = new_fds;
+            Conn** new_polled = realloc(polled, sizeof(Conn*) * new_cap);
+            if (new_polled) polled = new_polled;
+            if (new_fds && new_polled) cap = new_cap;
+        }
+        if (cap < 2)
+        {
+            pthread_mutex_unlock(&server->lock);
+            break; // out of memory before the first poll
+        }
+
+        fds[0] = (struct pollfd){.fd = server->listen_fd, .events = POLLIN};
+        fds[1] = (struct pollfd){.fd = server->wake[0], .events = POLLIN};
+        for (Conn* conn = server->conns; conn && nfds < cap; conn = conn->next)
+        {
+            // Stop reading from a client that has a full frame queued up
+            // behind a busy one; TCP flow control pushes back on it.
+            if (conn->closing || conn->len >= MDB_FRAME_HEADER_SIZE + MDB_FRAME_MAX_SIZE) continue;
+            fds[nfds] = (struct pollfd){.fd = conn->fd, .events = POLLIN};
+            polled[nfds] = conn;
+            nfds++;
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        while (dead)
+        {
+            Conn* next = dead->next;
+            close_conn(server, dead);
+            dead = next;
+        }
+
+        if (poll(fds, nfds, -1) < 0) continue;
+
+        if (fds[1].revents)
+        {
+            char drain[64];
+            while (read(server->wake[0], drain, sizeof(drain)) > 0)
+            {
+            }
+        }
+        if (fds[0].revents) accept_conn(server);
+        for (size_t i = 2; i < nfds; i++)
+        {
+            if (fds[i].revents) read_conn(server, polled[i]);
+        }
+    }
+
+    free(fds);
+    free(polled);
+    return NULL;
+}
+
+/**
+ * Listen on `config->address` and serve `db` from background threads
+ * until mdb_server_stop. The database must stay open meanwhile and must
+ * not be used by anyone else.
+ */
+ErrorCode mdb_server_start(MiniDB* db, const MDBServerConfig* config,
+                           MDBServer** out_server)
+{
+    if (!db || !config || !config->address || !out_server) return ERR_INVALID;
+
+    MDBServer* server = calloc(1, sizeof(MDBServer));
+    if (!server) return ERR_UNKNOWN;
+
+    server->db = db;
+    server->listen_fd = -1;
+    server->wake[0] = server->wake[1] = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_mutex_init(&server->exec_lock, NULL);
+    pthread_cond_init(&server->work, NULL);
+
+    uint32_t nworkers = config->workers ? config->workers : DEFAULT_WORKERS;
+    server->spool_size = config->spool_size ? config->spool_size : MDB_SERVER_SPOOL_SIZE;
+    bool unix_socket = is_unix_address(config->address);
+    ErrorCode err = unix_socket ? open_unix_socket(config->address, true, &server->listen_fd)
+                                : open_tcp_socket(config->address, true, &server->listen_fd);
+
+    if (err == OK && unix_socket)
+    {
+        server->unix_path = strdup(config->address);
+        if (!server->unix_path)
+        {
+            unlink(config->address);
+            err = ERR_UNKNOWN;
+        }
+    }
+    if (err == OK && (!set_nonblocking(server->listen_fd, true) || pipe(server->wake) != 0))
+    {
+        err = ERR_IO;
+    }
+    for (int i = 0; err == OK && i < 2; i++)
+    {
+        if (!set_nonblocking(server->wake[i], true) || fcntl(server->wake[i], F_SETFD, FD_CLOEXEC) != 0) err = ERR_IO;
+    }
+    if (err == OK)
+    {
+        server->workers = calloc(nworkers, sizeof(pthread_t));
+        if (!server->workers) err = ERR_UNKNOWN;
+    }
+    for (uint32_t i = 0; err == OK && i < nworkers; i++)
+    {
+        if (pthread_create(&server->workers[i], NULL, worker_main, server) != 0) err = ERR_UNKNOWN;
+        if (err == OK) server->nworkers++;
+    }
+    if (err == OK)
+    {
+        if (pthread_create(&server->loop, NULL, loop_main, server) != 0) err = ERR_UNKNOWN;
+        server->loop_started = err == OK;
+    }
+
+    if (err != OK)
+    {
+        mdb_server_stop(server);
+        return err;
+    }
+
+    *out_server = server;
+    return OK;
+}
+
+/**
+ * Stop accepting, finish the requests already queued, then close every
+ * connection (rolling back an open transaction) and free the server.
+ */
+void mdb_server_stop(MDBServer* server)
+{
+    if (!server) return;
+
+    pthread_mutex_lock(&server->lock);
+    server->stopping = true;
+    pthread_cond_broadcast(&server->work);
+    pthread_mutex_unlock(&server->lock);
+
+    if (server->loop_started)
+    {
+        wake_loop(server);
+        pthread_join(server->loop, NULL);
+    }
+    for (uint32_t i = 0; i < server->nworkers; i++)
+    {
+        pthread_join(server->workers[i], NULL);
+    }
+
+    while (server->conns)
+    {
+        Conn* next = server->conns->next;
+        close_conn(server, server->conns);
+        server->conns = next;
+    }
+
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    if (server->unix_path) unlink(server->unix_path);
+    if (server->wake[0] >= 0) close(server->wake[0]);
+    if (server->wake[1] >= 0) close(server->wake[1]);
+
+    pthread_cond_destroy(&server->work);
+    pthread_mutex_destroy(&server->exec_lock);
+    pthread_mutex_destroy(&server->lock);
+    free(server->unix_path);
+    free(server->workers);
+    free(server);
+}
@@ -0,0 +1,302 @@
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Column statistics.
+ *
+ * ANALYZE feeds every value of a column through an MDBStatsBuilder, which
+ * keeps three things in constant memory:
+ *
+ * - row and NULL counts;
+ * - a HyperLogLog sketch (1024 one-byte registers) for the number of
+ *   distinct values, accurate to a few percent at any table size;
+ * - for INT columns, a reservoir sample of MDB_STATS_SAMPLE values, from
+ *   which an equi-depth histogram is cut: every bucket holds the same
+ *   share of rows, so skewed data gets narrow buckets where it is dense.
+ *
+ * The planner turns a predicate into a selectivity (1/distinct for
+ * equality, histogram coverage for ranges) and compares the page reads
+ * of a full heap scan with those of an index lookup. An index only wins
+ * when few enough rows match: each match is a random heap page read,
+ * which costs several sequential ones.
+ */
+
+#define RANDOM_PAGE_COST 4.0
+#define INDEX_DESCENT_PAGES 3.0
+#define DEFAULT_RANGE_SELECTIVITY (1.0 / 3.0)
+
+void mdb_hll_init(MDBHyperLogLog* hll)
+{
+    memset(hll->registers, 0, sizeof(hll->registers));
+}
+
+/**
+ * The top MDB_HLL_PRECISION bits of the hash pick a register, which
+ * keeps the longest run of leading zeros seen in the remaining bits.
+ */
+void mdb_hll_add(MDBHyperLogLog* hll, uint64_t hash)
+{
+    uint32_t idx = (uint32_t)(hash >> (64 - MDB_HLL_PRECISION));
+    uint64_t rest = hash << MDB_HLL_PRECISION;
+
+    uint8_t rank = rest ? (uint8_t)(__builtin_clzll(rest) + 1) : 64 - MDB_HLL_PRECISION + 1;
+    if (rank > hll->registers[idx]) hll->registers[idx] = rank;
+}
+
+/**
+ * Natural log without libm: halve down to [1, 2), then the atanh series.
+ */
+static double ln(double x)
+{
+    double k = 0.0;
+    while (x >= 2.0)
+    {
+        x /= 2.0;
+        k += 1.0;
+    }
+
+    double y = (x - 1.0) / (x + 1.0);
+    double y2 = y * y;
+    double term = y;
+    double sum = 0.0;
+    for (int n = 1; n < 40; n += 2)
+    {
+        sum += term / n;
+        term *= y2;
+    }
+    return k * 0.6931471805599453 + 2.0 * sum;
+}
+
+uint64_t mdb_hll_estimate(const MDBHyperLogLog* hll)
+{
+    const double m = MDB_HLL_REGISTERS;
+
+    double sum = 0.0;
+    uint32_t zeros = 0;
+    for (uint32_t i = 0; i < MDB_HLL_REGISTERS; i++)
+    {
+        sum += 1.0 / (double)(1ull << hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+
+    // Small cardinalities: linear counting over the empty registers.
+    if (estimate <= 2.5 * m && zeros > 0)
+    {
+        estimate = m * ln(m / zeros);
+    }
+
+    return (uint64_t)(estimate + 0.5);
+}
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Well-mixed 64-bit hash of a value; equal values hash equal. The text of
+ * an externalized value is only its prefix, so those hash by prefix.
+ */
+uint64_t mdb_value_hash(const MDBValue* value)
+{
+    if (value->is_null) return 0;
+    if (value->type == COL_TYPE_INT) return mix64((uint64_t)value->integer);
+
+    uint64_t h = 14695981039346656037ull;
+    for (uint16_t i = 0; i < value->text.length; i++)
+    {
+        h ^= (uint8_t)value->text.ptr[i];
+        h *= 1099511628211ull;
+    }
+    return mix64(h);
+}
+
+struct MDBStatsBuilder
+{
+    MDBColumnType type;
+    uint64_t rows;
+    uint64_t nulls;
+    MDBHyperLogLog hll;
+
+    int64_t sample[MDB_STATS_SAMPLE];
+    uint32_t nsample;
+    uint64_t rng;
+};
+
+ErrorCode mdb_stats_builder_create(MDBColumnType type,
+                                   MDBStatsBuilder** out_builder)
+{
+    if (!out_builder) return ERR_INVALID;
+
+    MDBStatsBuilder* b = calloc(1, sizeof(MDBStatsBuilder));
+    if (!b) return ERR_UNKNOWN;
+
+    b->type = type;
+    b->rng = 0x9E3779B97F4A7C15ull;
+    mdb_hll_init(&b->hll);
+
+    *out_builder = b;
+    return OK;
+}
+
+void mdb_stats_builder_add(MDBStatsBuilder* b, const MDBValue* value)
+{
+    if (!b || !value) return;
+
+    b->rows++;
+    if (value->is_null)
+    {
+        b->nulls++;
+        return;
+    }
+
+    mdb_hll_add(&b->hll, mdb_value_hash(value));
+    if (b->type != COL_TYPE_INT) return;
+
+    // Reservoir sampling: every value seen so far is equally likely to be
+    // in the sample.
+    uint64_t seen = b->rows - b->nulls;
+    if (b->nsample < MDB_STATS_SAMPLE)
+    {
+        b->sample[b->nsample++] = value->integer;
+        return;
+    }
+
+    b->rng ^= b->rng << 13;
+    b->rng ^= b->rng >> 7;
+    b->rng ^= b->rng << 17;
+    uint64_t j = b->rng % seen;
+    if (j < MDB_STATS_SAMPLE) b->sample[j] = value->integer;
+}
+
+static int int64_compare(const void* a, const void* b)
+{
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+void mdb_stats_builder_finish(MDBStatsBuilder* b, MDBColumnStats* out_stats)
+{
+    if (!b || !out_stats) return;
+
+    memset(out_stats, 0, sizeof(MDBColumnStats));
+    out_stats->row_count = b->rows;
+    out_stats->null_count = b->nulls;
+
+    uint64_t nonnull = b->rows - b->nulls;
+    uint64_t distinct = mdb_hll_estimate(&b->hll);
+    if (distinct > nonnull) distinct = nonnull;
+    if (distinct == 0 && nonnull > 0) distinct = 1;
+    out_stats->distinct = distinct;
+
+    if (b->nsample == 0) return;
+
+    qsort(b->sample, b->nsample, sizeof(int64_t), int64_compare);
+
+    uint16_t nbuckets = b->nsample < MDB_HISTOGRAM_BUCKETS ? (uint16_t)b->nsample : MDB_HISTOGRAM_BUCKETS;
+    for (uint16_t i = 0; i <= nbuckets; i++)
+    {
+        out_stats->bounds[i] = b->sample[(uint64_t)i * (b->nsample - 1) / nbuckets];
+    }
+    out_stats->nbuckets = nbuckets;
+}
+
+void mdb_stats_builder_destroy(MDBStatsBuilder* b)
+{
+    free(b);
+}
+
+static double nonnull_fraction(const MDBColumnStats* stats)
+{
+    if (stats->row_count == 0) return 0.0;
+    return (double)(stats->row_count - stats->null_count) / (double)stats->row_count;
+}
+
+/**
+ * Fraction of rows expected to match `col = value`.
+ */
+double mdb_stats_selectivity_eq(const MDBColumnStats* stats)
+{
+    if (!stats || stats->distinct == 0) return 0.0;
+    return nonnull_fraction(stats) / (double)stats->distinct;
+}
+
+/**
+ * Fraction of rows expected to have lo <= col <= hi, assuming values are
+ * spread evenly inside each histogram bucket.
+ */
+double mdb_stats_selectivity_range(const MDBColumnStats* stats, int64_t lo,
+                                   int64_t hi)
+{
+    if (!stats || lo > hi) return 0.0;
+    if (stats->nbuckets == 0) return DEFAULT_RANGE_SELECTIVITY * nonnull_fraction(stats);
+
+    double covered = 0.0;
+    for (uint16_t b = 0; b < stats->nbuckets; b++)
+    {
+        double lb = (double)stats->bounds[b];
+        double ub = (double)stats->bounds[b + 1];
+        if ((double)hi < lb || (double)lo > ub) continue;
+
+        if (ub == lb)
+        {
+            covered += 1.0;
+            continue;
+        }
+
+        double from = (double)lo > lb ? (double)lo : lb;
+        double to = (double)hi < ub ? (double)hi : ub;
+        covered += (to - from + 1.0) / (ub - lb + 1.0);
+    }
+
+    double sel = covered / stats->nbuckets;
+    if (sel > 1.0) sel = 1.0;
+    return sel * nonnull_fraction(stats);
+}
+
+/**
+ * Pick the cheaper way to find the rows matching a predicate, in page
+ * reads. Without statistics the index is used, as before ANALYZE existed.
+ */
+MDBAccessPath mdb_stats_choose_access(const MDBColumnStats* stats,
+                                      uint32_t heap_pages, double selectivity)
+{
+    if (!stats) return MDB_ACCESS_PATH_INDEX;
+
+    double rows = selectivity * (double)stats->row_count;
+    double index_cost = INDEX_DESCENT_PAGES + rows * RANDOM_PAGE_COST;
+    double scan_cost = heap_pages;
+
+    return index_cost < scan_cost ? MDB_ACCESS_PATH_INDEX : MDB_ACCESS_PATH_SCAN;
+}
+
+/**
+ * Order join inputs by estimated cardinality (after their own filters),
+ * smallest first, so intermediate results stay as small as possible.
+ */
+void mdb_stats_order_joins(const double* cardinalities, uint16_t n,
+                           uint16_t* out_order)
+{
+    if (!cardinalities || !out_order) return;
+
+    for (uint16_t i = 0; i < n; i++)
+    {
+        uint16_t j = i;
+        while (j > 0 && cardinalities[out_order[j - 1]] > cardinalities[i])
+        {
+            out_order[j] = out_order[j - 1];
+            j--;
+        }
+        out_order[j] = i;
+    }
+}
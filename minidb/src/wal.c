@@ -0,0 +1,415 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "wal.h"
+#include "db_internal.h"
+#include "metrics.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The WAL lives next to the database file as "<filename>-wal". Records are
+ * appended to an in-memory buffer and only hit the file on mdb_wal_flush,
+ * which writes the whole buffer and fsyncs once.
+ *
+ * On disk each record is a fixed header followed by `size` payload bytes:
+ *
+ *   [uint32 type][uint64 lsn][uint32 page_num][uint32 size][payload]
+ *
+ * A record cut short by a crash is treated as the end of the log.
+ *
+ * Transactions: outside BEGIN every logged change is followed by its own
+ * WAL_OP_COMMIT and flush (autocommit). Inside BEGIN records just
+ * accumulate in the buffer, and COMMIT appends one WAL_OP_COMMIT and
+ * fsyncs once for the whole batch. ROLLBACK drops everything buffered
+ * since BEGIN, so aborted work never reaches the log.
+ *
+ * Records that must be durable regardless of the open transaction (row
+ * id reservations) go through mdb_wal_write_direct, which writes them
+ * straight to the file and leaves the buffer alone. They can land ahead
+ * of buffered records with smaller LSNs.
+ *
+ * Every operation holds the WAL's lock, so inserters on other threads
+ * can reserve row ids while a statement is appending.
+ */
+
+#define WAL_RECORD_HEADER_SIZE (sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint32_t))
+#define WAL_INITIAL_BUFFER 4096
+
+struct MDBWal
+{
+    pthread_mutex_t lock;
+    FILE* fp;
+    uint64_t next_lsn;
+
+    uint8_t* buf;
+    size_t len;
+    size_t cap;
+};
+
+static void wal_header_encode(const MDBWalRecord* record, uint8_t* out)
+{
+    uint32_t type = (uint32_t)record->type;
+    memcpy(out, &type, sizeof(uint32_t));
+    out += sizeof(uint32_t);
+    memcpy(out, &record->lsn, sizeof(uint64_t));
+    out += sizeof(uint64_t);
+    memcpy(out, &record->page_num, sizeof(uint32_t));
+    out += sizeof(uint32_t);
+    memcpy(out, &record->size, sizeof(uint32_t));
+}
+
+static void wal_header_decode(const uint8_t* in, MDBWalRecord* out_record)
+{
+    uint32_t type;
+    memcpy(&type, in, sizeof(uint32_t));
+    out_record->type = (MDBWalOpType)type;
+    in += sizeof(uint32_t);
+    memcpy(&out_record->lsn, in, sizeof(uint64_t));
+    in += sizeof(uint64_t);
+    memcpy(&out_record->page_num, in, sizeof(uint32_t));
+    in += sizeof(uint32_t);
+    memcpy(&out_record->size, in, sizeof(uint32_t));
+}
+
+static ErrorCode wal_find_last_lsn(void* ctx, const MDBWalRecord* record,
+                                   const void* payload)
+{
+    (void)payload;
+    uint64_t* last = ctx;
+    if (record->lsn > *last) *last = record->lsn;
+    return OK;
+}
+
+ErrorCode mdb_wal_open(MiniDB* db, MDBWal** out_wal)
+{
+    if (!db || !out_wal) return ERR_INVALID;
+
+    const char* filename = mdb_filename(db);
+    size_t path_len = strlen(filename) + sizeof("-wal");
+    char* path = malloc(path_len);
+    if (!path) return ERR_UNKNOWN;
+    snprintf(path, path_len, "%s-wal", filename);
+
+    FILE* fp = fopen(path, "r+b");
+    if (!fp) fp = fopen(path, "w+b");
+    free(path);
+    if (!fp) return ERR_IO;
+
+    MDBWal* wal = calloc(1, sizeof(MDBWal));
+    if (!wal)
+    {
+        fclose(fp);
+        return ERR_UNKNOWN;
+    }
+    wal->fp = fp;
+    pthread_mutex_init(&wal->lock, NULL);
+
+    // Continue numbering after whatever survived from the previous run.
+    uint64_t last_lsn = 0;
+    ErrorCode err = mdb_wal_scan(wal, wal_find_last_lsn, &last_lsn);
+    if (err != OK)
+    {
+        pthread_mutex_destroy(&wal->lock);
+        fclose(fp);
+        free(wal);
+        return err;
+    }
+    wal->next_lsn = last_lsn + 1;
+
+    *out_wal = wal;
+    return OK;
+}
+
+ErrorCode mdb_wal_close(MDBWal* wal)
+{
+    if (!wal) return ERR_INVALID;
+
+    ErrorCode err = mdb_wal_flush(wal);
+    pthread_mutex_destroy(&wal->lock);
+    fclose(wal->fp);
+    free(wal->buf);
+    free(wal);
+    return err;
+}
+
+// Caller holds wal->lock.
+static ErrorCode wal_append(MDBWal* wal, const MDBWalRecord* record,
+                            const void* payload)
+{
+    size_t needed = wal->len + WAL_RECORD_HEADER_SIZE + record->size;
+    if (needed > wal->cap)
+    {
+        size_t cap = wal->cap ? wal->cap : WAL_INITIAL_BUFFER;
+        while (cap < needed)
+        {
+            cap *= 2;
+        }
+
+        uint8_t* buf = realloc(wal->buf, cap);
+        if (!buf) return ERR_UNKNOWN;
+        wal->buf = buf;
+        wal->cap = cap;
+    }
+
+    MDBWalRecord r = *record;
+    r.lsn = wal->next_lsn++;
+
+    wal_header_encode(&r, wal->buf + wal->len);
+    wal->len += WAL_RECORD_HEADER_SIZE;
+
+    if (r.size > 0)
+    {
+        memcpy(wal->buf + wal->len, payload, r.size);
+        wal->len += r.size;
+    }
+
+    return OK;
+}
+
+/**
+ * Buffer a record. The LSN in `record` is ignored; the WAL assigns the next
+ * one in sequence. Nothing is durable until mdb_wal_flush returns OK.
+ */
+ErrorCode mdb_wal_append(MDBWal* wal, const MDBWalRecord* record,
+                         const void* payload)
+{
+    if (!wal || !record || (!payload && record->size > 0)) return ERR_INVALID;
+
+    pthread_mutex_lock(&wal->lock);
+    ErrorCode err = wal_append(wal, record, payload);
+    pthread_mutex_unlock(&wal->lock);
+    return err;
+}
+
+/**
+ * Append `len` bytes to the file and fsync. Caller holds wal->lock.
+ */
+static ErrorCode wal_write(MDBWal* wal, const uint8_t* data, size_t len)
+{
+    uint64_t start = mdb_metrics_now();
+    if (fseek(wal->fp, 0, SEEK_END) != 0) return ERR_IO;
+    if (fwrite(data, 1, len, wal->fp) != len) return ERR_IO;
+    if (fflush(wal->fp) != 0) return ERR_IO;
+
+    uint64_t sync_start = mdb_metrics_now();
+    int rc = fsync(fileno(wal->fp));
+    uint64_t end = mdb_metrics_now();
+    mdb_metrics_add(MDB_COUNTER_FSYNCS, 1);
+    mdb_metrics_record(MDB_LATENCY_FSYNC, end - sync_start);
+    if (rc != 0) return ERR_IO;
+
+    mdb_metrics_add(MDB_COUNTER_WAL_FLUSHES, 1);
+    mdb_metrics_record(MDB_LATENCY_WAL_FLUSH, end - start);
+    return OK;
+}
+
+static ErrorCode wal_flush(MDBWal* wal)
+{
+    if (wal->len == 0) return OK;
+
+    ErrorCode err = wal_write(wal, wal->buf, wal->len);
+    if (err == OK) wal->len = 0;
+    return err;
+}
+
+ErrorCode mdb_wal_flush(MDBWal* wal)
+{
+    if (!wal) return ERR_INVALID;
+
+    pthread_mutex_lock(&wal->lock);
+    ErrorCode err = wal_flush(wal);
+    pthread_mutex_unlock(&wal->lock);
+    return err;
+}
+
+/**
+ * Make one record durable on its own: it is written and fsynced without
+ * flushing, or being dropped with, the records buffered so far.
+ */
+ErrorCode mdb_wal_write_direct(MDBWal* wal, const MDBWalRecord* record,
+                               const void* payload)
+{
+    if (!wal || !record || (!payload && record->size > 0)) return ERR_INVALID;
+
+    uint8_t* buf = malloc(WAL_RECORD_HEADER_SIZE + record->size);
+    if (!buf) return ERR_UNKNOWN;
+
+    pthread_mutex_lock(&wal->lock);
+    MDBWalRecord r = *record;
+    r.lsn = wal->next_lsn++;
+    wal_header_encode(&r, buf);
+    if (r.size > 0) memcpy(buf + WAL_RECORD_HEADER_SIZE, payload, r.size);
+    ErrorCode err = wal_write(wal, buf, WAL_RECORD_HEADER_SIZE + r.size);
+    pthread_mutex_unlock(&wal->lock);
+
+    free(buf);
+    return err;
+}
+
+/**
+ * Call `fn` for every durable record, oldest first. Records still sitting
+ * in the append buffer are not visited. Stops early if `fn` fails.
+ */
+ErrorCode mdb_wal_scan(MDBWal* wal, MDBWalScanFn fn, void* ctx)
+{
+    if (!wal || !fn) return ERR_INVALID;
+
+    pthread_mutex_lock(&wal->lock);
+    if (fseek(wal->fp, 0, SEEK_SET) != 0)
+    {
+        pthread_mutex_unlock(&wal->lock);
+        return ERR_IO;
+    }
+
+    uint8_t header[WAL_RECORD_HEADER_SIZE];
+    void* payload = NULL;
+    size_t payload_cap = 0;
+    ErrorCode err = OK;
+
+    while (fread(header, 1, sizeof(header), wal->fp) == sizeof(header))
+    {
+        MDBWalRecord record;
+        wal_header_decode(header, &record);
+
+        if (record.size > payload_cap)
+        {
+            void* p = realloc(payload, record.size);
+            if (!p)
+            {
+                err = ERR_UNKNOWN;
+                break;
+            }
+            payload = p;
+            payload_cap = record.size;
+        }
+
+        if (record.size > 0 && fread(payload, 1, record.size, wal->fp) != record.size)
+        {
+            break; // Torn tail
+        }
+
+        err = fn(ctx, &record, payload);
+        if (err != OK) break;
+    }
+    pthread_mutex_unlock(&wal->lock);
+
+    free(payload);
+    return err;
+}
+
+/**
+ * Number of bytes appended but not yet flushed. Usable as a mark for
+ * mdb_wal_discard.
+ */
+size_t mdb_wal_buffered(MDBWal* wal)
+{
+    if (!wal) return 0;
+
+    pthread_mutex_lock(&wal->lock);
+    size_t len = wal->len;
+    pthread_mutex_unlock(&wal->lock);
+    return len;
+}
+
+/**
+ * Drop buffered records appended after `mark`. Their LSNs are not reused.
+ */
+ErrorCode mdb_wal_discard(MDBWal* wal, size_t mark)
+{
+    if (!wal) return ERR_INVALID;
+
+    pthread_mutex_lock(&wal->lock);
+    ErrorCode err = mark <= wal->len ? OK : ERR_INVALID;
+    if (err == OK) wal->len = mark;
+    pthread_mutex_unlock(&wal->lock);
+    return err;
+}
+
+ErrorCode mdb_wal_commit(MDBWal* wal)
+{
+    if (!wal) return ERR_INVALID;
+
+    MDBWalRecord record = {.type = WAL_OP_COMMIT};
+    pthread_mutex_lock(&wal->lock);
+    ErrorCode err = wal_append(wal, &record, NULL);
+    if (err == OK) err = wal_flush(wal);
+    pthread_mutex_unlock(&wal->lock);
+    return err;
+}
+
+static ErrorCode db_wal(MiniDB* db)
+{
+    if (db->wal) return OK;
+    return mdb_wal_open(db, &db->wal);
+}
+
+/**
+ * The database's own WAL, opened on first use and closed by mdb_close.
+ */
+ErrorCode mdb_wal_get(MiniDB* db, MDBWal** out_wal)
+{
+    if (!db || !out_wal) return ERR_INVALID;
+
+    ErrorCode err = db_wal(db);
+    if (err == OK) *out_wal = db->wal;
+    return err;
+}
+
+ErrorCode mdb_log(MiniDB* db, const MDBWalRecord* record, const void* payload)
+{
+    if (!db || !record) return ERR_INVALID;
+
+    ErrorCode err = db_wal(db);
+    if (err != OK) return err;
+
+    size_t mark = mdb_wal_buffered(db->wal);
+    err = mdb_wal_append(db->wal, record, payload);
+    if (err != OK || db->in_txn) return err;
+
+    err = mdb_wal_commit(db->wal);
+    if (err != OK) mdb_wal_discard(db->wal, mark);
+    return err;
+}
+
+ErrorCode mdb_begin(MiniDB* db)
+{
+    if (!db || db->in_txn) return ERR_INVALID;
+
+    ErrorCode err = db_wal(db);
+    if (err != OK) return err;
+
+    db->in_txn = true;
+    db->txn_start = mdb_wal_buffered(db->wal);
+    return OK;
+}
+
+ErrorCode mdb_commit(MiniDB* db)
+{
+    if (!db || !db->in_txn) return ERR_INVALID;
+
+    ErrorCode err = mdb_wal_commit(db->wal);
+    if (err != OK)
+    {
+        // Nothing of the transaction is durable; treat it as aborted.
+        mdb_wal_discard(db->wal, db->txn_start);
+    }
+
+    db->in_txn = false;
+    return err;
+}
+
+ErrorCode mdb_rollback(MiniDB* db)
+{
+    if (!db || !db->in_txn) return ERR_INVALID;
+
+    db->in_txn = false;
+    return mdb_wal_discard(db->wal, db->txn_start);
+}
+
+bool mdb_in_transaction(const MiniDB* db)
+{
+    return db && db->in_txn;
+}
@@ -0,0 +1,426 @@
+#include "zonemap.h"
+#include "heap.h"
+#include "mvcc.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Zone maps.
+ *
+ * A zone map summarises the values on each heap page of a table: the
+ * min/max of every INT column and a small bloom filter for every TEXT
+ * column. A scan with a WHERE clause asks the map first and skips pages
+ * that cannot hold a match without reading them. Tables that are appended
+ * to in time order are the sweet spot: the pages' ranges barely overlap,
+ * so a range query on the time column reads just the few pages at the
+ * matching end.
+ *
+ * Summaries only ever widen as rows are added (inserts, and the new
+ * version written by an update). Deleted values stay in the summary,
+ * which keeps it conservative: a page may be read needlessly but is never
+ * skipped wrongly. mdb_zone_map_reset_page plus re-adding the live rows
+ * tightens a page again, e.g. after it has been compacted.
+ *
+ * Pages the map knows nothing about always "may match". The map lives in
+ * memory only; mdb_zone_map_build fills it from a table's heap pages, e.g.
+ * when the table is opened.
+ *
+ * Entries sit in an open-addressed table keyed by page number, with each
+ * entry's per-column summaries in a parallel array.
+ */
+
+#define ZONE_INITIAL_SLOTS 64
+#define BLOOM_WORDS (MDB_ZONE_BLOOM_BITS / 64)
+#define BLOOM_HASHES 3
+#define NO_PAGE 0 // page 0 is the file header, never a heap page
+
+typedef struct
+{
+    int64_t min;
+    int64_t max;
+    uint64_t bloom[BLOOM_WORDS];
+    uint32_t nvalues; // non-NULL values seen
+} ZoneColumn;
+
+struct MDBZoneMap
+{
+    pthread_mutex_t lock;
+    MDBColumnType* types;
+    uint16_t ncols;
+
+    MDBPageNumber* pages; // NO_PAGE marks an empty slot
+    ZoneColumn* zones;    // ncols entries per slot
+    uint32_t nslots;
+    uint32_t npages;
+};
+
+static uint32_t slot_of(const MDBZoneMap* map, MDBPageNumber page_num)
+{
+    return (page_num * 2654435769u) & (map->nslots - 1);
+}
+
+static ZoneColumn* zones_at(MDBZoneMap* map, uint32_t slot)
+{
+    return &map->zones[(size_t)slot * map->ncols];
+}
+
+static int64_t find_slot(MDBZoneMap* map, MDBPageNumber page_num)
+{
+    for (uint32_t s = slot_of(map, page_num);; s = (s + 1) & (map->nslots - 1))
+    {
+        if (map->pages[s] == page_num) return s;
+        if (map->pages[s] == NO_PAGE) return -1;
+    }
+}
+
+static void zones_clear(MDBZoneMap* map, ZoneColumn* z)
+{
+    memset(z, 0, sizeof(ZoneColumn) * map->ncols);
+    for (uint16_t c = 0; c < map->ncols; c++)
+    {
+        z[c].min = INT64_MAX;
+        z[c].max = INT64_MIN;
+    }
+}
+
+static ErrorCode zone_map_alloc(MDBZoneMap* map, uint32_t nslots)
+{
+    map->pages = calloc(nslots, sizeof(MDBPageNumber));
+    map->zones = malloc(sizeof(ZoneColumn) * nslots * (map->ncols ? map->ncols : 1));
+    if (!map->pages || !map->zones)
+    {
+        free(map->pages);
+        free(map->zones);
+        return ERR_UNKNOWN;
+    }
+    map->nslots = nslots;
+    return OK;
+}
+
+/**
+ * Double the table once it is three quarters full.
+ */
+static ErrorCode zone_map_grow(MDBZoneMap* map)
+{
+    if ((map->npages + 1) * 4 < map->nslots * 3) return OK;
+
+    MDBPageNumber* old_pages = map->pages;
+    ZoneColumn* old_zones = map->zones;
+    uint32_t old_slots = map->nslots;
+
+    ErrorCode err = zone_map_alloc(map, old_slots * 2);
+    if (err != OK)
+    {
+        map->pages = old_pages;
+        map->zones = old_zones;
+        return err;
+    }
+
+    for (uint32_t i = 0; i < old_slots; i++)
+    {
+        if (old_pages[i] == NO_PAGE) continue;
+
+        uint32_t s = slot_of(map, old_pages[i]);
+        while (map->pages[s] != NO_PAGE)
+        {
+            s = (s + 1) & (map->nslots - 1);
+        }
+        map->pages[s] = old_pages[i];
+        memcpy(zones_at(map, s), &old_zones[(size_t)i * map->ncols], sizeof(ZoneColumn) * map->ncols);
+    }
+
+    free(old_pages);
+    free(old_zones);
+    return OK;
+}
+
+/**
+ * Find a page's summaries, adding an empty entry if it has none.
+ */
+static ZoneColumn* zone_entry(MDBZoneMap* map, MDBPageNumber page_num)
+{
+    int64_t found = find_slot(map, page_num);
+    if (found >= 0) return zones_at(map, (uint32_t)found);
+
+    if (zone_map_grow(map) != OK) return NULL;
+
+    uint32_t s = slot_of(map, page_num);
+    while (map->pages[s] != NO_PAGE)
+    {
+        s = (s + 1) & (map->nslots - 1);
+    }
+    map->pages[s] = page_num;
+    map->npages++;
+
+    ZoneColumn* z = zones_at(map, s);
+    zones_clear(map, z);
+    return z;
+}
+
+ErrorCode mdb_zone_map_create(const MDBColumnDef* cols, uint16_t ncols,
+                              MDBZoneMap** out_map)
+{
+    if ((!cols && ncols > 0) || !out_map) return ERR_INVALID;
+
+    MDBZoneMap* map = calloc(1, sizeof(MDBZoneMap));
+    if (!map) return ERR_UNKNOWN;
+
+    map->types = malloc(sizeof(MDBColumnType) * (ncols ? ncols : 1));
+    map->ncols = ncols;
+    if (!map->types || zone_map_alloc(map, ZONE_INITIAL_SLOTS) != OK)
+    {
+        free(map->types);
+        free(map);
+        return ERR_UNKNOWN;
+    }
+
+    for (uint16_t c = 0; c < ncols; c++)
+    {
+        map->types[c] = cols[c].type;
+    }
+    pthread_mutex_init(&map->lock, NULL);
+
+    *out_map = map;
+    return OK;
+}
+
+void mdb_zone_map_destroy(MDBZoneMap* map)
+{
+    if (!map) return;
+
+    pthread_mutex_destroy(&map->lock);
+    free(map->types);
+    free(map->pages);
+    free(map->zones);
+    free(map);
+}
+
+/**
+ * 64-bit FNV-1a; the two halves seed double hashing for the bloom bits.
+ */
+static uint64_t text_hash(UTF8String s)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (uint16_t i = 0; i < s.length; i++)
+    {
+        h ^= (uint8_t)s.ptr[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void bloom_add(uint64_t* bloom, uint64_t h)
+{
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    for (uint32_t i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint32_t bit = (h1 + i * h2) % MDB_ZONE_BLOOM_BITS;
+        bloom[bit / 64] |= 1ull << (bit % 64);
+    }
+}
+
+static bool bloom_has(const uint64_t* bloom, uint64_t h)
+{
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    for (uint32_t i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint32_t bit = (h1 + i * h2) % MDB_ZONE_BLOOM_BITS;
+        if (!(bloom[bit / 64] & (1ull << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+/**
+ * Widen a page's summaries to cover one more row.
+ */
+ErrorCode mdb_zone_map_add_row(MDBZoneMap* map, MDBPageNumber page_num,
+                               const MDBValue* cols, uint16_t ncols)
+{
+    if (!map || page_num == NO_PAGE || (!cols && ncols > 0)) return ERR_INVALID;
+    if (ncols > map->ncols) return ERR_INVALID;
+
+    pthread_mutex_lock(&map->lock);
+
+    ZoneColumn* z = zone_entry(map, page_num);
+    if (!z)
+    {
+        pthread_mutex_unlock(&map->lock);
+        return ERR_UNKNOWN;
+    }
+
+    for (uint16_t c = 0; c < ncols; c++)
+    {
+        const MDBValue* v = &cols[c];
+        if (v->is_null) continue;
+        z[c].nvalues++;
+
+        if (map->types[c] == COL_TYPE_INT)
+        {
+            if (v->integer < z[c].min) z[c].min = v->integer;
+            if (v->integer > z[c].max) z[c].max = v->integer;
+        }
+        else if (mdb_value_is_external(v))
+        {
+            // Only the prefix is at hand, so give up on filtering this page.
+            memset(z[c].bloom, 0xFF, sizeof(z[c].bloom));
+        }
+        else
+        {
+            bloom_add(z[c].bloom, text_hash(v->text));
+        }
+    }
+
+    pthread_mutex_unlock(&map->lock);
+    return OK;
+}
+
+/**
+ * Empty a page's summaries so they can be rebuilt from its live rows.
+ * Until rows are added again, nothing on the page is reported to match.
+ */
+ErrorCode mdb_zone_map_reset_page(MDBZoneMap* map, MDBPageNumber page_num)
+{
+    if (!map || page_num == NO_PAGE) return ERR_INVALID;
+
+    pthread_mutex_lock(&map->lock);
+    ZoneColumn* z = zone_entry(map, page_num);
+    if (z) zones_clear(map, z);
+    pthread_mutex_unlock(&map->lock);
+
+    return z ? OK : ERR_UNKNOWN;
+}
+
+/**
+ * Forget a page, e.g. once it has gone back to the free list. Uses
+ * backward-shift deletion so probe chains stay intact without tombstones.
+ */
+void mdb_zone_map_drop_page(MDBZoneMap* map, MDBPageNumber page_num)
+{
+    if (!map) return;
+
+    pthread_mutex_lock(&map->lock);
+
+    int64_t found = find_slot(map, page_num);
+    if (found >= 0)
+    {
+        uint32_t mask = map->nslots - 1;
+        uint32_t hole = (uint32_t)found;
+        for (uint32_t s = (hole + 1) & mask; map->pages[s] != NO_PAGE; s = (s + 1) & mask)
+        {
+            // Move the entry back if its home slot doesn't lie in (hole, s].
+            uint32_t home = slot_of(map, map->pages[s]);
+            if (((s - home) & mask) >= ((s - hole) & mask))
+            {
+                map->pages[hole] = map->pages[s];
+                memcpy(zones_at(map, hole), zones_at(map, s), sizeof(ZoneColumn) * map->ncols);
+                hole = s;
+            }
+        }
+        map->pages[hole] = NO_PAGE;
+        map->npages--;
+    }
+
+    pthread_mutex_unlock(&map->lock);
+}
+
+/**
+ * Summarise every row version on the heap pages of table `table_id` from
+ * scratch. Deleted versions are added too, as they would have been when
+ * they were inserted, so the result is as conservative as a map kept up
+ * to date row by row.
+ */
+ErrorCode mdb_zone_map_build(MDBZoneMap* map, MiniDB* db, uint32_t table_id)
+{
+    if (!map || !db) return ERR_INVALID;
+
+    MDBValue* vals = malloc(sizeof(MDBValue) * (map->ncols ? map->ncols : 1));
+    if (!vals) return ERR_UNKNOWN;
+
+    MDBPageScan scan;
+    mdb_page_scan_begin(db, 1, mdb_page_count(db), 0, &scan);
+
+    MDBPage page;
+    MDBPageNumber page_num;
+    ErrorCode err = OK;
+    while (err == OK && mdb_page_scan_next(&scan, &page, &page_num))
+    {
+        MDBHeapHeader h;
+        memcpy(&h, page.data, sizeof(h));
+        if (h.type != PG_HEAP || h.table_id != table_id) continue;
+
+        err = mdb_zone_map_reset_page(map, page_num);
+
+        MDBHeapIter it;
+        mdb_heap_iter_init(&it);
+        const uint8_t* record;
+        uint16_t size;
+        while (err == OK && mdb_heap_page_iter_next(&page, &it, NULL, &record, &size))
+        {
+            uint16_t n;
+            if (size < sizeof(MDBTupleHeader) ||
+                !mdb_row_decode(record + sizeof(MDBTupleHeader), size - sizeof(MDBTupleHeader),
+                                vals, map->ncols, &n))
+            {
+                err = ERR_CORRUPT;
+                break;
+            }
+            err = mdb_zone_map_add_row(map, page_num, vals, n);
+        }
+    }
+    if (err == OK) err = scan.err;
+
+    free(vals);
+    return err;
+}
+
+/**
+ * Could the page hold a row whose column `col` equals `value`? False
+ * means the page can be skipped; true means it has to be read.
+ */
+bool mdb_zone_map_may_contain(MDBZoneMap* map, MDBPageNumber page_num,
+                              uint16_t col, const MDBValue* value)
+{
+    if (!map || !value || col >= map->ncols || value->is_null) return true;
+
+    if (map->types[col] == COL_TYPE_INT)
+    {
+        return mdb_zone_map_may_overlap(map, page_num, col, value->integer, value->integer);
+    }
+
+    // The bloom filter is over full values, so a prefix can't be checked.
+    if (mdb_value_is_external(value)) return true;
+
+    uint64_t h = text_hash(value->text);
+
+    pthread_mutex_lock(&map->lock);
+    int64_t found = find_slot(map, page_num);
+    bool may = found < 0 || bloom_has(zones_at(map, (uint32_t)found)[col].bloom, h);
+    pthread_mutex_unlock(&map->lock);
+
+    return may;
+}
+
+/**
+ * Could the page hold a row whose INT column `col` lies in [lo, hi]?
+ */
+bool mdb_zone_map_may_overlap(MDBZoneMap* map, MDBPageNumber page_num,
+                              uint16_t col, int64_t lo, int64_t hi)
+{
+    if (!map || col >= map->ncols || map->types[col] != COL_TYPE_INT) return true;
+
+    pthread_mutex_lock(&map->lock);
+
+    bool may = true;
+    int64_t found = find_slot(map, page_num);
+    if (found >= 0)
+    {
+        const ZoneColumn* z = &zones_at(map, (uint32_t)found)[col];
+        may = z->nvalues > 0 && z->min <= hi && z->max >= lo;
+    }
+
+    pthread_mutex_unlock(&map->lock);
+    return may;
+}
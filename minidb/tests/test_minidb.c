@@ -1,9 +1,2703 @@
+#include "backup.h"
+#include "btree.h"
+#include "bufpool.h"
+#include "catalog.h"
+#include "column.h"
+#include "crc32c.h"
+#include "freelist.h"
+#include "hash.h"
+#include "heap.h"
+#include "io.h"
+#include "latch.h"
+#include "lz.h"
+#include "metrics.h"
+#include "mvcc.h"
+#include "overflow.h"
+#include "qcache.h"
+#include "rowbatch.h"
+#include "server.h"
+#include "stats.h"
+#include "wal.h"
 #include "unity.h"
+#include "zonemap.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 // Placeholder for future database tests (non-REPL related)
 void test_placeholder(void)
 {
     TEST_ASSERT_EQUAL(1, 1);
-}
\ No newline at end of file
+}
+
+static UTF8String text_key(const char* s)
+{
+    UTF8String key = {(uint16_t)strlen(s), s};
+    return key;
+}
+
+void test_btree_leaf_insert_keeps_keys_sorted(void)
+{
+    const char* keys[] = {"carol@example.com", "alice@example.com", "dave@example.com", "bob@example.com"};
+
+    MDBPage page;
+    mdb_btree_leaf_init(&page);
+
+    for (uint16_t i = 0; i < 4; i++)
+    {
+        MDBRecord rec = {.page_num = 10 + i, .slot = i};
+        TEST_ASSERT_EQUAL(OK, mdb_btree_leaf_insert(&page, text_key(keys[i]), rec));
+    }
+
+    TEST_ASSERT_EQUAL(4, mdb_btree_leaf_count(&page));
+
+    const char* expected[] = {"alice@example.com", "bob@example.com", "carol@example.com", "dave@example.com"};
+    for (uint16_t i = 0; i < 4; i++)
+    {
+        char buf[64];
+        uint16_t len;
+        MDBRecord rec;
+        TEST_ASSERT_EQUAL(OK, mdb_btree_leaf_get(&page, i, buf, sizeof(buf), &len, &rec));
+        buf[len] = '\0';
+        TEST_ASSERT_EQUAL_STRING(expected[i], buf);
+    }
+
+    uint16_t idx;
+    TEST_ASSERT_TRUE(mdb_btree_leaf_find(&page, text_key("carol@example.com"), &idx));
+    TEST_ASSERT_EQUAL(2, idx);
+    TEST_ASSERT_FALSE(mdb_btree_leaf_find(&page, text_key("bobby@example.com"), &idx));
+    TEST_ASSERT_EQUAL(2, idx);
+}
+
+void test_btree_leaf_prefix_compression(void)
+{
+    const char* base = "https://example.com/articles/2024/";
+    uint16_t base_len = (uint16_t)strlen(base);
+
+    MDBPage page;
+    mdb_btree_leaf_init(&page);
+
+    // Uncompressed, every entry costs base_len + 4 + cell/slot overhead.
+    uint16_t uncompressed_fit = (MDB_PAGE_SIZE - sizeof(MDBBTreeLeafHeader)) / (base_len + 4 + 10);
+
+    uint16_t n = 0;
+    for (;;)
+    {
+        char key[64];
+        snprintf(key, sizeof(key), "%s%04u", base, n);
+        MDBRecord rec = {.page_num = n, .slot = 0};
+        if (mdb_btree_leaf_insert(&page, text_key(key), rec) != OK) break;
+        n++;
+    }
+
+    TEST_ASSERT_TRUE(mdb_btree_leaf_prefix_len(&page) >= base_len);
+    TEST_ASSERT_TRUE(n > uncompressed_fit * 2);
+
+    char buf[64];
+    uint16_t len;
+    MDBRecord rec;
+    TEST_ASSERT_EQUAL(OK, mdb_btree_leaf_get(&page, 42, buf, sizeof(buf), &len, &rec));
+    buf[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("https://example.com/articles/2024/0042", buf);
+    TEST_ASSERT_EQUAL(42, rec.page_num);
+
+    // A key outside the shared prefix still goes in, shrinking the prefix,
+    // as long as the decompressed keys fit.
+    while (mdb_btree_leaf_count(&page) > 50)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_btree_leaf_delete(&page, 0));
+    }
+    rec.page_num = 9999;
+    TEST_ASSERT_EQUAL(OK, mdb_btree_leaf_insert(&page, text_key("https://example.com/a"), rec));
+    TEST_ASSERT_TRUE(mdb_btree_leaf_prefix_len(&page) < base_len);
+
+    uint16_t idx;
+    TEST_ASSERT_TRUE(mdb_btree_leaf_find(&page, text_key("https://example.com/a"), &idx));
+    TEST_ASSERT_EQUAL(0, idx);
+    char last[64];
+    snprintf(last, sizeof(last), "%s%04u", base, n - 1);
+    TEST_ASSERT_TRUE(mdb_btree_leaf_find(&page, text_key(last), &idx));
+    TEST_ASSERT_EQUAL(50, idx);
+}
+
+void test_btree_leaf_split_truncates_separator(void)
+{
+    const char* keys[] = {"user/alpha/profile", "user/bravo/profile", "user/charlie/profile", "user/delta/profile"};
+
+    MDBPage left, right;
+    mdb_btree_leaf_init(&left);
+    for (uint16_t i = 0; i < 4; i++)
+    {
+        MDBRecord rec = {.page_num = i, .slot = 0};
+        TEST_ASSERT_EQUAL(OK, mdb_btree_leaf_insert(&left, text_key(keys[i]), rec));
+    }
+
+    char sep[64];
+    uint16_t sep_len;
+    TEST_ASSERT_EQUAL(OK, mdb_btree_leaf_split(&left, &right, sep, sizeof(sep), &sep_len));
+
+    TEST_ASSERT_EQUAL(2, mdb_btree_leaf_count(&left));
+    TEST_ASSERT_EQUAL(2, mdb_btree_leaf_count(&right));
+    TEST_ASSERT_EQUAL(6, sep_len);
+    TEST_ASSERT_EQUAL_MEMORY("user/c", sep, sep_len);
+
+    // Each half gets the longest prefix its own key range allows.
+    TEST_ASSERT_EQUAL(5, mdb_btree_leaf_prefix_len(&left));
+
+    uint16_t idx;
+    TEST_ASSERT_TRUE(mdb_btree_leaf_find(&right, text_key("user/delta/profile"), &idx));
+    TEST_ASSERT_EQUAL(1, idx);
+}
+
+void test_btree_tree_insert_and_lookup(void)
+{
+    remove("test_btree.db");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_btree.db", &db));
+
+    MDBPageNumber root;
+    TEST_ASSERT_EQUAL(OK, mdb_btree_create(db, &root));
+
+    // Enough keys, inserted out of order, to split leaves and then the root.
+    enum { N = 20000, DUPS = 500 };
+    char key[64];
+    for (uint32_t i = 0; i < N; i++)
+    {
+        uint32_t k = i * 7919 % N;
+        snprintf(key, sizeof(key), "https://example.com/users/%08u/profile", k);
+        MDBRecord rec = {.page_num = k, .slot = 1};
+        TEST_ASSERT_EQUAL(OK, mdb_btree_insert(db, root, text_key(key), rec));
+        if (i % 40 == 0)
+        {
+            rec.slot = 2;
+            TEST_ASSERT_EQUAL(OK, mdb_btree_insert(db, root, text_key("https://example.com/users/dup"), rec));
+        }
+    }
+
+    MDBPage page;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, root, &page));
+    TEST_ASSERT_TRUE(mdb_page_is_type(&page, PG_INDEX_INTERNAL));
+    TEST_ASSERT_TRUE(mdb_btree_internal_count(&page) > 0);
+
+    MDBRecord recs[DUPS];
+    uint32_t count;
+    for (uint32_t k = 0; k < N; k++)
+    {
+        snprintf(key, sizeof(key), "https://example.com/users/%08u/profile", k);
+        TEST_ASSERT_EQUAL(OK, mdb_btree_lookup(db, root, text_key(key), recs, DUPS, &count));
+        TEST_ASSERT_EQUAL_UINT32(1, count);
+        TEST_ASSERT_EQUAL_UINT32(k, recs[0].page_num);
+    }
+
+    // Equal keys spread over several leaves are all found.
+    TEST_ASSERT_EQUAL(OK, mdb_btree_lookup(db, root, text_key("https://example.com/users/dup"), recs, DUPS, &count));
+    TEST_ASSERT_EQUAL_UINT32(N / 40, count);
+    TEST_ASSERT_EQUAL(ERR_FULL, mdb_btree_lookup(db, root, text_key("https://example.com/users/dup"), recs, 3, &count));
+    TEST_ASSERT_EQUAL_UINT32(N / 40, count);
+
+    TEST_ASSERT_EQUAL(OK, mdb_btree_lookup(db, root, text_key("https://example.com/users/x"), recs, DUPS, &count));
+    TEST_ASSERT_EQUAL_UINT32(0, count);
+
+    static char long_key[MDB_BTREE_KEY_MAX + 1];
+    memset(long_key, 'k', sizeof(long_key));
+    UTF8String too_long = {sizeof(long_key), long_key};
+    TEST_ASSERT_EQUAL(ERR_FULL, mdb_btree_insert(db, root, too_long, recs[0]));
+
+    mdb_close(db);
+    remove("test_btree.db");
+}
+
+void test_btree_separator(void)
+{
+    char out[32];
+    uint16_t len;
+
+    TEST_ASSERT_EQUAL(OK, mdb_btree_separator(text_key("apple"), text_key("apricot"), out, sizeof(out), &len));
+    TEST_ASSERT_EQUAL_MEMORY("apr", out, len);
+    TEST_ASSERT_EQUAL(3, len);
+
+    // When lower is a prefix of upper, one extra byte is enough.
+    TEST_ASSERT_EQUAL(OK, mdb_btree_separator(text_key("abc"), text_key("abcdef"), out, sizeof(out), &len));
+    TEST_ASSERT_EQUAL(4, len);
+
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_btree_separator(text_key("b"), text_key("a"), out, sizeof(out), &len));
+}
+
+void test_hash_bucket_insert_lookup(void)
+{
+    MDBPage page;
+    mdb_hash_bucket_init(&page, 0);
+
+    uint64_t token_hash = mdb_hash_key(mdb_value_text("3f2a9c", 6));
+    uint64_t other_hash = mdb_hash_key(mdb_value_text("77b1e0", 6));
+    TEST_ASSERT_NOT_EQUAL(token_hash, other_hash);
+    TEST_ASSERT_EQUAL(mdb_hash_key(mdb_value_int(42)), mdb_hash_key(mdb_value_int(42)));
+
+    MDBRecord a = {.page_num = 3, .slot = 1};
+    MDBRecord b = {.page_num = 7, .slot = 2};
+    TEST_ASSERT_EQUAL(OK, mdb_hash_bucket_insert(&page, token_hash, a));
+    TEST_ASSERT_EQUAL(OK, mdb_hash_bucket_insert(&page, other_hash, b));
+
+    MDBRecord out[4];
+    uint32_t count;
+    TEST_ASSERT_EQUAL(OK, mdb_hash_bucket_lookup(&page, token_hash, out, 4, &count));
+    TEST_ASSERT_EQUAL(1, count);
+    TEST_ASSERT_EQUAL(3, out[0].page_num);
+    TEST_ASSERT_EQUAL(1, out[0].slot);
+
+    TEST_ASSERT_EQUAL(OK, mdb_hash_bucket_delete(&page, token_hash, a));
+    TEST_ASSERT_EQUAL(OK, mdb_hash_bucket_lookup(&page, token_hash, out, 4, &count));
+    TEST_ASSERT_EQUAL(0, count);
+    TEST_ASSERT_EQUAL(1, mdb_hash_bucket_count(&page));
+}
+
+void test_hash_bucket_split(void)
+{
+    MDBPage page, image;
+    mdb_hash_bucket_init(&page, 0);
+
+    uint32_t n = 0;
+    for (;;)
+    {
+        MDBRecord rec = {.page_num = n, .slot = 0};
+        if (mdb_hash_bucket_insert(&page, mdb_hash_key(mdb_value_int(n)), rec) != OK) break;
+        n++;
+    }
+    TEST_ASSERT_EQUAL(MDB_HASH_BUCKET_CAPACITY, n);
+
+    TEST_ASSERT_EQUAL(OK, mdb_hash_bucket_split(&page, &image));
+    TEST_ASSERT_EQUAL(1, mdb_hash_bucket_local_depth(&page));
+    TEST_ASSERT_EQUAL(1, mdb_hash_bucket_local_depth(&image));
+    TEST_ASSERT_EQUAL(n, mdb_hash_bucket_count(&page) + mdb_hash_bucket_count(&image));
+
+    // Every key must now be found in the bucket its directory slot selects.
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t h = mdb_hash_key(mdb_value_int(i));
+        const MDBPage* bucket = mdb_hash_dir_slot(h, 1) ? &image : &page;
+
+        MDBRecord out[2];
+        uint32_t count;
+        TEST_ASSERT_EQUAL(OK, mdb_hash_bucket_lookup(bucket, h, out, 2, &count));
+        TEST_ASSERT_EQUAL(1, count);
+        TEST_ASSERT_EQUAL(i, out[0].page_num);
+    }
+}
+
+void test_hash_index_grows_and_chains(void)
+{
+    remove("test_hash.db");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_hash.db", &db));
+
+    MDBPageNumber dir;
+    TEST_ASSERT_EQUAL(OK, mdb_hash_create(db, &dir));
+
+    // Distinct keys split buckets and grow the directory; one key
+    // repeated past a bucket's capacity can only go to an overflow chain.
+    uint32_t distinct = 3 * MDB_HASH_BUCKET_CAPACITY;
+    uint32_t dups = 2 * MDB_HASH_BUCKET_CAPACITY + 1;
+    uint64_t dup_hash = mdb_hash_key(mdb_value_text("same", 4));
+    for (uint32_t i = 0; i < distinct; i++)
+    {
+        MDBRecord rec = {.page_num = i, .slot = 0};
+        TEST_ASSERT_EQUAL(OK, mdb_hash_insert(db, dir, mdb_hash_key(mdb_value_int(i)), rec));
+    }
+    for (uint32_t i = 0; i < dups; i++)
+    {
+        MDBRecord rec = {.page_num = i, .slot = 1};
+        TEST_ASSERT_EQUAL(OK, mdb_hash_insert(db, dir, dup_hash, rec));
+    }
+
+    MDBPage page;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, dir, &page));
+    TEST_ASSERT_GREATER_THAN(1, ((MDBHashDirHeader*)page.data)->global_depth);
+
+    MDBRecord out[4];
+    uint32_t count;
+    for (uint32_t i = 0; i < distinct; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_hash_lookup(db, dir, mdb_hash_key(mdb_value_int(i)), out, 4, &count));
+        TEST_ASSERT_EQUAL(1, count);
+        TEST_ASSERT_EQUAL(i, out[0].page_num);
+    }
+    TEST_ASSERT_EQUAL(ERR_FULL, mdb_hash_lookup(db, dir, dup_hash, out, 4, &count));
+    TEST_ASSERT_EQUAL(dups, count);
+
+    MDBRecord last = {.page_num = dups - 1, .slot = 1};
+    TEST_ASSERT_EQUAL(OK, mdb_hash_delete(db, dir, dup_hash, last));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_hash_delete(db, dir, dup_hash, last));
+    TEST_ASSERT_EQUAL(ERR_FULL, mdb_hash_lookup(db, dir, dup_hash, NULL, 0, &count));
+    TEST_ASSERT_EQUAL(dups - 1, count);
+
+    mdb_close(db);
+    remove("test_hash.db");
+}
+
+void test_catalog_tables(void)
+{
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}, {"email", COL_TYPE_TEXT}};
+
+    // Enough tables to force the hash table to grow a few times.
+    for (int i = 0; i < 100; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "table_%d", i);
+        TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, name, cols, 2, 100 + i));
+    }
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_catalog_create_table(catalog, "table_7", cols, 2, 1));
+
+    MDBCatalogTableMetadata meta;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get(catalog, "table_42", &meta));
+    TEST_ASSERT_EQUAL_STRING("table_42", meta.name);
+    TEST_ASSERT_EQUAL(142, meta.heap_root);
+    TEST_ASSERT_EQUAL(2, meta.ncols);
+
+    MDBRowID a, b;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_alloc_row_id(catalog, "table_42", &a));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_alloc_row_id(catalog, "table_42", &b));
+    TEST_ASSERT_EQUAL(a + 1, b);
+
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_drop_table(catalog, "table_42"));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_catalog_get(catalog, "table_42", &meta));
+
+    MDBCatalogTableMetadata* tables;
+    uint32_t count;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_list_tables(catalog, &tables, &count));
+    TEST_ASSERT_EQUAL(99, count);
+    free(tables);
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_catalog.db");
+}
+
+void test_catalog_indexes_follow_table(void)
+{
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+
+    MDBCatalogColumn cols[] = {{"token", COL_TYPE_TEXT}, {"user_id", COL_TYPE_INT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "sessions", cols, 2, 5));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "users", cols, 2, 6));
+
+    MDBCatalogIndexMetadata idx = {.name = "sessions_token", .table_name = "sessions", .col_idx = 0, .type = MDB_INDEX_HASH, .root_page = 9};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_add_index(catalog, &idx));
+
+    MDBCatalogIndexMetadata idx2 = {.name = "sessions_user", .table_name = "sessions", .col_idx = 1, .type = MDB_INDEX_BTREE, .root_page = 10};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_add_index(catalog, &idx2));
+
+    MDBCatalogIndexMetadata bad = {.name = "users_missing", .table_name = "users", .col_idx = 5};
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_catalog_add_index(catalog, &bad));
+
+    MDBCatalogIndexMetadata meta;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_index(catalog, "sessions_token", &meta));
+    TEST_ASSERT_EQUAL(MDB_INDEX_HASH, meta.type);
+    TEST_ASSERT_EQUAL(9, meta.root_page);
+
+    MDBCatalogIndexMetadata* list;
+    uint32_t count;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_list_indexes(catalog, "sessions", &list, &count));
+    TEST_ASSERT_EQUAL(2, count);
+    free(list);
+
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_list_indexes(catalog, "users", &list, &count));
+    TEST_ASSERT_EQUAL(0, count);
+    free(list);
+
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_drop_index(catalog, "sessions_user"));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_list_indexes(catalog, "sessions", &list, &count));
+    TEST_ASSERT_EQUAL(1, count);
+    free(list);
+
+    // Dropping the table drops its remaining indexes as well.
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_drop_table(catalog, "sessions"));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_catalog_get_index(catalog, "sessions_token", &meta));
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_catalog.db");
+}
+
+void test_catalog_persists(void)
+{
+    remove("test_catalog.db");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}, {"email", COL_TYPE_TEXT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "users", cols, 2, 7));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "gone", cols, 1, 8));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_table_flags(catalog, "users", MDB_TABLE_COMPRESSED));
+    MDBColumnStats stats = {.row_count = 42, .distinct = 40};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_column_stats(catalog, "users", 0, &stats));
+    MDBCatalogIndexMetadata idx = {.name = "users_email", .table_name = "users", .col_idx = 1, .type = MDB_INDEX_HASH, .root_page = 9};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_add_index(catalog, &idx));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_drop_table(catalog, "gone"));
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+
+    MDBCatalogTableMetadata meta;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get(catalog, "users", &meta));
+    TEST_ASSERT_EQUAL(7, meta.heap_root);
+    TEST_ASSERT_EQUAL(2, meta.ncols);
+    TEST_ASSERT_EQUAL(MDB_TABLE_COMPRESSED, meta.flags);
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_catalog_get(catalog, "gone", &meta));
+
+    bool analyzed;
+    MDBColumnStats got;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_column_stats(catalog, "users", 0, &got, &analyzed));
+    TEST_ASSERT_TRUE(analyzed);
+    TEST_ASSERT_EQUAL(42, got.row_count);
+
+    MDBCatalogIndexMetadata ix;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_index(catalog, "users_email", &ix));
+    TEST_ASSERT_EQUAL(MDB_INDEX_HASH, ix.type);
+    TEST_ASSERT_EQUAL(9, ix.root_page);
+
+    // Rewriting the catalog frees the previous chain.
+    uint32_t pages = mdb_io_page_count(db);
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_table_flags(catalog, "users", 0));
+    TEST_ASSERT_EQUAL(pages, mdb_io_page_count(db));
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_catalog.db");
+}
+
+void test_catalog_row_ids_recover_from_wal(void)
+{
+    remove("test_catalog.db-wal");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "events", cols, 1, 1));
+
+    MDBRowID id = 0;
+    for (int i = 0; i < 2000; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_catalog_alloc_row_id(catalog, "events", &id));
+    }
+    TEST_ASSERT_EQUAL(2000, id);
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+
+    // Simulate a restart: the table comes back from the file, its counter
+    // from the logged reservations, skipping the rest of the last batch
+    // rather than reusing ids.
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_alloc_row_id(catalog, "events", &id));
+    TEST_ASSERT_EQUAL(1 + 2 * MDB_ROW_ID_BATCH, id);
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_catalog.db");
+    remove("test_catalog.db-wal");
+}
+
+static ErrorCode count_wal_types(void* ctx, const MDBWalRecord* record,
+                                 const void* payload)
+{
+    (void)payload;
+    uint32_t* counts = ctx;
+    counts[record->type]++;
+    return OK;
+}
+
+void test_catalog_row_id_reservation_skips_open_txn(void)
+{
+    remove("test_catalog.db");
+    remove("test_catalog.db-wal");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+    MDBWal* wal;
+    TEST_ASSERT_EQUAL(OK, mdb_wal_get(db, &wal));
+
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "events", cols, 1, 1));
+
+    // A transaction's record is buffered when the first insert reserves
+    // ids, and is then rolled back: only the reservation may be durable.
+    size_t mark = mdb_wal_buffered(wal);
+    MDBWalRecord insert = {WAL_OP_INSERT, 0, 1, 3};
+    TEST_ASSERT_EQUAL(OK, mdb_wal_append(wal, &insert, "abc"));
+    MDBRowID id;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_alloc_row_id(catalog, "events", &id));
+    TEST_ASSERT_EQUAL(OK, mdb_wal_discard(wal, mark));
+
+    uint32_t counts[WAL_OP_ROW_ID_RESERVE + 1] = {0};
+    TEST_ASSERT_EQUAL(OK, mdb_wal_scan(wal, count_wal_types, counts));
+    TEST_ASSERT_EQUAL(0, counts[WAL_OP_INSERT]);
+    TEST_ASSERT_EQUAL(1, counts[WAL_OP_ROW_ID_RESERVE]);
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_catalog.db");
+    remove("test_catalog.db-wal");
+}
+
+#define ROW_ID_THREADS 4
+#define ROW_ID_PER_THREAD 5000
+
+typedef struct
+{
+    MDBCatalog* catalog;
+    MDBRowID ids[ROW_ID_PER_THREAD];
+} RowIdWorker;
+
+static void* row_id_worker(void* arg)
+{
+    RowIdWorker* w = arg;
+    for (int i = 0; i < ROW_ID_PER_THREAD; i++)
+    {
+        mdb_catalog_alloc_row_id(w->catalog, "events", &w->ids[i]);
+    }
+    return NULL;
+}
+
+void test_catalog_row_ids_concurrent(void)
+{
+    remove("test_catalog.db-wal");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_catalog.db", &db));
+
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "events", cols, 1, 1));
+
+    static RowIdWorker workers[ROW_ID_THREADS];
+    pthread_t threads[ROW_ID_THREADS];
+    for (int i = 0; i < ROW_ID_THREADS; i++)
+    {
+        workers[i].catalog = catalog;
+        pthread_create(&threads[i], NULL, row_id_worker, &workers[i]);
+    }
+    for (int i = 0; i < ROW_ID_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Every id in 1..N must have been handed out exactly once.
+    uint32_t total = ROW_ID_THREADS * ROW_ID_PER_THREAD;
+    uint8_t* seen = calloc(total + 1, 1);
+    for (int i = 0; i < ROW_ID_THREADS; i++)
+    {
+        for (int j = 0; j < ROW_ID_PER_THREAD; j++)
+        {
+            MDBRowID id = workers[i].ids[j];
+            TEST_ASSERT_TRUE(id >= 1 && id <= total);
+            TEST_ASSERT_EQUAL(0, seen[id]);
+            seen[id] = 1;
+        }
+    }
+    free(seen);
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_catalog.db");
+    remove("test_catalog.db-wal");
+}
+
+void test_heap_page_insert_get_delete(void)
+{
+    MDBPage page;
+    mdb_heap_page_init(&page, 7);
+
+    MDBSlotID a, b;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_insert(&page, (const uint8_t*)"alpha", 5, &a));
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_insert(&page, (const uint8_t*)"bravo", 5, &b));
+
+    const uint8_t* rec;
+    uint16_t size;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_get(&page, b, &rec, &size));
+    TEST_ASSERT_EQUAL(5, size);
+    TEST_ASSERT_EQUAL_MEMORY("bravo", rec, 5);
+
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_delete(&page, a));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_heap_page_get(&page, a, &rec, &size));
+
+    // The deleted slot is reused so slot ids stay dense.
+    MDBSlotID c;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_insert(&page, (const uint8_t*)"charlie", 7, &c));
+    TEST_ASSERT_EQUAL(a, c);
+
+    MDBHeapIter it;
+    mdb_heap_iter_init(&it);
+    int n = 0;
+    while (mdb_heap_page_iter_next(&page, &it, NULL, NULL, NULL))
+    {
+        n++;
+    }
+    TEST_ASSERT_EQUAL(2, n);
+
+    uint8_t big[MDB_PAGE_USABLE_SIZE] = {0};
+    MDBSlotID s;
+    TEST_ASSERT_EQUAL(ERR_FULL, mdb_heap_page_insert(&page, big, sizeof(big), &s));
+}
+
+void test_mvcc_snapshot_isolation(void)
+{
+    remove("test_mvcc.db");
+    remove("test_mvcc.db-wal");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_mvcc.db", &db));
+    MDBTxnManager* mgr;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_manager_create(db, &mgr));
+
+    MDBPage page;
+    mdb_heap_page_init(&page, 1);
+
+    // Writer inserts a row but has not committed yet.
+    MDBTxnID writer;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_begin(mgr, &writer));
+    MDBSlotID slot;
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, writer, (const uint8_t*)"v1", 2, &slot));
+
+    MDBSnapshot before;
+    TEST_ASSERT_EQUAL(OK, mdb_snapshot_take(mgr, MDB_TXN_INVALID, &before));
+
+    const uint8_t* rec;
+    uint16_t size;
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_mvcc_get(mgr, &page, slot, &before, &rec, &size));
+
+    // The writer sees its own insert.
+    MDBSnapshot own;
+    TEST_ASSERT_EQUAL(OK, mdb_snapshot_take(mgr, writer, &own));
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_get(mgr, &page, slot, &own, &rec, &size));
+    TEST_ASSERT_EQUAL_MEMORY("v1", rec, 2);
+    mdb_snapshot_release(&own);
+
+    TEST_ASSERT_EQUAL(OK, mdb_txn_commit(mgr, writer));
+
+    // The old snapshot still doesn't see it; a new one does.
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_mvcc_get(mgr, &page, slot, &before, &rec, &size));
+
+    MDBSnapshot after;
+    TEST_ASSERT_EQUAL(OK, mdb_snapshot_take(mgr, MDB_TXN_INVALID, &after));
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_get(mgr, &page, slot, &after, &rec, &size));
+
+    // An update by a later transaction: delete the old version, add a new one.
+    MDBTxnID updater;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_begin(mgr, &updater));
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_delete(mgr, 1, &page, slot, updater));
+    MDBSlotID slot2;
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, updater, (const uint8_t*)"v2", 2, &slot2));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_commit(mgr, updater));
+
+    // The reader that started before the update keeps seeing exactly v1.
+    MDBHeapIter it;
+    mdb_heap_iter_init(&it);
+    int n = 0;
+    while (mdb_mvcc_iter_next(mgr, &page, &it, &after, NULL, &rec, &size))
+    {
+        TEST_ASSERT_EQUAL_MEMORY("v1", rec, 2);
+        n++;
+    }
+    TEST_ASSERT_EQUAL(1, n);
+
+    MDBSnapshot latest;
+    TEST_ASSERT_EQUAL(OK, mdb_snapshot_take(mgr, MDB_TXN_INVALID, &latest));
+    mdb_heap_iter_init(&it);
+    n = 0;
+    while (mdb_mvcc_iter_next(mgr, &page, &it, &latest, NULL, &rec, &size))
+    {
+        TEST_ASSERT_EQUAL_MEMORY("v2", rec, 2);
+        n++;
+    }
+    TEST_ASSERT_EQUAL(1, n);
+
+    // Aborted inserts are never visible.
+    MDBTxnID aborted;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_begin(mgr, &aborted));
+    MDBSlotID slot3;
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, aborted, (const uint8_t*)"v3", 2, &slot3));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_abort(mgr, aborted));
+
+    MDBSnapshot final;
+    TEST_ASSERT_EQUAL(OK, mdb_snapshot_take(mgr, MDB_TXN_INVALID, &final));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_mvcc_get(mgr, &page, slot3, &final, &rec, &size));
+
+    mdb_snapshot_release(&before);
+    mdb_snapshot_release(&after);
+    mdb_snapshot_release(&latest);
+    mdb_snapshot_release(&final);
+    mdb_txn_manager_destroy(mgr);
+    mdb_close(db);
+    remove("test_mvcc.db");
+    remove("test_mvcc.db-wal");
+}
+
+void test_mvcc_write_conflict(void)
+{
+    remove("test_mvcc.db");
+    remove("test_mvcc.db-wal");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_mvcc.db", &db));
+    MDBTxnManager* mgr;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_manager_create(db, &mgr));
+
+    MDBPage page;
+    mdb_heap_page_init(&page, 1);
+
+    MDBTxnID setup;
+    mdb_txn_begin(mgr, &setup);
+    MDBSlotID slot;
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, setup, (const uint8_t*)"row", 3, &slot));
+    mdb_txn_commit(mgr, setup);
+
+    MDBTxnID t1, t2;
+    mdb_txn_begin(mgr, &t1);
+    mdb_txn_begin(mgr, &t2);
+
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_delete(mgr, 1, &page, slot, t1));
+    TEST_ASSERT_EQUAL(ERR_CONFLICT, mdb_mvcc_delete(mgr, 1, &page, slot, t2));
+
+    // Once the first deleter aborts the row is up for grabs again.
+    TEST_ASSERT_EQUAL(OK, mdb_txn_abort(mgr, t1));
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_delete(mgr, 1, &page, slot, t2));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_commit(mgr, t2));
+
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_txn_commit(mgr, t2));
+
+    mdb_txn_manager_destroy(mgr);
+    mdb_close(db);
+    remove("test_mvcc.db");
+    remove("test_mvcc.db-wal");
+}
+
+void test_mvcc_survives_reopen(void)
+{
+    remove("test_mvcc.db");
+    remove("test_mvcc.db-wal");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_mvcc.db", &db));
+    MDBTxnManager* mgr;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_manager_create(db, &mgr));
+
+    // One committed, one rolled back, one still running at "the crash".
+    MDBPage page;
+    mdb_heap_page_init(&page, 1);
+    MDBTxnID committed, aborted, running;
+    MDBSlotID a, b, c;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_begin(mgr, &committed));
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, committed, (const uint8_t*)"a", 1, &a));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_commit(mgr, committed));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_begin(mgr, &aborted));
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, aborted, (const uint8_t*)"b", 1, &b));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_abort(mgr, aborted));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_begin(mgr, &running));
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, running, (const uint8_t*)"c", 1, &c));
+
+    mdb_txn_manager_destroy(mgr);
+    mdb_close(db);
+
+    // The page keeps its xids; the reopened manager must judge them the
+    // same way and never hand them out again.
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_mvcc.db", &db));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_manager_create(db, &mgr));
+    TEST_ASSERT_EQUAL(MDB_TXN_COMMITTED, mdb_txn_status(mgr, committed));
+    TEST_ASSERT_EQUAL(MDB_TXN_ABORTED, mdb_txn_status(mgr, aborted));
+    TEST_ASSERT_EQUAL(MDB_TXN_ABORTED, mdb_txn_status(mgr, running));
+
+    MDBTxnID next;
+    TEST_ASSERT_EQUAL(OK, mdb_txn_begin(mgr, &next));
+    TEST_ASSERT_TRUE(next > running);
+
+    MDBSnapshot snapshot;
+    TEST_ASSERT_EQUAL(OK, mdb_snapshot_take(mgr, next, &snapshot));
+    const uint8_t* rec;
+    uint16_t size;
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_get(mgr, &page, a, &snapshot, &rec, &size));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_mvcc_get(mgr, &page, b, &snapshot, &rec, &size));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_mvcc_get(mgr, &page, c, &snapshot, &rec, &size));
+
+    // Rows from before the restart can still be deleted.
+    TEST_ASSERT_EQUAL(OK, mdb_mvcc_delete(mgr, 1, &page, a, next));
+    TEST_ASSERT_EQUAL(OK, mdb_txn_commit(mgr, next));
+
+    mdb_snapshot_release(&snapshot);
+    mdb_txn_manager_destroy(mgr);
+    mdb_close(db);
+    remove("test_mvcc.db");
+    remove("test_mvcc.db-wal");
+}
+
+void test_row_encode_decode(void)
+{
+    MDBValue cols[] = {mdb_value_int(-42), mdb_value_null(), mdb_value_text("hello", 5)};
+
+    uint8_t buf[64];
+    uint16_t size;
+    TEST_ASSERT_TRUE(mdb_row_encode(cols, 3, buf, sizeof(buf), &size));
+    TEST_ASSERT_EQUAL(mdb_row_encoded_size(cols, 3), size);
+    TEST_ASSERT_FALSE(mdb_row_encode(cols, 3, buf, size - 1, &size));
+
+    MDBValue out[4];
+    uint16_t ncols;
+    TEST_ASSERT_TRUE(mdb_row_decode(buf, size, out, 4, &ncols));
+    TEST_ASSERT_EQUAL(3, ncols);
+    TEST_ASSERT_EQUAL(-42, out[0].integer);
+    TEST_ASSERT_TRUE(out[1].is_null);
+    TEST_ASSERT_EQUAL(COL_TYPE_TEXT, out[2].type);
+    TEST_ASSERT_EQUAL_MEMORY("hello", out[2].text.ptr, 5);
+
+    // Truncated input is rejected rather than read past.
+    TEST_ASSERT_FALSE(mdb_row_decode(buf, size - 2, out, 4, &ncols));
+}
+
+typedef struct
+{
+    int changes;
+    int commits;
+} WalCounts;
+
+static ErrorCode count_wal_records(void* ctx, const MDBWalRecord* record,
+                                   const void* payload)
+{
+    (void)payload;
+    WalCounts* counts = ctx;
+    if (record->type == WAL_OP_COMMIT)
+        counts->commits++;
+    else
+        counts->changes++;
+    return OK;
+}
+
+void test_txn_commit_batches_wal_records(void)
+{
+    remove("test_txn.db");
+    remove("test_txn.db-wal");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_txn.db", &db));
+
+    MDBWalRecord change = {.type = WAL_OP_INSERT, .size = 3};
+
+    // Autocommit: one commit record per change.
+    TEST_ASSERT_EQUAL(OK, mdb_log(db, &change, "abc"));
+
+    // Rolled back work never reaches the log.
+    TEST_ASSERT_EQUAL(OK, mdb_begin(db));
+    TEST_ASSERT_EQUAL(OK, mdb_log(db, &change, "def"));
+    TEST_ASSERT_EQUAL(OK, mdb_rollback(db));
+
+    // Many changes share one commit record.
+    TEST_ASSERT_EQUAL(OK, mdb_begin(db));
+    TEST_ASSERT_TRUE(mdb_in_transaction(db));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_begin(db));
+    for (int i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_log(db, &change, "ghi"));
+    }
+    TEST_ASSERT_EQUAL(OK, mdb_commit(db));
+    TEST_ASSERT_FALSE(mdb_in_transaction(db));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_commit(db));
+
+    mdb_close(db);
+
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_txn.db", &db));
+    MDBWal* wal;
+    TEST_ASSERT_EQUAL(OK, mdb_wal_open(db, &wal));
+
+    WalCounts counts = {0};
+    TEST_ASSERT_EQUAL(OK, mdb_wal_scan(wal, count_wal_records, &counts));
+    TEST_ASSERT_EQUAL(101, counts.changes);
+    TEST_ASSERT_EQUAL(2, counts.commits);
+
+    mdb_wal_close(wal);
+    mdb_close(db);
+    remove("test_txn.db");
+    remove("test_txn.db-wal");
+}
+
+void test_latch_shared_exclusive(void)
+{
+    MDBLatchTable* latches;
+    TEST_ASSERT_EQUAL(OK, mdb_latch_table_create(&latches));
+
+    // Readers share a page; a writer has to wait for all of them.
+    TEST_ASSERT_EQUAL(OK, mdb_latch_acquire(latches, 7, MDB_LATCH_SHARED));
+    TEST_ASSERT_TRUE(mdb_latch_try_acquire(latches, 7, MDB_LATCH_SHARED));
+    TEST_ASSERT_FALSE(mdb_latch_try_acquire(latches, 7, MDB_LATCH_EXCLUSIVE));
+
+    // Other pages are independent.
+    TEST_ASSERT_TRUE(mdb_latch_try_acquire(latches, 8, MDB_LATCH_EXCLUSIVE));
+    TEST_ASSERT_FALSE(mdb_latch_try_acquire(latches, 8, MDB_LATCH_SHARED));
+    mdb_latch_release(latches, 8);
+
+    mdb_latch_release(latches, 7);
+    TEST_ASSERT_FALSE(mdb_latch_try_acquire(latches, 7, MDB_LATCH_EXCLUSIVE));
+    mdb_latch_release(latches, 7);
+    TEST_ASSERT_TRUE(mdb_latch_try_acquire(latches, 7, MDB_LATCH_EXCLUSIVE));
+    mdb_latch_release(latches, 7);
+
+    mdb_latch_table_destroy(latches);
+}
+
+void test_latch_crabbing_releases_ancestors(void)
+{
+    MDBLatchTable* latches;
+    TEST_ASSERT_EQUAL(OK, mdb_latch_table_create(&latches));
+
+    MDBPage leaf;
+    mdb_btree_leaf_init(&leaf);
+    TEST_ASSERT_TRUE(mdb_btree_leaf_is_safe(&leaf, 64));
+    TEST_ASSERT_FALSE(mdb_btree_leaf_is_safe(&leaf, MDB_PAGE_USABLE_SIZE));
+
+    // Insert descent: root -> inner -> leaf, all exclusive until the leaf
+    // is known not to split.
+    MDBLatchPath path;
+    mdb_latch_path_init(&path);
+    TEST_ASSERT_EQUAL(OK, mdb_latch_path_push(latches, &path, 1, MDB_LATCH_EXCLUSIVE));
+    TEST_ASSERT_EQUAL(OK, mdb_latch_path_push(latches, &path, 2, MDB_LATCH_EXCLUSIVE));
+    TEST_ASSERT_EQUAL(OK, mdb_latch_path_push(latches, &path, 3, MDB_LATCH_EXCLUSIVE));
+    TEST_ASSERT_FALSE(mdb_latch_try_acquire(latches, 1, MDB_LATCH_SHARED));
+
+    if (mdb_btree_leaf_is_safe(&leaf, 64)) mdb_latch_path_release_ancestors(latches, &path);
+    TEST_ASSERT_EQUAL(1, path.depth);
+    TEST_ASSERT_EQUAL(3, path.pages[0]);
+
+    // Other threads can now descend through the root and inner page.
+    TEST_ASSERT_TRUE(mdb_latch_try_acquire(latches, 1, MDB_LATCH_SHARED));
+    TEST_ASSERT_TRUE(mdb_latch_try_acquire(latches, 2, MDB_LATCH_SHARED));
+    TEST_ASSERT_FALSE(mdb_latch_try_acquire(latches, 3, MDB_LATCH_SHARED));
+    mdb_latch_release(latches, 1);
+    mdb_latch_release(latches, 2);
+
+    mdb_latch_path_release_all(latches, &path);
+    TEST_ASSERT_EQUAL(0, path.depth);
+    TEST_ASSERT_TRUE(mdb_latch_try_acquire(latches, 3, MDB_LATCH_EXCLUSIVE));
+    mdb_latch_release(latches, 3);
+
+    mdb_latch_table_destroy(latches);
+}
+
+#define LATCH_THREADS 4
+#define LATCH_ROUNDS 20000
+
+typedef struct
+{
+    MDBLatchTable* latches;
+    uint64_t* counter;
+} LatchWorker;
+
+static void* latch_worker(void* arg)
+{
+    LatchWorker* w = arg;
+    for (int i = 0; i < LATCH_ROUNDS; i++)
+    {
+        mdb_latch_acquire(w->latches, 42, MDB_LATCH_EXCLUSIVE);
+        (*w->counter)++;
+        mdb_latch_release(w->latches, 42);
+    }
+    return NULL;
+}
+
+void test_latch_exclusive_across_threads(void)
+{
+    MDBLatchTable* latches;
+    TEST_ASSERT_EQUAL(OK, mdb_latch_table_create(&latches));
+
+    uint64_t counter = 0;
+    LatchWorker workers[LATCH_THREADS];
+    pthread_t threads[LATCH_THREADS];
+    for (int i = 0; i < LATCH_THREADS; i++)
+    {
+        workers[i].latches = latches;
+        workers[i].counter = &counter;
+        pthread_create(&threads[i], NULL, latch_worker, &workers[i]);
+    }
+    for (int i = 0; i < LATCH_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_EQUAL_UINT64(LATCH_THREADS * LATCH_ROUNDS, counter);
+    mdb_latch_table_destroy(latches);
+}
+
+void test_page_allocate_read_write(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    TEST_ASSERT_EQUAL(1, mdb_page_count(db));
+
+    MDBPage page;
+    mdb_heap_page_init(&page, 1);
+    MDBPageNumber page_num;
+    TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &page_num));
+    TEST_ASSERT_EQUAL(1, page_num);
+    TEST_ASSERT_EQUAL(2, mdb_page_count(db));
+
+    MDBSlotID slot;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_insert(&page, (const uint8_t*)"hello", 5, &slot));
+    TEST_ASSERT_EQUAL(OK, mdb_page_write(db, page_num, &page));
+
+    MDBPage read;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, page_num, &read));
+    TEST_ASSERT_EQUAL_MEMORY(page.data, read.data, MDB_PAGE_SIZE);
+
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_page_read(db, 2, &read));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_page_write(db, 0, &page));
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+#define IO_TEST_PAGES 100
+
+void test_io_batch_and_scan(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+
+    MDBPage blank;
+    mdb_page_zero(&blank);
+    MDBPageNumber page_num;
+    for (int i = 0; i < IO_TEST_PAGES; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &blank, &page_num));
+    }
+
+    // Write every page in one batch, deliberately out of order.
+    static MDBPage pages[IO_TEST_PAGES];
+    MDBIoRequest reqs[IO_TEST_PAGES];
+    for (uint32_t i = 0; i < IO_TEST_PAGES; i++)
+    {
+        uint32_t n = IO_TEST_PAGES - i;
+        mdb_page_zero(&pages[i]);
+        memcpy(pages[i].data + 8, &n, sizeof(n));
+        reqs[i].page_num = n;
+        reqs[i].page = &pages[i];
+    }
+    // The last page goes out compressed; the scan must hand it back expanded.
+    mdb_page_set_flags(&pages[0], MDB_PAGE_FLAG_COMPRESS);
+    TEST_ASSERT_EQUAL(OK, mdb_page_write_batch(db, reqs, IO_TEST_PAGES));
+    TEST_ASSERT_EQUAL(1, reqs[0].page_num);
+    TEST_ASSERT_EQUAL(OK, mdb_io_sync(db));
+
+    MDBPageScan scan;
+    mdb_page_scan_begin(db, 1, mdb_page_count(db), 8, &scan);
+
+    MDBPage page;
+    uint32_t seen = 0;
+    while (mdb_page_scan_next(&scan, &page, &page_num))
+    {
+        uint32_t n;
+        memcpy(&n, page.data + 8, sizeof(n));
+        TEST_ASSERT_EQUAL(page_num, n);
+        seen++;
+    }
+    TEST_ASSERT_EQUAL(OK, scan.err);
+    TEST_ASSERT_EQUAL(IO_TEST_PAGES, seen);
+
+    // A page that fails its checksum stops the scan.
+    page.data[8] ^= 0xff;
+    TEST_ASSERT_EQUAL(OK, mdb_io_write(db, 50, &page));
+    mdb_page_scan_begin(db, 1, mdb_page_count(db), 8, &scan);
+    seen = 0;
+    while (mdb_page_scan_next(&scan, &page, &page_num)) seen++;
+    TEST_ASSERT_EQUAL(ERR_CORRUPT, scan.err);
+    TEST_ASSERT_EQUAL(49, seen);
+
+    // Reading past the end of the file fails rather than returning zeros.
+    MDBIoRequest past = {IO_TEST_PAGES + 5, &page};
+    TEST_ASSERT_EQUAL(ERR_IO, mdb_io_read_batch(db, &past, 1));
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+#define ALLOC_THREADS 4
+#define ALLOC_PER_THREAD 200
+
+typedef struct
+{
+    MiniDB* db;
+    uint32_t tag;
+    MDBPageNumber pages[ALLOC_PER_THREAD];
+} AllocWorker;
+
+static void* alloc_worker(void* arg)
+{
+    AllocWorker* w = arg;
+    MDBPage page;
+    for (uint32_t i = 0; i < ALLOC_PER_THREAD; i++)
+    {
+        uint32_t tag = w->tag * ALLOC_PER_THREAD + i;
+        mdb_page_zero(&page);
+        memcpy(page.data + 8, &tag, sizeof(tag));
+        if (mdb_page_allocate(w->db, &page, &w->pages[i]) != OK) w->pages[i] = 0;
+    }
+    return NULL;
+}
+
+void test_page_allocate_concurrent(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+
+    static AllocWorker workers[ALLOC_THREADS];
+    pthread_t threads[ALLOC_THREADS];
+    for (uint32_t i = 0; i < ALLOC_THREADS; i++)
+    {
+        workers[i].db = db;
+        workers[i].tag = i;
+        pthread_create(&threads[i], NULL, alloc_worker, &workers[i]);
+    }
+    for (int i = 0; i < ALLOC_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Appends never share a page, and each page holds what its owner wrote.
+    uint32_t total = ALLOC_THREADS * ALLOC_PER_THREAD;
+    TEST_ASSERT_EQUAL(total + 1, mdb_page_count(db));
+    for (uint32_t i = 0; i < ALLOC_THREADS; i++)
+    {
+        for (uint32_t j = 0; j < ALLOC_PER_THREAD; j++)
+        {
+            MDBPage page;
+            uint32_t tag;
+            TEST_ASSERT_EQUAL(OK, mdb_page_read(db, workers[i].pages[j], &page));
+            memcpy(&tag, page.data + 8, sizeof(tag));
+            TEST_ASSERT_EQUAL(i * ALLOC_PER_THREAD + j, tag);
+        }
+    }
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+static MiniDB* open_with_pages(const char* filename, uint32_t n)
+{
+    remove(filename);
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open(filename, &db));
+
+    MDBPage page;
+    MDBPageNumber page_num;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        mdb_heap_page_init(&page, i);
+        TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &page_num));
+    }
+    return db;
+}
+
+void test_buffer_pool_scan_keeps_hot_pages(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 200);
+
+    MDBBufferPool* pool;
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pool_create(db, 8, &pool));
+
+    // Warm the pool with a few "catalog" pages.
+    MDBPage* page;
+    for (MDBPageNumber p = 1; p <= 4; p++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_buffer_pin(pool, p, MDB_ACCESS_NORMAL, &page));
+        mdb_buffer_unpin(pool, page, false);
+    }
+
+    // A scan over far more pages than the pool holds.
+    MDBBufferScan scan;
+    mdb_buffer_scan_open(pool, 10, 200, &scan);
+    const MDBPage* scanned;
+    MDBPageNumber page_num;
+    uint32_t n = 0;
+    while (mdb_buffer_scan_next(&scan, &scanned, &page_num))
+    {
+        TEST_ASSERT_EQUAL(page_num - 1, ((const MDBHeapHeader*)scanned->data)->table_id);
+        n++;
+    }
+    mdb_buffer_scan_close(&scan);
+    TEST_ASSERT_EQUAL(OK, scan.err);
+    TEST_ASSERT_EQUAL(190, n);
+
+    MDBBufferStats before;
+    mdb_buffer_pool_stats(pool, &before);
+    TEST_ASSERT_EQUAL(190, before.ring_reads);
+
+    // The hot pages are all still cached.
+    for (MDBPageNumber p = 4; p >= 1; p--)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_buffer_pin(pool, p, MDB_ACCESS_NORMAL, &page));
+        mdb_buffer_unpin(pool, page, false);
+    }
+
+    MDBBufferStats after;
+    mdb_buffer_pool_stats(pool, &after);
+    TEST_ASSERT_EQUAL(before.misses, after.misses);
+    TEST_ASSERT_EQUAL(before.hits + 4, after.hits);
+
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pool_destroy(pool));
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_buffer_pool_sequential_detection_and_flush(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 100);
+
+    MDBBufferPool* pool;
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pool_create(db, 16, &pool));
+
+    MDBPage* hot;
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pin(pool, 50, MDB_ACCESS_NORMAL, &hot));
+    MDBSlotID slot;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_insert(hot, (const uint8_t*)"dirty", 5, &slot));
+    mdb_buffer_unpin(pool, hot, true);
+
+    // Plain page-by-page reads: after a short run the pool notices the
+    // pattern and moves them to the ring.
+    MDBPage* page;
+    for (MDBPageNumber p = 1; p < 40; p++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_buffer_pin(pool, p, MDB_ACCESS_NORMAL, &page));
+        mdb_buffer_unpin(pool, page, false);
+    }
+
+    MDBBufferStats stats;
+    mdb_buffer_pool_stats(pool, &stats);
+    TEST_ASSERT_TRUE(stats.ring_reads > 25);
+
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pin(pool, 50, MDB_ACCESS_NORMAL, &page));
+    TEST_ASSERT_EQUAL_PTR(hot, page);
+    mdb_buffer_unpin(pool, page, false);
+
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_flush(pool));
+
+    MDBPage on_disk;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 50, &on_disk));
+    const uint8_t* record;
+    uint16_t size;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_get(&on_disk, slot, &record, &size));
+    TEST_ASSERT_EQUAL_MEMORY("dirty", record, 5);
+
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pool_destroy(pool));
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+#define PIN_THREADS 4
+#define PIN_PAGES 32
+#define PIN_ROUNDS 2000
+
+typedef struct
+{
+    MDBBufferPool* pool;
+    uint32_t id;
+    ErrorCode err;
+} PinWorker;
+
+static void* pin_worker(void* arg)
+{
+    PinWorker* w = arg;
+    for (uint32_t i = 0; i < PIN_ROUNDS && w->err == OK; i++)
+    {
+        // Each thread owns the pages congruent to its id, so no two threads
+        // modify a page at once, but all of them fight over the frames.
+        MDBPageNumber p = 1 + (i * 5 % (PIN_PAGES / PIN_THREADS)) * PIN_THREADS + w->id;
+        MDBPage* page;
+        w->err = mdb_buffer_pin(w->pool, p, MDB_ACCESS_NORMAL, &page);
+        if (w->err != OK) break;
+
+        uint32_t count;
+        memcpy(&count, page->data + 8, sizeof(count));
+        count++;
+        memcpy(page->data + 8, &count, sizeof(count));
+        mdb_buffer_unpin(w->pool, page, true);
+    }
+    return NULL;
+}
+
+void test_buffer_pool_concurrent_pins(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+
+    MDBPage blank;
+    MDBPageNumber page_num;
+    for (uint32_t i = 0; i < PIN_PAGES; i++)
+    {
+        mdb_page_zero(&blank);
+        TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &blank, &page_num));
+    }
+
+    // Far fewer frames than pages, so most pins evict a dirty page.
+    MDBBufferPool* pool;
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pool_create(db, 6, &pool));
+
+    static PinWorker workers[PIN_THREADS];
+    pthread_t threads[PIN_THREADS];
+    for (uint32_t i = 0; i < PIN_THREADS; i++)
+    {
+        workers[i] = (PinWorker){pool, i, OK};
+        pthread_create(&threads[i], NULL, pin_worker, &workers[i]);
+    }
+    for (int i = 0; i < PIN_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        TEST_ASSERT_EQUAL(OK, workers[i].err);
+    }
+    TEST_ASSERT_EQUAL(OK, mdb_buffer_pool_destroy(pool));
+
+    // No increment was lost to a write-back racing a re-read.
+    uint32_t total = 0;
+    for (MDBPageNumber p = 1; p <= PIN_PAGES; p++)
+    {
+        MDBPage page;
+        uint32_t count;
+        TEST_ASSERT_EQUAL(OK, mdb_page_read(db, p, &page));
+        memcpy(&count, page.data + 8, sizeof(count));
+        total += count;
+    }
+    TEST_ASSERT_EQUAL(PIN_THREADS * PIN_ROUNDS, total);
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_crc32c(void)
+{
+    // Standard check value for CRC-32C.
+    TEST_ASSERT_EQUAL_HEX32(0xE3069283, mdb_crc32c(0, "123456789", 9));
+    TEST_ASSERT_EQUAL_HEX32(0xE3069283, mdb_crc32c_sw(0, "123456789", 9));
+
+    // Hardware and table paths agree on odd lengths and when chained.
+    uint8_t buf[5003];
+    for (size_t i = 0; i < sizeof(buf); i++)
+    {
+        buf[i] = (uint8_t)(i * 131 + 7);
+    }
+    uint32_t whole = mdb_crc32c(0, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_HEX32(whole, mdb_crc32c_sw(0, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_HEX32(whole, mdb_crc32c(mdb_crc32c(0, buf, 100), buf + 100, sizeof(buf) - 100));
+}
+
+void test_page_checksum_detects_corruption(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 2);
+
+    MDBPage page;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 0, &page));
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 2, &page));
+
+    // Flip one bit behind the checksum's back, as a torn or rotted write would.
+    page.data[1000] ^= 0x10;
+    TEST_ASSERT_EQUAL(OK, mdb_io_write(db, 2, &page));
+    TEST_ASSERT_EQUAL(ERR_CORRUPT, mdb_page_read(db, 2, &page));
+
+    // A normal write restamps the page.
+    TEST_ASSERT_EQUAL(OK, mdb_page_write(db, 2, &page));
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 2, &page));
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_lz_roundtrip(void)
+{
+    // Text-like input with plenty of repetition, including overlapping
+    // matches (runs) and long literal stretches.
+    static uint8_t input[8192];
+    size_t len = 0;
+    while (len + 64 < sizeof(input))
+    {
+        len += (size_t)snprintf((char*)input + len, 64, "order %zu status=shipped ", len % 97);
+    }
+    memset(input + len, 'x', sizeof(input) - len);
+    len = sizeof(input);
+
+    static uint8_t packed[8192];
+    static uint8_t unpacked[8192];
+    size_t n = mdb_lz_compress(input, len, packed, sizeof(packed));
+    TEST_ASSERT_TRUE(n > 0 && n < len / 3);
+    TEST_ASSERT_EQUAL(len, mdb_lz_decompress(packed, n, unpacked, sizeof(unpacked)));
+    TEST_ASSERT_EQUAL_MEMORY(input, unpacked, len);
+
+    // Incompressible data doesn't fit a smaller budget.
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < len; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        input[i] = (uint8_t)x;
+    }
+    TEST_ASSERT_EQUAL(0, mdb_lz_compress(input, len, packed, len / 2));
+
+    // Truncated input is rejected rather than read past.
+    n = mdb_lz_compress((const uint8_t*)"abcabcabcabcabcabc", 18, packed, sizeof(packed));
+    TEST_ASSERT_EQUAL(0, mdb_lz_decompress(packed, n - 2, unpacked, 8));
+}
+
+void test_compressed_heap_page_roundtrip(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 2);
+
+    MDBPage page;
+    mdb_heap_page_init(&page, 7);
+    mdb_page_set_flags(&page, MDB_PAGE_FLAG_COMPRESS);
+
+    char row[64];
+    MDBSlotID slot;
+    for (int i = 0; mdb_heap_page_has_space(&page, 48); i++)
+    {
+        int n = snprintf(row, sizeof(row), "2024-01-%02d archived order #%05d", i % 28 + 1, i);
+        TEST_ASSERT_EQUAL(OK, mdb_heap_page_insert(&page, (const uint8_t*)row, (uint16_t)n, &slot));
+    }
+    TEST_ASSERT_EQUAL(OK, mdb_page_write(db, 1, &page));
+
+    // On disk the slot starts with a compressed image, unless the page is
+    // a single file system block and a hole could not free anything...
+    bool compressed = MDB_PAGE_SIZE > mdb_io_block_size(db);
+    MDBPage raw;
+    TEST_ASSERT_EQUAL(OK, mdb_io_read(db, 1, &raw));
+    TEST_ASSERT_EQUAL(compressed, mdb_page_is_type(&raw, PG_COMPRESSED));
+    MDBCompressedPageHeader h;
+    memcpy(&h, raw.data, sizeof(h));
+    if (compressed) TEST_ASSERT_TRUE(h.size < MDB_PAGE_SIZE / 2);
+
+    // ...which reads back as the original page, still flagged.
+    MDBPage read;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 1, &read));
+    TEST_ASSERT_EQUAL_MEMORY(page.data, read.data, MDB_PAGE_SIZE);
+    TEST_ASSERT_EQUAL(MDB_PAGE_FLAG_COMPRESS, mdb_page_flags(&read));
+
+    // A damaged payload is caught.
+    raw.data[sizeof(h) + 10] ^= 0x01;
+    TEST_ASSERT_EQUAL(OK, mdb_io_write(db, 1, &raw));
+    TEST_ASSERT_EQUAL(ERR_CORRUPT, mdb_page_read(db, 1, &read));
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_overflow_large_text(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 0);
+
+    static char big[60000];
+    for (size_t i = 0; i < sizeof(big); i++)
+    {
+        big[i] = (char)('a' + i % 26);
+    }
+    const char* note = "short note";
+
+    MDBValue cols[3] = {mdb_value_int(1), mdb_value_text(big, sizeof(big)), mdb_value_text(note, 10)};
+    TEST_ASSERT_TRUE(mdb_row_encoded_size(cols, 3) > MDB_ROW_TARGET_SIZE);
+
+    TEST_ASSERT_EQUAL(OK, mdb_overflow_externalize(db, cols, 3));
+    TEST_ASSERT_TRUE(mdb_value_is_external(&cols[1]));
+    TEST_ASSERT_FALSE(mdb_value_is_external(&cols[2]));
+    TEST_ASSERT_TRUE(mdb_row_encoded_size(cols, 3) <= MDB_ROW_TARGET_SIZE);
+
+    // The row now fits comfortably on a heap page.
+    uint8_t encoded[MDB_ROW_TARGET_SIZE];
+    uint16_t size;
+    TEST_ASSERT_TRUE(mdb_row_encode(cols, 3, encoded, sizeof(encoded), &size));
+
+    MDBPage heap;
+    mdb_heap_page_init(&heap, 1);
+    MDBSlotID slot;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_insert(&heap, encoded, size, &slot));
+
+    const uint8_t* record;
+    TEST_ASSERT_EQUAL(OK, mdb_heap_page_get(&heap, slot, &record, &size));
+    MDBValue decoded[3];
+    uint16_t ncols;
+    TEST_ASSERT_TRUE(mdb_row_decode(record, size, decoded, 3, &ncols));
+
+    // Readers see the prefix without touching overflow pages...
+    TEST_ASSERT_TRUE(mdb_value_is_external(&decoded[1]));
+    TEST_ASSERT_EQUAL(MDB_OVERFLOW_PREFIX, decoded[1].text.length);
+    TEST_ASSERT_EQUAL_MEMORY(big, decoded[1].text.ptr, MDB_OVERFLOW_PREFIX);
+    TEST_ASSERT_EQUAL_STRING_LEN(note, decoded[2].text.ptr, 10);
+
+    // ...and can fetch the full value on demand.
+    static char buf[MDB_TEXT_MAX];
+    MDBValue full;
+    TEST_ASSERT_EQUAL(OK, mdb_overflow_fetch(db, &decoded[1], buf, sizeof(buf), &full));
+    TEST_ASSERT_EQUAL(sizeof(big), full.text.length);
+    TEST_ASSERT_EQUAL_MEMORY(big, full.text.ptr, sizeof(big));
+
+    TEST_ASSERT_EQUAL(ERR_FULL, mdb_overflow_fetch(db, &decoded[1], buf, 100, &full));
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_overflow_failure_frees_pages(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 0);
+    uint32_t pages = mdb_io_page_count(db);
+
+    // Let the file grow by one page less than the chain needs, so it
+    // fails partway.
+    static char big[MDB_TEXT_MAX];
+    uint32_t chain = (sizeof(big) + MDB_OVERFLOW_CAPACITY - 1) / MDB_OVERFLOW_CAPACITY;
+    struct rlimit saved, limit;
+    TEST_ASSERT_EQUAL(0, getrlimit(RLIMIT_FSIZE, &saved));
+    limit = saved;
+    limit.rlim_cur = (rlim_t)(pages + chain - 1) * MDB_PAGE_SIZE;
+    signal(SIGXFSZ, SIG_IGN);
+    TEST_ASSERT_EQUAL(0, setrlimit(RLIMIT_FSIZE, &limit));
+
+    memset(big, 'x', sizeof(big));
+    MDBValue cols[2] = {mdb_value_int(1), mdb_value_text(big, sizeof(big))};
+    ErrorCode err = mdb_overflow_externalize(db, cols, 2);
+
+    setrlimit(RLIMIT_FSIZE, &saved);
+    signal(SIGXFSZ, SIG_DFL);
+
+    // The value is back inline and the pages that were written are free.
+    TEST_ASSERT_NOT_EQUAL(OK, err);
+    TEST_ASSERT_FALSE(mdb_value_is_external(&cols[1]));
+    TEST_ASSERT_EQUAL(sizeof(big), cols[1].text.length);
+    TEST_ASSERT_EQUAL(chain - 1, mdb_freelist_count(db));
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_open_rejects_other_page_size(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    mdb_close(db);
+
+    // Rewrite the header as if another build had created the file.
+    FILE* fp = fopen("test_pages.db", "r+b");
+    MDBHeader header;
+    TEST_ASSERT_EQUAL(1, fread(&header, sizeof(header), 1, fp));
+    header.page_size = MDB_PAGE_SIZE == 4096 ? 8192 : 4096;
+    fseek(fp, 0, SEEK_SET);
+    TEST_ASSERT_EQUAL(1, fwrite(&header, sizeof(header), 1, fp));
+    fclose(fp);
+
+    TEST_ASSERT_EQUAL(ERR_UNSUPPORTED_FORMAT, mdb_open("test_pages.db", &db));
+    remove("test_pages.db");
+}
+
+void test_open_rejects_damaged_header(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    mdb_close(db);
+
+    // A field the open path doesn't otherwise look at still fails the
+    // page 0 checksum.
+    FILE* fp = fopen("test_pages.db", "r+b");
+    MDBHeader header;
+    TEST_ASSERT_EQUAL(1, fread(&header, sizeof(header), 1, fp));
+    header.free_count++;
+    fseek(fp, 0, SEEK_SET);
+    TEST_ASSERT_EQUAL(1, fwrite(&header, sizeof(header), 1, fp));
+    fclose(fp);
+    TEST_ASSERT_EQUAL(ERR_CORRUPT, mdb_open("test_pages.db", &db));
+
+    // Files from an older format version are refused outright.
+    fp = fopen("test_pages.db", "r+b");
+    header.free_count--;
+    header.version = MDB_VERSION - 1;
+    TEST_ASSERT_EQUAL(1, fwrite(&header, sizeof(header), 1, fp));
+    fclose(fp);
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_open("test_pages.db", &db));
+
+    remove("test_pages.db");
+}
+
+void test_freelist_reuses_pages(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 10);
+
+    TEST_ASSERT_EQUAL(OK, mdb_page_free(db, 3));
+    TEST_ASSERT_EQUAL(OK, mdb_page_free(db, 7));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_page_free(db, 0));
+    TEST_ASSERT_EQUAL(2, mdb_freelist_count(db));
+    mdb_close(db);
+
+    // The list lives in the file header and survives a reopen.
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    TEST_ASSERT_EQUAL(2, mdb_freelist_count(db));
+
+    MDBPage page;
+    MDBPageNumber a, b, c;
+    mdb_heap_page_init(&page, 1);
+    TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &a));
+    TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &b));
+    TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &c));
+
+    TEST_ASSERT_EQUAL(7, a);
+    TEST_ASSERT_EQUAL(3, b);
+    TEST_ASSERT_EQUAL(11, c);
+    TEST_ASSERT_EQUAL(0, mdb_freelist_count(db));
+    TEST_ASSERT_EQUAL(12, mdb_page_count(db));
+
+    MDBPage read;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 7, &read));
+    TEST_ASSERT_TRUE(mdb_page_is_type(&read, PG_HEAP));
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+typedef struct
+{
+    MiniDB* db;
+    MDBPageNumber from[4];
+    MDBPageNumber to[4];
+    MDBPageNumber trunk[4]; // free list head on disk during the move
+    uint32_t n;
+} RelocateLog;
+
+static ErrorCode record_relocate(void* ctx, MDBPageNumber from, MDBPageNumber to)
+{
+    RelocateLog* log = ctx;
+    MDBPage page;
+    MDBHeader h;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(log->db, 0, &page));
+    memcpy(&h, page.data, sizeof(h));
+    log->trunk[log->n] = h.free_trunk;
+    log->from[log->n] = from;
+    log->to[log->n] = to;
+    log->n++;
+    return OK;
+}
+
+void test_page_shrink_truncates_file(void)
+{
+    MiniDB* db = open_with_pages("test_pages.db", 20);
+
+    MDBPage page18, page17;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 18, &page18));
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 17, &page17));
+
+    MDBPageNumber freed[] = {5, 19, 20, 10};
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_page_free(db, freed[i]));
+    }
+
+    // One move per call: the free tail goes, then page 18 moves into 5.
+    // Page 5 is the list's only trunk, so the list must be off the header
+    // before anything is written there.
+    RelocateLog log = {.db = db};
+    uint32_t released;
+    TEST_ASSERT_EQUAL(OK, mdb_page_shrink(db, 1, record_relocate, &log, &released));
+    TEST_ASSERT_EQUAL(3, released);
+    TEST_ASSERT_EQUAL(1, log.n);
+    TEST_ASSERT_EQUAL(18, log.from[0]);
+    TEST_ASSERT_EQUAL(5, log.to[0]);
+    TEST_ASSERT_EQUAL(0, log.trunk[0]);
+    TEST_ASSERT_EQUAL(18, mdb_page_count(db));
+    TEST_ASSERT_EQUAL(1, mdb_freelist_count(db));
+
+    TEST_ASSERT_EQUAL(OK, mdb_page_shrink(db, 1, record_relocate, &log, &released));
+    TEST_ASSERT_EQUAL(1, released);
+    TEST_ASSERT_EQUAL(17, log.from[1]);
+    TEST_ASSERT_EQUAL(10, log.to[1]);
+    TEST_ASSERT_EQUAL(17, mdb_page_count(db));
+    TEST_ASSERT_EQUAL(0, mdb_freelist_count(db));
+
+    MDBPage read;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 5, &read));
+    TEST_ASSERT_EQUAL_MEMORY(page18.data, read.data, MDB_PAGE_USABLE_SIZE);
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, 10, &read));
+    TEST_ASSERT_EQUAL_MEMORY(page17.data, read.data, MDB_PAGE_USABLE_SIZE);
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+static MDBColumnPageHeader column_page_header(MiniDB* db, MDBPageNumber page_num)
+{
+    MDBPage page;
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, page_num, &page));
+    TEST_ASSERT_TRUE(mdb_page_is_type(&page, PG_COLUMN));
+
+    MDBColumnPageHeader h;
+    memcpy(&h, page.data, sizeof(h));
+    return h;
+}
+
+void test_column_int_frame_of_reference(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}, {"kind", COL_TYPE_TEXT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "events", cols, 2, 0));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_table_flags(catalog, "events", MDB_TABLE_COLUMNAR));
+
+    // Values spanning 200 fit in one byte each, so a page holds thousands.
+    enum { N = 10000 };
+    static MDBValue values[N];
+    for (uint32_t i = 0; i < N; i++)
+    {
+        values[i] = i % 97 == 0 ? mdb_value_null() : mdb_value_int(-1000000 + (int64_t)(i * 7919 % 200));
+    }
+
+    MDBPageNumber root = 0;
+    TEST_ASSERT_EQUAL(OK, mdb_column_append(db, COL_TYPE_INT, &root, values, N / 2));
+    TEST_ASSERT_EQUAL(OK, mdb_column_append(db, COL_TYPE_INT, &root, values + N / 2, N - N / 2));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_column_root(catalog, "events", 0, root));
+
+    MDBPageNumber stored;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_column_root(catalog, "events", 0, &stored));
+    TEST_ASSERT_EQUAL(root, stored);
+
+    MDBColumnPageHeader h = column_page_header(db, root);
+    TEST_ASSERT_EQUAL(MDB_COL_ENC_FOR, h.encoding);
+    TEST_ASSERT_TRUE(h.has_nulls);
+    TEST_ASSERT_TRUE(h.count > MDB_PAGE_USABLE_SIZE / 2 || h.count == N / 2);
+
+    MDBColumnScan scan;
+    TEST_ASSERT_EQUAL(OK, mdb_column_scan_open(db, stored, &scan));
+    const MDBValue* batch;
+    uint32_t count;
+    uint32_t seen = 0;
+    uint32_t pages = 0;
+    while (mdb_column_scan_next(&scan, &batch, &count))
+    {
+        for (uint32_t i = 0; i < count; i++, seen++)
+        {
+            TEST_ASSERT_EQUAL(values[seen].is_null, batch[i].is_null);
+            if (!batch[i].is_null) TEST_ASSERT_EQUAL_INT64(values[seen].integer, batch[i].integer);
+        }
+        pages++;
+    }
+    TEST_ASSERT_EQUAL(OK, scan.err);
+    mdb_column_scan_close(&scan);
+
+    TEST_ASSERT_EQUAL(N, seen);
+    TEST_ASSERT_TRUE(pages <= 2 * (N * 8 / (MDB_PAGE_USABLE_SIZE * 8 / 9) + 2));
+
+    // Mismatched types are rejected.
+    MDBValue text = mdb_value_text("x", 1);
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_column_append(db, COL_TYPE_INT, &root, &text, 1));
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_column_text_encodings(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+
+    // A few distinct values spread out: dictionary encoding.
+    static const char* kinds[] = {"click", "view", "purchase", "refund"};
+    enum { N = 3000 };
+    static MDBValue values[N];
+    for (uint32_t i = 0; i < N; i++)
+    {
+        const char* k = kinds[i * 31 % 4];
+        values[i] = i % 50 == 0 ? mdb_value_null() : mdb_value_text(k, (uint16_t)strlen(k));
+    }
+
+    MDBPageNumber dict_root = 0;
+    TEST_ASSERT_EQUAL(OK, mdb_column_append(db, COL_TYPE_TEXT, &dict_root, values, N));
+    TEST_ASSERT_EQUAL(MDB_COL_ENC_DICT, column_page_header(db, dict_root).encoding);
+
+    MDBColumnScan scan;
+    const MDBValue* batch;
+    uint32_t count;
+    uint32_t seen = 0;
+    TEST_ASSERT_EQUAL(OK, mdb_column_scan_open(db, dict_root, &scan));
+    while (mdb_column_scan_next(&scan, &batch, &count))
+    {
+        for (uint32_t i = 0; i < count; i++, seen++)
+        {
+            TEST_ASSERT_EQUAL(values[seen].is_null, batch[i].is_null);
+            if (batch[i].is_null) continue;
+            TEST_ASSERT_EQUAL(values[seen].text.length, batch[i].text.length);
+            TEST_ASSERT_EQUAL_MEMORY(values[seen].text.ptr, batch[i].text.ptr, batch[i].text.length);
+        }
+    }
+    mdb_column_scan_close(&scan);
+    TEST_ASSERT_EQUAL(N, seen);
+
+    // Long runs of many distinct values: run-length encoding.
+    static char names[N][8];
+    for (uint32_t i = 0; i < N; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "u%04u", i / 10);
+        values[i] = mdb_value_text(names[i], (uint16_t)strlen(names[i]));
+    }
+
+    MDBPageNumber rle_root = 0;
+    TEST_ASSERT_EQUAL(OK, mdb_column_append(db, COL_TYPE_TEXT, &rle_root, values, N));
+    MDBColumnPageHeader h = column_page_header(db, rle_root);
+    TEST_ASSERT_EQUAL(MDB_COL_ENC_RLE, h.encoding);
+    TEST_ASSERT_FALSE(h.has_nulls);
+
+    seen = 0;
+    TEST_ASSERT_EQUAL(OK, mdb_column_scan_open(db, rle_root, &scan));
+    while (mdb_column_scan_next(&scan, &batch, &count))
+    {
+        for (uint32_t i = 0; i < count; i++, seen++)
+        {
+            TEST_ASSERT_EQUAL_STRING_LEN(names[seen], batch[i].text.ptr, batch[i].text.length);
+        }
+    }
+    mdb_column_scan_close(&scan);
+    TEST_ASSERT_EQUAL(N, seen);
+
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_zone_map_skips_pages(void)
+{
+    MDBColumnDef cols[] = {{"ts", COL_TYPE_INT}, {"host", COL_TYPE_TEXT}};
+    MDBZoneMap* map;
+    TEST_ASSERT_EQUAL(OK, mdb_zone_map_create(cols, 2, &map));
+
+    // An append-only event table: 100 pages of 50 rows in timestamp order,
+    // each page written by a couple of hosts.
+    char hosts[100][16];
+    for (MDBPageNumber p = 1; p <= 100; p++)
+    {
+        snprintf(hosts[p - 1], sizeof(hosts[p - 1]), "host-%u", p);
+        for (int64_t i = 0; i < 50; i++)
+        {
+            const char* host = i % 2 ? hosts[p - 1] : "gateway";
+            MDBValue row[2] = {mdb_value_int((int64_t)p * 50 + i), mdb_value_text(host, (uint16_t)strlen(host))};
+            TEST_ASSERT_EQUAL(OK, mdb_zone_map_add_row(map, p, row, 2));
+        }
+    }
+
+    uint32_t ranged = 0;
+    uint32_t by_host = 0;
+    MDBValue wanted = mdb_value_text("host-7", 6);
+    for (MDBPageNumber p = 1; p <= 100; p++)
+    {
+        ranged += mdb_zone_map_may_overlap(map, p, 0, 2010, 2060);
+        by_host += mdb_zone_map_may_contain(map, p, 1, &wanted);
+    }
+    TEST_ASSERT_EQUAL(2, ranged);
+    TEST_ASSERT_TRUE(mdb_zone_map_may_contain(map, 7, 1, &wanted));
+    TEST_ASSERT_TRUE(by_host < 10);
+
+    MDBValue ts = mdb_value_int(1234);
+    TEST_ASSERT_TRUE(mdb_zone_map_may_contain(map, 24, 0, &ts));
+    TEST_ASSERT_FALSE(mdb_zone_map_may_contain(map, 25, 0, &ts));
+
+    // Resetting a page and re-adding its live rows tightens the summary.
+    TEST_ASSERT_EQUAL(OK, mdb_zone_map_reset_page(map, 41));
+    TEST_ASSERT_FALSE(mdb_zone_map_may_overlap(map, 41, 0, INT64_MIN, INT64_MAX));
+    MDBValue row[2] = {mdb_value_int(2070), mdb_value_null()};
+    TEST_ASSERT_EQUAL(OK, mdb_zone_map_add_row(map, 41, row, 2));
+    TEST_ASSERT_FALSE(mdb_zone_map_may_overlap(map, 41, 0, 2010, 2060));
+
+    // Unknown pages must always be read.
+    mdb_zone_map_drop_page(map, 40);
+    TEST_ASSERT_TRUE(mdb_zone_map_may_overlap(map, 40, 0, 0, 1));
+    for (MDBPageNumber p = 1; p <= 100; p++)
+    {
+        if (p == 40) continue;
+        TEST_ASSERT_EQUAL(p == 41, mdb_zone_map_may_overlap(map, p, 0, 2070, 2070));
+    }
+
+    mdb_zone_map_destroy(map);
+}
+
+void test_zone_map_build_from_heap(void)
+{
+    remove("test_pages.db");
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+
+    // Two heap pages of table 3 with disjoint timestamp ranges, and one of
+    // table 4 that the map must leave alone.
+    MDBPageNumber pages[3];
+    for (uint32_t p = 0; p < 3; p++)
+    {
+        MDBPage page;
+        mdb_heap_page_init(&page, p < 2 ? 3 : 4);
+        for (int64_t i = 0; i < 20; i++)
+        {
+            MDBValue row[2] = {mdb_value_int((int64_t)p * 100 + i), mdb_value_text("web", 3)};
+            uint8_t buf[64];
+            uint16_t size;
+            MDBSlotID slot;
+            TEST_ASSERT_TRUE(mdb_row_encode(row, 2, buf, sizeof(buf), &size));
+            TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, 1, buf, size, &slot));
+        }
+        TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &pages[p]));
+    }
+
+    MDBColumnDef cols[] = {{"ts", COL_TYPE_INT}, {"host", COL_TYPE_TEXT}};
+    MDBZoneMap* map;
+    TEST_ASSERT_EQUAL(OK, mdb_zone_map_create(cols, 2, &map));
+    TEST_ASSERT_EQUAL(OK, mdb_zone_map_build(map, db, 3));
+
+    TEST_ASSERT_TRUE(mdb_zone_map_may_overlap(map, pages[0], 0, 5, 5));
+    TEST_ASSERT_FALSE(mdb_zone_map_may_overlap(map, pages[0], 0, 100, 119));
+    TEST_ASSERT_TRUE(mdb_zone_map_may_overlap(map, pages[1], 0, 100, 119));
+    TEST_ASSERT_FALSE(mdb_zone_map_may_overlap(map, pages[1], 0, 0, 19));
+    MDBValue db_host = mdb_value_text("db", 2);
+    TEST_ASSERT_FALSE(mdb_zone_map_may_contain(map, pages[1], 1, &db_host));
+
+    // The other table's page is unknown to the map, so it must be read.
+    TEST_ASSERT_TRUE(mdb_zone_map_may_overlap(map, pages[2], 0, 0, 19));
+
+    mdb_zone_map_destroy(map);
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_stats_distinct_and_histogram(void)
+{
+    MDBStatsBuilder* b;
+    TEST_ASSERT_EQUAL(OK, mdb_stats_builder_create(COL_TYPE_INT, &b));
+
+    // 100k rows over 5000 distinct values, skewed so that half of the rows
+    // fall into the bottom 10% of the range; every 20th row is NULL.
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        MDBValue v = i % 20 == 1 ? mdb_value_null()
+                     : i % 2 ? mdb_value_int((int64_t)(i / 2 * 7919 % 500))
+                             : mdb_value_int((int64_t)(i / 2 * 7919 % 5000));
+        mdb_stats_builder_add(b, &v);
+    }
+
+    MDBColumnStats stats;
+    mdb_stats_builder_finish(b, &stats);
+    mdb_stats_builder_destroy(b);
+
+    TEST_ASSERT_EQUAL(100000, stats.row_count);
+    TEST_ASSERT_EQUAL(5000, stats.null_count);
+    TEST_ASSERT_TRUE(stats.distinct > 4750 && stats.distinct < 5250);
+    TEST_ASSERT_EQUAL(MDB_HISTOGRAM_BUCKETS, stats.nbuckets);
+
+    // Equi-depth: the dense low end gets most of the buckets.
+    double low = mdb_stats_selectivity_range(&stats, 0, 499);
+    double high = mdb_stats_selectivity_range(&stats, 4500, 4999);
+    TEST_ASSERT_TRUE(low > 0.45 && low < 0.62);
+    TEST_ASSERT_TRUE(high > 0.02 && high < 0.09);
+    TEST_ASSERT_TRUE(mdb_stats_selectivity_range(&stats, INT64_MIN, INT64_MAX) > 0.94);
+
+    double eq = mdb_stats_selectivity_eq(&stats);
+    TEST_ASSERT_TRUE(eq > 0.95 / 5250 && eq < 0.95 / 4750);
+
+    // Small sets come out nearly exact.
+    TEST_ASSERT_EQUAL(OK, mdb_stats_builder_create(COL_TYPE_TEXT, &b));
+    const char* words[] = {"red", "green", "blue"};
+    for (int i = 0; i < 300; i++)
+    {
+        MDBValue v = mdb_value_text(words[i % 3], (uint16_t)strlen(words[i % 3]));
+        mdb_stats_builder_add(b, &v);
+    }
+    mdb_stats_builder_finish(b, &stats);
+    mdb_stats_builder_destroy(b);
+    TEST_ASSERT_EQUAL(3, stats.distinct);
+    TEST_ASSERT_EQUAL(0, stats.nbuckets);
+}
+
+void test_stats_choose_access_path(void)
+{
+    MDBColumnStats stats = {.row_count = 100000, .distinct = 50000};
+
+    // 1000 heap pages: a point lookup uses the index, a predicate matching
+    // a tenth of the table reads the heap sequentially instead.
+    TEST_ASSERT_EQUAL(MDB_ACCESS_PATH_INDEX, mdb_stats_choose_access(&stats, 1000, mdb_stats_selectivity_eq(&stats)));
+    TEST_ASSERT_EQUAL(MDB_ACCESS_PATH_SCAN, mdb_stats_choose_access(&stats, 1000, 0.1));
+    TEST_ASSERT_EQUAL(MDB_ACCESS_PATH_INDEX, mdb_stats_choose_access(NULL, 1000, 0.1));
+
+    double cards[] = {5000.0, 20.0, 1e6};
+    uint16_t order[3];
+    mdb_stats_order_joins(cards, 3, order);
+    TEST_ASSERT_EQUAL(1, order[0]);
+    TEST_ASSERT_EQUAL(0, order[1]);
+    TEST_ASSERT_EQUAL(2, order[2]);
+
+    // ANALYZE results live in the catalog.
+    remove("test_pages.db");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}, {"name", COL_TYPE_TEXT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "users", cols, 2, 0));
+
+    MDBColumnStats got;
+    bool analyzed;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_column_stats(catalog, "users", 1, &got, &analyzed));
+    TEST_ASSERT_FALSE(analyzed);
+
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_column_stats(catalog, "users", 1, &stats));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_column_stats(catalog, "users", 1, &got, &analyzed));
+    TEST_ASSERT_TRUE(analyzed);
+    TEST_ASSERT_EQUAL(50000, got.distinct);
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_catalog_set_column_stats(catalog, "users", 2, &stats));
+
+    mdb_catalog_close(catalog);
+    mdb_close(db);
+    remove("test_pages.db");
+}
+
+void test_result_cache_lru_and_invalidation(void)
+{
+    MDBResultCache* cache;
+    TEST_ASSERT_EQUAL(OK, mdb_result_cache_create(1024, &cache));
+
+    const uint8_t rows[] = "1 alice\n2 bob\n";
+    uint64_t v = mdb_result_cache_version(cache, "users");
+    TEST_ASSERT_EQUAL(OK, mdb_result_cache_put(cache, "SELECT|users", "users", v, rows, sizeof(rows)));
+
+    uint8_t* data;
+    size_t len;
+    TEST_ASSERT_TRUE(mdb_result_cache_get(cache, "SELECT|users", "users", &data, &len));
+    TEST_ASSERT_EQUAL(sizeof(rows), len);
+    TEST_ASSERT_EQUAL_MEMORY(rows, data, len);
+    free(data);
+
+    // A write to the table makes the entry stale; other tables are unaffected.
+    TEST_ASSERT_EQUAL(OK, mdb_result_cache_put(cache, "SELECT|orders", "orders", 0, rows, 4));
+    mdb_result_cache_invalidate(cache, "users");
+    TEST_ASSERT_FALSE(mdb_result_cache_get(cache, "SELECT|users", "users", &data, &len));
+    TEST_ASSERT_TRUE(mdb_result_cache_get(cache, "SELECT|orders", "orders", &data, &len));
+    free(data);
+
+    // A result computed before a write is not stored.
+    TEST_ASSERT_EQUAL(OK, mdb_result_cache_put(cache, "SELECT|users", "users", v, rows, sizeof(rows)));
+    TEST_ASSERT_FALSE(mdb_result_cache_get(cache, "SELECT|users", "users", &data, &len));
+
+    // Filling past the byte budget evicts the least recently used entries.
+    uint8_t big[200] = {0};
+    char key[32];
+    for (int i = 0; i < 10; i++)
+    {
+        snprintf(key, sizeof(key), "SELECT|t%d", i);
+        TEST_ASSERT_EQUAL(OK, mdb_result_cache_put(cache, key, "t", 0, big, sizeof(big)));
+        TEST_ASSERT_TRUE(mdb_result_cache_get(cache, "SELECT|t0", "t", &data, &len));
+        free(data);
+    }
+    TEST_ASSERT_FALSE(mdb_result_cache_get(cache, "SELECT|t1", "t", &data, &len));
+    TEST_ASSERT_TRUE(mdb_result_cache_get(cache, "SELECT|t9", "t", &data, &len));
+    free(data);
+
+    MDBResultCacheStats stats;
+    mdb_result_cache_stats(cache, &stats);
+    TEST_ASSERT_TRUE(stats.bytes <= 1024);
+    TEST_ASSERT_TRUE(stats.evictions > 0);
+    TEST_ASSERT_EQUAL(1, stats.stale);
+
+    mdb_result_cache_destroy(cache);
+}
+
+void test_server_serves_clients(void)
+{
+    const char* address = "./test_server.sock";
+    remove("test_pages.db");
+    remove(address);
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    MDBServerConfig config = {address, 2, 0};
+    MDBServer* server;
+    TEST_ASSERT_EQUAL(OK, mdb_server_start(db, &config, &server));
+
+    int a, b;
+    TEST_ASSERT_EQUAL(OK, mdb_wire_connect(address, &a));
+    TEST_ASSERT_EQUAL(OK, mdb_wire_connect(address, &b));
+
+    char* text;
+    ErrorCode result;
+    TEST_ASSERT_EQUAL(OK, mdb_wire_query(a, "CREATE TABLE t (id INT)", &text, &result));
+    TEST_ASSERT_EQUAL(OK, result);
+    TEST_ASSERT_EQUAL_STRING("Creating table 't' with 1 columns\n", text);
+    free(text);
+
+    // Pipelined requests are answered in order.
+    const char* batch[] = {"SELECT * FROM t", "BOGUS", "HELP"};
+    for (int i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_wire_send(b, MDB_MSG_QUERY, batch[i], (uint32_t)strlen(batch[i])));
+    }
+    ErrorCode expected[] = {OK, ERR_UNSUPPORTED, OK};
+    for (int i = 0; i < 3; i++)
+    {
+        uint8_t type;
+        uint8_t* payload;
+        uint32_t len;
+        do
+        {
+            TEST_ASSERT_EQUAL(OK, mdb_wire_recv(b, &type, &payload, &len));
+            if (type == MDB_MSG_DONE) TEST_ASSERT_EQUAL(expected[i], payload[0]);
+            free(payload);
+        } while (type != MDB_MSG_DONE);
+    }
+
+    // A quoted string too long for the tokenizer is a parse error, not
+    // a crash.
+    char* big = malloc(2048);
+    TEST_ASSERT_NOT_NULL(big);
+    int n = snprintf(big, 2048, "INSERT INTO t VALUES ('");
+    memset(big + n, 'x', 2000);
+    snprintf(big + n + 2000, 2048 - (size_t)n - 2000, "')");
+    TEST_ASSERT_EQUAL(OK, mdb_wire_query(b, big, NULL, &result));
+    TEST_ASSERT_EQUAL(ERR_PARSE, result);
+    free(big);
+
+    // One connection's transaction locks the others out until it ends.
+    TEST_ASSERT_EQUAL(OK, mdb_wire_query(a, "BEGIN", NULL, &result));
+    TEST_ASSERT_EQUAL(OK, result);
+    TEST_ASSERT_EQUAL(OK, mdb_wire_query(b, "INSERT INTO t VALUES (1)", NULL, &result));
+    TEST_ASSERT_EQUAL(ERR_CONFLICT, result);
+    close(a); // rolls the transaction back
+    TEST_ASSERT_EQUAL(OK, mdb_wire_query(b, "INSERT INTO t VALUES (1)", NULL, &result));
+    TEST_ASSERT_EQUAL(OK, result);
+
+    // Binary-row requests still get their status text and result.
+    TEST_ASSERT_EQUAL(OK, mdb_wire_send(b, MDB_MSG_QUERY_ROWS, "SELECT * FROM t", 15));
+    uint8_t type;
+    uint8_t* payload;
+    uint32_t len;
+    TEST_ASSERT_EQUAL(OK, mdb_wire_recv(b, &type, &payload, &len));
+    TEST_ASSERT_EQUAL(MDB_MSG_TEXT, type);
+    free(payload);
+    TEST_ASSERT_EQUAL(OK, mdb_wire_recv(b, &type, &payload, &len));
+    TEST_ASSERT_EQUAL(MDB_MSG_DONE, type);
+    TEST_ASSERT_EQUAL(OK, payload[0]);
+    free(payload);
+
+    close(b);
+    mdb_server_stop(server);
+    mdb_close(db);
+    remove("test_pages.db");
+    remove("test_pages.db-wal");
+}
+
+void test_server_slow_reader_does_not_stall_others(void)
+{
+    const char* address = "./test_server.sock";
+    remove("test_pages.db");
+    remove(address);
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    MDBServerConfig config = {address, 2, 0};
+    MDBServer* server;
+    TEST_ASSERT_EQUAL(OK, mdb_server_start(db, &config, &server));
+
+    int slow, b;
+    TEST_ASSERT_EQUAL(OK, mdb_wire_connect(address, &slow));
+    TEST_ASSERT_EQUAL(OK, mdb_wire_connect(address, &b));
+
+    // Far more output than the socket buffers hold, never read: the worker
+    // serving `slow` ends up stuck in send(). Wait until the unread output
+    // stops growing.
+    for (int i = 0; i < 2000; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_wire_send(slow, MDB_MSG_QUERY, "HELP", 4));
+    }
+    int queued = -1;
+    for (int settled = 0; settled < 5;)
+    {
+        struct timespec tick = {0, 20 * 1000 * 1000};
+        nanosleep(&tick, NULL);
+        int now;
+        TEST_ASSERT_EQUAL(0, ioctl(slow, FIONREAD, &now));
+        settled = now == queued ? settled + 1 : 0;
+        queued = now;
+    }
+
+    // The other worker still gets to run statements; give up rather than
+    // hang if it can't.
+    struct timeval timeout = {5, 0};
+    setsockopt(b, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ErrorCode result;
+    for (int i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_wire_query(b, "SELECT * FROM t", NULL, &result));
+    }
+
+    close(slow);
+    close(b);
+    mdb_server_stop(server);
+    mdb_close(db);
+    remove("test_pages.db");
+    remove("test_pages.db-wal");
+}
+
+void test_server_caps_spooled_output(void)
+{
+    const char* address = "./test_server.sock";
+    remove("test_pages.db");
+    remove(address);
+
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_pages.db", &db));
+    MDBServerConfig config = {address, 1, 256};
+    MDBServer* server;
+    TEST_ASSERT_EQUAL(OK, mdb_server_start(db, &config, &server));
+
+    int fd;
+    TEST_ASSERT_EQUAL(OK, mdb_wire_connect(address, &fd));
+
+    // HELP prints more than the spool holds: what fits is sent, then
+    // ERR_FULL.
+    char* text;
+    ErrorCode result;
+    TEST_ASSERT_EQUAL(OK, mdb_wire_query(fd, "HELP", &text, &result));
+    TEST_ASSERT_EQUAL(ERR_FULL, result);
+    TEST_ASSERT_TRUE(strlen(text) < 256);
+    free(text);
+
+    // The connection carries on.
+    TEST_ASSERT_EQUAL(OK, mdb_wire_query(fd, "CREATE TABLE t (id INT)", NULL, &result));
+    TEST_ASSERT_EQUAL(OK, result);
+
+    close(fd);
+    mdb_server_stop(server);
+    mdb_close(db);
+    remove("test_pages.db");
+    remove("test_pages.db-wal");
+}
+
+void test_row_batch_round_trip(void)
+{
+    MDBRowBatch* batch;
+    TEST_ASSERT_EQUAL(OK, mdb_row_batch_create(3, &batch));
+
+    char name[16];
+    for (int i = 0; i < 100; i++)
+    {
+        int len = snprintf(name, sizeof(name), "user%d", i);
+        MDBValue row[] = {mdb_value_int(i * 1000 - 5), i % 3 ? mdb_value_text(name, (uint16_t)len) : mdb_value_null(),
+                          mdb_value_null()};
+        TEST_ASSERT_EQUAL(OK, mdb_row_batch_append(batch, row, 3));
+    }
+
+    // Values must match their column's type.
+    MDBValue bad[] = {mdb_value_text("x", 1), mdb_value_null(), mdb_value_null()};
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_row_batch_append(batch, bad, 3));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_row_batch_append(batch, bad, 2));
+    TEST_ASSERT_EQUAL(100, mdb_row_batch_nrows(batch));
+
+    // TEXT still in overflow pages holds only its prefix; it is refused.
+    MDBValue external[] = {mdb_value_int(1), mdb_value_text("user", 4), mdb_value_null()};
+    external[1].overflow.first_page = 7;
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_row_batch_append(batch, external, 3));
+    TEST_ASSERT_EQUAL(100, mdb_row_batch_nrows(batch));
+
+    size_t size = mdb_row_batch_encoded_size(batch);
+    uint8_t* buf = malloc(size);
+    TEST_ASSERT_EQUAL(ERR_FULL, mdb_row_batch_encode(batch, buf, size - 1, &size));
+    TEST_ASSERT_EQUAL(OK, mdb_row_batch_encode(batch, buf, size, &size));
+
+    uint16_t ncols;
+    uint32_t nrows;
+    TEST_ASSERT_EQUAL(OK, mdb_row_batch_decode(buf, size, &ncols, &nrows));
+    TEST_ASSERT_EQUAL(3, ncols);
+    TEST_ASSERT_EQUAL(100, nrows);
+    TEST_ASSERT_EQUAL(ERR_CORRUPT, mdb_row_batch_decode(buf, size - 1, &ncols, &nrows));
+
+    MDBValue values[100];
+    TEST_ASSERT_EQUAL(OK, mdb_row_batch_column(buf, size, 0, values));
+    TEST_ASSERT_EQUAL(-5, values[0].integer);
+    TEST_ASSERT_EQUAL(98995, values[99].integer);
+
+    TEST_ASSERT_EQUAL(OK, mdb_row_batch_column(buf, size, 1, values));
+    TEST_ASSERT_TRUE(values[0].is_null);
+    TEST_ASSERT_EQUAL(6, values[41].text.length);
+    TEST_ASSERT_EQUAL_MEMORY("user41", values[41].text.ptr, 6);
+
+    TEST_ASSERT_EQUAL(OK, mdb_row_batch_column(buf, size, 2, values));
+    TEST_ASSERT_TRUE(values[50].is_null);
+
+    // A reset batch takes new column types.
+    mdb_row_batch_reset(batch);
+    TEST_ASSERT_EQUAL(OK, mdb_row_batch_append(batch, bad, 3));
+    TEST_ASSERT_EQUAL(1, mdb_row_batch_nrows(batch));
+
+    free(buf);
+    mdb_row_batch_destroy(batch);
+}
+
+static void* metrics_worker(void* arg)
+{
+    (void)arg;
+    for (uint64_t us = 1; us <= 1000; us++)
+    {
+        mdb_metrics_record(MDB_LATENCY_COUNT - 1, us * 1000);
+    }
+    mdb_metrics_add(MDB_COUNTER_LOCK_WAITS, 5);
+    return NULL;
+}
+
+void test_metrics_merge_threads(void)
+{
+    MDBMetrics* before = malloc(sizeof(MDBMetrics));
+    MDBMetrics* after = malloc(sizeof(MDBMetrics));
+    TEST_ASSERT_NOT_NULL(before);
+    TEST_ASSERT_NOT_NULL(after);
+    mdb_metrics_snapshot(before);
+
+    // One thread has exited by the time of the snapshot, one is live.
+    pthread_t thread;
+    pthread_create(&thread, NULL, metrics_worker, NULL);
+    pthread_join(thread, NULL);
+    metrics_worker(NULL);
+
+    remove("test_metrics.db");
+    remove("test_metrics.db-wal");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_metrics.db", &db));
+    MDBWalRecord record = {WAL_OP_INSERT, 0, 1, 3};
+    TEST_ASSERT_EQUAL(OK, mdb_log(db, &record, "abc"));
+    mdb_close(db);
+    remove("test_metrics.db");
+    remove("test_metrics.db-wal");
+
+    mdb_metrics_snapshot(after);
+
+    const MDBLatencyHistogram* h = &after->latencies[MDB_LATENCY_COUNT - 1];
+    TEST_ASSERT_EQUAL_UINT64(2000, h->count - before->latencies[MDB_LATENCY_COUNT - 1].count);
+    TEST_ASSERT_EQUAL_UINT64(1000000, h->max_ns);
+    TEST_ASSERT_UINT64_WITHIN(30000, 500000, mdb_metrics_percentile(h, 50.0));
+    TEST_ASSERT_UINT64_WITHIN(60000, 990000, mdb_metrics_percentile(h, 99.0));
+    TEST_ASSERT_EQUAL_UINT64(10, after->counters[MDB_COUNTER_LOCK_WAITS] -
+                                     before->counters[MDB_COUNTER_LOCK_WAITS]);
+
+    TEST_ASSERT_TRUE(after->counters[MDB_COUNTER_WAL_FLUSHES] > before->counters[MDB_COUNTER_WAL_FLUSHES]);
+    TEST_ASSERT_TRUE(after->counters[MDB_COUNTER_FSYNCS] > before->counters[MDB_COUNTER_FSYNCS]);
+    TEST_ASSERT_TRUE(after->latencies[MDB_LATENCY_WAL_FLUSH].count >
+                     before->latencies[MDB_LATENCY_WAL_FLUSH].count);
+
+    free(before);
+    free(after);
+}
+
+#define BACKUP_TEST_PAGES 512
+#define BACKUP_TEST_WRITES 3000
+
+typedef struct
+{
+    MiniDB* db;
+    pthread_mutex_t* lock;
+} BackupWriter;
+
+// Page p holds version v: its first words are (v, p).
+static void backup_test_page(MDBPage* page, uint32_t version, MDBPageNumber p)
+{
+    memset(page->data, (int)(version & 0xFF), MDB_PAGE_SIZE);
+    memcpy(page->data, &version, sizeof(version));
+    memcpy(page->data + sizeof(version), &p, sizeof(p));
+}
+
+// Write i overwrites a page, or appends one every tenth time.
+static MDBPageNumber backup_test_target(uint32_t i, MDBPageNumber npages)
+{
+    return i % 10 == 0 ? npages : 1 + (i * 7919u) % (npages - 1);
+}
+
+static void* backup_writer(void* arg)
+{
+    BackupWriter* w = arg;
+    MDBPage page;
+    for (uint32_t i = 1; i <= BACKUP_TEST_WRITES; i++)
+    {
+        pthread_mutex_lock(w->lock);
+        MDBPageNumber p = backup_test_target(i, mdb_io_page_count(w->db));
+        backup_test_page(&page, i, p);
+        mdb_io_write(w->db, p, &page);
+        pthread_mutex_unlock(w->lock);
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    MiniDB* db;
+    pthread_mutex_t* lock;
+    ErrorCode err;
+} BackupRunner;
+
+static void* backup_runner(void* arg)
+{
+    BackupRunner* r = arg;
+    r->err = mdb_backup(r->db, "test_backup_copy.db", NULL, r->lock, NULL);
+    return NULL;
+}
+
+void test_backup_while_writing(void)
+{
+    remove("test_backup.db");
+    remove("test_backup.db-wal");
+    remove("test_backup_copy.db");
+    remove("test_backup_copy.db-wal");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_backup.db", &db));
+
+    MDBPage page;
+    for (MDBPageNumber p = 1; p < BACKUP_TEST_PAGES; p++)
+    {
+        backup_test_page(&page, 0, p);
+        TEST_ASSERT_EQUAL(OK, mdb_io_write(db, p, &page));
+    }
+    MDBWalRecord record = {WAL_OP_INSERT, 0, 1, 3};
+    TEST_ASSERT_EQUAL(OK, mdb_log(db, &record, "abc"));
+
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    BackupWriter writer = {db, &lock};
+    BackupRunner runner = {db, &lock, ERR_UNKNOWN};
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, backup_writer, &writer);
+    pthread_create(&threads[1], NULL, backup_runner, &runner);
+    pthread_join(threads[1], NULL);
+    pthread_join(threads[0], NULL);
+    TEST_ASSERT_EQUAL(OK, runner.err);
+
+    // The copy must be the database as it was after some write k: the
+    // newest version it holds, with every earlier write applied.
+    MiniDB* copy;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_backup_copy.db", &copy));
+    uint32_t npages = mdb_io_page_count(copy);
+    uint32_t newest = 0;
+    for (MDBPageNumber p = 1; p < npages; p++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_io_read(copy, p, &page));
+        uint32_t version;
+        memcpy(&version, page.data, sizeof(version));
+        if (version > newest) newest = version;
+    }
+
+    uint32_t* expected = calloc(BACKUP_TEST_PAGES + BACKUP_TEST_WRITES / 10 + 1, sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(expected);
+    uint32_t expected_pages = BACKUP_TEST_PAGES;
+    for (uint32_t i = 1; i <= newest; i++)
+    {
+        MDBPageNumber p = backup_test_target(i, expected_pages);
+        if (p == expected_pages) expected_pages++;
+        expected[p] = i;
+    }
+    TEST_ASSERT_EQUAL_UINT32(expected_pages, npages);
+
+    MDBPage want;
+    for (MDBPageNumber p = 1; p < npages; p++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_io_read(copy, p, &page));
+        backup_test_page(&want, expected[p], p);
+        TEST_ASSERT_EQUAL_MEMORY(want.data, page.data, MDB_PAGE_SIZE);
+    }
+    free(expected);
+    mdb_close(copy);
+
+    // The WAL came along. The destination can't be the source, its WAL
+    // or an existing file, and none of them is touched.
+    struct stat src_wal, dst_wal;
+    TEST_ASSERT_EQUAL(0, stat("test_backup.db-wal", &src_wal));
+    TEST_ASSERT_EQUAL(0, stat("test_backup_copy.db-wal", &dst_wal));
+    TEST_ASSERT_EQUAL(src_wal.st_size, dst_wal.st_size);
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_backup(db, "test_backup.db", NULL, NULL, NULL));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_backup(db, "test_backup.db-wal", NULL, NULL, NULL));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_backup(db, "test_backup_copy.db", NULL, NULL, NULL));
+    struct stat after;
+    TEST_ASSERT_EQUAL(0, stat("test_backup.db-wal", &after));
+    TEST_ASSERT_EQUAL(src_wal.st_size, after.st_size);
+    TEST_ASSERT_EQUAL(0, stat("test_backup_copy.db-wal", &after));
+    TEST_ASSERT_EQUAL(dst_wal.st_size, after.st_size);
+
+    mdb_close(db);
+    remove("test_backup.db");
+    remove("test_backup.db-wal");
+    remove("test_backup_copy.db");
+    remove("test_backup_copy.db-wal");
+}
+
+void test_page_lsn_increases(void)
+{
+    remove("test_lsn.db");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_lsn.db", &db));
+
+    MDBPage page, image;
+    MDBPageNumber page_num;
+    uint64_t last = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        mdb_page_zero(&page);
+        TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &page_num));
+        TEST_ASSERT_GREATER_THAN_UINT64(last, mdb_page_lsn(&page));
+        last = mdb_page_lsn(&page);
+    }
+
+    // Compressed images keep the LSN in their own header.
+    mdb_page_set_flags(&page, MDB_PAGE_FLAG_COMPRESS);
+    TEST_ASSERT_EQUAL(OK, mdb_page_write(db, page_num, &page));
+    TEST_ASSERT_EQUAL(OK, mdb_io_read(db, page_num, &image));
+    TEST_ASSERT_EQUAL(MDB_PAGE_SIZE > mdb_io_block_size(db), mdb_page_is_type(&image, PG_COMPRESSED));
+    TEST_ASSERT_GREATER_THAN_UINT64(last, mdb_page_image_lsn(&image));
+    TEST_ASSERT_EQUAL(OK, mdb_page_read(db, page_num, &image));
+    TEST_ASSERT_EQUAL_UINT64(mdb_page_lsn(&page), mdb_page_lsn(&image));
+    last = mdb_page_lsn(&page);
+    mdb_close(db);
+
+    // The clock resumes past every LSN handed out before the reopen.
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_lsn.db", &db));
+    mdb_page_zero(&page);
+    TEST_ASSERT_EQUAL(OK, mdb_page_write(db, 1, &page));
+    TEST_ASSERT_GREATER_THAN_UINT64(last, mdb_page_lsn(&page));
+    mdb_close(db);
+    remove("test_lsn.db");
+}
+
+static void incremental_test_write(MiniDB* db, MDBPageNumber p, uint8_t version)
+{
+    MDBPage page;
+    mdb_page_zero(&page);
+    memset(page.data, version, 256);
+    TEST_ASSERT_EQUAL(OK, mdb_page_write(db, p, &page));
+}
+
+static void incremental_test_cleanup(void)
+{
+    const char* files[] = {"test_incr.db", "test_incr_full.db", "test_incr_1.db",
+                           "test_incr_2.db", "test_incr_restored.db"};
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+        char wal[64];
+        snprintf(wal, sizeof(wal), "%s-wal", files[i]);
+        remove(files[i]);
+        remove(wal);
+    }
+}
+
+void test_incremental_backup_restore(void)
+{
+    incremental_test_cleanup();
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_incr.db", &db));
+
+    MDBPage page, want;
+    MDBPageNumber page_num;
+    for (int i = 0; i < 40; i++)
+    {
+        mdb_page_zero(&page);
+        TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &page_num));
+    }
+    MDBWalRecord record = {WAL_OP_INSERT, 0, 1, 3};
+    TEST_ASSERT_EQUAL(OK, mdb_log(db, &record, "abc"));
+
+    MDBBackupStats stats;
+    TEST_ASSERT_EQUAL(OK, mdb_backup(db, "test_incr_full.db", NULL, NULL, &stats));
+    TEST_ASSERT_EQUAL_UINT32(41, stats.copied);
+
+    // Only the header and the pages written since the base are copied.
+    incremental_test_write(db, 3, 1);
+    incremental_test_write(db, 7, 1);
+    mdb_page_zero(&page);
+    TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &page_num));
+    TEST_ASSERT_EQUAL(OK, mdb_log(db, &record, "def"));
+    TEST_ASSERT_EQUAL(OK, mdb_backup(db, "test_incr_1.db", "test_incr_full.db", NULL, &stats));
+    TEST_ASSERT_EQUAL_UINT32(4, stats.copied);
+    TEST_ASSERT_EQUAL_UINT32(42, stats.pages);
+    TEST_ASSERT_GREATER_THAN_UINT64(0, stats.wal_bytes);
+
+    incremental_test_write(db, 7, 2);
+    TEST_ASSERT_EQUAL(OK, mdb_backup(db, "test_incr_2.db", "test_incr_1.db", NULL, &stats));
+    TEST_ASSERT_EQUAL_UINT32(2, stats.copied);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.wal_bytes);
+
+    // The chain must be applied in order, and never over a database.
+    const char* skipped[] = {"test_incr_2.db"};
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_restore("test_incr_restored.db", "test_incr_full.db", skipped, 1));
+    TEST_ASSERT_EQUAL(-1, access("test_incr_restored.db", F_OK));
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_restore("test_incr.db", "test_incr_full.db", NULL, 0));
+
+    // A leftover log at the destination is neither overwritten nor removed.
+    FILE* stray = fopen("test_incr_restored.db-wal", "wb");
+    TEST_ASSERT_NOT_NULL(stray);
+    fclose(stray);
+    TEST_ASSERT_EQUAL(ERR_INVALID, mdb_restore("test_incr_restored.db", "test_incr_full.db", NULL, 0));
+    TEST_ASSERT_EQUAL(-1, access("test_incr_restored.db", F_OK));
+    TEST_ASSERT_EQUAL(0, access("test_incr_restored.db-wal", F_OK));
+    remove("test_incr_restored.db-wal");
+
+    const char* chain[] = {"test_incr_1.db", "test_incr_2.db"};
+    TEST_ASSERT_EQUAL(OK, mdb_restore("test_incr_restored.db", "test_incr_full.db", chain, 2));
+
+    MiniDB* restored;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_incr_restored.db", &restored));
+    TEST_ASSERT_EQUAL_UINT32(mdb_io_page_count(db), mdb_io_page_count(restored));
+    for (MDBPageNumber p = 0; p < mdb_io_page_count(db); p++)
+    {
+        TEST_ASSERT_EQUAL(OK, mdb_io_read(db, p, &want));
+        TEST_ASSERT_EQUAL(OK, mdb_io_read(restored, p, &page));
+        TEST_ASSERT_EQUAL_MEMORY(want.data, page.data, MDB_PAGE_SIZE);
+    }
+    mdb_close(restored);
+
+    struct stat src_wal, dst_wal;
+    TEST_ASSERT_EQUAL(0, stat("test_incr.db-wal", &src_wal));
+    TEST_ASSERT_EQUAL(0, stat("test_incr_restored.db-wal", &dst_wal));
+    TEST_ASSERT_EQUAL(src_wal.st_size, dst_wal.st_size);
+
+    mdb_close(db);
+    incremental_test_cleanup();
+}
@@ -1,4 +1,8 @@
+#include "catalog.h"
+#include "column.h"
 #include "errors.h"
+#include "heap.h"
+#include "mvcc.h"
 #include "repl.h"
 #include "unity.h"
 #include <stdio.h>
@@ -30,6 +34,45 @@ void test_parse_create_table_simple(void)
     free_tokens(&tokens);
 }
 
+void test_parse_create_table_with_compression(void)
+{
+    const char* sql = "CREATE TABLE history (id INT, body TEXT) WITH (compression = lz)";
+
+    Tokens tokens;
+    tokenize(sql, &tokens);
+
+    Statement stmt;
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    TEST_ASSERT_EQUAL(STMT_CREATE_TABLE, stmt.kind);
+    TEST_ASSERT_EQUAL(2, stmt.create_table.ncols);
+    TEST_ASSERT_TRUE(stmt.create_table.compressed);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    tokenize("CREATE TABLE t (id INT) WITH (compression = zip)", &tokens);
+    TEST_ASSERT_EQUAL(ERR_PARSE, parse_statement(&tokens, &stmt));
+    free_statement(&stmt);
+    free_tokens(&tokens);
+}
+
+void test_parse_create_table_with_column_storage(void)
+{
+    Tokens tokens;
+    tokenize("CREATE TABLE events (id INT, kind TEXT) WITH (storage = column, compression = none)", &tokens);
+
+    Statement stmt;
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    TEST_ASSERT_TRUE(stmt.create_table.columnar);
+    TEST_ASSERT_FALSE(stmt.create_table.compressed);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    tokenize("CREATE TABLE t (id INT) WITH (storage = diagonal)", &tokens);
+    TEST_ASSERT_EQUAL(ERR_PARSE, parse_statement(&tokens, &stmt));
+    free_statement(&stmt);
+    free_tokens(&tokens);
+}
+
 void test_parse_create_table_multiple_columns(void)
 {
     const char* sql = "CREATE TABLE products (id INTEGER, name VARCHAR, price INT, description TEXT)";
@@ -95,9 +138,33 @@ void test_parse_create_index(void)
     TEST_ASSERT_EQUAL_STRING("users", stmt.create_index.table_name);
     TEST_ASSERT_EQUAL(1, stmt.create_index.col_idx);
     TEST_ASSERT_EQUAL(false, stmt.create_index.is_unique);
+    TEST_ASSERT_EQUAL(MDB_INDEX_BTREE, stmt.create_index.type);
+
+    free_statement(&stmt);
+    free_tokens(&tokens);
+}
+
+void test_parse_create_index_using_hash(void)
+{
+    const char* sql = "CREATE INDEX idx_token ON sessions (0) USING HASH";
+
+    Tokens tokens;
+    tokenize(sql, &tokens);
+
+    Statement stmt;
+    ErrorCode err = parse_statement(&tokens, &stmt);
+
+    TEST_ASSERT_EQUAL(OK, err);
+    TEST_ASSERT_EQUAL(STMT_CREATE_INDEX, stmt.kind);
+    TEST_ASSERT_EQUAL_STRING("sessions", stmt.create_index.table_name);
+    TEST_ASSERT_EQUAL(MDB_INDEX_HASH, stmt.create_index.type);
 
     free_statement(&stmt);
     free_tokens(&tokens);
+
+    tokenize("CREATE INDEX idx_token ON sessions (0) USING SKIPLIST", &tokens);
+    TEST_ASSERT_EQUAL(ERR_PARSE, parse_statement(&tokens, &stmt));
+    free_tokens(&tokens);
 }
 
 void test_parse_drop_index(void)
@@ -451,6 +518,99 @@ void test_parse_quit(void)
     free_tokens(&tokens);
 }
 
+void test_parse_transaction_statements(void)
+{
+    const char* commands[] = {"BEGIN", "begin transaction", "COMMIT", "ROLLBACK"};
+    StmtKind expected[] = {STMT_BEGIN, STMT_BEGIN, STMT_COMMIT, STMT_ROLLBACK};
+
+    for (int i = 0; i < 4; i++)
+    {
+        Tokens tokens;
+        tokenize(commands[i], &tokens);
+
+        Statement stmt;
+        ErrorCode err = parse_statement(&tokens, &stmt);
+
+        TEST_ASSERT_EQUAL_MESSAGE(OK, err, commands[i]);
+        TEST_ASSERT_EQUAL_MESSAGE(expected[i], stmt.kind, commands[i]);
+
+        free_statement(&stmt);
+        free_tokens(&tokens);
+    }
+
+    const char* invalid[] = {"BEGIN now", "COMMIT garbage", "ROLLBACK everything"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        Tokens tokens;
+        Statement stmt;
+        tokenize(invalid[i], &tokens);
+        TEST_ASSERT_EQUAL_MESSAGE(ERR_PARSE, parse_statement(&tokens, &stmt), invalid[i]);
+        free_tokens(&tokens);
+    }
+}
+
+void test_parse_analyze(void)
+{
+    Tokens tokens;
+    Statement stmt;
+
+    tokenize("ANALYZE events", &tokens);
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    TEST_ASSERT_EQUAL(STMT_ANALYZE, stmt.kind);
+    TEST_ASSERT_EQUAL_STRING("events", stmt.analyze.table_name);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    tokenize("analyze", &tokens);
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    TEST_ASSERT_NULL(stmt.analyze.table_name);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    tokenize("ANALYZE a b", &tokens);
+    TEST_ASSERT_EQUAL(ERR_PARSE, parse_statement(&tokens, &stmt));
+    free_tokens(&tokens);
+}
+
+void test_statement_cache_key_normalizes(void)
+{
+    const char* same[] = {"select * from users where 1 = 'x'", "SELECT  *  FROM users WHERE 1='x'"};
+    char* keys[2];
+    for (int i = 0; i < 2; i++)
+    {
+        Tokens tokens;
+        Statement stmt;
+        tokenize(same[i], &tokens);
+        TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+        keys[i] = statement_cache_key(&stmt);
+        free_statement(&stmt);
+        free_tokens(&tokens);
+    }
+    TEST_ASSERT_NOT_NULL(keys[0]);
+    TEST_ASSERT_EQUAL_STRING(keys[0], keys[1]);
+
+    // A different literal type gives a different key.
+    Tokens tokens;
+    Statement stmt;
+    tokenize("SELECT * FROM users WHERE 1 = 1", &tokens);
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    char* other = statement_cache_key(&stmt);
+    TEST_ASSERT_TRUE(strcmp(keys[0], other) != 0);
+    free(other);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    // Writes are never cached.
+    tokenize("DELETE FROM users", &tokens);
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    TEST_ASSERT_NULL(statement_cache_key(&stmt));
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    free(keys[0]);
+    free(keys[1]);
+}
+
 void test_parse_case_insensitive(void)
 {
     const char* commands[] = {
@@ -517,4 +677,249 @@ void test_parse_invalid_statements(void)
         free_tokens(&tokens);
         // Don't free statement on parse error
     }
-}
\ No newline at end of file
+}
+static ErrorCode count_rows(void* ctx, const MDBValue* cols, uint16_t ncols)
+{
+    (void)cols;
+    *(int*)ctx += ncols;
+    return OK;
+}
+
+void test_emit_row_to_sink_or_text(void)
+{
+    MDBValue row[] = {mdb_value_int(-7), mdb_value_null(), mdb_value_text("bob", 3)};
+
+    int seen = 0;
+    RowSink sink = {count_rows, &seen};
+    TEST_ASSERT_EQUAL(OK, emit_row(&sink, NULL, row, 3));
+    TEST_ASSERT_EQUAL(3, seen);
+
+    FILE* out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_EQUAL(OK, emit_row(NULL, out, row, 3));
+    rewind(out);
+    char text[64] = "";
+    TEST_ASSERT_NOT_NULL(fgets(text, sizeof(text), out));
+    TEST_ASSERT_EQUAL_STRING("-7 | NULL | bob\n", text);
+    fclose(out);
+}
+
+void test_script_reader_splits_statements(void)
+{
+    FILE* in = tmpfile();
+    TEST_ASSERT_NOT_NULL(in);
+    fputs("-- setup\n"
+          "CREATE TABLE t (a INT, b TEXT);;\n"
+          "INSERT INTO t VALUES (1, 'a;b -- c'); -- trailing comment\n",
+          in);
+    for (int i = 0; i < 5000; i++)
+    {
+        fprintf(in, "INSERT INTO t VALUES (%d, 'x');\n", i);
+    }
+    fputs("SELECT * FROM t", in);
+    rewind(in);
+
+    ScriptReader reader;
+    TEST_ASSERT_EQUAL(OK, script_reader_init(&reader, in));
+
+    const char* sql;
+    TEST_ASSERT_EQUAL(OK, script_next_statement(&reader, &sql));
+    TEST_ASSERT_EQUAL_STRING("CREATE TABLE t (a INT, b TEXT)", sql);
+    TEST_ASSERT_EQUAL(OK, script_next_statement(&reader, &sql));
+    TEST_ASSERT_EQUAL_STRING("INSERT INTO t VALUES (1, 'a;b -- c')", sql);
+
+    // The rest spans several read chunks.
+    int inserts = 0;
+    while (script_next_statement(&reader, &sql) == OK && sql && strncmp(sql, "INSERT", 6) == 0)
+    {
+        inserts++;
+    }
+    TEST_ASSERT_EQUAL(5000, inserts);
+    TEST_ASSERT_EQUAL_STRING("SELECT * FROM t", sql);
+
+    TEST_ASSERT_EQUAL(OK, script_next_statement(&reader, &sql));
+    TEST_ASSERT_NULL(sql);
+
+    script_reader_free(&reader);
+    fclose(in);
+}
+
+void test_script_reader_comment_mid_statement(void)
+{
+    FILE* in = tmpfile();
+    TEST_ASSERT_NOT_NULL(in);
+    fputs("SELECT a--x\nFROM t;", in);
+    rewind(in);
+
+    ScriptReader reader;
+    TEST_ASSERT_EQUAL(OK, script_reader_init(&reader, in));
+
+    const char* sql;
+    TEST_ASSERT_EQUAL(OK, script_next_statement(&reader, &sql));
+    TEST_ASSERT_EQUAL_STRING("SELECT a FROM t", sql);
+
+    script_reader_free(&reader);
+    fclose(in);
+}
+
+void test_stats_statement_reports_metrics(void)
+{
+    remove("test_stats.db");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_stats.db", &db));
+    FILE* out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+
+    const char* sql[] = {"HELP", "stats"};
+    for (int i = 0; i < 2; i++)
+    {
+        Tokens tokens;
+        Statement stmt;
+        tokenize(sql[i], &tokens);
+        TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+        TEST_ASSERT_EQUAL(OK, execute_statement(db, &stmt, out, NULL));
+        free_statement(&stmt);
+        free_tokens(&tokens);
+    }
+
+    char text[8192];
+    rewind(out);
+    size_t len = fread(text, 1, sizeof(text) - 1, out);
+    text[len] = '\0';
+    TEST_ASSERT_NOT_NULL(strstr(text, "\npage_reads "));
+    TEST_ASSERT_NOT_NULL(strstr(text, "\nbuffer_hit_ratio "));
+    TEST_ASSERT_NOT_NULL(strstr(text, "\nfsync_us count="));
+    TEST_ASSERT_NOT_NULL(strstr(text, "\nstatement_us{kind=help} count="));
+
+    Tokens tokens;
+    Statement stmt;
+    tokenize("STATS now", &tokens);
+    TEST_ASSERT_EQUAL(ERR_PARSE, parse_statement(&tokens, &stmt));
+    free_tokens(&tokens);
+
+    fclose(out);
+    mdb_close(db);
+    remove("test_stats.db");
+}
+
+static ErrorCode run_sql(MiniDB* db, const char* sql, FILE* out)
+{
+    Tokens tokens;
+    Statement stmt;
+    ErrorCode err = tokenize(sql, &tokens);
+    memset(&stmt, 0, sizeof(stmt));
+    if (err == OK) err = parse_statement(&tokens, &stmt);
+    if (err == OK) err = execute_statement(db, &stmt, out, NULL);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+    return err;
+}
+
+void test_analyze_statement_stores_stats(void)
+{
+    remove("test_analyze.db");
+    remove("test_analyze.db-wal");
+    MiniDB* db;
+    TEST_ASSERT_EQUAL(OK, mdb_open("test_analyze.db", &db));
+
+    // A heap table: four live rows and one deleted version.
+    MDBPage page;
+    MDBPageNumber heap_root;
+    mdb_page_zero(&page);
+    TEST_ASSERT_EQUAL(OK, mdb_page_allocate(db, &page, &heap_root));
+    mdb_heap_page_init(&page, 7);
+    for (int64_t i = 0; i < 5; i++)
+    {
+        MDBValue row[] = {mdb_value_int(i % 2), mdb_value_text("x", 1)};
+        uint8_t buf[64];
+        uint16_t size;
+        MDBSlotID slot;
+        TEST_ASSERT_TRUE(mdb_row_encode(row, 2, buf, sizeof(buf), &size));
+        TEST_ASSERT_EQUAL(OK, mdb_mvcc_insert(&page, 1, buf, size, &slot));
+        if (i == 4)
+        {
+            MDBTupleHeader tuple = {.xmin = 1, .xmax = 2};
+            const uint8_t* record;
+            uint16_t len;
+            TEST_ASSERT_EQUAL(OK, mdb_heap_page_get(&page, slot, &record, &len));
+            memcpy((uint8_t*)record, &tuple, sizeof(tuple));
+        }
+    }
+    TEST_ASSERT_EQUAL(OK, mdb_page_write(db, heap_root, &page));
+
+    MDBCatalog* catalog;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+    MDBCatalogColumn cols[] = {{"id", COL_TYPE_INT}, {"name", COL_TYPE_TEXT}};
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "users", cols, 2, heap_root));
+
+    // A columnar table with one populated column.
+    MDBValue values[3] = {mdb_value_int(10), mdb_value_null(), mdb_value_int(30)};
+    MDBPageNumber root = 0;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_create_table(catalog, "events", cols, 2, 0));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_table_flags(catalog, "events", MDB_TABLE_COLUMNAR));
+    TEST_ASSERT_EQUAL(OK, mdb_column_append(db, COL_TYPE_INT, &root, values, 3));
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_set_column_root(catalog, "events", 0, root));
+    mdb_catalog_close(catalog);
+
+    FILE* out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_EQUAL(OK, run_sql(db, "ANALYZE users", out));
+    TEST_ASSERT_EQUAL(OK, run_sql(db, "ANALYZE", out));
+    TEST_ASSERT_EQUAL(ERR_INVALID, run_sql(db, "ANALYZE missing", out));
+
+    char text[512];
+    rewind(out);
+    size_t len = fread(text, 1, sizeof(text) - 1, out);
+    text[len] = '\0';
+    TEST_ASSERT_NOT_NULL(strstr(text, "Analyzed table 'users': 4 rows\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "Analyzed table 'events': 3 rows\n"));
+    fclose(out);
+
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_open(db, &catalog));
+    MDBColumnStats stats;
+    bool analyzed;
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_column_stats(catalog, "users", 0, &stats, &analyzed));
+    TEST_ASSERT_TRUE(analyzed);
+    TEST_ASSERT_EQUAL_UINT64(4, stats.row_count);
+    TEST_ASSERT_EQUAL_UINT64(2, stats.distinct);
+    TEST_ASSERT_EQUAL(OK, mdb_catalog_get_column_stats(catalog, "events", 0, &stats, &analyzed));
+    TEST_ASSERT_TRUE(analyzed);
+    TEST_ASSERT_EQUAL_UINT64(3, stats.row_count);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.null_count);
+    mdb_catalog_close(catalog);
+
+    mdb_close(db);
+    remove("test_analyze.db");
+    remove("test_analyze.db-wal");
+}
+
+void test_parse_backup(void)
+{
+    Tokens tokens;
+    Statement stmt;
+    tokenize("BACKUP TO '/var/backups/mini.db'", &tokens);
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    TEST_ASSERT_EQUAL(STMT_BACKUP, stmt.kind);
+    TEST_ASSERT_EQUAL_STRING("/var/backups/mini.db", stmt.backup.path);
+    TEST_ASSERT_NULL(stmt.backup.base);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    tokenize("backup to 'mon.db' since 'sun.db'", &tokens);
+    TEST_ASSERT_EQUAL(OK, parse_statement(&tokens, &stmt));
+    TEST_ASSERT_EQUAL_STRING("mon.db", stmt.backup.path);
+    TEST_ASSERT_EQUAL_STRING("sun.db", stmt.backup.base);
+    free_statement(&stmt);
+    free_tokens(&tokens);
+
+    const char* invalid[] = {"BACKUP", "BACKUP TO", "BACKUP TO ''", "BACKUP TO x.db",
+                             "BACKUP INTO 'x.db'", "BACKUP TO 'x.db' now",
+                             "BACKUP TO 'x.db' SINCE", "BACKUP TO 'x.db' SINCE y.db",
+                             "BACKUP TO 'x.db' SINCE 'y.db' now"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        tokenize(invalid[i], &tokens);
+        TEST_ASSERT_EQUAL(ERR_PARSE, parse_statement(&tokens, &stmt));
+        free_tokens(&tokens);
+    }
+}
@@ -2,12 +2,69 @@
 
 // Forward declarations of test functions
 void test_placeholder(void);
+void test_btree_leaf_insert_keeps_keys_sorted(void);
+void test_btree_leaf_prefix_compression(void);
+void test_btree_leaf_split_truncates_separator(void);
+void test_btree_tree_insert_and_lookup(void);
+void test_btree_separator(void);
+void test_hash_bucket_insert_lookup(void);
+void test_hash_bucket_split(void);
+void test_hash_index_grows_and_chains(void);
+void test_catalog_tables(void);
+void test_catalog_indexes_follow_table(void);
+void test_catalog_persists(void);
+void test_catalog_row_ids_recover_from_wal(void);
+void test_catalog_row_id_reservation_skips_open_txn(void);
+void test_catalog_row_ids_concurrent(void);
+void test_heap_page_insert_get_delete(void);
+void test_mvcc_snapshot_isolation(void);
+void test_mvcc_write_conflict(void);
+void test_mvcc_survives_reopen(void);
+void test_row_encode_decode(void);
+void test_txn_commit_batches_wal_records(void);
+void test_latch_shared_exclusive(void);
+void test_latch_crabbing_releases_ancestors(void);
+void test_latch_exclusive_across_threads(void);
+void test_page_allocate_read_write(void);
+void test_io_batch_and_scan(void);
+void test_page_allocate_concurrent(void);
+void test_buffer_pool_scan_keeps_hot_pages(void);
+void test_buffer_pool_sequential_detection_and_flush(void);
+void test_buffer_pool_concurrent_pins(void);
+void test_crc32c(void);
+void test_page_checksum_detects_corruption(void);
+void test_lz_roundtrip(void);
+void test_compressed_heap_page_roundtrip(void);
+void test_overflow_large_text(void);
+void test_overflow_failure_frees_pages(void);
+void test_open_rejects_other_page_size(void);
+void test_open_rejects_damaged_header(void);
+void test_freelist_reuses_pages(void);
+void test_page_shrink_truncates_file(void);
+void test_column_int_frame_of_reference(void);
+void test_column_text_encodings(void);
+void test_zone_map_skips_pages(void);
+void test_zone_map_build_from_heap(void);
+void test_stats_distinct_and_histogram(void);
+void test_stats_choose_access_path(void);
+void test_result_cache_lru_and_invalidation(void);
+void test_server_serves_clients(void);
+void test_server_slow_reader_does_not_stall_others(void);
+void test_server_caps_spooled_output(void);
+void test_row_batch_round_trip(void);
+void test_metrics_merge_threads(void);
+void test_backup_while_writing(void);
+void test_page_lsn_increases(void);
+void test_incremental_backup_restore(void);
 
 // REPL test functions
 void test_parse_create_table_simple(void);
 void test_parse_create_table_multiple_columns(void);
+void test_parse_create_table_with_compression(void);
+void test_parse_create_table_with_column_storage(void);
 void test_parse_drop_table(void);
 void test_parse_create_index(void);
+void test_parse_create_index_using_hash(void);
 void test_parse_drop_index(void);
 void test_parse_insert_integers(void);
 void test_parse_insert_mixed_types(void);
@@ -23,6 +80,15 @@ void test_parse_list_tables(void);
 void test_parse_help(void);
 void test_parse_exit(void);
 void test_parse_quit(void);
+void test_parse_transaction_statements(void);
+void test_parse_analyze(void);
+void test_parse_backup(void);
+void test_statement_cache_key_normalizes(void);
+void test_emit_row_to_sink_or_text(void);
+void test_script_reader_splits_statements(void);
+void test_script_reader_comment_mid_statement(void);
+void test_stats_statement_reports_metrics(void);
+void test_analyze_statement_stores_stats(void);
 void test_parse_case_insensitive(void);
 void test_parse_invalid_statements(void);
 
@@ -40,12 +106,69 @@ int main(void)
 
     // General database tests
     RUN_TEST(test_placeholder);
+    RUN_TEST(test_btree_leaf_insert_keeps_keys_sorted);
+    RUN_TEST(test_btree_leaf_prefix_compression);
+    RUN_TEST(test_btree_leaf_split_truncates_separator);
+    RUN_TEST(test_btree_tree_insert_and_lookup);
+    RUN_TEST(test_btree_separator);
+    RUN_TEST(test_hash_bucket_insert_lookup);
+    RUN_TEST(test_hash_bucket_split);
+    RUN_TEST(test_hash_index_grows_and_chains);
+    RUN_TEST(test_catalog_tables);
+    RUN_TEST(test_catalog_indexes_follow_table);
+    RUN_TEST(test_catalog_persists);
+    RUN_TEST(test_catalog_row_ids_recover_from_wal);
+    RUN_TEST(test_catalog_row_id_reservation_skips_open_txn);
+    RUN_TEST(test_catalog_row_ids_concurrent);
+    RUN_TEST(test_heap_page_insert_get_delete);
+    RUN_TEST(test_mvcc_snapshot_isolation);
+    RUN_TEST(test_mvcc_write_conflict);
+    RUN_TEST(test_mvcc_survives_reopen);
+    RUN_TEST(test_row_encode_decode);
+    RUN_TEST(test_txn_commit_batches_wal_records);
+    RUN_TEST(test_latch_shared_exclusive);
+    RUN_TEST(test_latch_crabbing_releases_ancestors);
+    RUN_TEST(test_latch_exclusive_across_threads);
+    RUN_TEST(test_page_allocate_read_write);
+    RUN_TEST(test_io_batch_and_scan);
+    RUN_TEST(test_page_allocate_concurrent);
+    RUN_TEST(test_buffer_pool_scan_keeps_hot_pages);
+    RUN_TEST(test_buffer_pool_sequential_detection_and_flush);
+    RUN_TEST(test_buffer_pool_concurrent_pins);
+    RUN_TEST(test_crc32c);
+    RUN_TEST(test_page_checksum_detects_corruption);
+    RUN_TEST(test_lz_roundtrip);
+    RUN_TEST(test_compressed_heap_page_roundtrip);
+    RUN_TEST(test_overflow_large_text);
+    RUN_TEST(test_overflow_failure_frees_pages);
+    RUN_TEST(test_open_rejects_other_page_size);
+    RUN_TEST(test_open_rejects_damaged_header);
+    RUN_TEST(test_freelist_reuses_pages);
+    RUN_TEST(test_page_shrink_truncates_file);
+    RUN_TEST(test_column_int_frame_of_reference);
+    RUN_TEST(test_column_text_encodings);
+    RUN_TEST(test_zone_map_skips_pages);
+    RUN_TEST(test_zone_map_build_from_heap);
+    RUN_TEST(test_stats_distinct_and_histogram);
+    RUN_TEST(test_stats_choose_access_path);
+    RUN_TEST(test_result_cache_lru_and_invalidation);
+    RUN_TEST(test_server_serves_clients);
+    RUN_TEST(test_server_slow_reader_does_not_stall_others);
+    RUN_TEST(test_server_caps_spooled_output);
+    RUN_TEST(test_row_batch_round_trip);
+    RUN_TEST(test_metrics_merge_threads);
+    RUN_TEST(test_backup_while_writing);
+    RUN_TEST(test_page_lsn_increases);
+    RUN_TEST(test_incremental_backup_restore);
 
     // REPL parsing tests
     RUN_TEST(test_parse_create_table_simple);
     RUN_TEST(test_parse_create_table_multiple_columns);
+    RUN_TEST(test_parse_create_table_with_compression);
+    RUN_TEST(test_parse_create_table_with_column_storage);
     RUN_TEST(test_parse_drop_table);
     RUN_TEST(test_parse_create_index);
+    RUN_TEST(test_parse_create_index_using_hash);
     RUN_TEST(test_parse_drop_index);
     RUN_TEST(test_parse_insert_integers);
     RUN_TEST(test_parse_insert_mixed_types);
@@ -61,6 +184,15 @@ int main(void)
     RUN_TEST(test_parse_help);
     RUN_TEST(test_parse_exit);
     RUN_TEST(test_parse_quit);
+    RUN_TEST(test_parse_transaction_statements);
+    RUN_TEST(test_parse_analyze);
+    RUN_TEST(test_parse_backup);
+    RUN_TEST(test_statement_cache_key_normalizes);
+    RUN_TEST(test_emit_row_to_sink_or_text);
+    RUN_TEST(test_script_reader_splits_statements);
+    RUN_TEST(test_script_reader_comment_mid_statement);
+    RUN_TEST(test_stats_statement_reports_metrics);
+    RUN_TEST(test_analyze_statement_stores_stats);
     RUN_TEST(test_parse_case_insensitive);
     RUN_TEST(test_parse_invalid_statements);
 